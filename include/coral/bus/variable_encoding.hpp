@@ -0,0 +1,38 @@
+/**
+\file
+\brief  Defines the coral::bus::VariableEncoding enum.
+\copyright
+    Copyright 2013-present, SINTEF Ocean.
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+#ifndef CORAL_BUS_VARIABLE_ENCODING_HPP_INCLUDED
+#define CORAL_BUS_VARIABLE_ENCODING_HPP_INCLUDED
+
+
+namespace coral
+{
+namespace bus
+{
+
+
+/// The encodings which may be used for variable values on the network.
+enum VariableEncoding
+{
+    /// Protocol Buffers.  This is understood by all versions of Coral.
+    PROTOBUF_VARIABLE_ENCODING = 0,
+
+    /**
+    \brief  A compact, fixed-layout binary encoding which is considerably
+            cheaper to create and parse.
+
+    This is only understood by subscribers which support version 2 or later
+    of the execution protocol.
+    */
+    BINARY_VARIABLE_ENCODING = 1,
+};
+
+
+}} // namespace
+#endif // header guard
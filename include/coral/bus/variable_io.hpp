@@ -13,16 +13,24 @@
 
 #include <chrono>
 #include <memory>
-#include <queue>
+#include <set>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include <coral/bus/variable_encoding.hpp>
 #include <coral/model.hpp>
 #include <coral/net.hpp>
 
 
 // Forward declaration to avoid dependency on ZMQ headers
-namespace zmq { class socket_t; }
+namespace zmq { class message_t; class socket_t; }
+
+// Forward declaration to avoid dependency on private headers
+namespace coral { namespace protocol { namespace exe_data
+{
+    struct BatchMessage;
+}}}
 
 
 namespace coral
@@ -31,6 +39,12 @@ namespace bus
 {
 
 
+// Forward declarations to avoid dependency on private headers.  These
+// types are held by std::shared_ptr, which doesn't need their definitions.
+class SharedMemoryRingWriter;
+class SharedMemoryRingReader;
+
+
 /// A class which handles publishing of variable values on the network.
 class VariablePublisher
 {
@@ -45,6 +59,10 @@ public:
     /**
     \brief  Binds to a local endpoint.
 
+    If the endpoint uses the TCP transport, the publisher also makes its
+    values available to subscribers on the same host through shared memory
+    (see SharedMemoryEndpoint()).
+
     \param [in] endpoint
         The endpoint, in the format `tcp://<interface>:<port>`, where
         "interface" may be "*" to signify all network interfaces, and
@@ -64,6 +82,16 @@ public:
     */
     coral::net::Endpoint BoundEndpoint() const;
 
+    /**
+    \brief  Sets the encoding used for all subsequently published values.
+
+    The default is `PROTOBUF_VARIABLE_ENCODING`.
+    */
+    void SetEncoding(VariableEncoding encoding) noexcept;
+
+    /// Returns the encoding used for published values.
+    VariableEncoding Encoding() const noexcept;
+
     /**
     \brief  Publishes the value of a single variable.
 
@@ -86,8 +114,68 @@ public:
         coral::model::VariableID variableID,
         coral::model::ScalarValue value);
 
+    /**
+    \brief  Publishes the values of several variables in a single message.
+
+    All the variables must belong to the same slave, and the values must
+    all be for the same time step.  The recipient demultiplexes the message
+    into individual values, so the same requirements as for Publish() apply.
+
+    Note that batches are only understood by subscribers which support
+    version 1 or later of the execution protocol.
+
+    \param [in] stepID      Time step ID
+    \param [in] slaveID     Slave ID
+    \param [in] variableIDs An array of variable IDs
+    \param [in] values      An array of variable values, where each element
+                            corresponds to the element in `variableIDs` at the
+                            same index.
+    \param [in] count       The size of the `variableIDs` and `values` arrays
+
+    \pre Bind() has been called successfully on this instance.
+    */
+    void Publish(
+        coral::model::StepID stepID,
+        coral::model::SlaveID slaveID,
+        const coral::model::VariableID* variableIDs,
+        const coral::model::ScalarValue* values,
+        std::size_t count);
+
+    /**
+    \brief  Publishes a block of typed variable values in a single message.
+
+    This is equivalent to the array-based overload, but with the binary
+    encoding, the values are encoded straight from the columns of `values`,
+    without any conversion to and from coral::model::ScalarValue.
+
+    \param [in] stepID      Time step ID
+    \param [in] slaveID     Slave ID
+    \param [in] values      The variable values
+
+    \pre Bind() has been called successfully on this instance.
+    */
+    void Publish(
+        coral::model::StepID stepID,
+        coral::model::SlaveID slaveID,
+        const coral::model::ValueBlock& values);
+
 private:
+    // Sends a message through the socket and the shared memory ring, but
+    // only through those that someone is listening to.
+    void Send(coral::model::StepID stepID, std::vector<zmq::message_t>& msg);
+
+    // Whether anyone is listening to the ring or the socket.  If not, we
+    // don't even build the message.
+    bool HasListeners();
+
+    // Processes new (un)subscriptions on the socket, and returns whether
+    // there are any.
+    bool HasTcpSubscribers();
+
     std::unique_ptr<zmq::socket_t> m_socket;
+    std::shared_ptr<SharedMemoryRingWriter> m_ring;
+    VariableEncoding m_encoding;
+    int m_tcpSubscriptions;
 };
 
 
@@ -110,6 +198,11 @@ public:
     new ones are established.  Thus, *all* endpoints must be specified each
     time.
 
+    Endpoints created with SharedMemoryEndpoint() refer to publishers on the
+    same host, whose values are read directly from shared memory.  If that
+    turns out not to be possible, e.g. because the publisher doesn't support
+    it, the subscriber falls back to connecting over TCP.
+
     \param [in] endpoints
         A pointer to an array of endpoints.
     \param [in] endpointsSize
@@ -119,12 +212,68 @@ public:
         const coral::net::Endpoint* endpoints,
         std::size_t endpointsSize);
 
+    /**
+    \brief  Connects to one more remote endpoint, without affecting existing
+            connections.
+
+    \pre Connect() has been called successfully on this instance.
+    */
+    void ConnectTo(const coral::net::Endpoint& endpoint);
+
+    /**
+    \brief  Breaks the connection to a remote endpoint, without affecting
+            other connections.
+
+    \param [in] endpoint
+        An endpoint which has previously been connected to, either with
+        Connect() or ConnectTo().
+
+    \pre Connect() has been called successfully on this instance.
+    */
+    void DisconnectFrom(const coral::net::Endpoint& endpoint);
+
+    /**
+    \brief  Waits until the connections made with Connect() and ConnectTo()
+            have been established.
+
+    ZeroMQ connects in the background, and a publisher does not know about
+    our subscriptions until the connection is up, so values published in
+    the meantime are lost.  Once this function returns `true`, our
+    subscriptions are on their way to all publishers.  Connections to
+    publishers which are read through shared memory are established
+    immediately.
+
+    \param [in] timeout
+        The maximum time to wait.  A negative value means to wait
+        indefinitely.
+    \returns
+        Whether all connections were established in time.
+    \pre Connect() has been called successfully on this instance.
+    */
+    bool WaitForPeers(std::chrono::milliseconds timeout);
+
     /**
     \brief Subscribes to the given variable.
 
+    \param [in] variable
+        The variable to subscribe to.
+    \param [in] delay
+        The number of time steps by which the variable's values are delayed
+        (see Update()).  If the variable is already subscribed to, this must
+        be the same as before.
+
+    \returns
+        The subscription's slot number, which may be passed to Value() to
+        look up the variable's value in constant time.  It stays the same
+        until the variable is unsubscribed from, and is then reused for
+        later subscriptions.
+
+    \throws std::invalid_argument
+        If `delay` is negative or differs from that of an existing
+        subscription to the same variable.
     \pre Connect() has been called successfully on this instance.
     */
-    void Subscribe(const coral::model::Variable& variable);
+    std::size_t Subscribe(const coral::model::Variable& variable, int delay = 0);
 
     /**
     \brief Unsubscribes from the given variable.
@@ -137,17 +286,33 @@ public:
     \brief  Waits until the values of all subscribed-to variables have been
             received for the given time step.
 
+    Values may arrive either individually or in batches (see
+    VariablePublisher::Publish()); batches are split up and the values they
+    contain are queued just like individually received ones.  Both
+    encodings (see VariableEncoding) are recognised automatically.
+
+    For a variable which was subscribed to with a nonzero delay `d`, the
+    function waits for the value from time step `stepID - d` instead.  Values
+    from later time steps are kept until they are due, so they may arrive
+    at any time before that.
+
     \param [in] stepID      The timestep ID for which we should wait for
                             variable data.
     \param [in] timeout     How long to wait without receiving any data.
                             A negative value means to wait indefinitely.
+    \param [in] ignoreDelays
+        Whether to wait for the values from time step `stepID` for all
+        variables, regardless of their delays.  This is used when values
+        are resent and should take effect immediately, e.g. to set up
+        initial values.
 
     \returns Whether a value has been received for all variables.
     \pre Connect() has been called successfully on this instance.
     */
     bool Update(
         coral::model::StepID stepID,
-        std::chrono::milliseconds timeout);
+        std::chrono::milliseconds timeout,
+        bool ignoreDelays = false);
 
     /**
     \brief  Returns the value of the given variable which was acquired with the
@@ -155,7 +320,8 @@ public:
 
     This function may not be called if Update() has not been called yet, or if
     the last Update() call failed.  Furthermore, the returned reference is only
-    guaranteed to be valid until the next Update() call.
+    guaranteed to be valid until the next call to Update(), Subscribe() or
+    Unsubscribe().
 
     \param [in] variable    A variable identifier. The variable must be one
                             which has previously been subscribed to with
@@ -166,9 +332,92 @@ public:
     const coral::model::ScalarValue& Value(const coral::model::Variable& variable)
         const;
 
+    /**
+    \brief  Returns the value of the variable whose subscription has the
+            given slot number.
+
+    This is equivalent to the other overload, but avoids looking up the
+    variable.
+
+    \param [in] slot    A slot number returned by Subscribe() for a variable
+                        which is still subscribed to.
+
+    \pre Update() has been called successfully.
+    */
+    const coral::model::ScalarValue& Value(std::size_t slot) const;
+
+    /**
+    \brief  The underlying socket, for use with coral::net::Reactor.
+
+    The socket has incoming data when new values may have arrived.  This
+    can be used to call Update() with a zero timeout only when it may
+    succeed, rather than blocking in it.  The socket is replaced by
+    Connect(), so it must be re-registered afterwards.
+
+    Values which arrive through shared memory do not make the socket
+    readable, so if HasLocalPeers() is true, Update() must be polled.
+
+    \pre Connect() has been called successfully on this instance.
+    */
+    zmq::socket_t& Socket();
+
+    /// Whether any values are received through shared memory.
+    bool HasLocalPeers() const noexcept;
+
+    /**
+    \brief  Enables or disables busy polling in Update().
+
+    If `spinBudget` is positive, Update() checks for incoming data without
+    blocking for up to this long each time it has to wait, and only then
+    goes to sleep.  This reduces latency at the cost of CPU time, so it is
+    only sensible when there are cores to spare.  The default is zero,
+    which disables busy polling.
+    */
+    void SetSpinBudget(std::chrono::microseconds spinBudget) noexcept;
+
+    /// Statistics on the time Update() has spent waiting for data.
+    const coral::net::BusyPollStats& PollStats() const noexcept;
+
 private:
-    typedef std::queue<std::pair<coral::model::StepID, coral::model::ScalarValue>>
-        ValueQueue;
+    // Connects to a single endpoint, which may be a shared memory endpoint.
+    void AddPeer(const coral::net::Endpoint& endpoint);
+
+    // Waits until there is incoming data on the socket or in any of the
+    // shared memory rings.
+    bool WaitForData(std::chrono::milliseconds timeout);
+
+    // Queues the values in all unread messages in the shared memory rings.
+    // Returns whether there were any.
+    bool ReceiveLocal(coral::model::StepID oldestStepID);
+
+    // Queues the values in a message received through the socket.
+    void ReceiveMessage(
+        const std::vector<zmq::message_t>& rawMsg,
+        coral::model::StepID oldestStepID);
+
+    // Queues the values in a binary-encoded message.
+    void ReceiveBinary(
+        const char* header,
+        std::size_t headerSize,
+        const char* body,
+        std::size_t bodySize,
+        coral::model::StepID oldestStepID);
+
+    // Returns the position in m_ringValues where a received value should
+    // be stored, or NO_SLOT if it should be discarded.
+    std::size_t EnqueueSlot(
+        const coral::model::Variable& variable,
+        coral::model::StepID stepID);
+
+    // Queues a received value if it is one we're listening for, and it is
+    // for the time step which is currently due (or a newer one).
+    void Enqueue(
+        const coral::model::Variable& variable,
+        coral::model::StepID stepID,
+        const coral::model::ScalarValue& value);
+
+    // Doubles the capacity of every subscription's ring buffer.
+    void GrowRings();
 
     // A hash function for Variable objects, so we can put them in a
     // std::unordered_map (below)
@@ -180,11 +429,85 @@ private:
         }
     };
 
+    // A subscription.  Its received values are stored in a ring buffer which
+    // occupies the elements [slot*m_ringCapacity, (slot+1)*m_ringCapacity)
+    // of m_ringSteps and m_ringValues, where `slot` is the subscription's
+    // position in m_subscriptions.  Slots which are not in use have an empty
+    // `variable`.
+    struct Subscription
+    {
+        coral::model::Variable variable;
+        int delay;
+        std::size_t head;
+        std::size_t size;
+    };
+
     coral::model::StepID m_currentStepID;
+    bool m_ignoreDelays;  // the ignoreDelays argument of the last Update()
+    int m_maxDelay;       // the largest delay of any subscription
     std::unique_ptr<zmq::socket_t> m_socket;
-    std::unordered_map<coral::model::Variable, ValueQueue, VariableHash> m_values;
+
+    // Receives connection events for m_socket, and the URLs of the TCP
+    // peers which have been connected to but not yet reported as
+    // established (see WaitForPeers()).
+    std::unique_ptr<zmq::socket_t> m_monitor;
+    std::set<std::string> m_pendingPeers;
+
+    // Publishers on the same host, whose values we read from shared memory
+    // rather than through m_socket.
+    struct LocalPeer
+    {
+        std::string endpoint;
+        std::shared_ptr<SharedMemoryRingReader> ring;
+    };
+    std::vector<LocalPeer> m_localPeers;
+
+    // Subscriptions are assigned a slot at Subscribe() time, and the value
+    // store is a set of flat arrays addressed by slot.  Slots freed by
+    // Unsubscribe() are listed in m_freeSlots for reuse.  Ring elements are
+    // reused across time steps, so in the steady state, receiving a value
+    // doesn't allocate memory (except when a string value grows).
+    std::unordered_map<coral::model::Variable, std::size_t, VariableHash> m_index;
+    std::vector<Subscription> m_subscriptions;
+    std::vector<std::size_t> m_freeSlots;
+    std::size_t m_ringCapacity;
+    std::vector<coral::model::StepID> m_ringSteps;
+    std::vector<coral::model::ScalarValue> m_ringValues;
+
+    std::chrono::microseconds m_spinBudget;
+    coral::net::BusyPollStats m_pollStats;
+
+    // Receive buffers, kept between Update() calls so their memory can be
+    // reused.
+    std::vector<zmq::message_t> m_rawMsg;
+    std::shared_ptr<coral::protocol::exe_data::BatchMessage> m_batch;
+
+    // The ID of the time step whose value is currently due for a
+    // subscription, taking its delay into account.
+    coral::model::StepID DueStepID(const Subscription& sub) const noexcept;
 };
 
 
+/**
+\brief  Returns an endpoint which tells a VariableSubscriber to read the
+        values of a publisher on the same host from shared memory.
+
+\param [in] dataPubEndpoint
+    The TCP endpoint to which the VariablePublisher is bound, with any
+    address of the host in question (e.g. from a coral::net::SlaveLocator).
+
+\returns
+    An endpoint on the form `shm://<address>`, where `<address>` is the
+    address of `dataPubEndpoint`.  This should only be passed to
+    VariableSubscriber::Connect() or VariableSubscriber::ConnectTo() on the
+    same host as the publisher.  A subscriber which is unable to use shared
+    memory connects to `tcp://<address>` instead.
+
+\throws std::invalid_argument if `dataPubEndpoint` is not a TCP endpoint.
+*/
+coral::net::Endpoint SharedMemoryEndpoint(
+    const coral::net::Endpoint& dataPubEndpoint);
+
+
 }} // namespace
 #endif // header guard
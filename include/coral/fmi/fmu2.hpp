@@ -10,7 +10,10 @@
 #ifndef CORAL_FMI_FMU2_HPP
 #define CORAL_FMI_FMU2_HPP
 
+#include <array>
+#include <cstddef>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -92,10 +95,27 @@ public:
     fmi2_value_reference_t FMIValueReference(coral::model::VariableID variable)
         const;
 
-    /// Returns the underlying C API handle (for FMI Library)
+    /**
+    \brief  Returns the underlying C API handle (for FMI Library)
+
+    The handle may be shared with one of the slave instances, so it should
+    only be used to query the model description.
+    */
     fmi2_import_t* FmilibHandle() const;
 
 private:
+    friend class SlaveInstance2;
+
+    // Returns a handle whose model description has been parsed, but which
+    // has no DLL loaded.  The parsed description is shared with instances
+    // whenever possible, since FMI Library only lets us load one instance
+    // per handle.
+    fmi2_import_t* AcquireHandle();
+
+    // Returns a handle obtained with AcquireHandle() to the pool after its
+    // DLL has been unloaded.
+    void ReleaseHandle(fmi2_import_t* handle) noexcept;
+
     std::shared_ptr<coral::fmi::Importer> m_importer;
     boost::filesystem::path m_dir;
 
@@ -104,6 +124,11 @@ private:
     std::vector<fmi2_value_reference_t> m_valueReferences;
     std::vector<std::weak_ptr<SlaveInstance2>> m_instances;
 
+    // Parsed handles which are not in use by any instance, including
+    // m_handle when it is free.
+    std::mutex m_spareHandlesMutex;
+    std::vector<fmi2_import_t*> m_spareHandles;
+
 #ifdef _WIN32
     // Workaround for VIPROMA-67 (FMU DLL search paths on Windows).
     std::unique_ptr<AdditionalPath> m_additionalDllSearchPath;
@@ -111,7 +136,13 @@ private:
 };
 
 
-/// An FMI 2.0 co-simulation slave instance.
+/**
+\brief  An FMI 2.0 co-simulation slave instance.
+
+Like the FMU instance it wraps, an object of this class may only be used by
+one thread at a time.  This also applies to its `const` member functions,
+which share some internal buffers.
+*/
 class SlaveInstance2 : public coral::fmi::SlaveInstance
 {
 private:
@@ -129,7 +160,7 @@ public:
     ~SlaveInstance2() noexcept;
 
     // coral::slave::Instance methods
-    coral::model::SlaveTypeDescription TypeDescription() const override;
+    const coral::model::SlaveTypeDescription& TypeDescription() const override;
 
     void Setup(
         const std::string& slaveName,
@@ -154,6 +185,40 @@ public:
     bool SetBooleanVariable(coral::model::VariableID variable, bool value) override;
     bool SetStringVariable(coral::model::VariableID variable, const std::string& value) override;
 
+    void GetRealVariables(
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        double* values) const override;
+    void GetIntegerVariables(
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        int* values) const override;
+    void GetBooleanVariables(
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        bool* values) const override;
+    void GetStringVariables(
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        std::string* values) const override;
+
+    bool SetRealVariables(
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        const double* values) override;
+    bool SetIntegerVariables(
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        const int* values) override;
+    bool SetBooleanVariables(
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        const bool* values) override;
+    bool SetStringVariables(
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        const std::string* values) override;
+
     // coral::fmi::SlaveInstance methods
     std::shared_ptr<coral::fmi::FMU> FMU() const override;
 
@@ -170,7 +235,20 @@ private:
     bool m_setupComplete = false;
     bool m_simStarted = false;
 
-    std::string m_instanceName;
+    // The last message logged by the FMU, for use in exception messages.
+    // The logger callback writes directly to this buffer, which it finds
+    // through the component environment pointer, so there is no shared
+    // state between instances.  FMUs call the logger from within the FMI
+    // functions, so no locking is needed either.
+    std::array<char, 1024> m_lastLogMessage;
+
+    // Scratch buffers used by the batch get/set functions, so they don't have
+    // to allocate memory on every call.  Since the getters are const, this
+    // means that even they may not be called concurrently (see the class
+    // documentation).
+    mutable std::vector<fmi2_value_reference_t> m_valueReferenceBuffer;
+    mutable std::vector<int> m_booleanBuffer; // fmi2_boolean_t
+    mutable std::vector<const char*> m_stringBuffer; // fmi2_string_t
 };
 
 
@@ -10,6 +10,7 @@
 #ifndef CORAL_FMI_IMPORTER_HPP
 #define CORAL_FMI_IMPORTER_HPP
 
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <string>
@@ -48,14 +49,27 @@ it is not automatically emptied on destruction.  Thus, if the same path is
 supplied each time, the cache becomes persistent between program runs.
 It may be cleared manually by calling CleanCache().
 
-\warning
-    Currently there are no synchronisation mechanisms to protect the cache from
-    concurrent use, so accessing the same cache from multiple
-    instances/processes will likely cause problems.
+The unpacked FMUs are identified by their contents (more precisely, by the
+names, sizes and checksums of the files in the archive), so an %FMU is only
+unpacked anew when it has actually changed, and then without disturbing any
+process which uses the old version.  An index records the size of each
+%FMU in the cache and when it was last imported.  If a maximum cache size is
+given, the least recently used FMUs are removed when the cache grows beyond
+it, except those which are currently in use.
+
+The cache may be shared by several processes.  Access to each %FMU in it is
+coordinated with file locks, so that when several processes import the same
+%FMU at the same time, only one of them unpacks it while the others wait and
+then use the result.  The contents are unpacked to a temporary directory and
+moved into place when complete, so a partially unpacked %FMU is never seen
+in the cache, not even after a crash.
 */
 class Importer : public std::enable_shared_from_this<Importer>
 {
 public:
+    /// A `maxCacheSize` value which means that the cache size is unlimited.
+    static const std::uint64_t UNLIMITED_CACHE_SIZE = 0xFFFFFFFFFFFFFFFFull;
+
     /**
     \brief  Creates a new %FMU importer that uses a specific cache directory.
 
@@ -64,9 +78,14 @@ public:
     \param [in] cachePath
         The path to the directory which will hold the %FMU cache.  If it does
         not exist already, it will be created.
+    \param [in] maxCacheSize
+        The size, in bytes, beyond which the least recently used FMUs are
+        removed from the cache.  This only takes effect when an %FMU is
+        imported.  Importers which share a cache may use different limits.
     */
     static std::shared_ptr<Importer> Create(
-        const boost::filesystem::path& cachePath);
+        const boost::filesystem::path& cachePath,
+        std::uint64_t maxCacheSize = UNLIMITED_CACHE_SIZE);
 
     /**
     \brief  Creates a new %FMU importer that uses a temporary cache directory.
@@ -79,7 +98,7 @@ public:
 
 private:
     // Private constructors, to force use of factory functions.
-    Importer(const boost::filesystem::path& cachePath);
+    Importer(const boost::filesystem::path& cachePath, std::uint64_t maxCacheSize);
     Importer(coral::util::TempDir tempDir);
 
 public:
@@ -118,7 +137,7 @@ public:
     \brief  Removes unused files and directories from the %FMU cache.
 
     This will remove all %FMU contents from the cache, except the ones for
-    which there currently exist FMU objects.
+    which there currently exist FMU objects, in this or other processes.
     */
     void CleanCache();
 
@@ -138,6 +157,9 @@ private:
 
     boost::filesystem::path m_fmuDir;
     boost::filesystem::path m_workDir;
+    boost::filesystem::path m_lockFile;
+    boost::filesystem::path m_indexFile;
+    std::uint64_t m_maxCacheSize;
 
     std::map<boost::filesystem::path, std::weak_ptr<FMU>> m_pathCache;
     std::map<std::string, std::weak_ptr<FMU>> m_guidCache;
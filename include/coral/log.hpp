@@ -44,6 +44,17 @@ the one that matches.
 Level ParseLevel(std::string str);
 
 
+/**
+\brief  Returns whether messages at the given level would be written to any
+        of the sinks.
+
+This is cheap, and does not take the lock that serialises writes to the
+sinks, so it can be used to skip formatting messages which would be
+discarded anyway.
+*/
+bool IsEnabled(Level level) noexcept;
+
+
 /// Writes a plain C string to the global logger.
 void Log(Level level, const char* message) noexcept;
 
@@ -11,6 +11,8 @@
 #define CORAL_MASTER_EXECUTION_HPP
 
 #include <chrono>
+#include <exception>
+#include <functional>
 #include <future>
 #include <iterator>
 #include <memory>
@@ -132,6 +134,85 @@ struct SlaveConfig
 };
 
 
+/**
+ *  \brief
+ *  A change to a slave's variables, scheduled for a specific point in
+ *  simulation time.
+ *
+ *  This class is used with `Execution::RunUntil()`, which applies the
+ *  setting right before the time step that starts at or after `#timePoint`.
+ */
+struct ScenarioEvent
+{
+    /// The simulation time at which the change takes effect.
+    coral::model::TimePoint timePoint;
+
+    /// The ID number of the slave which owns the variable.
+    coral::model::SlaveID slaveID;
+
+    /// The new value of, or connection to, the variable.
+    coral::model::VariableSetting setting;
+
+    /// Constructor which sets all fields.
+    ScenarioEvent(
+        coral::model::TimePoint timePoint_,
+        coral::model::SlaveID slaveID_,
+        coral::model::VariableSetting setting_)
+        : timePoint(timePoint_)
+        , slaveID(slaveID_)
+        , setting(std::move(setting_))
+    { }
+};
+
+
+/// Options for `Execution::RunUntil()`.
+struct RunOptions
+{
+    /**
+     *  \brief
+     *  The communications timeout used for each time step.
+     *  A negative value means no timeout.
+     */
+    std::chrono::milliseconds stepTimeout = std::chrono::seconds(1);
+
+    /**
+     *  \brief
+     *  The communications timeout used for all other communication
+     *  with the slaves.  A negative value means no timeout.
+     */
+    std::chrono::milliseconds commTimeout = std::chrono::seconds(1);
+
+    /**
+     *  \brief
+     *  Variable changes to apply during the run, in any order.
+     *
+     *  Events scheduled for the same time are applied in the order they
+     *  are listed.  Events scheduled for a time that is not reached are
+     *  ignored.
+     */
+    std::vector<ScenarioEvent> scenario;
+
+    /**
+     *  \brief
+     *  A progress handler, which is called with the current simulation
+     *  time after a time step has been completed.
+     *
+     *  This is called in a background thread, so it must be short and not
+     *  call any functions on the `Execution` object.  If it returns `false`,
+     *  the run is stopped after the current time step.  If it throws, the
+     *  run is stopped in the same way, and the exception is rethrown by
+     *  `Execution::RunUntil()`.
+     */
+    std::function<bool(coral::model::TimePoint)> onProgress;
+
+    /**
+     *  \brief
+     *  The minimum amount of wall-clock time between two calls to
+     *  `#onProgress`.  If zero, it is called after every time step.
+     */
+    std::chrono::milliseconds progressInterval = std::chrono::milliseconds(0);
+};
+
 
 /**
  *  \brief
@@ -144,6 +225,25 @@ struct SlaveConfig
 class Execution
 {
 public:
+    /**
+     *  \brief
+     *  Completion handler for asynchronous operations without a result.
+     *
+     *  The argument is null if the operation succeeded, and otherwise
+     *  contains the exception that the corresponding synchronous function
+     *  would have thrown.
+     */
+    using AsyncHandler = std::function<void(std::exception_ptr)>;
+
+    /**
+     *  \brief
+     *  Completion handler for `StepAsync()`.
+     *
+     *  The `StepResult` is only meaningful if the `std::exception_ptr`
+     *  is null.
+     */
+    using AsyncStepHandler = std::function<void(std::exception_ptr, StepResult)>;
+
     /**
      *  \brief
      *  Constructor which creates a new execution.
@@ -260,6 +360,14 @@ public:
      *  length. (This is the reason why two function calls,
      *  `Step()` and `AcceptStep()`, are required per time step.)
      *
+     *  If it is known in advance that a successful step will be accepted,
+     *  `Step()` may also be called again right after a successful step,
+     *  without calling `AcceptStep()` in between.  The previous step is
+     *  then accepted implicitly.  For slaves which support it, this is done
+     *  in the same request as the new step, which saves one round trip
+     *  per slave per time step.  `AcceptStep()` must still be called before
+     *  any operation other than `Step()`, e.g. `Reconfigure()`.
+     *
      *  \param [in] stepSize
      *      How much the simulation should be advanced in time.
      *      This must be a positive number.
@@ -283,7 +391,7 @@ public:
      *  Confirms and completes a time step.
      *
      *  This method must be called after a successful `Step()` call,
-     *  before any other operations are performed.
+     *  before any other operations except `Step()` are performed.
      *  See the `Step()` documentation for details.
      *
      *  \param timeout
@@ -292,6 +400,170 @@ public:
      */
     void AcceptStep(std::chrono::milliseconds timeout);
 
+    /**
+     *  \brief
+     *  Performs a number of time steps, letting the slaves drive the
+     *  stepping themselves.
+     *
+     *  Rather than waiting for the master to tell them to perform each
+     *  step, the slaves step as soon as they have received the variable
+     *  values they need from the other slaves.  This removes one round trip
+     *  between master and slaves per time step, and slaves that don't
+     *  depend on each other don't have to wait for each other.  All slaves
+     *  must support this (master/slave protocol version 7 or later).
+     *
+     *  Like after `AcceptStep()`, the execution is ready for other
+     *  operations, e.g. `Reconfigure()`, when the function returns.
+     *
+     *  \param [in] stepSize
+     *      The step size.  This must be a positive number.
+     *  \param [in] stepCount
+     *      The number of time steps to perform.
+     *  \param [in] timeout
+     *      The communications timeout used to detect loss of communication
+     *      with slaves.  If `progressInterval` is zero, this applies to the
+     *      entire run.  A negative value means no timeout.
+     *  \param [in] progressInterval
+     *      If positive, `onProgress` is called, at most every
+     *      `progressInterval` steps, with the simulation time up to which
+     *      all slaves have completed their steps.
+     *  \param [in] onProgress
+     *      A progress handler.  This is called in a background thread, so
+     *      it must be short and not call any functions on this object.
+     *      If it returns `false`, the run is interrupted, and the slaves
+     *      are brought to a halt at the earliest possible time step.
+     *
+     *  \returns
+     *      The number of time steps performed.  This is less than
+     *      `stepCount` if the run was interrupted.
+     *  \throws std::runtime_error
+     *      If a slave failed to perform a time step, or in case of
+     *      communication failure.  In both cases, the execution may not be
+     *      used for anything but `Terminate()` afterwards.
+     */
+    int RunDecentralized(
+        coral::model::TimeDuration stepSize,
+        int stepCount,
+        std::chrono::milliseconds timeout,
+        int progressInterval = 0,
+        std::function<bool(coral::model::TimePoint)> onProgress = nullptr);
+
+    /**
+     *  \brief
+     *  Performs time steps until the simulation reaches a given time,
+     *  applying scenario events along the way.
+     *
+     *  This is equivalent to calling `Step()` and `AcceptStep()` in a loop,
+     *  and `Reconfigure()` for the scenario events that are due before
+     *  each step, but the whole loop runs in the execution's background
+     *  thread.  The function therefore only returns at the end of the run,
+     *  and it is considerably faster when the steps are short.
+     *
+     *  The run starts at the time reached by the previous operations,
+     *  or at `ExecutionOptions::startTime`.  Time steps are performed
+     *  as long as the current time is less than `stopTime - 0.9*stepSize`,
+     *  which allows for rounding errors in the accumulated time.
+     *  Like after `AcceptStep()`, the execution is ready for other
+     *  operations, including another `RunUntil()`, when the function
+     *  returns.
+     *
+     *  \param [in] stopTime
+     *      The simulation time at which to stop.
+     *  \param [in] stepSize
+     *      The step size.  This must be a positive number.
+     *  \param [in] options
+     *      Timeouts, scenario events and progress reporting.
+     *
+     *  \returns
+     *      The simulation time reached.  This is less than `stopTime` if
+     *      the run was stopped by `RunOptions::onProgress`.
+     *  \throws std::runtime_error
+     *      If a slave failed to perform a time step or to apply a
+     *      scenario event, or in case of communication failure.  In all
+     *      cases, the execution may not be used for anything but
+     *      `Terminate()` afterwards.
+     */
+    coral::model::TimePoint RunUntil(
+        coral::model::TimePoint stopTime,
+        coral::model::TimeDuration stepSize,
+        const RunOptions& options = RunOptions{});
+
+    /**
+     *  \name Asynchronous operations
+     *
+     *  These functions start the same operations as their synchronous
+     *  counterparts, e.g. `StepAsync()` for `Step()`, but return without
+     *  waiting for them to complete.  Operations are performed one at a
+     *  time, in the order in which they were started, so a sequence like
+     *  `ReconfigureAsync()`, `StepAsync()`, `AcceptStepAsync()` may be
+     *  issued at once.  Synchronous functions wait for all operations
+     *  started before them.  If an operation fails, the ones after it
+     *  are still attempted, and will usually fail too.
+     *
+     *  At most `ExecutionOptions::maxPendingOperations` operations may be
+     *  pending at the same time.  If this limit has been reached, the
+     *  functions wait for an operation to complete before they return.
+     *
+     *  Each function comes in two variants.  One returns a `std::future`
+     *  for the result.  The other takes a completion handler, which is
+     *  called when the operation has completed, and is useful e.g. for
+     *  building awaitables for coroutines.  The handler is called in the
+     *  execution's background thread.  It must not throw, nor block for
+     *  any length of time, and it may not call the synchronous functions.
+     *  It *may* start new asynchronous operations, using the handler
+     *  variants, but in this case they throw `std::length_error` rather
+     *  than wait if the limit on pending operations has been reached.
+     *
+     *  Any vectors passed by reference (`slavesToAdd`, `slaveConfigs`,
+     *  `slaveResults`) must stay alive until the operation has completed.
+     */
+    ///@{
+
+    /// Asynchronous version of `Reconstitute()`.
+    std::future<void> ReconstituteAsync(
+        std::vector<AddedSlave>& slavesToAdd,
+        std::chrono::milliseconds commTimeout);
+
+    /// Asynchronous version of `Reconstitute()`.
+    void ReconstituteAsync(
+        std::vector<AddedSlave>& slavesToAdd,
+        std::chrono::milliseconds commTimeout,
+        AsyncHandler onComplete);
+
+    /// Asynchronous version of `Reconfigure()`.
+    std::future<void> ReconfigureAsync(
+        std::vector<SlaveConfig>& slaveConfigs,
+        std::chrono::milliseconds commTimeout);
+
+    /// Asynchronous version of `Reconfigure()`.
+    void ReconfigureAsync(
+        std::vector<SlaveConfig>& slaveConfigs,
+        std::chrono::milliseconds commTimeout,
+        AsyncHandler onComplete);
+
+    /// Asynchronous version of `Step()`.
+    std::future<StepResult> StepAsync(
+        coral::model::TimeDuration stepSize,
+        std::chrono::milliseconds timeout,
+        std::vector<std::pair<coral::model::SlaveID, StepResult>>* slaveResults = nullptr);
+
+    /// Asynchronous version of `Step()`.
+    void StepAsync(
+        coral::model::TimeDuration stepSize,
+        std::chrono::milliseconds timeout,
+        std::vector<std::pair<coral::model::SlaveID, StepResult>>* slaveResults,
+        AsyncStepHandler onComplete);
+
+    /// Asynchronous version of `AcceptStep()`.
+    std::future<void> AcceptStepAsync(std::chrono::milliseconds timeout);
+
+    /// Asynchronous version of `AcceptStep()`.
+    void AcceptStepAsync(
+        std::chrono::milliseconds timeout,
+        AsyncHandler onComplete);
+
+    ///@}
+
     /**
      *  \brief
      *  Terminates the execution.
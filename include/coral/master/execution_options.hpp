@@ -11,6 +11,7 @@
 #define CORAL_MASTER_EXECUTION_OPTIONS_HPP
 
 #include <chrono>
+#include <coral/bus/variable_encoding.hpp>
 #include <coral/model.hpp>
 
 
@@ -58,6 +59,44 @@ struct ExecutionOptions
      *  A negative value means no timeout.
      */
     std::chrono::milliseconds slaveVariableRecvTimeout = std::chrono::seconds(1);
+
+    /**
+     *  \brief
+     *  The encoding which slaves should use for the variable values they
+     *  exchange among themselves.
+     *
+     *  `coral::bus::BINARY_VARIABLE_ENCODING` is considerably cheaper to
+     *  encode and decode than the default, and is recommended for executions
+     *  with very short time steps.  If one or more of the slaves in the
+     *  execution don't support it (i.e., they run an older version of
+     *  Coral), all slaves fall back to the default encoding.
+     */
+    coral::bus::VariableEncoding variableEncoding =
+        coral::bus::PROTOBUF_VARIABLE_ENCODING;
+
+    /**
+     *  \brief
+     *  The maximum number of operations that may be pending at any time.
+     *
+     *  This is the number of operations that have been started with the
+     *  asynchronous functions of `Execution` (e.g. `Execution::StepAsync()`)
+     *  but have not yet completed, plus the one synchronous operation that
+     *  may be in progress.  It must be at least 1.
+     */
+    int maxPendingOperations = 16;
+
+    /**
+     *  \brief
+     *  The number of extra threads used for communicating with slaves.
+     *
+     *  If zero, all communication with slaves takes place in the
+     *  execution's own background thread.  Otherwise, the slaves are
+     *  divided evenly between this many threads, which take care of
+     *  serialising the commands and processing the replies, so that the
+     *  work is spread over several cores.  This pays off for executions
+     *  with hundreds of slaves.  It must not be negative.
+     */
+    int slaveControlThreads = 0;
 };
 
 
@@ -10,11 +10,15 @@
 #ifndef CORAL_MODEL_HPP
 #define CORAL_MODEL_HPP
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <iterator>
 #include <limits>
 #include <map>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <boost/range/adaptor/map.hpp>
@@ -314,10 +318,14 @@ public:
     If `outputVar` is a default-constructed `Variable` object (i.e., if
     `outputVar.Empty()` is `true`) this is equivalent to "no connection",
     meaning that an existing connection should be broken.
+
+    `delay` is the number of time steps by which values are delayed across
+    the connection; see ConnectionDelay().
     */
     VariableSetting(
         VariableID inputVar,
-        const coral::model::Variable& outputVar);
+        const coral::model::Variable& outputVar,
+        int delay = 0);
 
     /**
     \brief  Indicates an input variable which should both be given a specific
@@ -326,11 +334,15 @@ public:
     If `outputVar` is a default-constructed `Variable` object (i.e., if
     `outputVar.Empty()` is `true`) this is equivalent to "no connection",
     meaning that an existing connection should be broken.
+
+    `delay` is the number of time steps by which values are delayed across
+    the connection; see ConnectionDelay().
     */
     VariableSetting(
         VariableID inputVar,
         const ScalarValue& value,
-        const coral::model::Variable& outputVar);
+        const coral::model::Variable& outputVar,
+        int delay = 0);
 
     /// The variable ID.
     VariableID Variable() const noexcept;
@@ -353,12 +365,140 @@ public:
     */
     const coral::model::Variable& ConnectedOutput() const;
 
+    /**
+    \brief  The number of time steps by which values are delayed across the
+            connection.
+
+    Normally (with a delay of zero), the input receives the value which the
+    output had at the end of the previous time step.  With a delay of one,
+    it receives the value from the step before that, and so on.  This allows
+    the receiving slave to start a time step before the values from the
+    previous one have arrived, so data exchange overlaps with computation.
+
+    All inputs of a slave which are connected to the same output must use
+    the same delay.
+
+    \pre `IsConnectionChange() == true`
+    */
+    int ConnectionDelay() const;
+
 private:
     VariableID m_variable;
     bool m_hasValue;
     ScalarValue m_value;
     bool m_isConnectionChange;
     coral::model::Variable m_connectedOutput;
+    int m_connectionDelay;
+};
+
+
+/**
+\brief  A list of values of a single data type, along with the IDs of the
+        variables they belong to.
+
+This is one column of a ValueBlock.  The IDs and values are stored in two
+separate contiguous arrays, so they can be passed directly to functions
+which take arrays, e.g. the batch functions of coral::slave::Instance.
+Clear() does not release any memory, so a column which is reused for
+similar sets of values stops allocating after the first use.
+
+(The values are not stored in a `std::vector`, since `std::vector<bool>`
+does not provide contiguous storage.)
+*/
+template<typename T>
+class ValueColumn
+{
+public:
+    /// Constructs an empty column.
+    ValueColumn() noexcept : m_capacity(0) { }
+
+    ValueColumn(const ValueColumn& other);
+    ValueColumn& operator=(const ValueColumn& other);
+    ValueColumn(ValueColumn&& other) noexcept;
+    ValueColumn& operator=(ValueColumn&& other) noexcept;
+
+    /// The number of values in the column.
+    std::size_t Size() const noexcept { return m_ids.size(); }
+
+    /// Whether the column is empty.
+    bool Empty() const noexcept { return m_ids.empty(); }
+
+    /// Removes all values, but keeps the allocated memory.
+    void Clear() noexcept { m_ids.clear(); }
+
+    /// Adds a value to the end of the column.
+    void Add(VariableID id, const T& value);
+
+    /// The variable IDs, an array of `Size()` elements.
+    const VariableID* IDs() const noexcept { return m_ids.data(); }
+
+    /// The values, an array of `Size()` elements.
+    const T* Values() const noexcept { return m_values.get(); }
+
+    /// The values, an array of `Size()` elements which may be modified.
+    T* Values() noexcept { return m_values.get(); }
+
+    /// The ID of the variable at the given index.  \pre `index < Size()`
+    VariableID ID(std::size_t index) const { return m_ids[index]; }
+
+    /// The value at the given index.  \pre `index < Size()`
+    const T& Value(std::size_t index) const { return m_values[index]; }
+
+    /// The value at the given index.  \pre `index < Size()`
+    T& Value(std::size_t index) { return m_values[index]; }
+
+private:
+    std::vector<VariableID> m_ids;
+    std::unique_ptr<T[]> m_values;
+    std::size_t m_capacity;
+};
+
+
+/**
+\brief  A set of variable values, stored in a struct-of-arrays fashion with
+        one ValueColumn per data type.
+
+This is an alternative to lists of ScalarValue objects for places where
+many values are moved around at a time.  Values of the non-string types are
+stored unboxed, so they can be read and written without visiting a variant
+or touching the heap.
+*/
+class ValueBlock
+{
+public:
+    /// The real values.
+    ValueColumn<double>& Reals() noexcept { return m_reals; }
+    const ValueColumn<double>& Reals() const noexcept { return m_reals; }
+
+    /// The integer values.
+    ValueColumn<int>& Integers() noexcept { return m_integers; }
+    const ValueColumn<int>& Integers() const noexcept { return m_integers; }
+
+    /// The boolean values.
+    ValueColumn<bool>& Booleans() noexcept { return m_booleans; }
+    const ValueColumn<bool>& Booleans() const noexcept { return m_booleans; }
+
+    /// The string values.
+    ValueColumn<std::string>& Strings() noexcept { return m_strings; }
+    const ValueColumn<std::string>& Strings() const noexcept { return m_strings; }
+
+    /// Adds a value to the column that corresponds to its data type.
+    void Add(VariableID id, const ScalarValue& value);
+
+    /// The total number of values in all columns.
+    std::size_t Size() const noexcept;
+
+    /// Whether all columns are empty.
+    bool Empty() const noexcept;
+
+    /// Removes all values from all columns, but keeps the allocated memory.
+    void Clear() noexcept;
+
+private:
+    ValueColumn<double> m_reals;
+    ValueColumn<int> m_integers;
+    ValueColumn<bool> m_booleans;
+    ValueColumn<std::string> m_strings;
 };
 
 
@@ -395,5 +535,70 @@ SlaveTypeDescription::SlaveTypeDescription(
 }
 
 
+template<typename T>
+ValueColumn<T>::ValueColumn(const ValueColumn& other)
+    : m_capacity(0)
+{
+    *this = other;
+}
+
+
+template<typename T>
+ValueColumn<T>& ValueColumn<T>::operator=(const ValueColumn& other)
+{
+    if (this != &other) {
+        if (m_capacity < other.Size()) {
+            m_values.reset(new T[other.Size()]);
+            m_capacity = other.Size();
+        }
+        std::copy(
+            other.m_values.get(),
+            other.m_values.get() + other.Size(),
+            m_values.get());
+        m_ids = other.m_ids;
+    }
+    return *this;
+}
+
+
+template<typename T>
+ValueColumn<T>::ValueColumn(ValueColumn&& other) noexcept
+    : m_ids(std::move(other.m_ids)),
+      m_values(std::move(other.m_values)),
+      m_capacity(other.m_capacity)
+{
+    other.m_ids.clear();
+    other.m_capacity = 0;
+}
+
+
+template<typename T>
+ValueColumn<T>& ValueColumn<T>::operator=(ValueColumn&& other) noexcept
+{
+    m_ids = std::move(other.m_ids);
+    m_values = std::move(other.m_values);
+    m_capacity = other.m_capacity;
+    other.m_ids.clear();
+    other.m_capacity = 0;
+    return *this;
+}
+
+
+template<typename T>
+void ValueColumn<T>::Add(VariableID id, const T& value)
+{
+    const auto size = m_ids.size();
+    if (size == m_capacity) {
+        const auto newCapacity = std::max<std::size_t>(8, 2 * m_capacity);
+        std::unique_ptr<T[]> newValues(new T[newCapacity]);
+        std::move(m_values.get(), m_values.get() + size, newValues.get());
+        m_values = std::move(newValues);
+        m_capacity = newCapacity;
+    }
+    m_values[size] = value;
+    m_ids.push_back(id);
+}
+
+
 }}      // namespace
 #endif  // header guard
@@ -294,14 +294,55 @@ class SlaveLocator
 public:
     explicit SlaveLocator(
         const Endpoint& controlEndpoint = Endpoint{},
-        const Endpoint& dataPubEndpoint = Endpoint{}) noexcept;
+        const Endpoint& dataPubEndpoint = Endpoint{},
+        const Endpoint& subMasterEndpoint = Endpoint{}) noexcept;
 
     const Endpoint& ControlEndpoint() const noexcept;
     const Endpoint& DataPubEndpoint() const noexcept;
 
+    /**
+    \brief  The endpoint of a sub-master which can relay commands to the
+            slave, or an empty endpoint if there is none.
+
+    A sub-master typically runs in the slave provider which started the
+    slave, and serves all the slaves on that host.
+    */
+    const Endpoint& SubMasterEndpoint() const noexcept;
+
 private:
     Endpoint m_controlEndpoint;
     Endpoint m_dataPubEndpoint;
+    Endpoint m_subMasterEndpoint;
+};
+
+
+/**
+\brief  Statistics on how time was spent waiting for incoming messages.
+
+These are reported by components which support busy polling, where sockets
+are checked repeatedly without blocking for a limited time (the "spin
+budget") before the thread goes to sleep in the operating system's polling
+function.
+*/
+struct BusyPollStats
+{
+    /// Default constructor; sets all values to zero.
+    BusyPollStats() noexcept;
+
+    /// Adds the values from `other` to this object's values.
+    BusyPollStats& operator+=(const BusyPollStats& other) noexcept;
+
+    /// Time spent checking for messages without blocking.
+    std::chrono::nanoseconds spinTime;
+
+    /// Time spent blocked while waiting for messages (or timeouts).
+    std::chrono::nanoseconds sleepTime;
+
+    /// The number of waits which ended while spinning.
+    std::uint64_t spinWakeups;
+
+    /// The number of waits which ended after blocking.
+    std::uint64_t sleepWakeups;
 };
 
 
@@ -58,13 +58,21 @@ public:
         Note that the exception handler will be called *in* the background
         thread, so care should be taken not to implement it in a thread-unsafe
         manner.
+    \param [in] enableSubMaster
+        Whether to run a sub-master (see coral::bus::SubMaster) alongside
+        the slave provider.  If so, masters will relay time step commands
+        to the slaves started by this provider through it, so that they only
+        exchange one message with this host per step, rather than one per
+        slave.  This is worthwhile when several slaves in the same execution
+        run on this host.
     */
     SlaveProvider(
         const std::string& slaveProviderID,
         std::vector<std::unique_ptr<SlaveCreator>>&& slaveTypes,
         const coral::net::ip::Address& networkInterface,
         coral::net::ip::Port discoveryPort,
-        std::function<void(std::exception_ptr)> exceptionHandler = nullptr);
+        std::function<void(std::exception_ptr)> exceptionHandler = nullptr,
+        bool enableSubMaster = false);
 
     SlaveProvider(const SlaveProvider&) = delete;
     SlaveProvider& operator=(const SlaveProvider&) = delete;
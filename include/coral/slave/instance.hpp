@@ -10,6 +10,7 @@
 #ifndef CORAL_SLAVE_INSTANCE_HPP
 #define CORAL_SLAVE_INSTANCE_HPP
 
+#include <cstddef>
 #include <string>
 #include <coral/model.hpp>
 
@@ -42,8 +43,14 @@ to be "broken" and no further method calls will be made.
 class Instance
 {
 public:
-    /// Returns an object that describes the slave type.
-    virtual coral::model::SlaveTypeDescription TypeDescription() const = 0;
+    /**
+    \brief  Returns an object that describes the slave type.
+
+    The returned reference must remain valid, and the description must remain
+    unchanged, for the lifetime of the instance.  This lets callers use it
+    in every time step without copying it.
+    */
+    virtual const coral::model::SlaveTypeDescription& TypeDescription() const = 0;
 
     /**
     \brief  Instructs the slave to perform pre-simulation setup and enter
@@ -180,10 +187,124 @@ public:
     */
     virtual bool SetStringVariable(coral::model::VariableID variable, const std::string& value) = 0;
 
+    /**
+    \brief  Retrieves the values of several real variables.
+
+    The default implementation simply calls GetRealVariable() for each
+    variable, but implementations which can do it more efficiently (e.g.
+    with a single call to some underlying API) should override it.
+
+    \param [in] variables
+        An array of `count` variable IDs.
+    \param [in] count
+        The number of variables.
+    \param [out] values
+        An array of `count` elements which receives the variable values.
+
+    \throws std::logic_error
+        If any of the IDs do not refer to a real variable.
+    */
+    virtual void GetRealVariables(
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        double* values) const;
+
+    /// Like GetRealVariables(), but for integer variables.
+    virtual void GetIntegerVariables(
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        int* values) const;
+
+    /// Like GetRealVariables(), but for boolean variables.
+    virtual void GetBooleanVariables(
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        bool* values) const;
+
+    /// Like GetRealVariables(), but for string variables.
+    virtual void GetStringVariables(
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        std::string* values) const;
+
+    /**
+    \brief  Sets the values of several real variables.
+
+    The default implementation simply calls SetRealVariable() for each
+    variable, but implementations which can do it more efficiently (e.g.
+    with a single call to some underlying API) should override it.
+
+    \param [in] variables
+        An array of `count` variable IDs.
+    \param [in] count
+        The number of variables.
+    \param [in] values
+        An array of `count` variable values.
+
+    \returns
+        Whether all the values were set successfully.
+    \throws std::logic_error
+        If any of the IDs do not refer to a real variable.
+    */
+    virtual bool SetRealVariables(
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        const double* values);
+
+    /// Like SetRealVariables(), but for integer variables.
+    virtual bool SetIntegerVariables(
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        const int* values);
+
+    /// Like SetRealVariables(), but for boolean variables.
+    virtual bool SetBooleanVariables(
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        const bool* values);
+
+    /// Like SetRealVariables(), but for string variables.
+    virtual bool SetStringVariables(
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        const std::string* values);
+
     // Because it's an interface:
     virtual ~Instance() { }
 };
 
 
+/**
+\brief  Retrieves the values of a block of variables from a slave instance.
+
+The variables are identified by the IDs in the columns of `values`, and the
+values are written to the corresponding elements of the same columns.  The
+values are retrieved with one call to each of the batch functions
+(Instance::GetRealVariables() etc.), so no coral::model::ScalarValue objects
+are involved.
+
+\throws std::logic_error
+    If any of the IDs do not refer to a variable of the type that corresponds
+    to the column.
+*/
+void GetVariables(const Instance& instance, coral::model::ValueBlock& values);
+
+
+/**
+\brief  Sets the values of a block of variables in a slave instance.
+
+The values are set with one call to each of the batch functions
+(Instance::SetRealVariables() etc.).
+
+\returns
+    Whether all the values were set successfully.  (All values are attempted
+    set even if setting one of them fails.)
+\throws std::logic_error
+    If any of the IDs do not refer to a variable of the type that corresponds
+    to the column.
+*/
+bool SetVariables(Instance& instance, const coral::model::ValueBlock& values);
+
+
 }}
 #endif // header guard
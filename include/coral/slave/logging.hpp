@@ -13,7 +13,10 @@
 #include <fstream>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include <coral/model.hpp>
 #include <coral/slave/instance.hpp>
 
 
@@ -45,7 +48,7 @@ public:
         const std::string& outputFilePrefix = std::string{});
 
     // slave::Instance methods.
-    coral::model::SlaveTypeDescription TypeDescription() const override;
+    const coral::model::SlaveTypeDescription& TypeDescription() const override;
     void Setup(
         const std::string& slaveName,
         const std::string& executionName,
@@ -64,11 +67,25 @@ public:
     bool SetIntegerVariable(coral::model::VariableID variable, int value) override;
     bool SetBooleanVariable(coral::model::VariableID variable, bool value) override;
     bool SetStringVariable(coral::model::VariableID variable, const std::string& value) override;
+    void GetRealVariables(const coral::model::VariableID* variables, std::size_t count, double* values) const override;
+    void GetIntegerVariables(const coral::model::VariableID* variables, std::size_t count, int* values) const override;
+    void GetBooleanVariables(const coral::model::VariableID* variables, std::size_t count, bool* values) const override;
+    void GetStringVariables(const coral::model::VariableID* variables, std::size_t count, std::string* values) const override;
+    bool SetRealVariables(const coral::model::VariableID* variables, std::size_t count, const double* values) override;
+    bool SetIntegerVariables(const coral::model::VariableID* variables, std::size_t count, const int* values) override;
+    bool SetBooleanVariables(const coral::model::VariableID* variables, std::size_t count, const bool* values) override;
+    bool SetStringVariables(const coral::model::VariableID* variables, std::size_t count, const std::string* values) override;
 
 private:
     std::shared_ptr<Instance> m_instance;
     std::string m_outputFilePrefix;
     std::ofstream m_outputStream;
+
+    // The values of all variables, updated with one batch call per data type
+    // in each time step, and the column and index of each variable's value
+    // in m_values, in the order in which the variables are printed.
+    coral::model::ValueBlock m_values;
+    std::vector<std::pair<coral::model::DataType, std::size_t>> m_printOrder;
 };
 
 
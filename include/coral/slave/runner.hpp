@@ -49,6 +49,21 @@ public:
 
     void Run();
 
+    /**
+    \brief  Enables or disables busy polling.
+
+    If `spinBudget` is positive, the slave checks for incoming messages
+    without blocking for up to this long whenever it has to wait, both for
+    commands from the master and for variable values from other slaves, and
+    only then goes to sleep.  This reduces latency at the cost of CPU time,
+    and is meant for fast-stepping runs on dedicated machines.  The default
+    is zero, which disables busy polling.
+    */
+    void SetSpinBudget(std::chrono::microseconds spinBudget);
+
+    /// Statistics on the time the slave has spent waiting for messages.
+    coral::net::BusyPollStats PollStats() const;
+
 private:
     std::shared_ptr<Instance> m_slaveInstance;
     std::unique_ptr<coral::net::Reactor> m_reactor;
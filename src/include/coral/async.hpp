@@ -10,12 +10,19 @@
 #ifndef CORAL_ASYNC_HPP
 #define CORAL_ASYNC_HPP
 
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <exception>
 #include <functional>
 #include <future>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <thread>
+#include <type_traits>
 #include <utility>
 
 #include <zmq.hpp>
@@ -88,20 +95,378 @@ struct CommThreadTask<void, Result>
 
 namespace detail
 {
-    template<typename StackData>
-    struct CommThreadAnyTask
+    struct CommThreadSlot;
+
+
+    /*
+    Type-erased storage for one task.  Function objects of up to
+    `inlineSize` bytes which can be moved without throwing are stored
+    inline, so that submitting a task doesn't allocate memory.  Larger ones
+    are moved to the heap.  The background thread's `StackData` object is
+    passed to the task through a `void*`, which is null if `StackData` is
+    `void`.
+    */
+    class CommThreadTaskStorage
     {
-        using Type = std::function<void(coral::net::Reactor&, StackData&)>;
-        using SharedPtr = std::shared_ptr<Type>;
-        using WeakPtr = std::weak_ptr<Type>;
+    public:
+        static const std::size_t inlineSize = 128;
+
+        CommThreadTaskStorage() noexcept;
+        ~CommThreadTaskStorage() noexcept;
+
+        CommThreadTaskStorage(const CommThreadTaskStorage&) = delete;
+        CommThreadTaskStorage& operator=(const CommThreadTaskStorage&) = delete;
+
+        // Stores `task`, which must be callable as `task(reactor, data,
+        // slot)`, or as `task(reactor, slot)` if `StackData` is `void`.
+        // The storage must be empty.
+        template<typename StackData, typename Task>
+        void Emplace(Task task);
+
+        // Moves the task, if any, into `target`, which must be empty.
+        void MoveTo(CommThreadTaskStorage& target) noexcept;
+
+        // Runs the task and destroys it afterwards, even if it throws.
+        void Run(
+            coral::net::Reactor& reactor,
+            void* stackData,
+            CommThreadSlot& slot);
+
+        // Destroys the task, if any.
+        void Clear() noexcept;
+
+    private:
+        struct Ops
+        {
+            void (*invoke)(void*, coral::net::Reactor&, void*, CommThreadSlot&);
+            void (*move)(void* from, void* to); // must not throw
+            void (*destroy)(void*);
+        };
+
+        typename std::aligned_storage<
+                inlineSize,
+                std::alignment_of<std::max_align_t>::value
+            >::type m_storage;
+        const Ops* m_ops;
     };
 
-    template<>
-    struct CommThreadAnyTask<void>
+
+    /*
+    A reusable completion slot.  A foreground thread which submits a task to
+    CommThread's background thread acquires one of these from a fixed-size
+    pool, and waits for the background thread to complete it.
+    */
+    struct CommThreadSlot
+    {
+        enum State
+        {
+            pending,
+            succeeded,
+            failed,
+            dead,   // the background thread terminated without running the task
+        };
+
+        CommThreadSlot() noexcept;
+
+        // Prepares the slot for a new task.  Called by the foreground thread.
+        void Reset(void* resultStorage) noexcept;
+
+        // Sets the final state and wakes the waiting thread.  Note that the
+        // slot may be reused as soon as this function has been called.
+        void Complete(State state, std::exception_ptr exception = nullptr)
+            noexcept;
+
+        // Spins briefly, then blocks until the slot is no longer pending.
+        State Wait() noexcept;
+
+        std::size_t index;
+        void* result;
+        std::exception_ptr exception;
+
+        // The task, which is stored here by the foreground thread and moved
+        // out by the background thread before it is run.
+        CommThreadTaskStorage task;
+
+    private:
+        std::atomic<int> m_state;
+        std::mutex m_mutex;
+        std::condition_variable m_completed;
+    };
+
+
+    /*
+    Wakes the background thread's reactor.  On Linux this is an eventfd,
+    elsewhere it is a pair of inproc ZMQ sockets.
+    */
+    class CommThreadWakeup
+    {
+    public:
+        CommThreadWakeup();
+        ~CommThreadWakeup() noexcept;
+
+        CommThreadWakeup(const CommThreadWakeup&) = delete;
+        CommThreadWakeup& operator=(const CommThreadWakeup&) = delete;
+
+        // Signals the background thread.  May be called from any thread.
+        void Signal();
+
+        // Registers `handler` with `reactor`, to be called after Signal().
+        // Several signals may be coalesced into one call.
+        void Register(
+            coral::net::Reactor& reactor,
+            std::function<void(coral::net::Reactor&)> handler);
+
+        // Undoes Register().
+        void Unregister(coral::net::Reactor& reactor) noexcept;
+
+    private:
+#ifdef __linux__
+        int m_eventFD;
+#else
+        std::mutex m_signalMutex;
+        zmq::socket_t m_signalSocket;
+        zmq::socket_t m_waitSocket;
+#endif
+    };
+
+
+    /*
+    A bounded, lock-free multi-producer/multi-consumer queue with storage
+    for all its elements preallocated.  (This is Dmitry Vyukov's array-based
+    design, where each cell carries a sequence number that tells producers
+    and consumers whether it is their turn to use it.)  CommThread uses it
+    as an MPSC queue of slots with tasks in them, and as an MPMC pool of free
+    completion slots.
+    */
+    template<typename T>
+    class CommThreadQueue
+    {
+    public:
+        // `capacity` must be a power of two.
+        explicit CommThreadQueue(std::size_t capacity)
+            : m_cells{new Cell[capacity]}
+            , m_mask{capacity - 1}
+        {
+            m_push.value.store(0, std::memory_order_relaxed);
+            m_pop.value.store(0, std::memory_order_relaxed);
+            assert(capacity > 0 && (capacity & m_mask) == 0);
+            for (std::size_t i = 0; i < capacity; ++i) {
+                m_cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        CommThreadQueue(const CommThreadQueue&) = delete;
+        CommThreadQueue& operator=(const CommThreadQueue&) = delete;
+
+        // Moves `item` into the queue, unless it is full.
+        bool TryPush(T& item)
+        {
+            auto pos = m_push.value.load(std::memory_order_relaxed);
+            for (;;) {
+                auto& cell = m_cells[pos & m_mask];
+                const auto seq = cell.sequence.load(std::memory_order_acquire);
+                const auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+                if (diff == 0) {
+                    if (m_push.value.compare_exchange_weak(
+                            pos, pos + 1, std::memory_order_relaxed)) {
+                        cell.data = std::move(item);
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = m_push.value.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Moves the oldest element into `item`, unless the queue is empty.
+        bool TryPop(T& item)
+        {
+            auto pos = m_pop.value.load(std::memory_order_relaxed);
+            for (;;) {
+                auto& cell = m_cells[pos & m_mask];
+                const auto seq = cell.sequence.load(std::memory_order_acquire);
+                const auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+                if (diff == 0) {
+                    if (m_pop.value.compare_exchange_weak(
+                            pos, pos + 1, std::memory_order_relaxed)) {
+                        item = std::move(cell.data);
+                        cell.data = T{};
+                        cell.sequence.store(
+                            pos + m_mask + 1,
+                            std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = m_pop.value.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+    private:
+        struct Cell
+        {
+            std::atomic<std::size_t> sequence;
+            T data;
+        };
+
+        // Producers and consumers should not fight over the same cache line.
+        struct Position
+        {
+            std::atomic<std::size_t> value;
+            char padding[64 - sizeof(std::atomic<std::size_t>)];
+        };
+
+        std::unique_ptr<Cell[]> m_cells;
+        const std::size_t m_mask;
+        Position m_push;
+        Position m_pop;
+    };
+
+
+    // Common, untyped part of CommThreadCompletion.
+    class CommThreadCompletionBase
     {
-        using Type = std::function<void(coral::net::Reactor&)>;
-        using SharedPtr = std::shared_ptr<Type>;
-        using WeakPtr = std::weak_ptr<Type>;
+    public:
+        CommThreadCompletionBase(const CommThreadCompletionBase&) = delete;
+        CommThreadCompletionBase& operator=(const CommThreadCompletionBase&) = delete;
+
+        CommThreadCompletionBase(CommThreadCompletionBase&& other) noexcept;
+        CommThreadCompletionBase& operator=(CommThreadCompletionBase&& other) noexcept;
+
+    protected:
+        explicit CommThreadCompletionBase(CommThreadSlot& slot) noexcept;
+        ~CommThreadCompletionBase() noexcept;
+
+        void SetException(std::exception_ptr exception);
+
+        // Returns the slot and detaches from it.
+        CommThreadSlot& Release();
+
+    private:
+        void Abandon() noexcept;
+
+        CommThreadSlot* m_slot;
+    };
+} // namespace detail
+
+
+/**
+\brief  Used to report the result of a task executed with
+        CommThread::ExecuteAndWait().
+
+This plays the same role as the std::promise that is passed to tasks
+executed with CommThread::Execute(), but it refers to a preallocated,
+reusable completion slot rather than a freshly allocated shared state.
+Like std::promise, it is movable but not copyable.  If it is destroyed
+before a result has been set, the waiting thread receives a
+`std::future_error` with the `broken_promise` error code.
+
+A completion object must not outlive the background thread of the
+CommThread that created it.
+
+\tparam Result
+    The type of the task's "return value", or `void`.
+*/
+template<typename Result>
+class CommThreadCompletion : public detail::CommThreadCompletionBase
+{
+public:
+    /// For internal use by CommThread.
+    explicit CommThreadCompletion(detail::CommThreadSlot& slot) noexcept
+        : CommThreadCompletionBase(slot)
+    { }
+
+    /**
+    \brief  Reports the task's result.
+    \pre No result or exception has been set yet.
+    */
+    void SetValue(Result value)
+    {
+        auto& slot = Release();
+        try {
+            new (slot.result) Result(std::move(value));
+        } catch (...) {
+            slot.Complete(detail::CommThreadSlot::failed, std::current_exception());
+            return;
+        }
+        slot.Complete(detail::CommThreadSlot::succeeded);
+    }
+
+    /**
+    \brief  Reports that the task failed with an exception.
+    \pre No result or exception has been set yet.
+    */
+    void SetException(std::exception_ptr exception)
+    {
+        CommThreadCompletionBase::SetException(exception);
+    }
+};
+
+
+/// Specialisation of CommThreadCompletion for tasks with no result.
+template<>
+class CommThreadCompletion<void> : public detail::CommThreadCompletionBase
+{
+public:
+    /// For internal use by CommThread.
+    explicit CommThreadCompletion(detail::CommThreadSlot& slot) noexcept
+        : CommThreadCompletionBase(slot)
+    { }
+
+    /**
+    \brief  Reports that the task completed successfully.
+    \pre No result or exception has been set yet.
+    */
+    void SetValue()
+    {
+        Release().Complete(detail::CommThreadSlot::succeeded);
+    }
+
+    /**
+    \brief  Reports that the task failed with an exception.
+    \pre No result or exception has been set yet.
+    */
+    void SetException(std::exception_ptr exception)
+    {
+        CommThreadCompletionBase::SetException(exception);
+    }
+};
+
+
+namespace detail
+{
+    // State shared between the foreground and background threads.
+    template<typename StackData>
+    struct CommThreadShared
+    {
+        // The number of completion slots, and therefore the maximum number
+        // of tasks that may be queued at the same time.  Since each queued
+        // task occupies a slot, the task queue can never be full.
+        static const std::size_t capacity = 64;
+
+        CommThreadShared()
+            : tasks{capacity}
+            , freeSlots{capacity}
+            , slots{new CommThreadSlot[capacity]}
+            , alive{true}
+        {
+            for (std::size_t i = 0; i < capacity; ++i) {
+                slots[i].index = i;
+                auto index = i;
+                freeSlots.TryPush(index);
+            }
+        }
+
+        CommThreadQueue<CommThreadSlot*> tasks;
+        CommThreadQueue<std::size_t> freeSlots;
+        std::unique_ptr<CommThreadSlot[]> slots;
+        CommThreadWakeup wakeup;
+        std::atomic<bool> alive;
     };
 } // namespace detail
 
@@ -120,6 +485,15 @@ to all functions that are executed in it.
 To execute tasks in the background thread, use the Execute() method.
 Results and exceptions from such functions should be transferred to
 the foreground thread using the std::future / std::promise mechanism.
+When the foreground thread is going to wait for the result anyway,
+ExecuteAndWait() does the same job with less overhead, as it reports
+results through reusable completion slots instead.
+
+Tasks are handed to the background thread through a bounded, preallocated,
+lock-free queue, and the thread's reactor is woken through an eventfd
+(on Linux) or an inproc ZMQ socket (elsewhere).  Each task is stored in its
+completion slot, which has room for small function objects, so submitting
+a task normally allocates no memory.
 
 The background thread may have a dedicated object of type `StackData`.
 This is located on that thread's stack, and can be used to hold objects
@@ -245,6 +619,51 @@ public:
     std::future<Result> Execute(
         typename CommThreadTask<StackData, Result>::Type task);
 
+    /**
+    \brief  Executes a task in the background thread and waits for its
+            result.
+
+    This is equivalent to `Execute<Result>(task).get()`, except that the
+    task receives a CommThreadCompletion<Result> object instead of a
+    std::promise, and that no shared state is allocated for the result.
+    This makes it considerably cheaper for tasks which complete quickly.
+
+    If `StackData` is not `void`, `task` must be callable as follows:
+    ~~~{.cpp}
+    void fun(
+        coral::net::Reactor& reactor,
+        StackData& data,
+        CommThreadCompletion<Result> completion);
+    ~~~
+    And if `StackData` is `void`, it must be callable like this:
+    ~~~{.cpp}
+    void fun(
+        coral::net::Reactor& reactor,
+        CommThreadCompletion<Result> completion);
+    ~~~
+    The remarks about `reactor`, `data` and exceptions that escape from
+    `task` in the Execute() documentation apply here too.
+
+    \tparam Result
+        The type of the function's "return value".  May be `void`.
+    \param [in] task
+        A copyable function object to be executed in the background thread.
+    \returns
+        The value passed to CommThreadCompletion::SetValue().
+    \throws CommThreadDead
+        If the background thread has terminated unexpectedly due to
+        an exception.
+    \throws std::future_error
+        With error code `broken_promise` if the completion object was
+        destroyed before a result was set.
+    \throws
+        Any exception passed to CommThreadCompletion::SetException().
+    \pre
+        `Active() == true`
+    */
+    template<typename Result, typename Task>
+    Result ExecuteAndWait(Task task);
+
     /**
     \brief  Terminates the background thread in a controlled manner.
 
@@ -283,10 +702,24 @@ private:
     void WaitForThreadTermination();
     void DestroySilently() noexcept;
 
+    // Stores a task in a free slot, queues it for execution and returns the
+    // slot, which the task will complete.
+    template<typename Task>
+    detail::CommThreadSlot& Submit(Task task, void* resultStorage);
+
+    // Waits for a slot returned by Submit() to be completed.  On return,
+    // the slot's state is either `succeeded` or `failed`.
+    void Await(detail::CommThreadSlot& slot);
+
+    // Returns a slot to the pool once its result has been read.
+    void ReleaseSlot(detail::CommThreadSlot& slot) noexcept;
+
+    // Called when the background thread is found to have terminated.
+    [[noreturn]] void ThreadDied();
+
     bool m_active;
-    zmq::socket_t m_socket;
+    std::shared_ptr<detail::CommThreadShared<StackData>> m_shared;
     std::future<void> m_threadStatus;
-    typename detail::CommThreadAnyTask<StackData>::WeakPtr m_nextTask;
 };
 
 
@@ -320,80 +753,196 @@ private:
 
 namespace detail
 {
+    // Calls a task with the background thread's StackData object, if any.
     template<typename StackData>
-    void CommThreadMessagingLoop(
-        zmq::socket_t& bgSocket,
-        typename CommThreadAnyTask<StackData>::SharedPtr nextTask)
+    struct CommThreadInvoker
     {
-        coral::net::Reactor reactor;
-        StackData data;
-        reactor.AddSocket(
-            bgSocket,
-            [nextTask = std::move(nextTask), &data] (coral::net::Reactor& r, zmq::socket_t& s) mutable {
-                char dummy;
-                s.recv(&dummy, 1);
-
-                // Now, the foreground thread is blocked waiting for our
-                // reply, so we can freely access `nextTask`.
-                typename CommThreadAnyTask<StackData>::Type myTask;
-                swap(*nextTask, myTask);
-
-                // Unblock foreground thread again and then run the task.
-                s.send("\1", 1);
-                myTask(r, data);
-            });
-        reactor.Run();
+        template<typename Task>
+        static void Invoke(
+            Task& task,
+            coral::net::Reactor& reactor,
+            void* stackData,
+            CommThreadSlot& slot)
+        {
+            task(reactor, *static_cast<StackData*>(stackData), slot);
+        }
+    };
+
+    template<>
+    struct CommThreadInvoker<void>
+    {
+        template<typename Task>
+        static void Invoke(
+            Task& task,
+            coral::net::Reactor& reactor,
+            void*,
+            CommThreadSlot& slot)
+        {
+            task(reactor, slot);
+        }
+    };
+
+
+    // The operations of CommThreadTaskStorage for a task which is stored
+    // inline (`Inline == true`) or on the heap.
+    template<typename StackData, typename Task, bool Inline>
+    struct CommThreadTaskOps
+    {
+        static Task& Get(void* storage) noexcept
+        {
+            return *static_cast<Task*>(storage);
+        }
+
+        static void Create(void* storage, Task&& task)
+        {
+            new (storage) Task(std::move(task));
+        }
+
+        static void Invoke(
+            void* storage,
+            coral::net::Reactor& reactor,
+            void* stackData,
+            CommThreadSlot& slot)
+        {
+            CommThreadInvoker<StackData>::Invoke(Get(storage), reactor, stackData, slot);
+        }
+
+        static void Move(void* from, void* to)
+        {
+            new (to) Task(std::move(Get(from)));
+            Get(from).~Task();
+        }
+
+        static void Destroy(void* storage)
+        {
+            Get(storage).~Task();
+        }
+    };
+
+    template<typename StackData, typename Task>
+    struct CommThreadTaskOps<StackData, Task, false>
+    {
+        static Task*& Get(void* storage) noexcept
+        {
+            return *static_cast<Task**>(storage);
+        }
+
+        static void Create(void* storage, Task&& task)
+        {
+            new (storage) Task*(new Task(std::move(task)));
+        }
+
+        static void Invoke(
+            void* storage,
+            coral::net::Reactor& reactor,
+            void* stackData,
+            CommThreadSlot& slot)
+        {
+            CommThreadInvoker<StackData>::Invoke(*Get(storage), reactor, stackData, slot);
+        }
+
+        static void Move(void* from, void* to)
+        {
+            new (to) Task*(Get(from));
+        }
+
+        static void Destroy(void* storage)
+        {
+            delete Get(storage);
+        }
+    };
+
+
+    template<typename StackData, typename Task>
+    void CommThreadTaskStorage::Emplace(Task task)
+    {
+        assert(m_ops == nullptr);
+        typedef CommThreadTaskOps<
+                StackData,
+                Task,
+                sizeof(Task) <= inlineSize
+                    && std::alignment_of<Task>::value
+                        <= std::alignment_of<std::max_align_t>::value
+                    && std::is_nothrow_move_constructible<Task>::value
+            > TaskOps;
+        static const Ops ops =
+            { &TaskOps::Invoke, &TaskOps::Move, &TaskOps::Destroy };
+        TaskOps::Create(&m_storage, std::move(task));
+        m_ops = &ops;
     }
 
+
+    // Holds the background thread's StackData object, if any.
+    template<typename StackData>
+    struct CommThreadStack
+    {
+        void* Data() noexcept { return &data; }
+
+        StackData data;
+    };
+
     template<>
-    inline void CommThreadMessagingLoop<void>(
-        zmq::socket_t& bgSocket,
-        typename CommThreadAnyTask<void>::SharedPtr nextTask)
+    struct CommThreadStack<void>
+    {
+        void* Data() noexcept { return nullptr; }
+    };
+
+
+    template<typename StackData>
+    void CommThreadMessagingLoop(CommThreadShared<StackData>& shared)
     {
         coral::net::Reactor reactor;
-        reactor.AddSocket(
-            bgSocket,
-            [nextTask = std::move(nextTask)] (coral::net::Reactor& r, zmq::socket_t& s) mutable {
-                char dummy;
-                s.recv(&dummy, 1);
-
-                // Now, the foreground thread is blocked waiting for our
-                // reply, so we can freely access `nextTask`.
-                CommThreadAnyTask<void>::Type myTask;
-                swap(*nextTask, myTask);
-
-                // Unblock foreground thread again and then run the task.
-                s.send("\1", 1);
-                myTask(r);
+        CommThreadStack<StackData> stack;
+        shared.wakeup.Register(
+            reactor,
+            [&shared, &stack] (coral::net::Reactor& r)
+            {
+                CommThreadSlot* slot = nullptr;
+                while (shared.tasks.TryPop(slot)) {
+                    // The slot may be reused as soon as the task has
+                    // completed it, so the task must be moved out first.
+                    CommThreadTaskStorage task;
+                    slot->task.MoveTo(task);
+                    task.Run(r, stack.Data(), *slot);
+                }
             });
         reactor.Run();
     }
 
+
     template<typename StackData>
     void CommThreadBackground(
-        zmq::socket_t bgSocket,
-        std::promise<void> statusNotifier,
-        typename CommThreadAnyTask<StackData>::SharedPtr nextTask)
+        std::shared_ptr<CommThreadShared<StackData>> shared,
+        std::promise<void> statusNotifier)
         noexcept
     {
+        std::exception_ptr error;
         try {
-            CommThreadMessagingLoop<StackData>(
-                bgSocket,
-                std::move(nextTask));
-
-            // We should possibly use set_value_at_thread_exit() and
-            // set_exception_at_thread_exit() in the following, but those are
-            // not supported in GCC 4.9.
-            statusNotifier.set_value();
+            CommThreadMessagingLoop<StackData>(*shared);
         } catch (...) {
-            statusNotifier.set_exception(
-                std::current_exception());
+            error = std::current_exception();
         }
 
-        // This is to avoid the race condition where the background
-        // thread dies after the foreground thread has sent a task notification
-        // and is waiting to receive an acknowledgement.
-        bgSocket.send("\0", 1);
+        // No more tasks will be run, so fail the ones that are still queued.
+        // A foreground thread which queues a task after this checks `alive`
+        // afterwards, and the fences ensure that either it sees the flag
+        // or we see its task.
+        shared->alive.store(false);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        CommThreadSlot* slot = nullptr;
+        while (shared->tasks.TryPop(slot)) {
+            slot->task.Clear();
+            slot->Complete(CommThreadSlot::dead);
+        }
+
+        // We should possibly use set_value_at_thread_exit() and
+        // set_exception_at_thread_exit() in the following, but those are
+        // not supported in GCC 4.9.
+        if (error) {
+            statusNotifier.set_exception(error);
+        } else {
+            statusNotifier.set_value();
+        }
     }
 } // namespace detail
 
@@ -401,26 +950,13 @@ namespace detail
 template<typename StackData>
 CommThread<StackData>::CommThread()
     : m_active{true}
-    , m_socket{coral::net::zmqx::GlobalContext(), ZMQ_PAIR}
+    , m_shared{std::make_shared<detail::CommThreadShared<StackData>>()}
     , m_threadStatus{}
-    , m_nextTask{}
 {
-    auto bgSocket = zmq::socket_t(coral::net::zmqx::GlobalContext(), ZMQ_PAIR);
-    bgSocket.setsockopt(ZMQ_LINGER, -1);
-    m_socket.setsockopt(ZMQ_LINGER, -1);
-    const auto endpoint = "inproc://" + coral::util::RandomUUID();
-    bgSocket.bind(endpoint);
-    m_socket.connect(endpoint);
-
     std::promise<void> statusNotifier;
     m_threadStatus = statusNotifier.get_future();
-
-    auto sharedTask =
-        std::make_shared<typename detail::CommThreadAnyTask<StackData>::Type>(/*empty*/);
-    m_nextTask = sharedTask;
-
     std::thread{&detail::CommThreadBackground<StackData>,
-        std::move(bgSocket), std::move(statusNotifier), sharedTask}.detach();
+        m_shared, std::move(statusNotifier)}.detach();
 }
 
 
@@ -434,9 +970,8 @@ CommThread<StackData>::~CommThread() noexcept
 template<typename StackData>
 CommThread<StackData>::CommThread(CommThread&& other) noexcept
     : m_active{other.m_active}
-    , m_socket{std::move(other.m_socket)}
+    , m_shared{std::move(other.m_shared)}
     , m_threadStatus{std::move(other.m_threadStatus)}
-    , m_nextTask{std::move(other.m_nextTask)}
 {
     other.m_active = false;
 }
@@ -447,9 +982,8 @@ CommThread<StackData>& CommThread<StackData>::operator=(CommThread&& other) noex
 {
     DestroySilently();
     m_active = other.m_active;
-    m_socket = std::move(other.m_socket);
+    m_shared = std::move(other.m_shared);
     m_threadStatus = std::move(other.m_threadStatus);
-    m_nextTask = std::move(other.m_nextTask);
     other.m_active = false;
     return *this;
 }
@@ -460,16 +994,27 @@ namespace detail
     template<typename StackData, typename Result>
     struct CommThreadFunctions
     {
-        static typename CommThreadAnyTask<StackData>::Type WrapTask(
+        // The slot is completed as soon as the task has been dequeued, to
+        // signal that it has been accepted.  The result goes via the promise.
+        static auto WrapTask(
             typename CommThreadTask<StackData, Result>::Type task,
             std::promise<Result> promise)
         {
-            const auto sharedPromise =
-                std::make_shared<typename std::promise<Result>>(std::move(promise));
-            return [task, sharedPromise]
-                (coral::net::Reactor& reactor, StackData& data)
+            return [task = std::move(task), promise = std::move(promise)]
+                (coral::net::Reactor& reactor, StackData& data, CommThreadSlot& slot) mutable
             {
-                task(reactor, data, std::move(*sharedPromise));
+                slot.Complete(CommThreadSlot::succeeded);
+                task(reactor, data, std::move(promise));
+            };
+        }
+
+        template<typename Task>
+        static auto WrapSyncTask(Task task)
+        {
+            return [task = std::move(task)]
+                (coral::net::Reactor& reactor, StackData& data, CommThreadSlot& slot) mutable
+            {
+                task(reactor, data, CommThreadCompletion<Result>(slot));
             };
         }
     };
@@ -478,19 +1023,63 @@ namespace detail
     template<typename Result>
     struct CommThreadFunctions<void, Result>
     {
-        static typename CommThreadAnyTask<void>::Type WrapTask(
+        static auto WrapTask(
             typename CommThreadTask<void, Result>::Type task,
             std::promise<Result> promise)
         {
-            const auto sharedPromise =
-                std::make_shared<typename std::promise<Result>>(std::move(promise));
-            return [task, sharedPromise]
-                (coral::net::Reactor& reactor)
+            return [task = std::move(task), promise = std::move(promise)]
+                (coral::net::Reactor& reactor, CommThreadSlot& slot) mutable
+            {
+                slot.Complete(CommThreadSlot::succeeded);
+                task(reactor, std::move(promise));
+            };
+        }
+
+        template<typename Task>
+        static auto WrapSyncTask(Task task)
+        {
+            return [task = std::move(task)]
+                (coral::net::Reactor& reactor, CommThreadSlot& slot) mutable
             {
-                task(reactor, std::move(*sharedPromise));
+                task(reactor, CommThreadCompletion<Result>(slot));
             };
         }
     };
+
+
+    // Uninitialised storage for the result of ExecuteAndWait().
+    template<typename Result>
+    class CommThreadResult
+    {
+    public:
+        void* Storage() noexcept { return &m_storage; }
+
+        // Moves the value out and destroys it.  Only call this if the
+        // value has been constructed.
+        Result Take()
+        {
+            const auto value = reinterpret_cast<Result*>(&m_storage);
+            const auto cleanup = coral::util::OnScopeExit([value] ()
+            {
+                value->~Result();
+            });
+            return std::move(*value);
+        }
+
+    private:
+        typename std::aligned_storage<
+                sizeof(Result),
+                std::alignment_of<Result>::value
+            >::type m_storage;
+    };
+
+    template<>
+    class CommThreadResult<void>
+    {
+    public:
+        void* Storage() noexcept { return nullptr; }
+        void Take() noexcept { }
+    };
 } // namespace detail
 
 
@@ -505,33 +1094,121 @@ std::future<Result> CommThread<StackData>::Execute(
     auto promise = std::promise<Result>{};
     auto future = promise.get_future();
 
-    char alive = 0;
-    if (auto sharedTask = m_nextTask.lock()) {
-        assert(!(*sharedTask));
-        assert(sharedTask.use_count() == 2);
-        *sharedTask = detail::CommThreadFunctions<StackData, Result>::WrapTask(
+    // Wait for the background thread to accept the task before returning,
+    // so that we detect it if the thread has died.
+    auto& slot = Submit(
+        detail::CommThreadFunctions<StackData, Result>::WrapTask(
             std::move(task),
-            std::move(promise));
+            std::move(promise)),
+        nullptr);
+    Await(slot);
+    assert(slot.exception == nullptr);
+    ReleaseSlot(slot);
+    return future;
+}
+
+
+template<typename StackData>
+template<typename Result, typename Task>
+Result CommThread<StackData>::ExecuteAndWait(Task task)
+{
+    CORAL_PRECONDITION_CHECK(Active());
+
+    detail::CommThreadResult<Result> result;
+    auto& slot = Submit(
+        detail::CommThreadFunctions<StackData, Result>::WrapSyncTask(
+            std::move(task)),
+        result.Storage());
+    Await(slot);
+    const auto exception = slot.exception;
+    ReleaseSlot(slot);
+    if (exception) std::rethrow_exception(exception);
+    return result.Take();
+}
+
 
-        // Notify background thread that a task is ready and wait for it
-        // to acknowledge it before returning.
-        m_socket.send("", 0);
-        m_socket.recv(&alive, 1);
+template<typename StackData>
+template<typename Task>
+detail::CommThreadSlot& CommThread<StackData>::Submit(
+    Task task,
+    void* resultStorage)
+{
+    auto& shared = *m_shared;
+
+    // The pool only runs dry if there are more concurrent callers than
+    // there are slots, in which case we wait our turn.  We yield a limited
+    // number of times, and then sleep between attempts, so that a long wait
+    // doesn't burn CPU time.
+    std::size_t slotIndex = 0;
+    for (std::size_t attempt = 1; !shared.freeSlots.TryPop(slotIndex); ++attempt) {
+        if (attempt < detail::CommThreadShared<StackData>::capacity) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
     }
-    if (!alive) {
-        // Either the weak_ptr has expired or the background thread sent a
-        // zero message. Both mean that the background thread has died.
-        WaitForThreadTermination();
-
-        // The above function should have thrown.  If it didn't, it probably
-        // means that calling code did something stupid.
-        coral::log::Log(
-            coral::log::error,
-            "CommThread background thread has terminated silently and "
-            "unexpectedly.  Perhaps Reactor::Stop() was called?");
-        std::terminate();
+    auto& slot = shared.slots[slotIndex];
+    slot.Reset(resultStorage);
+    try {
+        slot.task.template Emplace<StackData>(std::move(task));
+    } catch (...) {
+        ReleaseSlot(slot);
+        throw;
     }
-    return future;
+
+    // We hold a slot, so there is room in the queue.
+    auto queuedSlot = &slot;
+    const auto queued = shared.tasks.TryPush(queuedSlot);
+    assert(queued);
+    (void) queued;
+    shared.wakeup.Signal();
+
+    // If the background thread is terminating, it may already have drained
+    // the queue (see CommThreadBackground() for why the fence is needed).
+    // Once it is gone, we fail the tasks it didn't see.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!shared.alive.load()) {
+        m_threadStatus.wait();
+        detail::CommThreadSlot* leftover = nullptr;
+        while (shared.tasks.TryPop(leftover)) {
+            leftover->task.Clear();
+            leftover->Complete(detail::CommThreadSlot::dead);
+        }
+    }
+    return slot;
+}
+
+
+template<typename StackData>
+void CommThread<StackData>::Await(detail::CommThreadSlot& slot)
+{
+    if (slot.Wait() == detail::CommThreadSlot::dead) ThreadDied();
+}
+
+
+template<typename StackData>
+void CommThread<StackData>::ReleaseSlot(detail::CommThreadSlot& slot) noexcept
+{
+    slot.exception = nullptr;
+    auto index = slot.index;
+    const auto released = m_shared->freeSlots.TryPush(index);
+    assert(released);
+    (void) released;
+}
+
+
+template<typename StackData>
+void CommThread<StackData>::ThreadDied()
+{
+    WaitForThreadTermination();
+
+    // The above function should have thrown.  If it didn't, it probably
+    // means that calling code did something stupid.
+    coral::log::Log(
+        coral::log::error,
+        "CommThread background thread has terminated silently and "
+        "unexpectedly.  Perhaps Reactor::Stop() was called?");
+    std::terminate();
 }
 
 
@@ -589,7 +1266,7 @@ void CommThread<StackData>::WaitForThreadTermination()
             const auto cleanup = coral::util::OnScopeExit([this] ()
             {
                 m_active = false;
-                m_socket.close();
+                m_shared.reset();
 #ifdef _MSC_VER
                 // Visual Studio does not "reset" the future after get().
                 // See:  http://stackoverflow.com/q/33899615
@@ -668,7 +1345,7 @@ void CommThread<StackData>::DestroySilently() noexcept
         }
     }
     assert(!Active());
-    assert(!static_cast<void*>(m_socket));
+    assert(!m_shared);
     assert(!m_threadStatus.valid());
 }
 
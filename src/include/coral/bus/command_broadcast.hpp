@@ -0,0 +1,211 @@
+/**
+\file
+\brief  Defines the coral::bus::CommandBroadcaster and
+        coral::bus::CommandSubscriber classes.
+\copyright
+    Copyright 2013-present, SINTEF Ocean.
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+#ifndef CORAL_BUS_COMMAND_BROADCAST_HPP
+#define CORAL_BUS_COMMAND_BROADCAST_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/message_lite.h>
+#include <zmq.hpp>
+
+#include <coral/config.h>
+#include <coral/model.hpp>
+#include <coral/net.hpp>
+
+#include <execution.pb.h>
+
+
+namespace coral
+{
+namespace bus
+{
+
+
+/**
+\brief  Sends identical control commands to many slaves at once.
+
+This is used by the master to send commands like STEP and ACCEPT_STEP,
+which are the same for all slaves, without serializing and sending them
+once per slave.  The command is serialized once and sent as a single
+message, which ZeroMQ then hands to every connected slave without copying
+it.  The slaves reply on their normal control channels.
+
+Each broadcast message consists of a frame that holds a 64-bit sequence
+number, which increases by one for each message, followed by the frames
+of an ordinary execution control message.  The slaves use the sequence
+number to discard stale and duplicate commands.
+
+A slave is connected with Connect(), but a connection only takes effect
+once the slave's subscription has reached us.  Commands which are
+broadcast before then are not received by that slave, so AllSubscribed()
+must return `true` before the broadcast channel is used in place of the
+per-slave channels.  To tell the subscriptions apart, each slave's
+CommandSubscriber also subscribes to a topic which identifies the slave
+(see CommandSubscriber::Identify()).
+*/
+class CommandBroadcaster
+{
+public:
+    /// Constructor.
+    CommandBroadcaster();
+
+    CommandBroadcaster(const CommandBroadcaster&) = delete;
+    CommandBroadcaster& operator=(const CommandBroadcaster&) = delete;
+
+    CORAL_DEFINE_DEFAULT_MOVE(CommandBroadcaster,
+        m_socket, m_connections, m_subscribed, m_sequence)
+
+    /**
+    \brief  Connects to a slave's command subscriber endpoint.
+
+    \param [in] slaveID     The ID of the slave, as passed to its
+                            CommandSubscriber::Identify().
+    \param [in] endpoint    The slave's command subscriber endpoint.
+
+    \pre The slave is not already connected.
+    */
+    void Connect(coral::model::SlaveID slaveID, const coral::net::Endpoint& endpoint);
+
+    /**
+    \brief  Disconnects from a slave, e.g. because it has left the execution.
+
+    Does nothing if the slave is not connected.
+    */
+    void Disconnect(coral::model::SlaveID slaveID);
+
+    /// Returns the number of slaves which are currently connected.
+    int ConnectionCount() const noexcept;
+
+    /// Returns whether the given slave is currently connected.
+    bool IsConnected(coral::model::SlaveID slaveID) const noexcept;
+
+    /**
+    \brief  Returns whether all connected slaves have subscribed, so that
+            broadcast commands will reach all of them.
+
+    This checks for any subscriptions and unsubscriptions that have arrived
+    since the last call.  It never blocks.
+    */
+    bool AllSubscribed();
+
+    /**
+    \brief  Sends a command to all subscribed slaves.
+
+    \param [in] type    The message type.
+    \param [in] body    The message body, or null if there is none.
+    */
+    void Send(
+        coralproto::execution::MessageType type,
+        const google::protobuf::MessageLite* body = nullptr);
+
+private:
+    std::unique_ptr<zmq::socket_t> m_socket;
+
+    // The endpoints of the connected slaves, and which of those slaves
+    // currently have a subscription.
+    std::map<coral::model::SlaveID, std::string> m_connections;
+    std::set<coral::model::SlaveID> m_subscribed;
+
+    std::uint64_t m_sequence;
+};
+
+
+/**
+\brief  Receives control commands sent with a CommandBroadcaster.
+
+This is the slave's end of the broadcast channel.  The slave binds to an
+endpoint, which the master connects to.
+*/
+class CommandSubscriber
+{
+public:
+    /**
+    \brief  Default constructor.
+
+    Note that Bind() must be called before any commands may be received.
+    */
+    CommandSubscriber();
+
+    CommandSubscriber(const CommandSubscriber&) = delete;
+    CommandSubscriber& operator=(const CommandSubscriber&) = delete;
+
+    CORAL_DEFINE_DEFAULT_MOVE(CommandSubscriber,
+        m_socket, m_lastSequence, m_identityTopic)
+
+    /**
+    \brief  Binds to a local endpoint.
+
+    The endpoint has the same format as for VariablePublisher::Bind().
+
+    \pre Bind() has not been called previously on this instance.
+    */
+    void Bind(const coral::net::Endpoint& endpoint);
+
+    /**
+    \brief  Returns the endpoint bound to by the last Bind() call.
+
+    \pre Bind() has been called successfully on this instance.
+    */
+    coral::net::Endpoint BoundEndpoint() const;
+
+    /**
+    \brief  Tells the broadcaster which slave this subscriber belongs to.
+
+    This makes the subscription count towards the slave with the given ID
+    in CommandBroadcaster::AllSubscribed().  It may be called before or
+    after the broadcaster connects, but the broadcaster won't consider
+    the slave subscribed until it has been called.
+
+    \pre Bind() has been called successfully on this instance.
+    */
+    void Identify(coral::model::SlaveID slaveID);
+
+    /**
+    \brief  Receives a command.
+
+    This function blocks until a message is available, so it should only
+    be called when Socket() has incoming data.
+
+    \param [out] msg
+        The frames of the execution control message, without the sequence
+        number frame.  Only valid if the function returns `true`.
+
+    \returns
+        `false` if the command was older than, or the same as, the last one
+        received, in which case it must be ignored.  Otherwise `true`.
+
+    \throws coral::error::ProtocolViolationException
+        If the message is invalid.
+    \pre Bind() has been called successfully on this instance.
+    */
+    bool Receive(std::vector<zmq::message_t>& msg);
+
+    /**
+    \brief  The underlying socket, for use with coral::net::Reactor.
+
+    \pre Bind() has been called successfully on this instance.
+    */
+    zmq::socket_t& Socket();
+
+private:
+    std::unique_ptr<zmq::socket_t> m_socket;
+    std::uint64_t m_lastSequence;
+    std::string m_identityTopic;
+};
+
+
+}} // namespace
+#endif // header guard
@@ -181,7 +181,15 @@ public:
     typedef std::function<void(const std::error_code&, coral::model::SlaveID)>
         SlaveStepHandler;
 
-    /// Steps the simulation forward.
+    /**
+    \brief  Steps the simulation forward.
+
+    This may be called either when the execution is ready, or right after a
+    successful step.  In the latter case, the previous step is accepted
+    first, as if by AcceptStep().  This is done in the same request for
+    slaves that support protocol version 5 or later, so it avoids a full
+    round trip per step.
+    */
     void Step(
         coral::model::TimeDuration stepSize,
         std::chrono::milliseconds timeout,
@@ -204,6 +212,75 @@ public:
         AcceptStepHandler onComplete,
         SlaveAcceptStepHandler onSlaveAcceptStepComplete = nullptr);
 
+    /**
+    \brief  Progress handler type for the Run() function.
+
+    The argument is the simulation time up to which all slaves have
+    completed their time steps.
+    */
+    typedef std::function<void(coral::model::TimePoint)> RunProgressHandler;
+
+    /**
+    \brief  Completion handler type for the Run() function.
+
+    The second argument is the number of time steps which were completed.
+    */
+    typedef std::function<void(const std::error_code&, int)> RunHandler;
+
+    /// Completion handler type for the Run() function of individual slaves.
+    typedef std::function<void(const std::error_code&, coral::model::SlaveID)>
+        SlaveRunHandler;
+
+    /**
+    \brief  Performs a number of time steps without the master's involvement
+            in each step.
+
+    Each slave steps on its own, as soon as it has received the variable
+    values it needs from the other slaves, so slaves which don't depend on
+    each other do not wait for each other.  This requires all slaves to
+    support protocol version 7 or later.
+
+    The run may be ended early with Interrupt(), in which case the slaves
+    which have fallen behind are brought up to the same time step as the
+    one which has come furthest before `onComplete` is called.
+
+    \param [in] stepSize
+        The step size.  Must be positive.
+    \param [in] stepCount
+        The number of steps to perform.
+    \param [in] progressInterval
+        If positive, each slave reports its progress every
+        `progressInterval` steps, and `onProgress` is called whenever the
+        slowest slave has made progress.
+    \param [in] timeout
+        Max. allowed time between progress reports from each slave, or for
+        the entire run if `progressInterval` is zero.  A negative value
+        means no time limit.
+    \param [in] onProgress
+        Progress handler.  May be empty.
+    \param [in] onComplete
+        Completion handler.
+    \param [in] onSlaveRunComplete
+        Per-slave completion handler.  May be empty.
+
+    \pre The execution is ready, i.e., the last step has been accepted.
+    */
+    void Run(
+        coral::model::TimeDuration stepSize,
+        int stepCount,
+        int progressInterval,
+        std::chrono::milliseconds timeout,
+        RunProgressHandler onProgress,
+        RunHandler onComplete,
+        SlaveRunHandler onSlaveRunComplete = nullptr);
+
+    /**
+    \brief  Ends an ongoing Run() early.
+
+    This has no effect if no run is in progress.
+    */
+    void Interrupt();
+
     /// Terminates the entire execution and all associated slaves.
     void Terminate();
 
@@ -13,10 +13,12 @@
 // For the sake of maintainability, we can skip the headers which are already
 // included by execution_manager.hpp, and which are only needed here because
 // ExecutionManagerPrivate duplicates ExecutionManager's method signatures.
+#include <chrono>
 #include <functional>
-#include <map>
 #include <memory>
+#include <string>
 #include <system_error>
+#include <vector>
 
 #include <boost/noncopyable.hpp>
 
@@ -24,9 +26,13 @@
 #include <coral/model.hpp>
 #include <coral/net.hpp>
 
+#include <coral/bus/command_broadcast.hpp>
 #include <coral/bus/execution_manager.hpp>
 #include <coral/bus/slave_controller.hpp>
 #include <coral/bus/slave_setup.hpp>
+#include <coral/bus/slave_shard.hpp>
+#include <coral/bus/sub_master.hpp>
+#include <coral/util/flat_map.hpp>
 
 
 namespace coral
@@ -82,6 +88,17 @@ public:
         ExecutionManager::AcceptStepHandler onComplete,
         ExecutionManager::SlaveAcceptStepHandler onSlaveAcceptStepComplete);
 
+    void Run(
+        coral::model::TimeDuration stepSize,
+        int stepCount,
+        int progressInterval,
+        std::chrono::milliseconds timeout,
+        ExecutionManager::RunProgressHandler onProgress,
+        ExecutionManager::RunHandler onComplete,
+        ExecutionManager::SlaveRunHandler onSlaveRunComplete);
+
+    void Interrupt();
+
     void Terminate();
 
     // Internal methods, i.e. those that are used by the state-specific objects.
@@ -100,6 +117,10 @@ public:
     coral::model::TimePoint CurrentSimTime() const;
     void AdvanceSimTime(coral::model::TimeDuration delta);
 
+    // Sets the ID of the last time step performed.  This is used after a
+    // run, where the slaves have performed a number of steps on their own.
+    void SetCurrentStepID(coral::model::StepID stepID);
+
     // To be called when a per-slave operation has started and completed,
     // respectively.
     void SlaveOpStarted() noexcept;
@@ -125,6 +146,22 @@ public:
     */
     void WhenAllSlaveOpsComplete(AllSlaveOpsCompleteHandler handler);
 
+    /*
+    Calls `action` once all the commands which have been given to the slave
+    controllers so far have actually been handed to their messengers.
+
+    Without shards, this happens immediately.  With shards, it happens in
+    the thread of whichever shard gets there last, so `action` may only use
+    data that is left alone until the commands complete, and it may not
+    throw.  In the latter case, it also counts as a per-slave operation,
+    so WhenAllSlaveOpsComplete() waits for it.
+    */
+    void WhenCommandsIssued(std::function<void()> action);
+
+    // Returns the shard which the given slave belongs to, or null if the
+    // execution doesn't use shards.
+    SlaveShard* ShardFor(coral::model::SlaveID slaveID) noexcept;
+
     /*
     Switches to another state, and returns the current state object (for when
     the object needs to be kept alive a little bit more).
@@ -148,11 +185,78 @@ public:
         coral::model::SlaveDescription description;
     };
 
+    // A sub-master, and the slaves in the execution which it serves.
+    struct SubMasterGroup
+    {
+        std::unique_ptr<coral::bus::SubMasterClient> client;
+        std::vector<coral::model::SlaveID> slaves;
+
+        // The slaves which are to receive the next relayed command.
+        std::vector<coral::model::SlaveID> pending;
+    };
+
+    /*
+    Returns the sub-master through which STEP and ACCEPT_STEP commands to
+    the given slave should be relayed, or null if there is none.
+
+    A sub-master is only used if it serves more than one slave, because
+    otherwise it just adds a detour.  If it is still busy with a previous
+    command, the caller should send the command directly instead.  It must
+    not be broadcast, because the slave would send its reply to whichever
+    client sent it the last direct command, which may be the sub-master.
+    */
+    SubMasterGroup* SubMasterFor(const Slave& slave);
+
+    /*
+    Makes every sub-master which has slaves in its `pending` list relay
+    `command` to them, and passes the replies on to the slave controllers.
+    The controllers must already have been prepared with StepByRelay() or
+    AcceptStepByRelay().  `step` is only used for STEP.
+    */
+    void RelayCommand(
+        coralproto::execution::MessageType command,
+        const coralproto::execution::StepData* step,
+        std::chrono::milliseconds timeout);
+
     // Data which is available to the state objects
     coral::net::Reactor& reactor;
     coral::bus::SlaveSetup slaveSetup;
+    coral::bus::VariableEncoding variableEncoding;
     coral::model::SlaveID lastSlaveID;
-    std::map<coral::model::SlaveID, Slave> slaves;
+
+    // The threads which the slaves are divided between, if any, and the
+    // inbox through which their controllers call us back.  These are
+    // declared before `slaves`, because they must outlive them.
+    std::vector<std::unique_ptr<SlaveShard>> shards;
+    std::unique_ptr<TaskInbox> homeInbox;
+
+    coral::util::FlatMap<coral::model::SlaveID, Slave> slaves;
+
+    // The sub-masters which serve the slaves, keyed by endpoint URL.
+    coral::util::FlatMap<std::string, SubMasterGroup> subMasters;
+
+    // Sends STEP and ACCEPT_STEP commands to all the slaves which support
+    // it (protocol version 6 and up) with a single message.
+    coral::bus::CommandBroadcaster commandBroadcaster;
+
+    // A mapping from slave to input variable to output variable.
+    typedef coral::util::FlatMap<
+            coral::model::SlaveID,
+            coral::util::FlatMap<coral::model::VariableID, coral::model::Variable>>
+        ConnectionMap;
+
+    // A mapping from slave to output variable to the number of inputs
+    // connected to it.  Only nonzero counts are stored.
+    typedef coral::util::FlatMap<
+            coral::model::SlaveID,
+            coral::util::FlatMap<coral::model::VariableID, int>>
+        ConsumerCountMap;
+
+    // The current variable connections, and the number of consumers of each
+    // output.  These are only updated once the slaves have confirmed a
+    // reconfiguration, so they always reflect what the slaves have been told.
+    ConnectionMap connections;
+    ConsumerCountMap outputConsumerCounts;
 
 private:
     // Make class nonmovable in addition to noncopyable, because we leak
@@ -163,6 +267,12 @@ private:
     // Performs the actual aborting of the "wait for all slave ops" thingy
     void AbortSlaveOpWaiting() noexcept;
 
+    // Calls `action`, after sending RESEND_VARS to the slaves first if
+    // necessary.  If the latter fails, `onFailure` is called instead.
+    void WithResentVars(
+        std::function<void()> action,
+        std::function<void(const std::error_code&)> onFailure);
+
     // An object that represents, and performs the actions for, the current
     // execution state.
     std::unique_ptr<ExecutionState> m_state;
@@ -15,8 +15,10 @@
 // included by execution_manager.hpp, and which are only needed here because
 // ExecutionState duplicates ExecutionManager's method signatures.
 #include <coral/bus/execution_manager.hpp>
+#include <coral/bus/execution_manager_private.hpp>
 #include <coral/config.h>
 #include <coral/error.hpp>
+#include <coral/util/flat_map.hpp>
 
 
 namespace coral
@@ -77,6 +79,21 @@ public:
         ExecutionManager::SlaveAcceptStepHandler onSlaveAcceptStepComplete)
     { NotAllowed(__FUNCTION__); }
 
+    virtual void Run(
+        ExecutionManagerPrivate& self,
+        coral::model::TimeDuration stepSize,
+        int stepCount,
+        int progressInterval,
+        std::chrono::milliseconds timeout,
+        ExecutionManager::RunProgressHandler onProgress,
+        ExecutionManager::RunHandler onComplete,
+        ExecutionManager::SlaveRunHandler onSlaveRunComplete)
+    { NotAllowed(__FUNCTION__); }
+
+    // Unlike the other functions, this does nothing by default, since
+    // there is no way for the caller to know whether a run has ended.
+    virtual void Interrupt(ExecutionManagerPrivate& self) { }
+
     virtual void Terminate(ExecutionManagerPrivate& self)
     { NotAllowed(__FUNCTION__); }
 
@@ -120,6 +137,16 @@ class ReadyExecutionState : public ExecutionState
         ExecutionManager::StepHandler onComplete,
         ExecutionManager::SlaveStepHandler onSlaveStepComplete) override;
 
+    void Run(
+        ExecutionManagerPrivate& self,
+        coral::model::TimeDuration stepSize,
+        int stepCount,
+        int progressInterval,
+        std::chrono::milliseconds timeout,
+        ExecutionManager::RunProgressHandler onProgress,
+        ExecutionManager::RunHandler onComplete,
+        ExecutionManager::SlaveRunHandler onSlaveRunComplete) override;
+
     void Terminate(ExecutionManagerPrivate& self) override;
 };
 
@@ -167,6 +194,11 @@ private:
     const std::chrono::milliseconds m_commTimeout;
     const ExecutionManager::ReconfigureHandler m_onComplete;
     const ExecutionManager::SlaveReconfigureHandler m_onSlaveComplete;
+
+    // The connection bookkeeping as it will be once the reconfiguration
+    // has succeeded.
+    ExecutionManagerPrivate::ConnectionMap m_connections;
+    ExecutionManagerPrivate::ConsumerCountMap m_outputConsumerCounts;
 };
 
 
@@ -227,6 +259,14 @@ private:
         ExecutionManager::SlaveAcceptStepHandler onSlaveAcceptStepComplete)
             override;
 
+    // Accepts the current step and starts a new one.
+    void Step(
+        ExecutionManagerPrivate& self,
+        coral::model::TimeDuration stepSize,
+        std::chrono::milliseconds timeout,
+        ExecutionManager::StepHandler onComplete,
+        ExecutionManager::SlaveStepHandler onSlaveStepComplete) override;
+
     const coral::model::TimeDuration m_stepSize;
 };
 
@@ -248,6 +288,51 @@ private:
 };
 
 
+class RunningExecutionState : public ExecutionState
+{
+public:
+    RunningExecutionState(
+        coral::model::TimeDuration stepSize,
+        int stepCount,
+        int progressInterval,
+        std::chrono::milliseconds timeout,
+        ExecutionManager::RunProgressHandler onProgress,
+        ExecutionManager::RunHandler onComplete,
+        ExecutionManager::SlaveRunHandler onSlaveRunComplete);
+
+private:
+    void StateEntered(ExecutionManagerPrivate& self) override;
+    void Interrupt(ExecutionManagerPrivate& self) override;
+
+    void StartRun(
+        ExecutionManagerPrivate& self,
+        coral::model::SlaveID slaveID,
+        coral::model::StepID firstStepID,
+        coral::model::StepID lastStepID,
+        int progressInterval);
+    void ReportProgress();
+    void InterruptAll(ExecutionManagerPrivate& self);
+    void AllRunsComplete(ExecutionManagerPrivate& self);
+
+    // Input parameters to this state
+    const coral::model::TimeDuration m_stepSize;
+    const int m_stepCount;
+    const int m_progressInterval;
+    const std::chrono::milliseconds m_timeout;
+    const ExecutionManager::RunProgressHandler m_onProgress;
+    const ExecutionManager::RunHandler m_onComplete;
+    const ExecutionManager::SlaveRunHandler m_onSlaveRunComplete;
+
+    // Local variables of this state
+    coral::model::StepID m_firstStepID;
+    coral::model::TimePoint m_startTime;
+    coral::util::FlatMap<coral::model::SlaveID, coral::model::StepID> m_lastStepIDs;
+    coral::model::StepID m_reportedStepID;
+    bool m_interrupted;
+    bool m_catchingUp;
+};
+
+
 class StepFailedExecutionState : public ExecutionState
 {
     void Terminate(ExecutionManagerPrivate& self) override;
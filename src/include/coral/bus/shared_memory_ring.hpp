@@ -0,0 +1,233 @@
+/**
+\file
+\brief  Defines the coral::bus::SharedMemoryRingWriter and
+        coral::bus::SharedMemoryRingReader classes.
+\copyright
+    Copyright 2013-present, SINTEF Ocean.
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+#ifndef CORAL_BUS_SHARED_MEMORY_RING_HPP
+#define CORAL_BUS_SHARED_MEMORY_RING_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+#include <coral/config.h>
+#include <coral/model.hpp>
+
+
+namespace coral
+{
+namespace bus
+{
+
+
+// The layout of the control segment, which is defined in the .cpp file.
+struct SharedMemoryRingControl;
+
+
+/**
+\brief  The writing end of a message ring buffer in shared memory.
+
+This lets one process pass messages to any number of processes on the same
+host without going through the network stack.  It is used by
+VariablePublisher to send variable values to subscribers on the same host.
+
+The ring consists of a small control segment, which is named after the ring,
+and one or more data segments.  The control segment holds the position at
+which the next message will be written and the positions from which each of
+up to `MAX_READERS` readers will read next.  Positions are byte offsets from
+the start of the message stream, and they only ever increase, so every
+message is identified by its position.  Each message is also tagged with
+the ID of the time step it belongs to, so readers can skip old messages
+without parsing them.
+
+A message is never overwritten before all readers have moved past it.
+When there is no room for a new message, the writer moves on to a new data
+segment ("generation") of twice the size, and the readers follow once they
+have read everything in the old one.  Only when the data segment has reached
+its maximum size does the writer wait for the readers.  A reader which hasn't
+made room within `stallTimeout` is evicted, and will fail on its next read.
+
+The ring is removed again when the writer is destroyed.  A ring which was
+left behind by a writer that has terminated is removed by the next writer
+that wants to use the same name, but a ring whose writer is still running is
+never touched by others.
+*/
+class SharedMemoryRingWriter
+{
+public:
+    /// The maximum number of simultaneous readers.
+    static const int MAX_READERS = 64;
+
+    /**
+    \brief  Constructor which creates the ring.
+
+    An existing ring with the same name is removed first if the process
+    which created it has terminated (e.g. crashed).
+
+    \param [in] name
+        The name of the ring, which the readers use to find it.
+    \param [in] initialCapacity
+        The size of the first data segment, in bytes.
+    \param [in] maxCapacity
+        The size beyond which data segments will not grow (unless a single
+        message requires it).
+    \param [in] stallTimeout
+        How long Write() waits for slow readers when the ring is full
+        before evicting them.
+
+    \throws std::runtime_error
+        If there is already a ring with the given name, and its writer may
+        still be running.
+    \throws boost::interprocess::interprocess_exception
+        If the shared memory segments could not be created.
+    */
+    SharedMemoryRingWriter(
+        const std::string& name,
+        std::size_t initialCapacity = 256*1024,
+        std::size_t maxCapacity = 64*1024*1024,
+        std::chrono::milliseconds stallTimeout = std::chrono::seconds(10));
+
+    /// Destructor which removes the ring.
+    ~SharedMemoryRingWriter() noexcept;
+
+    SharedMemoryRingWriter(const SharedMemoryRingWriter&) = delete;
+    SharedMemoryRingWriter& operator=(const SharedMemoryRingWriter&) = delete;
+    SharedMemoryRingWriter(SharedMemoryRingWriter&&) = delete;
+    SharedMemoryRingWriter& operator=(SharedMemoryRingWriter&&) = delete;
+
+    /**
+    \brief  Whether any readers are attached to the ring.
+
+    Messages written while there are no readers would never be read, so
+    Write() simply drops them.
+    */
+    bool HasReaders() const noexcept;
+
+    /**
+    \brief  Writes a message which consists of a header and a body.
+
+    This may block if the ring is full (see the class documentation).
+    */
+    void Write(
+        coral::model::StepID stepID,
+        const void* header,
+        std::size_t headerSize,
+        const void* body,
+        std::size_t bodySize);
+
+private:
+    std::uint64_t ReadPosition() const noexcept;
+    void NewGeneration(std::size_t minCapacity);
+    void WaitForReaders(std::uint64_t neededPosition);
+    void RemoveOldGenerations() noexcept;
+    void RemoveAll() noexcept;
+
+    std::string m_name;
+    std::size_t m_maxCapacity;
+    std::chrono::milliseconds m_stallTimeout;
+
+    // The control segment is kept open, since we hold a lock on it which
+    // shows that we're alive.
+    boost::interprocess::shared_memory_object m_controlShm;
+    boost::interprocess::mapped_region m_controlRegion;
+    SharedMemoryRingControl* m_control;
+    std::uint32_t m_instanceID;
+
+    // The data segments, indexed by generation.  Those which no reader needs
+    // any more are unmapped, and only the last one is written to.
+    std::vector<std::unique_ptr<boost::interprocess::mapped_region>> m_data;
+    std::uint32_t m_oldestGeneration;
+    std::uint64_t m_start;
+    std::uint64_t m_capacity;
+    char* m_buffer;
+    std::uint64_t m_writePos;
+};
+
+
+/**
+\brief  The reading end of a message ring buffer in shared memory.
+
+See SharedMemoryRingWriter for details.  A reader only receives the messages
+which are written after it has been attached to the ring.
+*/
+class SharedMemoryRingReader
+{
+public:
+    /// A message read from the ring.
+    struct Message
+    {
+        coral::model::StepID stepID;
+        const char* header;
+        std::size_t headerSize;
+        const char* body;
+        std::size_t bodySize;
+    };
+
+    /**
+    \brief  Constructor which attaches to an existing ring.
+
+    \throws std::runtime_error
+        If there is no ring with the given name, or it already has the
+        maximum number of readers.
+    */
+    explicit SharedMemoryRingReader(const std::string& name);
+
+    /// Destructor which detaches from the ring.
+    ~SharedMemoryRingReader() noexcept;
+
+    SharedMemoryRingReader(const SharedMemoryRingReader&) = delete;
+    SharedMemoryRingReader& operator=(const SharedMemoryRingReader&) = delete;
+    SharedMemoryRingReader(SharedMemoryRingReader&&) = delete;
+    SharedMemoryRingReader& operator=(SharedMemoryRingReader&&) = delete;
+
+    /// Whether there are unread messages.  This never blocks.
+    bool HasData() const noexcept;
+
+    /**
+    \brief  Reads the next message, if there is one.  This never blocks.
+
+    The pointers in `message` refer directly to the shared memory, and they
+    remain valid until the next call to this function.
+
+    \returns Whether a message was read.
+    \throws std::runtime_error
+        If the reader has been evicted from the ring for falling too far
+        behind.
+    */
+    bool Next(Message& message);
+
+private:
+    void MapGeneration();
+
+    std::string m_name;
+    boost::interprocess::mapped_region m_controlRegion;
+    SharedMemoryRingControl* m_control;
+    int m_slot;
+
+    std::uint32_t m_generation;
+    boost::interprocess::mapped_region m_data;
+    std::uint64_t m_start;
+    std::uint64_t m_capacity;
+    const char* m_buffer;
+
+    // m_committed is the position which is registered in the control
+    // segment, and m_cursor is that of the next unread message.  The
+    // difference is the message that was last returned by Next().
+    std::uint64_t m_committed;
+    std::uint64_t m_cursor;
+};
+
+
+}} // namespace
+#endif // header guard
@@ -12,7 +12,10 @@
 
 #include <chrono>
 #include <exception>
+#include <map>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <boost/bimap.hpp>
@@ -20,6 +23,7 @@
 #include <zmq.hpp>
 
 #include <coral/config.h>
+#include <coral/bus/command_broadcast.hpp>
 #include <coral/bus/variable_io.hpp>
 #include <coral/model.hpp>
 #include <coral/net.hpp>
@@ -101,7 +105,39 @@ public:
     */
     coral::net::Endpoint BoundDataPubEndpoint() const;
 
+    /**
+    \brief  Enables or disables busy polling while waiting for variable data
+            from other slaves.
+
+    See coral::bus::VariableSubscriber::SetSpinBudget().  Busy polling in the
+    main messaging loop is controlled separately, with
+    coral::net::Reactor::SetSpinBudget().
+    */
+    void SetSpinBudget(std::chrono::microseconds spinBudget) noexcept;
+
+    /// Statistics on the time spent waiting for variable data.
+    const coral::net::BusyPollStats& PollStats() const noexcept;
+
+    /**
+    \brief  Limits the execution protocol version which the slave will agree
+            to use.
+
+    By default, the slave uses the newest version which both it and the
+    master support.  Lowering the limit makes it behave like an older slave,
+    which is mainly useful for testing that masters remain compatible with
+    those.  It only takes effect for masters which connect afterwards.
+
+    \throws std::invalid_argument
+        If `version` is negative or greater than the newest supported version.
+    */
+    void SetMaxProtocolVersion(int version);
+
 private:
+    // Receives a request from the master, either through the control socket
+    // or, if `broadcast` is true, through the command subscriber, and sends
+    // the reply through the control socket.
+    void HandleRequest(coral::net::Reactor& reactor, bool broadcast);
+
     /*
     \brief  Responds to a message from the master.
 
@@ -120,6 +156,7 @@ private:
     void ConnectedHandler(std::vector<zmq::message_t>& msg);
     void ReadyHandler(std::vector<zmq::message_t>& msg);
     void PublishedHandler(std::vector<zmq::message_t>& msg);
+    void RunningHandler(std::vector<zmq::message_t>& msg);
     void StepFailedHandler(std::vector<zmq::message_t>& msg);
 
     // Performs the "describe" operation, including filling `msg` with a
@@ -134,16 +171,59 @@ private:
     // filling `msg` with a reply message.
     void HandleSetPeers(std::vector<zmq::message_t>& msg);
 
+    // Waits a short while for new connections to peers to be established,
+    // so that values published right afterwards are not lost.
+    void WaitForPeers();
+
     // Performs the "prime" operation for ReadyHandler(), including
     // filling `msg` with a reply message.
     void HandleResendVars(std::vector<zmq::message_t>& msg);
 
-    // Performs the time step for ReadyHandler()
-    bool Step(const coralproto::execution::StepData& stepData);
+    // Performs the "step" operation for ReadyHandler() and PublishedHandler(),
+    // including filling `msg` with a reply message and switching to the next
+    // state.
+    void HandleStep(std::vector<zmq::message_t>& msg);
+
+    // Updates the slave's inputs with the values received from other slaves
+    // for the current step (used by PublishedHandler()).
+    void AcceptStep();
+
+    // Performs the "run" operation for ReadyHandler() and PublishedHandler(),
+    // where `inputsPending` is true for the latter.  This only starts the
+    // run and switches to the RUNNING state; `msg` is left empty, since the
+    // reply is sent by EndRun() when the run is over.
+    void HandleRun(std::vector<zmq::message_t>& msg, bool inputsPending);
+
+    // Performs as many steps of the ongoing run as possible without blocking,
+    // and ends the run when it is complete, has failed or has been
+    // interrupted.  If an error occurs, the master is sent a FATAL_ERROR
+    // reply before the exception propagates.
+    void ContinueRun();
+
+    // The part of ContinueRun() which does the actual work.
+    void RunSteps();
+
+    // Makes the reactor call ContinueRun() after `delay`, or as soon as it
+    // has handled any pending events if `delay` is zero.
+    void ScheduleContinueRun(
+        std::chrono::microseconds delay = std::chrono::microseconds(0));
+
+    // Sends the reply to RUN and switches to the state which corresponds
+    // to it.
+    void EndRun(coralproto::execution::MessageType reply);
+
+    // Performs a time step (used by HandleStep() and RunSteps()).
+    bool Step(
+        coral::model::StepID stepID,
+        coral::model::TimePoint currentT,
+        coral::model::TimeDuration deltaT);
 
     // Publishes all variable values (used by HandleResendVars() and Step()).
     void PublishAll();
 
+    // Rebuilds m_outputValues after m_publishedOutputs has changed.
+    void UpdatePublishedOutputs();
+
     // A pointer to the handler function for the current state.
     void (SlaveAgent::* m_stateHandler)(std::vector<zmq::message_t>&);
 
@@ -186,18 +266,43 @@ private:
             const coral::net::Endpoint* endpoints,
             std::size_t endpointsSize);
 
+        // Connects to, or disconnects from, a single publisher endpoint
+        // without affecting the other connections.
+        void ConnectTo(const coral::net::Endpoint& endpoint);
+        void DisconnectFrom(const coral::net::Endpoint& endpoint);
+
+        // Waits until the connections to the publishers are established,
+        // so that our subscriptions have reached them.
+        bool WaitForPeers(std::chrono::milliseconds timeout);
+
         // Establishes a connection between a remote output variable and one of
         // our input variables, breaking any existing connections to that input.
+        // The input receives the output's value from `delay` time steps ago.
+        // All connections from the same output must have the same delay.
         void Couple(
             coral::model::Variable remoteOutput,
-            coral::model::VariableID localInput);
+            coral::model::VariableID localInput,
+            int delay = 0);
 
         // Waits until all data has been received for the time step specified
-        // by `stepID` and updates the slave instance with the new values.
+        // by `stepID` (minus each connection's delay, unless `ignoreDelays`
+        // is true) and updates the slave instance with the new values.
         bool Update(
             coral::slave::Instance& slaveInstance,
             coral::model::StepID stepID,
-            std::chrono::milliseconds timeout);
+            std::chrono::milliseconds timeout,
+            bool ignoreDelays = false);
+
+        // The socket on which data is received.
+        zmq::socket_t& Socket();
+
+        // Whether some data is received through shared memory rather than
+        // the socket.
+        bool HasLocalPeers() const noexcept;
+
+        // Busy polling settings and statistics for the data socket.
+        void SetSpinBudget(std::chrono::microseconds spinBudget) noexcept;
+        const coral::net::BusyPollStats& PollStats() const noexcept;
 
     private:
         // Breaks a connection to a local input variable, if any.
@@ -211,18 +316,62 @@ private:
 
         ConnectionBimap m_connections;
         coral::bus::VariableSubscriber m_subscriber;
+
+        // The subscriber slot of each connected input, for fast lookup of
+        // the values in Update().
+        std::vector<std::pair<std::size_t, coral::model::VariableID>> m_inputSlots;
+        coral::model::ValueBlock m_inputValues;
     };
 
+    coral::net::Reactor& m_reactor;
     coral::slave::Instance& m_slaveInstance;
     Timeout m_masterInactivityTimeout;
     std::chrono::milliseconds m_variableRecvTimeout;
 
     coral::net::zmqx::RepSocket m_control;
+    coral::bus::CommandSubscriber m_commandSub;
     coral::bus::VariablePublisher m_publisher;
     Connections m_connections;
     coral::model::SlaveID m_id; // The slave's ID number in the current execution
 
     coral::model::StepID m_currentStepID; // ID of ongoing or just completed step
+
+    // The parameters and progress of a run (see HandleRun()).  Only valid
+    // in the RUNNING state.
+    struct Run
+    {
+        coral::model::StepID firstStepID = 0;
+        coral::model::StepID lastStepID = 0;
+        coral::model::TimePoint startTime = 0.0;
+        coral::model::TimeDuration stepSize = 0.0;
+        int progressInterval = 0;
+        bool inputsPending = false;  // waiting for inputs for m_currentStepID
+        bool interrupted = false;    // INTERRUPT received
+        bool inputsTimedOut = false; // inputTimeoutTimer has fired
+        std::chrono::microseconds pollInterval{0}; // for local inputs
+        int continueTimer = coral::net::Reactor::invalidTimerID;
+        int inputTimeoutTimer = coral::net::Reactor::invalidTimerID;
+    };
+    Run m_run;
+
+    int m_maxProtocolVersion; // See SetMaxProtocolVersion()
+    int m_protocolVersion; // Protocol version negotiated with the master
+    bool m_batchedData;    // Whether to publish variable values in batches
+
+    // The data types of all the slave's output variables, indexed by
+    // variable ID.  Built once at setup, so that later lookups don't need
+    // to search the slave type description.
+    std::unordered_map<coral::model::VariableID, coral::model::DataType>
+        m_outputTypes;
+
+    // The output variables which are published after each step.  With
+    // protocol version 3 and up, this only contains the variables which are
+    // connected to other slaves' inputs, as reported by the master.
+    std::map<coral::model::VariableID, coral::model::DataType> m_publishedOutputs;
+
+    // Buffer used by PublishAll(), which contains the IDs of the variables
+    // in m_publishedOutputs.  Updated by UpdatePublishedOutputs().
+    coral::model::ValueBlock m_outputValues;
 };
 
 
@@ -22,10 +22,12 @@ stuff in this header.
 #include <vector>
 
 #include <boost/noncopyable.hpp>
+#include <zmq.hpp>
 
 #include <coral/config.h>
 
 #include <coral/bus/slave_setup.hpp>
+#include <coral/bus/variable_io.hpp>
 #include <coral/net/reactor.hpp>
 #include <coral/model.hpp>
 #include <coral/net.hpp>
@@ -163,6 +165,18 @@ public:
     */
     virtual SlaveState State() const noexcept = 0;
 
+    /// Returns the protocol version negotiated with the slave.
+    virtual int ProtocolVersion() const noexcept = 0;
+
+    /**
+    \brief  Returns the endpoint on which the slave receives broadcast
+            commands.
+
+    The endpoint is empty (has an empty transport) if the slave does not
+    support broadcast commands, i.e., if `ProtocolVersion() < 6`.
+    */
+    virtual const coral::net::Endpoint& CommandSubEndpoint() const noexcept = 0;
+
     /**
     \brief  Ends all communication with the slave.
 
@@ -264,6 +278,22 @@ public:
         implemented yet.
 
     \param [in] settings        A list of variable values and connections
+    \param [in] startPublishing Output variables which have become connected
+                                to other slaves' inputs, and which the slave
+                                must start publishing.  Ignored if
+                                `ProtocolVersion() < 3`, in which case the
+                                slave publishes all its outputs.
+    \param [in] stopPublishing  Output variables which are no longer connected
+                                to any other slave's inputs, and which the
+                                slave may stop publishing.  Ignored if
+                                `ProtocolVersion() < 3`.
+    \param [in] connectPeers    Data publisher endpoints of other slaves which
+                                the slave should start receiving data from,
+                                without affecting existing connections.
+                                Ignored if `ProtocolVersion() < 4`.
+    \param [in] disconnectPeers Data publisher endpoints of other slaves which
+                                the slave should stop receiving data from.
+                                Ignored if `ProtocolVersion() < 4`.
     \param [in] timeout         Max. allowed time for the operation to complete.
                                 A negative value means no time limit.
     \param [in] onComplete      Completion handler
@@ -276,6 +306,10 @@ public:
     */
     virtual void SetVariables(
         const std::vector<coral::model::VariableSetting>& settings,
+        const std::vector<coral::model::VariableID>& startPublishing,
+        const std::vector<coral::model::VariableID>& stopPublishing,
+        const std::vector<coral::net::Endpoint>& connectPeers,
+        const std::vector<coral::net::Endpoint>& disconnectPeers,
         std::chrono::milliseconds timeout,
         SetVariablesHandler onComplete) = 0;
 
@@ -315,6 +349,14 @@ public:
         implemented yet.
 
     \param [in] peers           A list of peer endpoints
+    \param [in] batchedData     Whether the slave should publish its variable
+                                values in batches.  This may only be `true`
+                                if all peers support protocol version 1 or
+                                later.
+    \param [in] encoding        The encoding the slave should use for its
+                                variable values.  This may only be
+                                `BINARY_VARIABLE_ENCODING` if all peers support
+                                protocol version 2 or later.
     \param [in] timeout         Max. allowed time for the operation to complete.
                                 A negative value means no time limit.
     \param [in] onComplete      Completion handler
@@ -323,10 +365,14 @@ public:
         if `onComplete` is empty.
 
     \pre  `State() == SLAVE_READY`
+    \pre  `ProtocolVersion() >= 1` if `batchedData` is `true`.
+    \pre  `ProtocolVersion() >= 2` if `encoding` is `BINARY_VARIABLE_ENCODING`.
     \post `State() == SLAVE_BUSY`.
     */
     virtual void SetPeers(
         const std::vector<coral::net::Endpoint>& peer,
+        bool batchedData,
+        VariableEncoding encoding,
         std::chrono::milliseconds timeout,
         SetPeersHandler onComplete) = 0;
 
@@ -383,6 +429,10 @@ public:
     /**
     \brief  Tells the slave to perform a time step
 
+    If `ProtocolVersion() >= 5`, this may also be called when the slave is in
+    the `SLAVE_STEP_OK` state, in which case the previous step is accepted
+    (as by AcceptStep()) and the new one performed using a single message.
+
     On return, the slave state is `SLAVE_BUSY`.  When the operation completes
     (or fails), `onComplete` is called.  Before `onComplete` is called, the
     slave state is updated to one of the following:
@@ -418,7 +468,8 @@ public:
     \throws std::invalid_argument if `timeout` is less than 1 ms or
         if `onComplete` is empty.
 
-    \pre  `State() == SLAVE_READY`
+    \pre  `State() == SLAVE_READY`, or `State() == SLAVE_STEP_OK` and
+          `ProtocolVersion() >= 5`
     \post `State() == SLAVE_BUSY`.
     */
     virtual void Step(
@@ -470,6 +521,178 @@ public:
         std::chrono::milliseconds timeout,
         AcceptStepHandler onComplete) = 0;
 
+    /**
+    \brief  Prepares for a STEP command which is broadcast to the slave
+            rather than sent to it directly.
+
+    This function does the same as Step(), except that it doesn't send
+    anything.  The caller is responsible for broadcasting the STEP message
+    to the slave's CommandSubEndpoint() immediately afterwards.
+
+    \pre  The same as for Step(), and `ProtocolVersion() >= 6`.
+    \post `State() == SLAVE_BUSY`.
+    */
+    virtual void StepByBroadcast(
+        std::chrono::milliseconds timeout,
+        StepHandler onComplete) = 0;
+
+    /**
+    \brief  Prepares for an ACCEPT_STEP command which is broadcast to the
+            slave rather than sent to it directly.
+
+    This function does the same as AcceptStep(), except that it doesn't send
+    anything.  The caller is responsible for broadcasting the ACCEPT_STEP
+    message to the slave's CommandSubEndpoint() immediately afterwards.
+
+    \pre  The same as for AcceptStep(), and `ProtocolVersion() >= 6`.
+    \post `State() == SLAVE_BUSY`.
+    */
+    virtual void AcceptStepByBroadcast(
+        std::chrono::milliseconds timeout,
+        AcceptStepHandler onComplete) = 0;
+
+    /**
+    \brief  Prepares for a STEP command which is relayed to the slave by a
+            sub-master rather than sent to it directly.
+
+    This function does the same as Step(), except that it doesn't send
+    anything.  The caller is responsible for having a sub-master send the
+    STEP message to the slave, and for passing on the slave's reply with
+    ReceiveRelayedReply().
+
+    \pre  The same as for Step().
+    \post `State() == SLAVE_BUSY`.
+    */
+    virtual void StepByRelay(
+        std::chrono::milliseconds timeout,
+        StepHandler onComplete) = 0;
+
+    /**
+    \brief  Prepares for an ACCEPT_STEP command which is relayed to the
+            slave by a sub-master rather than sent to it directly.
+
+    See StepByRelay().
+
+    \pre  The same as for AcceptStep().
+    \post `State() == SLAVE_BUSY`.
+    */
+    virtual void AcceptStepByRelay(
+        std::chrono::milliseconds timeout,
+        AcceptStepHandler onComplete) = 0;
+
+    /**
+    \brief  Handles a reply which the slave has sent to a sub-master.
+
+    This completes the current operation exactly as if the reply had been
+    received directly from the slave.  If no relayed command is in progress,
+    for example because it has already timed out, the reply is ignored.
+    */
+    virtual void ReceiveRelayedReply(std::vector<zmq::message_t>& msg) = 0;
+
+    /**
+    \brief  Fails a relayed command because the sub-master did not deliver
+            the slave's reply.
+
+    As when a reply times out, the state of the slave is unknown, so this
+    calls the completion handler with `ec` and disconnects from the slave.
+    If no relayed command is in progress, this function does nothing.
+    */
+    virtual void RelayFailed(const std::error_code& ec) = 0;
+
+
+    /// Progress handler type for Run()
+    typedef std::function<void(coral::model::StepID)> RunProgressHandler;
+
+    /// Completion handler type for Run()
+    typedef std::function<void(const std::error_code&, coral::model::StepID)>
+        RunHandler;
+
+    /**
+    \brief  Tells the slave to perform a series of time steps on its own.
+
+    The slave performs each step as soon as it has received the variable
+    values it needs from other slaves, without waiting for STEP and
+    ACCEPT_STEP commands from the master.  Time step `firstStepID + n` starts
+    at `startT + n*deltaT`.  If the slave is in the `SLAVE_STEP_OK` state,
+    it first waits for the input values for the step it has already
+    performed.
+
+    On return, the slave state is `SLAVE_BUSY`.  When the operation completes
+    (or fails), `onComplete` is called.  Before `onComplete` is called, the
+    slave state is updated to one of the following:
+
+      - `SLAVE_READY` if all steps were performed (or the run was
+            interrupted) and the slave has received its inputs
+      - `SLAVE_STEP_OK` if the run was interrupted while the slave was
+            waiting for its inputs
+      - `SLAVE_STEP_FAILED` if a step could not be completed
+      - `SLAVE_NOT_CONNECTED` on fatal failure
+
+    `onComplete` must have the following signature:
+    ~~~{.cpp}
+    void f(const std::error_code&, coral::model::StepID);
+    ~~~
+    The second argument is the ID of the last step the slave performed, or
+    attempted to perform in the case of a step failure.  It is only valid
+    if the error code is zero or `cannot_perform_timestep`.
+
+    Possible error conditions are:
+
+      - `coral::error::sim_error::cannot_perform_timestep` (non-fatal): The slave
+            was unable to complete a time step.
+      - `std::errc::bad_message`: The slave sent invalid data.
+      - `std::errc::timed_out`: The slave did not report progress in time.
+      - `coral::error::generic_error::aborted`: The operation was aborted
+            (e.g. by Close()).
+      - `coral::error::generic_error::failed`: The operation failed (e.g. due to
+            an error in the slave).
+
+    All error conditions are fatal unless otherwise specified.
+
+    \param [in] firstStepID     The ID of the first time step to be performed
+    \param [in] lastStepID      The ID of the last time step to be performed
+    \param [in] startT          The time point at which the first step starts
+    \param [in] deltaT          The step size
+    \param [in] progressInterval
+        If positive, the slave reports progress every `progressInterval`
+        steps, and `onProgress` is called with the ID of the last step
+        performed.
+    \param [in] timeout         Max. allowed time between progress reports,
+                                or for the entire run if `progressInterval`
+                                is zero.  A negative value means no time
+                                limit.
+    \param [in] onProgress      Progress handler (may be empty)
+    \param [in] onComplete      Completion handler
+
+    \throws std::invalid_argument if `timeout` is less than 1 ms or
+        if `onComplete` is empty.
+
+    \pre  `State() == SLAVE_READY` or `State() == SLAVE_STEP_OK`, and
+          `ProtocolVersion() >= 7`
+    \post `State() == SLAVE_BUSY`.
+    */
+    virtual void Run(
+        coral::model::StepID firstStepID,
+        coral::model::StepID lastStepID,
+        coral::model::TimePoint startT,
+        coral::model::TimeDuration deltaT,
+        int progressInterval,
+        std::chrono::milliseconds timeout,
+        RunProgressHandler onProgress,
+        RunHandler onComplete) = 0;
+
+    /**
+    \brief  Tells a running slave to stop after the current time step.
+
+    This does not have a completion handler of its own; the run simply
+    completes early.  Since the slave may already have finished the run
+    when the message arrives, there is no guarantee that it has any effect.
+
+    \pre  Run() has been called and its completion handler has not yet been
+          called.
+    */
+    virtual void Interrupt() = 0;
+
     /**
     \brief  Instructs the slave to terminate, then closes the connection.
 
@@ -35,8 +35,8 @@ namespace bus
 
 
 /**
-\brief  An implementation of ISlaveControlMessenger for version 0 of the
-        master/slave communication protocol.
+\brief  An implementation of ISlaveControlMessenger for versions 0 through 8
+        of the master/slave communication protocol.
 */
 class SlaveControlMessengerV0 : public ISlaveControlMessenger
 {
@@ -44,6 +44,8 @@ public:
     SlaveControlMessengerV0(
         coral::net::Reactor& reactor,
         coral::net::zmqx::ReqSocket socket,
+        int protocolVersion,
+        const coral::net::Endpoint& commandSubEndpoint,
         coral::model::SlaveID slaveID,
         const std::string& slaveName,
         const SlaveSetup& setup,
@@ -54,6 +56,10 @@ public:
 
     SlaveState State() const noexcept override;
 
+    int ProtocolVersion() const noexcept override;
+
+    const coral::net::Endpoint& CommandSubEndpoint() const noexcept override;
+
     void Close() override;
 
     void GetDescription(
@@ -62,11 +68,17 @@ public:
 
     void SetVariables(
         const std::vector<coral::model::VariableSetting>& settings,
+        const std::vector<coral::model::VariableID>& startPublishing,
+        const std::vector<coral::model::VariableID>& stopPublishing,
+        const std::vector<coral::net::Endpoint>& connectPeers,
+        const std::vector<coral::net::Endpoint>& disconnectPeers,
         std::chrono::milliseconds timeout,
         SetVariablesHandler onComplete) override;
 
     void SetPeers(
         const std::vector<coral::net::Endpoint>& peers,
+        bool batchedData,
+        VariableEncoding encoding,
         std::chrono::milliseconds timeout,
         SetPeersHandler onComplete) override;
 
@@ -85,10 +97,43 @@ public:
         std::chrono::milliseconds timeout,
         AcceptStepHandler onComplete) override;
 
+    void StepByBroadcast(
+        std::chrono::milliseconds timeout,
+        StepHandler onComplete) override;
+
+    void AcceptStepByBroadcast(
+        std::chrono::milliseconds timeout,
+        AcceptStepHandler onComplete) override;
+
+    void StepByRelay(
+        std::chrono::milliseconds timeout,
+        StepHandler onComplete) override;
+
+    void AcceptStepByRelay(
+        std::chrono::milliseconds timeout,
+        AcceptStepHandler onComplete) override;
+
+    void ReceiveRelayedReply(std::vector<zmq::message_t>& msg) override;
+
+    void RelayFailed(const std::error_code& ec) override;
+
+    void Run(
+        coral::model::StepID firstStepID,
+        coral::model::StepID lastStepID,
+        coral::model::TimePoint startT,
+        coral::model::TimeDuration deltaT,
+        int progressInterval,
+        std::chrono::milliseconds timeout,
+        RunProgressHandler onProgress,
+        RunHandler onComplete) override;
+
+    void Interrupt() override;
+
     void Terminate() override;
 
 private:
-    typedef boost::variant<VoidHandler, GetDescriptionHandler> AnyHandler;
+    typedef boost::variant<VoidHandler, GetDescriptionHandler, RunHandler>
+        AnyHandler;
 
     void Setup(
         coral::model::SlaveID slaveID,
@@ -114,6 +159,7 @@ private:
     // Event handlers
     void OnReply();
     void OnReplyTimeout();
+    void ReplyReceived(std::vector<zmq::message_t>& msg);
 
     // Reply parsing/handling
     void SetupReplyReceived(
@@ -137,6 +183,10 @@ private:
     void AcceptStepReplyReceived(
         const std::vector<zmq::message_t>& msg,
         VoidHandler onComplete);
+    void RunProgressReceived(const std::vector<zmq::message_t>& msg);
+    void RunReplyReceived(
+        const std::vector<zmq::message_t>& msg,
+        RunHandler onComplete);
 
     // These guys perform the work which is common to several of the above
     // XyxReplyReceived() functions.
@@ -150,13 +200,20 @@ private:
 
     coral::net::Reactor& m_reactor;
     coral::net::zmqx::ReqSocket m_socket;
+    const int m_protocolVersion;
+    const coral::net::Endpoint m_commandSubEndpoint;
 
     // State information
     SlaveState m_state;
     bool m_attachedToReactor;
     int m_currentCommand;
+    bool m_relayed; // whether m_currentCommand is relayed by a sub-master
     AnyHandler m_onComplete;
     int m_replyTimeoutTimerId;
+
+    // Used while a RUN command is active
+    RunProgressHandler m_onRunProgress;
+    std::chrono::milliseconds m_runTimeout;
 };
 
 
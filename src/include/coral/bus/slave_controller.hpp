@@ -16,9 +16,12 @@
 #include <system_error>
 #include <vector>
 
+#include <zmq.hpp>
+
 #include <coral/config.h>
 #include <coral/bus/slave_control_messenger.hpp>
 #include <coral/bus/slave_setup.hpp>
+#include <coral/bus/slave_shard.hpp>
 #include <coral/net/reactor.hpp>
 #include <coral/model.hpp>
 #include <coral/net.hpp>
@@ -91,6 +94,36 @@ public:
         ConnectHandler onComplete,
         int maxConnectionAttempts = 3);
 
+    /**
+    \brief  Constructor which creates a controller in sharded mode.
+
+    In sharded mode, all communication with the slave takes place in the
+    thread of `shard`, while the controller's functions must be called
+    in the thread that runs the reactor of `home`.  Completion and progress
+    handlers are called in the latter thread, too.  Otherwise, the
+    controller behaves like one created with the other constructor.
+
+    `shard` must be stopped before the controller is destroyed, and both
+    `shard` and `home` must outlive it.
+
+    \param [in] shard
+        The shard which handles the communication with the slave.
+    \param [in] home
+        The inbox of the thread which uses the controller.
+
+    The remaining parameters are the same as for the other constructor.
+    */
+    SlaveController(
+        SlaveShard& shard,
+        TaskInbox& home,
+        const coral::net::SlaveLocator& slaveLocator,
+        coral::model::SlaveID slaveID,
+        const std::string& slaveName,
+        const SlaveSetup& setup,
+        std::chrono::milliseconds timeout,
+        ConnectHandler onComplete,
+        int maxConnectionAttempts = 3);
+
     /**
     \brief  Destructor
 
@@ -117,6 +150,22 @@ public:
     /// Returns the current state of the slave.
     SlaveState State() const noexcept;
 
+    /**
+    \brief  Returns the protocol version negotiated with the slave, or -1
+            if the connection has not been established.
+    */
+    int ProtocolVersion() const noexcept;
+
+    /**
+    \brief  Returns the endpoint on which the slave receives broadcast
+            commands.
+
+    \returns
+        The endpoint, or an empty endpoint if the slave does not support
+        broadcast commands or the connection has not been established.
+    */
+    coral::net::Endpoint CommandSubEndpoint() const;
+
     /// Completion handler type for GetDescription()
     typedef std::function<void(const std::error_code&, const coral::model::SlaveDescription&)>
         GetDescriptionHandler;
@@ -142,7 +191,20 @@ public:
             variables.
 
     \param [in] settings
-        A list of variable values and connections. May not be empty.
+        A list of variable values and connections.
+    \param [in] startPublishing
+        Output variables which the slave must start publishing because they
+        have become connected to other slaves' inputs.
+    \param [in] stopPublishing
+        Output variables which the slave may stop publishing because they are
+        no longer connected to any other slave's inputs.
+    \param [in] connectPeers
+        Data publisher endpoints of other slaves which the slave must connect
+        to because its inputs have become connected to their outputs.
+    \param [in] disconnectPeers
+        Data publisher endpoints of other slaves which the slave may
+        disconnect from because none of its inputs are connected to their
+        outputs anymore.
     \param [in] timeout
         Max. allowed time for the operation to complete.
         A negative value means no time limit.
@@ -151,6 +213,10 @@ public:
     */
     void SetVariables(
         const std::vector<coral::model::VariableSetting>& settings,
+        const std::vector<coral::model::VariableID>& startPublishing,
+        const std::vector<coral::model::VariableID>& stopPublishing,
+        const std::vector<coral::net::Endpoint>& connectPeers,
+        const std::vector<coral::net::Endpoint>& disconnectPeers,
         std::chrono::milliseconds timeout,
         SetVariablesHandler onComplete);
 
@@ -163,6 +229,13 @@ public:
 
     \param [in] peers
         A list of peer endpoint specifications.
+    \param [in] batchedData
+        Whether the slave should publish its variable values in batches.
+        This requires that all peers support protocol version 1 or later.
+    \param [in] encoding
+        The encoding the slave should use for its variable values.
+        `BINARY_VARIABLE_ENCODING` requires that all peers support protocol
+        version 2 or later.
     \param [in] timeout
         Max. allowed time for the operation to complete.
         A negative value means no time limit.
@@ -171,6 +244,8 @@ public:
     */
     void SetPeers(
         const std::vector<coral::net::Endpoint>& peers,
+        bool batchedData,
+        VariableEncoding encoding,
         std::chrono::milliseconds timeout,
         SetPeersHandler onComplete);
 
@@ -203,6 +278,10 @@ public:
     /**
     \brief  Makes the slave perform a time step.
 
+    If `ProtocolVersion() >= 5`, this may also be called after a successful
+    step without calling AcceptStep() first.  The previous step is then
+    accepted as part of the same request.
+
     \param [in] stepID
         The ID number of the time step to be performed
     \param [in] currentT
@@ -239,6 +318,105 @@ public:
         std::chrono::milliseconds timeout,
         AcceptStepHandler onComplete);
 
+    /**
+    \brief  Like Step(), except that the STEP message is not sent.
+
+    The caller must broadcast the STEP message to the slave's
+    CommandSubEndpoint() immediately afterwards.
+    \pre `ProtocolVersion() >= 6`
+    */
+    void StepByBroadcast(
+        std::chrono::milliseconds timeout,
+        StepHandler onComplete);
+
+    /**
+    \brief  Like AcceptStep(), except that the ACCEPT_STEP message is not sent.
+
+    The caller must broadcast the ACCEPT_STEP message to the slave's
+    CommandSubEndpoint() immediately afterwards.
+    \pre `ProtocolVersion() >= 6`
+    */
+    void AcceptStepByBroadcast(
+        std::chrono::milliseconds timeout,
+        AcceptStepHandler onComplete);
+
+    /**
+    \brief  Like Step(), except that the STEP message is not sent.
+
+    The caller must have a sub-master send the STEP message to the slave
+    immediately afterwards, and pass the reply on with ReceiveRelayedReply().
+    */
+    void StepByRelay(
+        std::chrono::milliseconds timeout,
+        StepHandler onComplete);
+
+    /**
+    \brief  Like AcceptStep(), except that the ACCEPT_STEP message is not sent.
+
+    See StepByRelay().
+    */
+    void AcceptStepByRelay(
+        std::chrono::milliseconds timeout,
+        AcceptStepHandler onComplete);
+
+    /**
+    \brief  Handles the slave's reply to a command relayed by a sub-master.
+
+    See ISlaveControlMessenger::ReceiveRelayedReply().
+    */
+    void ReceiveRelayedReply(std::vector<zmq::message_t> msg);
+
+    /**
+    \brief  Fails the current relayed command.
+
+    See ISlaveControlMessenger::RelayFailed().
+    */
+    void RelayFailed(const std::error_code& ec);
+
+    /// Progress handler type for Run()
+    typedef ISlaveControlMessenger::RunProgressHandler RunProgressHandler;
+
+    /// Completion handler type for Run()
+    typedef ISlaveControlMessenger::RunHandler RunHandler;
+
+    /**
+    \brief  Makes the slave perform a series of time steps on its own.
+
+    See ISlaveControlMessenger::Run() for details.
+
+    \param [in] firstStepID
+        The ID number of the first time step to be performed.
+    \param [in] lastStepID
+        The ID number of the last time step to be performed.
+    \param [in] startT
+        The time point at which the first step starts.
+    \param [in] deltaT
+        The step size. Must be positive.
+    \param [in] progressInterval
+        How often (in number of steps) the slave reports progress, or zero
+        if it shouldn't.
+    \param [in] timeout
+        Max. allowed time between progress reports.
+        A negative value means no time limit.
+    \param [in] onProgress
+        Progress handler.  May be empty.
+    \param [in] onComplete
+        Completion handler.
+    \pre `ProtocolVersion() >= 7`
+    */
+    void Run(
+        coral::model::StepID firstStepID,
+        coral::model::StepID lastStepID,
+        coral::model::TimePoint startT,
+        coral::model::TimeDuration deltaT,
+        int progressInterval,
+        std::chrono::milliseconds timeout,
+        RunProgressHandler onProgress,
+        RunHandler onComplete);
+
+    /// Tells the slave to stop an ongoing Run() after the current time step.
+    void Interrupt();
+
     /**
     \brief  Terminates the slave and cancels all pending operations.
 
@@ -252,11 +430,50 @@ private:
     SlaveController(SlaveController&&);
     SlaveController& operator=(SlaveController&&);
 
+    // Initiates the connection.  In sharded mode, this is called in the
+    // shard's thread.
+    void Connect(
+        coral::net::Reactor& reactor,
+        const coral::net::SlaveLocator& slaveLocator,
+        coral::model::SlaveID slaveID,
+        const std::string& slaveName,
+        const SlaveSetup& setup,
+        std::chrono::milliseconds timeout,
+        ConnectHandler onComplete,
+        int maxConnectionAttempts);
+
+    // Calls `op` with `onComplete`, where `op` starts an operation on the
+    // messenger.  In sharded mode, this happens in the shard's thread, and
+    // `onComplete` is wrapped with ToHome().
+    template<typename Op, typename... Args>
+    void Perform(
+        Op op,
+        std::function<void(const std::error_code&, Args...)> onComplete);
+
+    // Runs `action` in the shard's thread, or right away if not in sharded
+    // mode.
+    void InShard(std::function<void()> action);
+
+    // Sharded mode: Wraps a handler which is to be called in the shard's
+    // thread, so that it updates the mirrored state and calls `handler`
+    // in the home thread.
+    template<typename... Args>
+    std::function<void(Args...)> ToHome(std::function<void(Args...)> handler);
+
     // A handle for the pending connection.
     PendingSlaveControlConnection m_pendingConnection;
 
     // The object through which we communicate with the slave.
     std::unique_ptr<coral::bus::ISlaveControlMessenger> m_messenger;
+
+    // Sharded mode only (null otherwise).  The messenger and the pending
+    // connection are only used in the shard's thread, while the
+    // remaining members mirror their state in the home thread.
+    SlaveShard* m_shard = nullptr;
+    TaskInbox* m_home = nullptr;
+    SlaveState m_state = SLAVE_NOT_CONNECTED;
+    int m_protocolVersion = -1;
+    coral::net::Endpoint m_commandSubEndpoint;
 };
 
 
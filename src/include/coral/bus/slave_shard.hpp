@@ -0,0 +1,129 @@
+/**
+\file
+\brief  Defines the coral::bus::TaskInbox and coral::bus::SlaveShard classes.
+\copyright
+    Copyright 2013-present, SINTEF Ocean.
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+#ifndef CORAL_BUS_SLAVE_SHARD_HPP
+#define CORAL_BUS_SLAVE_SHARD_HPP
+
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <coral/config.h>
+#include <coral/async.hpp>
+#include <coral/net/reactor.hpp>
+
+
+namespace coral
+{
+namespace bus
+{
+
+
+/**
+\brief  A queue of tasks which may be posted from any thread, and which are
+        executed in the thread that runs a given reactor.
+
+Tasks are executed in the order they were posted.  The reactor is only
+woken when the queue goes from empty to non-empty, so a burst of tasks
+posted in quick succession is executed as one batch.
+
+The object must be destroyed in the reactor's thread, or while the reactor
+is not running.  Tasks which have not been executed by then are discarded.
+*/
+class TaskInbox
+{
+public:
+    /// Constructor which registers the inbox with `reactor`.
+    explicit TaskInbox(coral::net::Reactor& reactor);
+
+    /// Destructor which unregisters the inbox from the reactor.
+    ~TaskInbox() noexcept;
+
+    TaskInbox(const TaskInbox&) = delete;
+    TaskInbox& operator=(const TaskInbox&) = delete;
+    TaskInbox(TaskInbox&&) = delete;
+    TaskInbox& operator=(TaskInbox&&) = delete;
+
+    /**
+    \brief  Queues a task for execution in the reactor's thread.
+
+    This function may be called from any thread.  `task` may not throw.
+    */
+    void Post(std::function<void()> task);
+
+private:
+    void RunTasks();
+
+    coral::net::Reactor& m_reactor;
+    coral::async::detail::CommThreadWakeup m_wakeup;
+
+    std::mutex m_mutex;
+    std::vector<std::function<void()>> m_tasks;
+
+    // Only used in the reactor's thread.  Kept as a member so its capacity
+    // is reused from batch to batch.
+    std::vector<std::function<void()>> m_batch;
+};
+
+
+/**
+\brief  A background thread with its own reactor, which handles the
+        communication with a subset of the slaves in an execution.
+
+The execution manager gives each shard a share of the slaves, and creates
+their `SlaveController` objects in sharded mode, so that the serialisation
+of commands and the processing of replies is spread over several cores.
+*/
+class SlaveShard
+{
+public:
+    /// Constructor which starts the thread.
+    SlaveShard();
+
+    /// Destructor which calls Stop().
+    ~SlaveShard() noexcept;
+
+    SlaveShard(const SlaveShard&) = delete;
+    SlaveShard& operator=(const SlaveShard&) = delete;
+    SlaveShard(SlaveShard&&) = delete;
+    SlaveShard& operator=(SlaveShard&&) = delete;
+
+    /**
+    \brief  The shard's reactor.
+
+    This may only be used in tasks executed by the shard, and, after Stop(),
+    to unregister sockets that are being closed.
+    */
+    coral::net::Reactor& Reactor() noexcept;
+
+    /**
+    \brief  Queues a task for execution in the shard's thread.
+
+    This function may be called from any thread.  `task` may not throw.
+    */
+    void Post(std::function<void()> task);
+
+    /**
+    \brief  Stops the reactor and waits for the thread to terminate.
+
+    Tasks which have not been executed by then are discarded.  The function
+    does nothing if the thread has already been stopped.
+    */
+    void Stop() noexcept;
+
+private:
+    coral::net::Reactor m_reactor;
+    TaskInbox m_inbox;
+    std::thread m_thread;
+};
+
+
+}} // namespace
+#endif // header guard
@@ -0,0 +1,233 @@
+/**
+\file
+\brief  Defines the coral::bus::SubMaster and coral::bus::SubMasterClient
+        classes.
+\copyright
+    Copyright 2013-present, SINTEF Ocean.
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+#ifndef CORAL_BUS_SUB_MASTER_HPP
+#define CORAL_BUS_SUB_MASTER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <zmq.hpp>
+
+#include <coral/config.h>
+#include <coral/model.hpp>
+#include <coral/net.hpp>
+#include <coral/net/reactor.hpp>
+#include <coral/net/zmqx.hpp>
+#include <coral/util/flat_map.hpp>
+
+#include <execution.pb.h>
+
+
+namespace coral
+{
+namespace bus
+{
+
+
+/**
+\brief  Relays STEP and ACCEPT_STEP commands from a master to the slaves on
+        one host, and returns their replies to the master in a single message.
+
+Without a sub-master, the master exchanges one request and one reply with
+every slave in every time step.  When the slaves are spread over several
+hosts, a sub-master on each host lets the master send one request per host
+instead.  The sub-master forwards the command to each of the local slaves
+over the loopback interface, collects their replies, and sends them back
+to the master together.
+
+The sub-master is just another client of the slaves' control sockets, so
+the slaves need no special support for it.  It is stateless with respect to
+executions: each request lists the control endpoints of the slaves it
+applies to, and the sub-master connects to new slaves as needed.  It may
+therefore be shared by several masters, whose requests are handled one at
+a time.
+
+A slave which does not reply within the timeout given in the request is
+left out of the reply, and the sub-master disconnects from it so that a late
+reply cannot be mistaken for the reply to a later command.
+*/
+class SubMaster
+{
+public:
+    /**
+    \brief  Constructor.
+
+    \param [in] reactor
+        The reactor used for all communication.
+    \param [in] endpoint
+        The endpoint to which the sub-master should bind to receive requests
+        from masters.  This may contain a wildcard port number.
+    */
+    SubMaster(
+        coral::net::Reactor& reactor,
+        const coral::net::Endpoint& endpoint);
+
+    /// Destructor which unregisters all sockets from the reactor.
+    ~SubMaster() noexcept;
+
+    // Class can't be copied or moved because it leaks references to `this`
+    // through Reactor event handlers.
+    SubMaster(const SubMaster&) = delete;
+    SubMaster& operator=(const SubMaster&) = delete;
+    SubMaster(SubMaster&&) = delete;
+    SubMaster& operator=(SubMaster&&) = delete;
+
+    /// The endpoint to which the sub-master is bound.
+    const coral::net::Endpoint& BoundEndpoint() const;
+
+private:
+    struct Link
+    {
+        coral::net::zmqx::ReqSocket socket;
+        int pendingIndex = -1;
+        std::uint64_t lastUsed = 0;
+    };
+
+    void OnRequest();
+    void Relay(
+        coralproto::execution::MessageType command,
+        const coralproto::execution::RelayCommandData& data);
+    Link& GetLink(const std::string& endpoint);
+    void OnSlaveReply(Link& link);
+    void Finish();
+    void DropLink(const std::string& endpoint) noexcept;
+    void PruneLinks() noexcept;
+
+    coral::net::Reactor& m_reactor;
+    coral::net::zmqx::RepSocket m_socket;
+    coral::util::FlatMap<std::string, std::unique_ptr<Link>> m_links;
+
+    // The request which is currently being relayed.
+    std::uint64_t m_requestCount = 0;
+    bool m_busy = false;
+    int m_remainingReplies = 0;
+    int m_timeoutTimer = -1;
+    std::vector<std::string> m_endpoints;
+    coralproto::execution::RelayedRepliesData m_replies;
+};
+
+
+/**
+\brief  The master's end of the connection to a SubMaster.
+
+This sends relayed commands to one sub-master and receives its combined
+replies.  The replies are handed back in their original, per-slave form,
+so that they can be processed exactly as if the slaves had sent them
+directly (see SlaveController::ReceiveRelayedReply()).
+*/
+class SubMasterClient
+{
+public:
+    /**
+    \brief  Completion handler type for Step() and AcceptStep().
+
+    `replies` contains one entry for each of the slaves in the request, in
+    the same order.  An entry is empty if the slave didn't reply in time.
+    If `ec` is set, `replies` is empty.  This happens if the request failed,
+    or if the sub-master didn't reply within the request's timeout (in which
+    case `ec` is `std::errc::timed_out`).
+    */
+    typedef std::function<void(
+            const std::error_code& ec,
+            std::vector<std::vector<zmq::message_t>>& replies)>
+        ReplyHandler;
+
+    /// Constructor which connects to the sub-master at `endpoint`.
+    SubMasterClient(
+        coral::net::Reactor& reactor,
+        const coral::net::Endpoint& endpoint);
+
+    /// Destructor which unregisters the socket from the reactor.
+    ~SubMasterClient() noexcept;
+
+    // Class can't be copied or moved because it leaks references to `this`
+    // through Reactor event handlers.
+    SubMasterClient(const SubMasterClient&) = delete;
+    SubMasterClient& operator=(const SubMasterClient&) = delete;
+    SubMasterClient(SubMasterClient&&) = delete;
+    SubMasterClient& operator=(SubMasterClient&&) = delete;
+
+    /**
+    \brief  Whether a request is in progress.
+
+    Only one request may be in progress at a time.
+    */
+    bool Busy() const noexcept;
+
+    /**
+    \brief  Makes the sub-master send STEP to the given slaves.
+
+    \param [in] slaves
+        The control endpoints of the slaves, as the master knows them.
+    \param [in] stepID
+        The ID of the time step.
+    \param [in] currentT
+        The current time point.
+    \param [in] deltaT
+        The step size.
+    \param [in] timeout
+        How long the sub-master should wait for the slaves' replies.
+        This object waits for the sub-master's reply for slightly longer,
+        and if that time expires, the request fails and the connection to
+        the sub-master is reset, so that a late reply cannot be mistaken
+        for the reply to a later request.  A negative value means no time
+        limit.
+    \param [in] onComplete
+        Completion handler.
+
+    \pre `!Busy()`
+    */
+    void Step(
+        const std::vector<std::string>& slaves,
+        coral::model::StepID stepID,
+        coral::model::TimePoint currentT,
+        coral::model::TimeDuration deltaT,
+        std::chrono::milliseconds timeout,
+        ReplyHandler onComplete);
+
+    /**
+    \brief  Makes the sub-master send ACCEPT_STEP to the given slaves.
+
+    The parameters have the same meaning as for Step().
+
+    \pre `!Busy()`
+    */
+    void AcceptStep(
+        const std::vector<std::string>& slaves,
+        std::chrono::milliseconds timeout,
+        ReplyHandler onComplete);
+
+private:
+    void Send(
+        coralproto::execution::MessageType command,
+        coralproto::execution::RelayCommandData& data,
+        const std::vector<std::string>& slaves,
+        std::chrono::milliseconds timeout,
+        ReplyHandler onComplete);
+    void OnReply();
+    void OnReplyTimeout();
+    void Connect();
+
+    coral::net::Reactor& m_reactor;
+    coral::net::Endpoint m_endpoint;
+    coral::net::zmqx::ReqSocket m_socket;
+    ReplyHandler m_onComplete;
+    int m_timeoutTimer = -1;
+};
+
+
+}} // namespace
+#endif // header guard
@@ -11,13 +11,23 @@
 #define CORAL_NET_REACTOR_HPP
 
 #include <chrono>
+#include <cstddef>
 #include <functional>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 
 #include <zmq.hpp>
 #include <coral/config.h>
+#include <coral/net.hpp>
+
+
+// On Linux, the reactor uses epoll rather than zmq::poll() (unless this
+// macro is defined).
+#if defined(__linux__) && !defined(CORAL_REACTOR_NO_EPOLL)
+#   define CORAL_REACTOR_USE_EPOLL
+#endif
 
 
 namespace coral
@@ -37,6 +47,24 @@ one socket, the functions are called in the order they were added.
 It also supports timed events, where a handler function is called a certain
 number of times (or indefinitely) with a fixed time interval.  Timers are only
 active when the messaging loop is running, i.e. between Run() and Stop().
+
+On Linux, sockets are registered with an epoll instance once, rather than
+being polled one by one in each iteration of the messaging loop, and only the
+handlers of sockets with incoming messages are looked at.  ZeroMQ sockets are
+watched through their `ZMQ_FD` file descriptors.  These are edge-triggered,
+and an edge may be consumed by any operation on the socket (e.g. sending a
+message from some other handler).  Therefore, in every iteration of the
+messaging loop in which a socket or timer handler has been called, the
+`ZMQ_EVENTS` option of every ZeroMQ socket is checked before the reactor goes
+back to sleep.  Iterations in which no handler is called only cost time in
+proportion to the number of sockets with incoming messages.
+
+Timers are measured against a monotonic clock (`std::chrono::steady_clock`),
+so they are unaffected by adjustments of the system time, and have microsecond
+resolution.  Since ZeroMQ only supports polling with millisecond timeouts, the
+reactor polls without blocking during the last (partial) millisecond before a
+timer event.  Adding, removing and restarting a timer takes logarithmic time
+in the number of active timers.
 */
 class Reactor
 {
@@ -47,13 +75,18 @@ public:
     typedef int NativeSocket;
 #endif
 
-    typedef std::chrono::system_clock::time_point TimePoint;
+    typedef std::chrono::steady_clock::time_point TimePoint;
     typedef std::function<void(Reactor&, zmq::socket_t&)> SocketHandler;
     typedef std::function<void(Reactor&, NativeSocket)> NativeSocketHandler;
     typedef std::function<void(Reactor&, int)> TimerHandler;
 
     Reactor();
 
+    ~Reactor() noexcept;
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
     /// Adds a handler for the given socket.
     void AddSocket(zmq::socket_t& socket, SocketHandler handler);
 
@@ -99,11 +132,12 @@ public:
                             runs indefinitely.
     \param [in] handler     The event handler.
 
-    \returns an index which may later be used to remove the timer.
+    \returns an ID which may later be used to remove the timer.  IDs are never
+        reused by the same reactor.
     \throws std::invalid_argument if `count` is zero or `interval` is negative.
     */
     int AddTimer(
-        std::chrono::milliseconds interval,
+        std::chrono::microseconds interval,
         int count,
         TimerHandler handler);
 
@@ -117,7 +151,9 @@ public:
     \brief  Resets the time to the next event for a timer.
 
     This function sets the elapsed time for the *current* iteration of a timer
-    to zero.  It does not change the number of remaining events.
+    to zero.  It does not change the number of remaining events.  It may be
+    called by the timer's own handler, in which case the next event is
+    scheduled a full interval after the call.
 
     \throws std::invalid_argument if `id` is not a valid timer ID.
     */
@@ -133,6 +169,7 @@ public:
     and the exception will propagate out of `Run()`.
 
     \throws zmq::error_t if ZMQ reports an error.
+    \throws std::runtime_error if epoll reports an error (Linux only).
     */
     void Run();
 
@@ -145,45 +182,98 @@ public:
     */
     void Stop();
 
+    /**
+    \brief  Enables or disables busy polling.
+
+    If `spinBudget` is positive, the messaging loop checks the sockets without
+    blocking for up to this long whenever it would otherwise go to sleep, and
+    only then falls back to a blocking poll.  It never spins past the next
+    timer event.  This reduces the latency with which incoming messages are
+    handled, at the cost of CPU time, and is meant for low-latency runs on
+    dedicated machines.  The default is zero, which disables busy polling.
+    */
+    void SetSpinBudget(std::chrono::microseconds spinBudget) noexcept;
+
+    /// Statistics on the time the messaging loop has spent waiting.
+    const coral::net::BusyPollStats& PollStats() const noexcept;
+
 private:
     struct Timer
     {
-        Timer(
-            int id,
-            TimePoint nextEventTime,
-            std::chrono::milliseconds interval,
-            int remaining,
-            std::unique_ptr<TimerHandler> handler);
+        Timer();
 
-        CORAL_DEFINE_DEFAULT_MOVE(Timer, id, nextEventTime, interval, remaining, handler)
+        CORAL_DEFINE_DEFAULT_MOVE(Timer,
+            id, nextEventTime, interval, remaining, handler, heapPos)
 
         int id;
         TimePoint nextEventTime;
-        std::chrono::milliseconds interval;
+        std::chrono::microseconds interval;
         int remaining;
         std::unique_ptr<TimerHandler> handler;
+        std::size_t heapPos; // this timer's position in m_timerHeap
     };
 
-    void RestartTimerIntervals(
-        std::vector<Timer>::iterator begin,
-        std::vector<Timer>::iterator end);
-    std::chrono::milliseconds TimeToNextEvent() const;
-    void PerformNextEvent();
+    // Returns the slot (index into m_timers) of the timer with the given ID.
+    std::size_t TimerSlot(int id) const;
+
+    // Removes the timer in the given slot and frees the slot.
+    void DeleteTimer(std::size_t slot) noexcept;
 
-    // Rebuilds the list of poll items.
+    // Indexed binary min-heap operations on m_timerHeap, which contains slot
+    // numbers ordered by event time.  They keep Timer::heapPos up to date.
+    bool TimerHeapLess(std::size_t posA, std::size_t posB) const noexcept;
+    void TimerHeapSwap(std::size_t posA, std::size_t posB) noexcept;
+    void TimerHeapSiftUp(std::size_t pos) noexcept;
+    void TimerHeapSiftDown(std::size_t pos) noexcept;
+    void TimerHeapUpdate(std::size_t pos) noexcept;
+
+    void RestartAllTimerIntervals();
+    std::chrono::microseconds TimeToNextEvent() const;
+
+    // Adds the timers in the heap below (and including) position `heapPos`
+    // whose events are due at `now` to m_dueTimers.
+    void CollectDueTimers(std::size_t heapPos, TimePoint now);
+
+    // Performs the event of the timer in the given slot.
+    void PerformEvent(std::size_t slot);
+
+    // Rebuilds the list of poll items (or the epoll registrations).
     void Rebuild();
 
+    // Waits for incoming messages for at most `timeout` milliseconds (or
+    // indefinitely if it is negative).  Returns whether any socket has them.
+    bool Poll(long timeout);
+
+    // Calls the handlers of the sockets which the last Poll() found to have
+    // incoming messages.  Returns false if one of them called Stop().
+    bool Dispatch();
+
     typedef std::pair<zmq::socket_t*, std::unique_ptr<SocketHandler>> SocketHandlerPair;
     typedef std::pair<NativeSocket, std::unique_ptr<NativeSocketHandler>> NativeSocketHandlerPair;
     std::vector<SocketHandlerPair> m_sockets;
     std::vector<NativeSocketHandlerPair> m_nativeSockets;
+#ifdef CORAL_REACTOR_USE_EPOLL
+    struct Epoll;
+    std::unique_ptr<Epoll> m_epoll;
+#else
     std::vector<zmq::pollitem_t> m_pollItems;
+#endif
 
     int m_nextTimerID;
-    std::vector<Timer> m_timers;
+    std::vector<Timer> m_timers;            // indexed by slot
+    std::vector<std::size_t> m_freeTimerSlots;
+    std::vector<std::size_t> m_timerHeap;   // slots, ordered by event time
+    std::unordered_map<int, std::size_t> m_timerSlots; // ID-to-slot mapping
+
+    // The event times and IDs of the timers which are due in the current
+    // iteration of the messaging loop (kept here to reuse the memory).
+    std::vector<std::pair<TimePoint, int>> m_dueTimers;
 
     bool m_needsRebuild;
     bool m_running;
+
+    std::chrono::microseconds m_spinBudget;
+    coral::net::BusyPollStats m_pollStats;
 };
 
 
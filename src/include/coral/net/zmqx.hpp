@@ -97,6 +97,28 @@ If `timeout` is negative, the function will wait indefinitely.
 bool WaitForIncoming(zmq::socket_t& socket, std::chrono::milliseconds timeout);
 
 
+/**
+\brief  Waits up to `timeout` milliseconds for incoming messages on `socket`,
+        busy-polling for up to `spinBudget` before blocking.
+
+This checks the socket repeatedly without blocking until a message arrives or
+`spinBudget` (or `timeout`, if that is shorter) has passed, and only then
+falls back to a blocking wait for the remaining time.  This trades CPU time
+for lower wakeup latency.  If `spinBudget` is zero, the function is
+equivalent to the two-argument overload.
+
+If `stats` is not null, the time spent spinning and sleeping is added to it.
+
+\returns whether there are incoming messages on `socket`.
+\throws zmq::error_t on communications error.
+*/
+bool WaitForIncoming(
+    zmq::socket_t& socket,
+    std::chrono::milliseconds timeout,
+    std::chrono::microseconds spinBudget,
+    coral::net::BusyPollStats* stats);
+
+
 /// Flags for the Send() function
 enum class SendFlag : int
 {
@@ -230,7 +252,7 @@ public:
     RepSocket();
 
     CORAL_DEFINE_DEFAULT_MOVE(RepSocket,
-        m_socket, m_boundEndpoint, m_clientEnvelope)
+        m_socket, m_boundEndpoint, m_clientEnvelope, m_lastClientEnvelope)
 
     ~RepSocket() noexcept;
 
@@ -285,6 +307,20 @@ public:
     */
     void Send(std::vector<zmq::message_t>& msg);
 
+    /**
+    \brief  Sends a message to the client which sent the last request,
+            regardless of whether that request has been replied to.
+
+    This is for servers which receive some requests from the same client
+    through a different channel (e.g. a broadcast), and which must reply to
+    them on this one.  The client must be prepared to receive such
+    unsolicited replies.
+
+    This function may only be called if the socket is connected or bound,
+    and then only after a request has been received with Receive().
+    */
+    void SendToLastClient(std::vector<zmq::message_t>& msg);
+
     /**
     \brief  Ignores the last received request.
 
@@ -310,6 +346,7 @@ private:
     std::unique_ptr<zmq::socket_t> m_socket;
     coral::net::Endpoint m_boundEndpoint;
     std::vector<zmq::message_t> m_clientEnvelope;
+    std::vector<zmq::message_t> m_lastClientEnvelope;
 };
 
 
@@ -10,6 +10,8 @@
 #ifndef CORAL_PROTOCOL_EXE_DATA_HPP
 #define CORAL_PROTOCOL_EXE_DATA_HPP
 
+#include <cstdint>
+#include <utility>
 #include <vector>
 #include <zmq.hpp>
 #include <coral/model.hpp>
@@ -35,6 +37,23 @@ struct Message
     coral::model::ScalarValue value;
 };
 
+/**
+\brief  The variable ID which identifies a batch message in the header frame.
+
+This corresponds to `fmi2UndefinedValueReference`, and may therefore not be
+used as the ID of an actual variable.
+*/
+const coral::model::VariableID BATCH_VARIABLE_ID = 0xFFFFFFFFu;
+
+/// A set of variable values from one slave, all for the same time step.
+struct BatchMessage
+{
+    coral::model::SlaveID slaveID;
+    coral::model::StepID timestepID;
+    std::vector<std::pair<coral::model::VariableID, coral::model::ScalarValue>>
+        values;
+};
+
 Message ParseMessage(const std::vector<zmq::message_t>& rawMsg);
 
 void CreateMessage(const Message& message, std::vector<zmq::message_t>& rawOut);
@@ -43,5 +62,216 @@ void Subscribe(zmq::socket_t& socket, const coral::model::Variable& variable);
 
 void Unsubscribe(zmq::socket_t& socket, const coral::model::Variable& variable);
 
+/// Returns whether `rawMsg` is a batch message (as opposed to a plain one).
+bool IsBatchMessage(const std::vector<zmq::message_t>& rawMsg);
+
+/**
+\brief  Parses a batch message.
+
+The contents of `message` are replaced, but its `values` vector retains its
+capacity, so that the same object may be reused for subsequent messages
+without further memory allocations.
+
+\throws coral::error::ProtocolViolationException if `rawMsg` is not a valid
+        batch message.
+*/
+void ParseBatchMessage(
+    const std::vector<zmq::message_t>& rawMsg,
+    BatchMessage& message);
+
+/**
+\brief  Creates a batch message.
+
+\pre `message.slaveID` is a valid slave ID.
+*/
+void CreateBatchMessage(
+    const BatchMessage& message,
+    std::vector<zmq::message_t>& rawOut);
+
+/**
+\brief  Subscribes to batch messages from the given slave.
+
+Like ZMQ subscriptions in general, batch subscriptions are reference
+counted, so every call to this function must be matched by a call to
+UnsubscribeBatch() before the subscription is actually removed.
+*/
+void SubscribeBatch(zmq::socket_t& socket, coral::model::SlaveID slaveID);
+
+/// Unsubscribes from batch messages from the given slave.
+void UnsubscribeBatch(zmq::socket_t& socket, coral::model::SlaveID slaveID);
+
+
+// =============================================================================
+// Binary encoding
+// =============================================================================
+
+/**
+\brief  The first byte of the body frame of a binary-encoded message.
+
+The binary encoding is an alternative to the Protocol Buffers encoding used
+by CreateMessage() and CreateBatchMessage().  The header frame is the same
+for both encodings, while the body frame has the following fixed layout,
+with all integers in little-endian byte order:
+
+    Single value:   [version:1] [step ID:4] [value]
+    Batch:          [version:1] [step ID:4] [count:4] count*([var. ID:4] [value])
+
+where each value is encoded as
+
+    [type:1] [data]
+
+Here, `type` is a coral::model::DataType, and `data` is an IEEE 754 double
+(8 bytes) for reals, a two's complement integer (4 bytes) for integers,
+0 or 1 (1 byte) for booleans, and a length (4 bytes) followed by that many
+characters for strings.
+
+The body of a Protocol Buffers-encoded message always starts with the byte
+0x08, so the two encodings are easily distinguished.  The high bit of
+the version byte is always set for that reason.
+*/
+const std::uint8_t BINARY_FORMAT_VERSION = 0x81;
+
+/// Returns whether the body of `rawMsg` uses the binary encoding.
+bool IsBinaryMessage(const std::vector<zmq::message_t>& rawMsg);
+
+/// Creates a binary-encoded message.
+void CreateBinaryMessage(
+    const Message& message,
+    std::vector<zmq::message_t>& rawOut);
+
+/**
+\brief  Creates a binary-encoded batch message.
+
+\pre `message.slaveID` is a valid slave ID.
+*/
+void CreateBinaryBatchMessage(
+    const BatchMessage& message,
+    std::vector<zmq::message_t>& rawOut);
+
+/**
+\brief  Creates a binary-encoded batch message from a block of typed values.
+
+This produces the same format as the other CreateBinaryBatchMessage()
+overload, with the values ordered by data type, but it works directly on
+the columns of `values` without going through ScalarValue.
+
+\pre `slaveID` is a valid slave ID.
+*/
+void CreateBinaryBatchMessage(
+    coral::model::SlaveID slaveID,
+    coral::model::StepID timestepID,
+    const coral::model::ValueBlock& values,
+    std::vector<zmq::message_t>& rawOut);
+
+
+/**
+\brief  Reads the contents of a binary-encoded message (single or batch)
+        directly from the raw message buffer.
+
+No part of the message is copied, and no memory is allocated, unless
+Value() is called for a string variable.  The reader refers to the message
+buffer, so `rawMsg` must outlive it and may not be modified in the meantime.
+
+Usage:
+~~~{.cpp}
+BinaryMessageReader reader(rawMsg);
+while (reader.Next()) {
+    // Do something with reader.VariableID(), reader.RealValue(), etc.
+}
+~~~
+*/
+class BinaryMessageReader
+{
+public:
+    /**
+    \brief  Constructor which parses the message header.
+
+    \throws coral::error::ProtocolViolationException if `rawMsg` is not a
+        valid binary-encoded message.
+    */
+    explicit BinaryMessageReader(const std::vector<zmq::message_t>& rawMsg);
+
+    /**
+    \brief  Constructor which parses a message whose header and body frames
+            are given as raw buffers.
+
+    This is used when messages arrive by some other means than a ZMQ
+    socket, e.g. through shared memory.  The buffers must outlive the reader.
+
+    \throws coral::error::ProtocolViolationException if the frames do not
+        make up a valid binary-encoded message.
+    */
+    BinaryMessageReader(
+        const char* header,
+        std::size_t headerSize,
+        const char* body,
+        std::size_t bodySize);
+
+    /// The ID of the slave which sent the message.
+    coral::model::SlaveID Slave() const noexcept { return m_slaveID; }
+
+    /// The ID of the time step to which the values belong.
+    coral::model::StepID TimestepID() const noexcept { return m_stepID; }
+
+    /**
+    \brief  Advances to the next value in the message.
+
+    This must be called before the first value can be accessed.
+
+    \returns `true` if there was another value, `false` if the end of the
+        message has been reached.
+    \throws coral::error::ProtocolViolationException if the message is
+        truncated or otherwise malformed.
+    */
+    bool Next();
+
+    /// The ID of the current variable.
+    coral::model::VariableID VariableID() const noexcept { return m_variableID; }
+
+    /// The data type of the current value.
+    coral::model::DataType DataType() const noexcept { return m_dataType; }
+
+    /// The current value. \pre `DataType() == coral::model::REAL_DATATYPE`
+    double RealValue() const;
+
+    /// The current value. \pre `DataType() == coral::model::INTEGER_DATATYPE`
+    int IntegerValue() const;
+
+    /// The current value. \pre `DataType() == coral::model::BOOLEAN_DATATYPE`
+    bool BooleanValue() const;
+
+    /**
+    \brief  A pointer to the characters of the current value, which are not
+            null terminated.
+    \pre `DataType() == coral::model::STRING_DATATYPE`
+    */
+    const char* StringData() const;
+
+    /// The length of the current string value.  \pre As for StringData().
+    std::size_t StringSize() const;
+
+    /// The current value, regardless of type.
+    coral::model::ScalarValue Value() const;
+
+private:
+    void Init(
+        const char* header,
+        std::size_t headerSize,
+        const char* body,
+        std::size_t bodySize);
+
+    const char* m_next;
+    const char* m_end;
+    bool m_batch;
+    std::uint32_t m_remaining;
+
+    coral::model::SlaveID m_slaveID;
+    coral::model::StepID m_stepID;
+    coral::model::VariableID m_variableID;
+    coral::model::DataType m_dataType;
+    const char* m_data;
+    std::size_t m_dataSize;
+};
+
 }}} // namespace
 #endif // header guard
@@ -38,6 +38,55 @@ namespace execution
 {
 
 
+/**
+\brief  The highest version of the master/slave communication protocol
+        supported by this implementation.
+
+The versions are:
+
+  - 0: The original protocol.
+  - 1: Like version 0, but slaves may be instructed (via SET_PEERS) to
+       publish their variable values in batches, one message per time step.
+  - 2: Like version 1, but slaves may also be instructed (via SET_PEERS) to
+       use the binary variable encoding (see coral::protocol::exe_data).
+  - 3: Like version 2, but slaves only publish those output variables which
+       the master has told them (via SET_VARS) are connected to some other
+       slave's inputs.
+  - 4: Like version 3, but slaves are only told (via SET_PEERS) about the
+       peers whose outputs they are connected to, and are subsequently told
+       (via SET_VARS) to connect to or disconnect from individual peers as
+       connections change.
+  - 5: Like version 4, but a slave which has completed a time step may be
+       sent a STEP message directly, without a preceding ACCEPT_STEP.  The
+       slave then accepts the completed step (i.e., it updates its inputs
+       as for ACCEPT_STEP) before performing the new one, saving one round
+       trip per time step.  ACCEPT_STEP is still supported.
+  - 6: Like version 5, but the slave's HELLO reply includes an endpoint on
+       which it subscribes to broadcast commands, and the master may send
+       STEP and ACCEPT_STEP to all slaves at once through it (see
+       coral::bus::CommandBroadcaster).  The slave replies through the
+       control channel as usual.
+  - 7: Like version 6, but the master may send a RUN message, in reply to
+       which the slave performs a whole sequence of time steps on its own,
+       starting each one as soon as its inputs from the previous one have
+       arrived from its peers.  The slave reports its progress with
+       PROGRESS messages, and may be stopped early with INTERRUPT.
+  - 8: Like version 7, but variable connections made with SET_VARS may
+       have a delay of one or more time steps, so that the receiving slave
+       uses older values and need not wait for the most recent ones.
+  - 9: Like version 8, but the peer endpoints in SET_PEERS and SET_VARS
+       may be shared memory endpoints (see coral::bus::SharedMemoryEndpoint()),
+       for peers which run on the same host as the slave.
+
+Masters always send a version 0 HELLO, accompanied by a
+`coralproto::execution::HelloData` body that specifies the highest version
+they support.  Slaves reply with the version which will be used for the rest
+of the session.  This way, old slaves (which only understand version 0) and
+old masters (which don't send a HELLO body) are still supported.
+*/
+const uint16_t MAX_PROTOCOL_VERSION = 9;
+
+
 /**
 \brief  Fills `message` with a body-less HELLO message that requests the
         given protocol version.
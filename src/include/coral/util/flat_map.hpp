@@ -0,0 +1,180 @@
+/**
+\file
+\brief  Defines the coral::util::FlatMap class template.
+\copyright
+    Copyright 2013-present, SINTEF Ocean.
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+#ifndef CORAL_UTIL_FLAT_MAP_HPP
+#define CORAL_UTIL_FLAT_MAP_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <coral/config.h>
+
+
+namespace coral
+{
+namespace util
+{
+
+
+/**
+\brief  An associative container which stores its elements in a sorted,
+        contiguous array.
+
+The interface is a subset of that of `std::map`, and elements are
+`std::pair<Key, T>` objects, so the class may be used as a drop-in
+replacement wherever that subset suffices.  Lookups and iteration are
+cheaper than for `std::map`, because there is no per-element allocation
+and the elements are adjacent in memory.  Insertion and erasure are linear
+in the number of elements, so the class is best suited to maps that are
+read far more often than they are modified.
+
+Unlike `std::map`, insertion and erasure invalidate all iterators and
+references to elements.
+
+`Key` must be less-than comparable.
+*/
+template<typename Key, typename T>
+class FlatMap
+{
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<Key, T>;
+    using size_type = std::size_t;
+    using iterator = typename std::vector<value_type>::iterator;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+    /// Creates an empty map.
+    FlatMap() noexcept { }
+
+    CORAL_DEFINE_DEFAULT_MOVE(FlatMap, m_elements)
+
+    FlatMap(const FlatMap&) = default;
+    FlatMap& operator=(const FlatMap&) = default;
+
+    iterator begin() noexcept { return m_elements.begin(); }
+    const_iterator begin() const noexcept { return m_elements.begin(); }
+    iterator end() noexcept { return m_elements.end(); }
+    const_iterator end() const noexcept { return m_elements.end(); }
+
+    bool empty() const noexcept { return m_elements.empty(); }
+    size_type size() const noexcept { return m_elements.size(); }
+
+    void clear() noexcept { m_elements.clear(); }
+
+    /// Returns an iterator to the element with the given key, or end().
+    iterator find(const Key& key)
+    {
+        const auto it = LowerBound(key);
+        return (it != end() && !(key < it->first)) ? it : end();
+    }
+
+    /// Returns an iterator to the element with the given key, or end().
+    const_iterator find(const Key& key) const
+    {
+        const auto it = LowerBound(key);
+        return (it != end() && !(key < it->first)) ? it : end();
+    }
+
+    /// Returns 1 if there is an element with the given key, otherwise 0.
+    size_type count(const Key& key) const
+    {
+        return find(key) == end() ? 0 : 1;
+    }
+
+    /**
+    \brief  Returns a reference to the value with the given key.
+    \throws std::out_of_range if there is no such element.
+    */
+    T& at(const Key& key)
+    {
+        const auto it = find(key);
+        if (it == end()) throw std::out_of_range("FlatMap::at(): No such key");
+        return it->second;
+    }
+
+    /**
+    \brief  Returns a reference to the value with the given key.
+    \throws std::out_of_range if there is no such element.
+    */
+    const T& at(const Key& key) const
+    {
+        const auto it = find(key);
+        if (it == end()) throw std::out_of_range("FlatMap::at(): No such key");
+        return it->second;
+    }
+
+    /**
+    \brief  Returns a reference to the value with the given key, inserting
+            a default-constructed value first if there is no such element.
+    */
+    T& operator[](const Key& key)
+    {
+        auto it = LowerBound(key);
+        if (it == end() || key < it->first) {
+            it = m_elements.insert(it, value_type(key, T()));
+        }
+        return it->second;
+    }
+
+    /**
+    \brief  Inserts an element, unless there already is one with the same key.
+
+    \returns
+        An iterator to the element with the given key, and whether the
+        element was inserted.
+    */
+    std::pair<iterator, bool> insert(value_type value)
+    {
+        auto it = LowerBound(value.first);
+        if (it != end() && !(value.first < it->first)) {
+            return std::make_pair(it, false);
+        }
+        it = m_elements.insert(it, std::move(value));
+        return std::make_pair(it, true);
+    }
+
+    /// Removes an element, and returns an iterator to the one after it.
+    iterator erase(const_iterator pos)
+    {
+        // Some standard libraries lack vector::erase(const_iterator).
+        return m_elements.erase(begin() + (pos - m_elements.cbegin()));
+    }
+
+    /// Removes the element with the given key, if any, and returns the count.
+    size_type erase(const Key& key)
+    {
+        const auto it = find(key);
+        if (it == end()) return 0;
+        m_elements.erase(it);
+        return 1;
+    }
+
+private:
+    iterator LowerBound(const Key& key)
+    {
+        return std::lower_bound(m_elements.begin(), m_elements.end(), key,
+            [] (const value_type& element, const Key& k) { return element.first < k; });
+    }
+
+    const_iterator LowerBound(const Key& key) const
+    {
+        return std::lower_bound(m_elements.begin(), m_elements.end(), key,
+            [] (const value_type& element, const Key& k) { return element.first < k; });
+    }
+
+    std::vector<value_type> m_elements;
+};
+
+
+}}      // namespace
+#endif  // header guard
@@ -178,6 +178,34 @@ public:
     */
     bool IsDirEntry(EntryIndex index) const;
 
+    /**
+    \brief  Returns the uncompressed size of an archive entry, in bytes.
+
+    \param [in] index
+        An archive entry index in the range `[0,EntryCount())`.
+    \throws coral::util::zip::Exception
+        If there was an error accessing the archive.
+    \pre
+        `IsOpen() == true`
+    */
+    std::uint64_t EntrySize(EntryIndex index) const;
+
+    /**
+    \brief  Returns the CRC-32 checksum of the uncompressed contents of an
+            archive entry.
+
+    This is read from the archive directory, so it is cheap to obtain, and
+    it doesn't involve decompressing anything.
+
+    \param [in] index
+        An archive entry index in the range `[0,EntryCount())`.
+    \throws coral::util::zip::Exception
+        If there was an error accessing the archive.
+    \pre
+        `IsOpen() == true`
+    */
+    std::uint32_t EntryCRC(EntryIndex index) const;
+
     /**
     \brief  Extracts the entire contents of the archive.
 
@@ -6,6 +6,18 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 */
 #include <coral/async.hpp>
 
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef __linux__
+#   include <sys/eventfd.h>
+#   include <unistd.h>
+#endif
+
+#include <coral/util.hpp>
+
 
 namespace coral
 {
@@ -13,6 +25,298 @@ namespace async
 {
 
 
+// =============================================================================
+// detail::CommThreadTaskStorage and detail::CommThreadSlot
+// =============================================================================
+
+namespace detail
+{
+
+namespace
+{
+    // How many times CommThreadSlot::Wait() polls the slot state before
+    // blocking.  Most tasks complete within a few microseconds, and spinning
+    // for that long is far cheaper than sleeping and being woken up.
+    const int slotSpinCount = 2000;
+
+    // Returns the same exception that std::future::get() throws for a broken
+    // promise.  (std::future_error's error_code constructor is not public
+    // in all standard libraries, so we let one of them do the work.)
+    std::exception_ptr BrokenPromise() noexcept
+    {
+        std::future<void> future;
+        {
+            std::promise<void> promise;
+            future = promise.get_future();
+        }
+        try {
+            future.get();
+        } catch (...) {
+            return std::current_exception();
+        }
+        assert(false);
+        return nullptr;
+    }
+}
+
+
+CommThreadTaskStorage::CommThreadTaskStorage() noexcept
+    : m_ops{nullptr}
+{
+}
+
+
+CommThreadTaskStorage::~CommThreadTaskStorage() noexcept
+{
+    Clear();
+}
+
+
+void CommThreadTaskStorage::MoveTo(CommThreadTaskStorage& target) noexcept
+{
+    assert(target.m_ops == nullptr);
+    if (m_ops == nullptr) return;
+    m_ops->move(&m_storage, &target.m_storage);
+    target.m_ops = m_ops;
+    m_ops = nullptr;
+}
+
+
+void CommThreadTaskStorage::Run(
+    coral::net::Reactor& reactor,
+    void* stackData,
+    CommThreadSlot& slot)
+{
+    assert(m_ops != nullptr);
+    const auto cleanup = coral::util::OnScopeExit([this] () { Clear(); });
+    m_ops->invoke(&m_storage, reactor, stackData, slot);
+}
+
+
+void CommThreadTaskStorage::Clear() noexcept
+{
+    if (m_ops == nullptr) return;
+    m_ops->destroy(&m_storage);
+    m_ops = nullptr;
+}
+
+
+CommThreadSlot::CommThreadSlot() noexcept
+    : index{0}
+    , result{nullptr}
+    , exception{}
+    , m_state{pending}
+{
+}
+
+
+void CommThreadSlot::Reset(void* resultStorage) noexcept
+{
+    result = resultStorage;
+    exception = nullptr;
+    m_state.store(pending, std::memory_order_relaxed);
+}
+
+
+void CommThreadSlot::Complete(State state, std::exception_ptr exception_)
+    noexcept
+{
+    assert(state != pending);
+    // The notification is done while holding the lock, because the waiting
+    // thread may reuse the slot as soon as it sees the new state.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    exception = exception_;
+    m_state.store(state, std::memory_order_release);
+    m_completed.notify_one();
+}
+
+
+CommThreadSlot::State CommThreadSlot::Wait() noexcept
+{
+    for (int i = 0; i < slotSpinCount; ++i) {
+        const auto state = m_state.load(std::memory_order_acquire);
+        if (state != pending) return static_cast<State>(state);
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_completed.wait(lock, [this] ()
+    {
+        return m_state.load(std::memory_order_acquire) != pending;
+    });
+    return static_cast<State>(m_state.load(std::memory_order_acquire));
+}
+
+
+// =============================================================================
+// detail::CommThreadWakeup
+// =============================================================================
+
+#ifdef __linux__
+
+CommThreadWakeup::CommThreadWakeup()
+    : m_eventFD{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)}
+{
+    if (m_eventFD < 0) {
+        throw std::runtime_error(
+            coral::error::ErrnoMessage("Failed to create eventfd", errno));
+    }
+}
+
+
+CommThreadWakeup::~CommThreadWakeup() noexcept
+{
+    close(m_eventFD);
+}
+
+
+void CommThreadWakeup::Signal()
+{
+    const std::uint64_t one = 1;
+    // EAGAIN means that the counter is saturated, and then the reactor
+    // is about to wake up anyway.
+    if (write(m_eventFD, &one, sizeof one) < 0
+            && errno != EAGAIN && errno != EINTR) {
+        throw std::runtime_error(
+            coral::error::ErrnoMessage("Failed to signal eventfd", errno));
+    }
+}
+
+
+void CommThreadWakeup::Register(
+    coral::net::Reactor& reactor,
+    std::function<void(coral::net::Reactor&)> handler)
+{
+    reactor.AddNativeSocket(
+        m_eventFD,
+        [handler] (coral::net::Reactor& r, coral::net::Reactor::NativeSocket fd)
+        {
+            // Reset the counter before the handler looks for work, so that
+            // no signal is lost.
+            std::uint64_t count;
+            while (read(fd, &count, sizeof count) < 0 && errno == EINTR) { }
+            handler(r);
+        });
+}
+
+
+void CommThreadWakeup::Unregister(coral::net::Reactor& reactor) noexcept
+{
+    reactor.RemoveNativeSocket(m_eventFD);
+}
+
+#else
+
+CommThreadWakeup::CommThreadWakeup()
+    : m_signalSocket{coral::net::zmqx::GlobalContext(), ZMQ_PAIR}
+    , m_waitSocket{coral::net::zmqx::GlobalContext(), ZMQ_PAIR}
+{
+    m_signalSocket.setsockopt(ZMQ_LINGER, 0);
+    m_waitSocket.setsockopt(ZMQ_LINGER, 0);
+    const auto endpoint = "inproc://" + coral::util::RandomUUID();
+    m_waitSocket.bind(endpoint);
+    m_signalSocket.connect(endpoint);
+}
+
+
+CommThreadWakeup::~CommThreadWakeup() noexcept
+{
+}
+
+
+void CommThreadWakeup::Signal()
+{
+    // ZMQ sockets are not thread safe.  If the send would block, there are
+    // plenty of unread signals already.
+    std::lock_guard<std::mutex> lock(m_signalMutex);
+    m_signalSocket.send("", 0, ZMQ_DONTWAIT);
+}
+
+
+void CommThreadWakeup::Register(
+    coral::net::Reactor& reactor,
+    std::function<void(coral::net::Reactor&)> handler)
+{
+    reactor.AddSocket(
+        m_waitSocket,
+        [handler] (coral::net::Reactor& r, zmq::socket_t& s)
+        {
+            zmq::message_t msg;
+            while (s.recv(&msg, ZMQ_DONTWAIT)) { }
+            handler(r);
+        });
+}
+
+
+void CommThreadWakeup::Unregister(coral::net::Reactor& reactor) noexcept
+{
+    reactor.RemoveSocket(m_waitSocket);
+}
+
+#endif
+
+
+// =============================================================================
+// detail::CommThreadCompletionBase
+// =============================================================================
+
+CommThreadCompletionBase::CommThreadCompletionBase(CommThreadSlot& slot)
+    noexcept
+    : m_slot{&slot}
+{
+}
+
+
+CommThreadCompletionBase::~CommThreadCompletionBase() noexcept
+{
+    Abandon();
+}
+
+
+CommThreadCompletionBase::CommThreadCompletionBase(
+    CommThreadCompletionBase&& other) noexcept
+    : m_slot{other.m_slot}
+{
+    other.m_slot = nullptr;
+}
+
+
+CommThreadCompletionBase& CommThreadCompletionBase::operator=(
+    CommThreadCompletionBase&& other) noexcept
+{
+    if (&other != this) {
+        Abandon();
+        m_slot = other.m_slot;
+        other.m_slot = nullptr;
+    }
+    return *this;
+}
+
+
+void CommThreadCompletionBase::SetException(std::exception_ptr exception)
+{
+    CORAL_INPUT_CHECK(exception);
+    Release().Complete(CommThreadSlot::failed, exception);
+}
+
+
+CommThreadSlot& CommThreadCompletionBase::Release()
+{
+    CORAL_PRECONDITION_CHECK(m_slot);
+    const auto slot = m_slot;
+    m_slot = nullptr;
+    return *slot;
+}
+
+
+void CommThreadCompletionBase::Abandon() noexcept
+{
+    if (m_slot) {
+        Release().Complete(CommThreadSlot::failed, BrokenPromise());
+    }
+}
+
+} // namespace detail
+
+
 // =============================================================================
 // CommThreadDead
 // =============================================================================
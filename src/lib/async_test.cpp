@@ -1,4 +1,9 @@
+#include <array>
+#include <chrono>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 #include <gtest/gtest.h>
 #include <coral/async.hpp>
 
@@ -310,3 +315,179 @@ TEST(coral_async, CommThread_BadData)
     }
     EXPECT_FALSE(thread.Active());
 }
+
+
+TEST(coral_async, CommThread_ExecuteAndWait)
+{
+    auto thread = coral::async::CommThread<MyData>{};
+
+    // Immediate return, with and without a value
+    EXPECT_EQ(42, thread.ExecuteAndWait<int>(
+        [] (coral::net::Reactor&, MyData&, coral::async::CommThreadCompletion<int> c)
+        {
+            c.SetValue(42);
+        }));
+    EXPECT_NO_THROW(thread.ExecuteAndWait<void>(
+        [] (coral::net::Reactor&, MyData& data, coral::async::CommThreadCompletion<void> c)
+        {
+            data.eventCount = 0;
+            c.SetValue();
+        }));
+
+    // Delayed return, non-trivial value
+    const auto str = thread.ExecuteAndWait<std::string>(
+        [] (coral::net::Reactor& reactor, MyData& data, coral::async::CommThreadCompletion<std::string> c)
+        {
+            auto cPtr = std::make_shared<decltype(c)>(std::move(c));
+            reactor.AddTimer(
+                std::chrono::milliseconds(1),
+                -1,
+                [&data, cPtr] (coral::net::Reactor& reactor, int self)
+                {
+                    if (++data.eventCount == 5) {
+                        reactor.RemoveTimer(self);
+                        cPtr->SetValue(std::string(100, 'x'));
+                    }
+                });
+        });
+    EXPECT_EQ(std::string(100, 'x'), str);
+
+    // Immediate throw
+    EXPECT_THROW(
+        thread.ExecuteAndWait<int>(
+            [] (coral::net::Reactor&, MyData&, coral::async::CommThreadCompletion<int> c)
+            {
+                c.SetException(std::make_exception_ptr(std::out_of_range{""}));
+            }),
+        std::out_of_range);
+
+    // Result never set
+    EXPECT_THROW(
+        thread.ExecuteAndWait<int>(
+            [] (coral::net::Reactor&, MyData&, coral::async::CommThreadCompletion<int>) { }),
+        std::future_error);
+    ASSERT_TRUE(thread.Active());
+
+    // Unexpected thread death during execution
+    EXPECT_THROW(
+        thread.ExecuteAndWait<void>(
+            [] (coral::net::Reactor&, MyData&, coral::async::CommThreadCompletion<void>)
+            {
+                throw std::underflow_error{""};
+            }),
+        std::future_error);
+    try {
+        thread.ExecuteAndWait<void>(
+            [] (coral::net::Reactor&, MyData&, coral::async::CommThreadCompletion<void> c)
+            {
+                c.SetValue();
+            });
+        ADD_FAILURE();
+    } catch (const coral::async::CommThreadDead& e) {
+        EXPECT_THROW(
+            std::rethrow_exception(e.OriginalException()),
+            std::underflow_error);
+    } catch (...) {
+        ADD_FAILURE();
+    }
+    EXPECT_FALSE(thread.Active());
+}
+
+
+TEST(coral_async, CommThread_ExecuteMany)
+{
+    const int CALL_COUNT = 20000;
+    auto thread = coral::async::CommThread<MyData>{};
+
+    for (int i = 0; i < CALL_COUNT; ++i) {
+        const auto n = thread.ExecuteAndWait<int>(
+            [] (coral::net::Reactor&, MyData& data, coral::async::CommThreadCompletion<int> c)
+            {
+                c.SetValue(++data.eventCount);
+            });
+        ASSERT_EQ(i + 1, n);
+    }
+    for (int i = 0; i < CALL_COUNT; ++i) {
+        const auto n = thread.Execute<int>(
+            [] (coral::net::Reactor&, MyData& data, std::promise<int> p)
+            {
+                p.set_value(++data.eventCount);
+            }).get();
+        ASSERT_EQ(CALL_COUNT + i + 1, n);
+    }
+    thread.Shutdown();
+}
+
+
+TEST(coral_async, CommThread_ConcurrentCallers)
+{
+    // More callers than there are completion slots, with tasks which are
+    // too big to be stored inline as well as small ones.
+    const int THREAD_COUNT = 100;
+    const int CALL_COUNT = 100;
+    auto thread = coral::async::CommThread<MyData>{};
+
+    std::vector<int> failures(THREAD_COUNT);
+    std::vector<std::thread> callers;
+    for (int i = 0; i < THREAD_COUNT; ++i) {
+        callers.emplace_back([&, i] () {
+            for (int j = 0; j < CALL_COUNT; ++j) {
+                std::array<int, 100> big;
+                big.fill(i);
+                const auto n = (j % 2 == 0)
+                    ? thread.ExecuteAndWait<int>(
+                        [big] (coral::net::Reactor&, MyData&, coral::async::CommThreadCompletion<int> c)
+                        {
+                            c.SetValue(big.back());
+                        })
+                    : thread.ExecuteAndWait<int>(
+                        [i] (coral::net::Reactor&, MyData&, coral::async::CommThreadCompletion<int> c)
+                        {
+                            c.SetValue(i);
+                        });
+                if (n != i) ++failures[i];
+            }
+        });
+    }
+    for (auto& c : callers) c.join();
+    for (int i = 0; i < THREAD_COUNT; ++i) EXPECT_EQ(0, failures[i]);
+    thread.Shutdown();
+}
+
+
+// A microbenchmark of the round-trip latency of the two ways to execute a
+// task in the background thread.  The average time per call, in
+// nanoseconds, is reported as a test property (see --gtest_output) rather
+// than checked, since it depends entirely on the machine and its load.
+TEST(coral_async, CommThread_ExecuteLatency)
+{
+    const int CALL_COUNT = 20000;
+    auto thread = coral::async::CommThread<MyData>{};
+
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < CALL_COUNT; ++i) {
+        thread.ExecuteAndWait<int>(
+            [] (coral::net::Reactor&, MyData& data, coral::async::CommThreadCompletion<int> c)
+            {
+                c.SetValue(++data.eventCount);
+            });
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+    for (int i = 0; i < CALL_COUNT; ++i) {
+        thread.Execute<int>(
+            [] (coral::net::Reactor&, MyData& data, std::promise<int> p)
+            {
+                p.set_value(++data.eventCount);
+            }).get();
+    }
+    const auto t2 = std::chrono::steady_clock::now();
+    thread.Shutdown();
+
+    const auto nsPerCall = [CALL_COUNT] (std::chrono::steady_clock::duration d) {
+        return static_cast<int>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()
+            / CALL_COUNT);
+    };
+    RecordProperty("ExecuteAndWaitNsPerCall", nsPerCall(t1 - t0));
+    RecordProperty("ExecuteNsPerCall", nsPerCall(t2 - t1));
+}
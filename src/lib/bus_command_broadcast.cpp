@@ -0,0 +1,245 @@
+/*
+Copyright 2013-present, SINTEF Ocean.
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+#include <coral/bus/command_broadcast.hpp>
+
+#include <cstring>
+#include <exception>
+#include <string>
+#include <utility>
+
+#include <boost/numeric/conversion/cast.hpp>
+
+#include <coral/error.hpp>
+#include <coral/log.hpp>
+#include <coral/net/zmqx.hpp>
+#include <coral/protocol/execution.hpp>
+#include <coral/util.hpp>
+
+
+namespace coral
+{
+namespace bus
+{
+
+namespace
+{
+    const std::size_t SEQUENCE_FRAME_SIZE = 8;
+
+    // The first byte of a subscription and an unsubscription message from
+    // a SUB socket, respectively.
+    const char SUBSCRIBE_MARKER = 1;
+    const char UNSUBSCRIBE_MARKER = 0;
+
+    // The prefix of the topics which slaves subscribe to in order to
+    // identify themselves.  The topics are longer than the sequence number
+    // frame, so they never match an actual command.
+    const char IDENTITY_TOPIC_PREFIX[] = "coral.slave:";
+    const std::size_t IDENTITY_TOPIC_PREFIX_SIZE = sizeof(IDENTITY_TOPIC_PREFIX) - 1;
+    static_assert(sizeof(IDENTITY_TOPIC_PREFIX) - 1 > SEQUENCE_FRAME_SIZE,
+        "Identity topics must be longer than the sequence number frame");
+
+    std::string IdentityTopic(coral::model::SlaveID slaveID)
+    {
+        return IDENTITY_TOPIC_PREFIX + std::to_string(slaveID);
+    }
+
+    // Returns the ID of the slave whose identity topic is the given
+    // subscription message's topic, or INVALID_SLAVE_ID if it is some other
+    // topic.
+    coral::model::SlaveID IdentifiedSlave(const zmq::message_t& msg)
+    {
+        const auto topic = static_cast<const char*>(msg.data()) + 1;
+        const auto topicSize = msg.size() - 1;
+        if (topicSize <= IDENTITY_TOPIC_PREFIX_SIZE
+                || std::memcmp(topic, IDENTITY_TOPIC_PREFIX, IDENTITY_TOPIC_PREFIX_SIZE) != 0) {
+            return coral::model::INVALID_SLAVE_ID;
+        }
+        try {
+            return boost::numeric_cast<coral::model::SlaveID>(std::stoul(
+                std::string(
+                    topic + IDENTITY_TOPIC_PREFIX_SIZE,
+                    topicSize - IDENTITY_TOPIC_PREFIX_SIZE)));
+        } catch (const std::exception&) {
+            return coral::model::INVALID_SLAVE_ID;
+        }
+    }
+
+    void EnforceBound(const std::unique_ptr<zmq::socket_t>& s)
+    {
+        if (!s) throw coral::error::PreconditionViolation("Not bound");
+    }
+}
+
+
+// =============================================================================
+// class CommandBroadcaster
+// =============================================================================
+
+
+CommandBroadcaster::CommandBroadcaster()
+    : m_socket(std::make_unique<zmq::socket_t>(
+        coral::net::zmqx::GlobalContext(), ZMQ_XPUB))
+    , m_sequence(0)
+{
+    // We need to see every subscription, not just the first one for each
+    // topic.  (The identity topics are unique anyway, but a slave which
+    // reconnects subscribes to its topic again.)
+    m_socket->setsockopt(ZMQ_XPUB_VERBOSE, 1);
+    m_socket->setsockopt(ZMQ_SNDHWM, 0);
+    m_socket->setsockopt(ZMQ_LINGER, 0);
+}
+
+
+void CommandBroadcaster::Connect(
+    coral::model::SlaveID slaveID,
+    const coral::net::Endpoint& endpoint)
+{
+    CORAL_PRECONDITION_CHECK(m_connections.count(slaveID) == 0);
+    const auto url = endpoint.URL();
+    m_socket->connect(url.c_str());
+    m_connections.insert(std::make_pair(slaveID, url));
+}
+
+
+void CommandBroadcaster::Disconnect(coral::model::SlaveID slaveID)
+{
+    const auto it = m_connections.find(slaveID);
+    if (it == m_connections.end()) return;
+    try {
+        m_socket->disconnect(it->second.c_str());
+    } catch (const zmq::error_t& e) {
+        // The connection may already be gone, which is fine.
+        CORAL_LOG_DEBUG(boost::format("CommandBroadcaster: Disconnecting from %s: %s")
+            % it->second % e.what());
+    }
+    m_connections.erase(it);
+    m_subscribed.erase(slaveID);
+}
+
+
+int CommandBroadcaster::ConnectionCount() const noexcept
+{
+    return static_cast<int>(m_connections.size());
+}
+
+
+bool CommandBroadcaster::IsConnected(coral::model::SlaveID slaveID) const noexcept
+{
+    return m_connections.count(slaveID) > 0;
+}
+
+
+bool CommandBroadcaster::AllSubscribed()
+{
+    zmq::message_t msg;
+    while (m_socket->recv(&msg, ZMQ_DONTWAIT)) {
+        if (msg.size() == 0) continue;
+        const auto slaveID = IdentifiedSlave(msg);
+        if (slaveID == coral::model::INVALID_SLAVE_ID) continue;
+        const auto marker = static_cast<const char*>(msg.data())[0];
+        if (marker == SUBSCRIBE_MARKER && m_connections.count(slaveID)) {
+            m_subscribed.insert(slaveID);
+        } else if (marker == UNSUBSCRIBE_MARKER) {
+            m_subscribed.erase(slaveID);
+        }
+    }
+    return m_subscribed.size() == m_connections.size();
+}
+
+
+void CommandBroadcaster::Send(
+    coralproto::execution::MessageType type,
+    const google::protobuf::MessageLite* body)
+{
+    std::vector<zmq::message_t> msg;
+    if (body) coral::protocol::execution::CreateMessage(msg, type, *body);
+    else      coral::protocol::execution::CreateMessage(msg, type);
+
+    ++m_sequence;
+    zmq::message_t sequenceFrame(SEQUENCE_FRAME_SIZE);
+    coral::util::EncodeUint64(
+        m_sequence,
+        static_cast<char*>(sequenceFrame.data()));
+    m_socket->send(sequenceFrame, ZMQ_SNDMORE);
+    coral::net::zmqx::Send(*m_socket, msg);
+    CORAL_LOG_TRACE(boost::format("CommandBroadcaster: Sent %s (sequence %d)")
+        % coralproto::execution::MessageType_Name(type)
+        % m_sequence);
+}
+
+
+// =============================================================================
+// class CommandSubscriber
+// =============================================================================
+
+
+CommandSubscriber::CommandSubscriber()
+    : m_lastSequence(0)
+{
+}
+
+
+void CommandSubscriber::Bind(const coral::net::Endpoint& endpoint)
+{
+    if (m_socket) {
+        throw coral::error::PreconditionViolation("Already bound");
+    }
+    auto socket = std::make_unique<zmq::socket_t>(
+        coral::net::zmqx::GlobalContext(), ZMQ_SUB);
+    socket->setsockopt(ZMQ_RCVHWM, 0);
+    socket->setsockopt(ZMQ_LINGER, 0);
+    socket->setsockopt(ZMQ_SUBSCRIBE, "", 0);
+    socket->bind(endpoint.URL().c_str());
+    m_socket = std::move(socket);
+}
+
+
+coral::net::Endpoint CommandSubscriber::BoundEndpoint() const
+{
+    EnforceBound(m_socket);
+    return coral::net::Endpoint{coral::net::zmqx::LastEndpoint(*m_socket)};
+}
+
+
+void CommandSubscriber::Identify(coral::model::SlaveID slaveID)
+{
+    EnforceBound(m_socket);
+    if (!m_identityTopic.empty()) {
+        m_socket->setsockopt(
+            ZMQ_UNSUBSCRIBE, m_identityTopic.data(), m_identityTopic.size());
+    }
+    m_identityTopic = IdentityTopic(slaveID);
+    m_socket->setsockopt(
+        ZMQ_SUBSCRIBE, m_identityTopic.data(), m_identityTopic.size());
+}
+
+
+bool CommandSubscriber::Receive(std::vector<zmq::message_t>& msg)
+{
+    EnforceBound(m_socket);
+    coral::net::zmqx::Receive(*m_socket, msg);
+    if (msg.size() < 2 || msg.front().size() != SEQUENCE_FRAME_SIZE) {
+        throw coral::error::ProtocolViolationException(
+            "Invalid broadcast command message");
+    }
+    const auto sequence = coral::util::DecodeUint64(
+        static_cast<const char*>(msg.front().data()));
+    msg.erase(msg.begin());
+    if (sequence <= m_lastSequence) return false;
+    m_lastSequence = sequence;
+    return true;
+}
+
+
+zmq::socket_t& CommandSubscriber::Socket()
+{
+    EnforceBound(m_socket);
+    return *m_socket;
+}
+
+
+}} // namespace
@@ -0,0 +1,112 @@
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <zmq.hpp>
+
+#include <coral/bus/command_broadcast.hpp>
+#include <coral/error.hpp>
+#include <coral/net.hpp>
+#include <coral/protobuf.hpp>
+#include <coral/protocol/execution.hpp>
+
+#include <execution.pb.h>
+
+
+TEST(coral_bus, CommandBroadcast)
+{
+    coral::bus::CommandSubscriber sub1;
+    sub1.Bind(coral::net::Endpoint{"inproc://coral_bus_CommandBroadcast_1"});
+    coral::bus::CommandSubscriber sub2;
+    sub2.Bind(coral::net::Endpoint{"inproc://coral_bus_CommandBroadcast_2"});
+
+    coral::bus::CommandBroadcaster broadcaster;
+    EXPECT_EQ(0, broadcaster.ConnectionCount());
+    sub1.Identify(1);
+    broadcaster.Connect(1, sub1.BoundEndpoint());
+    broadcaster.Connect(2, sub2.BoundEndpoint());
+    EXPECT_EQ(2, broadcaster.ConnectionCount());
+
+    // The second slave hasn't identified itself yet, so the broadcaster
+    // can't know whether its subscription has arrived.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_FALSE(broadcaster.AllSubscribed());
+
+    sub2.Identify(2);
+    for (int i = 0; i < 100 && !broadcaster.AllSubscribed(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(broadcaster.AllSubscribed());
+
+    coralproto::execution::StepData stepData;
+    stepData.set_step_id(3);
+    stepData.set_timepoint(1.0);
+    stepData.set_stepsize(0.5);
+    broadcaster.Send(coralproto::execution::MSG_STEP, &stepData);
+    broadcaster.Send(coralproto::execution::MSG_ACCEPT_STEP);
+
+    for (auto sub : { &sub1, &sub2 }) {
+        std::vector<zmq::message_t> msg;
+        ASSERT_TRUE(sub->Receive(msg));
+        ASSERT_EQ(2u, msg.size());
+        EXPECT_EQ(
+            coralproto::execution::MSG_STEP,
+            coral::protocol::execution::ParseMessageType(msg.front()));
+        coralproto::execution::StepData recvData;
+        coral::protobuf::ParseFromFrame(msg[1], recvData);
+        EXPECT_EQ(3, recvData.step_id());
+        EXPECT_EQ(1.0, recvData.timepoint());
+        EXPECT_EQ(0.5, recvData.stepsize());
+
+        ASSERT_TRUE(sub->Receive(msg));
+        ASSERT_EQ(1u, msg.size());
+        EXPECT_EQ(
+            coralproto::execution::MSG_ACCEPT_STEP,
+            coral::protocol::execution::ParseMessageType(msg.front()));
+    }
+}
+
+
+TEST(coral_bus, CommandBroadcastDisconnect)
+{
+    coral::bus::CommandSubscriber sub1;
+    sub1.Bind(coral::net::Endpoint{"inproc://coral_bus_CommandBroadcastDisconnect_1"});
+    sub1.Identify(1);
+    auto sub2 = std::make_unique<coral::bus::CommandSubscriber>();
+    sub2->Bind(coral::net::Endpoint{"inproc://coral_bus_CommandBroadcastDisconnect_2"});
+    sub2->Identify(2);
+
+    coral::bus::CommandBroadcaster broadcaster;
+    broadcaster.Connect(1, sub1.BoundEndpoint());
+    broadcaster.Connect(2, sub2->BoundEndpoint());
+    EXPECT_THROW(
+        broadcaster.Connect(2, sub2->BoundEndpoint()),
+        coral::error::PreconditionViolation);
+    for (int i = 0; i < 100 && !broadcaster.AllSubscribed(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(broadcaster.AllSubscribed());
+
+    // When a slave goes away, its subscription does too.
+    sub2.reset();
+    for (int i = 0; i < 100 && broadcaster.AllSubscribed(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_FALSE(broadcaster.AllSubscribed());
+
+    // Once the slave is disconnected from, the rest are all subscribed.
+    broadcaster.Disconnect(2);
+    EXPECT_EQ(1, broadcaster.ConnectionCount());
+    EXPECT_TRUE(broadcaster.AllSubscribed());
+    broadcaster.Disconnect(2);
+    EXPECT_EQ(1, broadcaster.ConnectionCount());
+
+    broadcaster.Send(coralproto::execution::MSG_ACCEPT_STEP);
+    std::vector<zmq::message_t> msg;
+    ASSERT_TRUE(sub1.Receive(msg));
+    EXPECT_EQ(
+        coralproto::execution::MSG_ACCEPT_STEP,
+        coral::protocol::execution::ParseMessageType(msg.front()));
+}
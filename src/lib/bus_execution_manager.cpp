@@ -83,6 +83,32 @@ void ExecutionManager::AcceptStep(
 }
 
 
+void ExecutionManager::Run(
+    coral::model::TimeDuration stepSize,
+    int stepCount,
+    int progressInterval,
+    std::chrono::milliseconds timeout,
+    RunProgressHandler onProgress,
+    RunHandler onComplete,
+    SlaveRunHandler onSlaveRunComplete)
+{
+    m_private->Run(
+        stepSize,
+        stepCount,
+        progressInterval,
+        timeout,
+        std::move(onProgress),
+        std::move(onComplete),
+        std::move(onSlaveRunComplete));
+}
+
+
+void ExecutionManager::Interrupt()
+{
+    m_private->Interrupt();
+}
+
+
 void ExecutionManager::Terminate()
 {
     m_private->Terminate();
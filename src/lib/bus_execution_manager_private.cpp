@@ -7,7 +7,10 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #define NOMINMAX
 #include <coral/bus/execution_manager_private.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <exception>
 #include <typeinfo>
 #include <utility>
 
@@ -34,23 +37,37 @@ ExecutionManagerPrivate::ExecutionManagerPrivate(
         options.maxTime,
         executionName,
         options.slaveVariableRecvTimeout),
+      variableEncoding(options.variableEncoding),
       lastSlaveID(0),
+      shards(),
+      homeInbox(),
       slaves(),
+      subMasters(),
+      commandBroadcaster(),
       m_state(), // created below
       m_operationCount(0),
       m_allSlaveOpsCompleteHandler(),
       m_currentStepID(-1),
       m_resendVarsNeeded(false)
 {
+    CORAL_INPUT_CHECK(options.slaveControlThreads >= 0);
+    if (options.slaveControlThreads > 0) {
+        homeInbox = std::make_unique<TaskInbox>(reactor);
+        for (int i = 0; i < options.slaveControlThreads; ++i) {
+            shards.push_back(std::make_unique<SlaveShard>());
+        }
+    }
     SwapState(std::make_unique<ReadyExecutionState>());
 }
 
 
 ExecutionManagerPrivate::~ExecutionManagerPrivate()
 {
-    // For the moment, the destructor does nothing.  We just need it to be able
-    // to use std::unique_ptr (for m_state) with an undefined type (i.e.,
-    // ExecutionState) in the header.
+    // The shard threads use the slave controllers, so they must be stopped
+    // before the controllers are destroyed.  Apart from that, we just need
+    // the destructor to be able to use std::unique_ptr (for m_state) with an
+    // undefined type (i.e., ExecutionState) in the header.
+    for (auto& shard : shards) shard->Stop();
 }
 
 
@@ -69,6 +86,9 @@ void ExecutionManagerPrivate::Reconstitute(
     m_state->Reconstitute(
         *this, slavesToAdd, commTimeout,
         std::move(onComplete), std::move(onSlaveComplete));
+    // The slaves' peer connections have changed, so we must make sure
+    // values flow between them before the next step.
+    m_resendVarsNeeded = true;
 }
 
 
@@ -90,6 +110,96 @@ void ExecutionManagerPrivate::Step(
     std::chrono::milliseconds timeout,
     ExecutionManager::StepHandler onComplete,
     ExecutionManager::SlaveStepHandler onSlaveStepComplete)
+{
+    WithResentVars(
+        [=] () {
+            m_state->Step(
+                *this,
+                stepSize,
+                timeout,
+                std::move(onComplete),
+                std::move(onSlaveStepComplete));
+        },
+        [=] (const std::error_code& ec) {
+            if (onSlaveStepComplete) {
+                for (const auto& s : this->slaves) {
+                    if (s.second.slave->State() != SLAVE_NOT_CONNECTED) {
+                        onSlaveStepComplete(ec, s.first);
+                    }
+                }
+            }
+            onComplete(ec);
+        });
+}
+
+
+void ExecutionManagerPrivate::AcceptStep(
+    std::chrono::milliseconds timeout,
+    ExecutionManager::AcceptStepHandler onComplete,
+    ExecutionManager::SlaveAcceptStepHandler onSlaveStepComplete)
+{
+    m_state->AcceptStep(
+        *this,
+        timeout,
+        std::move(onComplete),
+        std::move(onSlaveStepComplete));
+}
+
+
+void ExecutionManagerPrivate::Run(
+    coral::model::TimeDuration stepSize,
+    int stepCount,
+    int progressInterval,
+    std::chrono::milliseconds timeout,
+    ExecutionManager::RunProgressHandler onProgress,
+    ExecutionManager::RunHandler onComplete,
+    ExecutionManager::SlaveRunHandler onSlaveRunComplete)
+{
+    CORAL_INPUT_CHECK(stepSize > 0.0);
+    CORAL_INPUT_CHECK(stepCount >= 0);
+    CORAL_INPUT_CHECK(progressInterval >= 0);
+    CORAL_INPUT_CHECK(onComplete);
+    for (const auto& s : slaves) {
+        if (s.second.slave->ProtocolVersion() < 7) {
+            throw coral::error::PreconditionViolation(
+                "Slave \"" + s.second.description.Name()
+                + "\" does not support running on its own");
+        }
+    }
+    WithResentVars(
+        [=] () {
+            m_state->Run(
+                *this,
+                stepSize,
+                stepCount,
+                progressInterval,
+                timeout,
+                std::move(onProgress),
+                std::move(onComplete),
+                std::move(onSlaveRunComplete));
+        },
+        [=] (const std::error_code& ec) {
+            if (onSlaveRunComplete) {
+                for (const auto& s : this->slaves) {
+                    if (s.second.slave->State() != SLAVE_NOT_CONNECTED) {
+                        onSlaveRunComplete(ec, s.first);
+                    }
+                }
+            }
+            onComplete(ec, 0);
+        });
+}
+
+
+void ExecutionManagerPrivate::Interrupt()
+{
+    m_state->Interrupt(*this);
+}
+
+
+void ExecutionManagerPrivate::WithResentVars(
+    std::function<void()> action,
+    std::function<void(const std::error_code&)> onFailure)
 {
     if (m_resendVarsNeeded) {
         auto resendTimeout = 2*slaveSetup.variableRecvTimeout;
@@ -111,47 +221,17 @@ void ExecutionManagerPrivate::Step(
             {
                 if (!ec) {
                     m_resendVarsNeeded = false;
-                    m_state->Step(
-                        *this,
-                        stepSize,
-                        timeout,
-                        std::move(onComplete),
-                        std::move(onSlaveStepComplete));
+                    action();
                 } else {
-                    if (onSlaveStepComplete) {
-                        for (const auto& s : this->slaves) {
-                            if (s.second.slave->State() != SLAVE_NOT_CONNECTED) {
-                                onSlaveStepComplete(ec, s.first);
-                            }
-                        }
-                    }
-                    onComplete(ec);
+                    onFailure(ec);
                 }
             });
     } else {
-        m_state->Step(
-            *this,
-            stepSize,
-            timeout,
-            std::move(onComplete),
-            std::move(onSlaveStepComplete));
+        action();
     }
 }
 
 
-void ExecutionManagerPrivate::AcceptStep(
-    std::chrono::milliseconds timeout,
-    ExecutionManager::AcceptStepHandler onComplete,
-    ExecutionManager::SlaveAcceptStepHandler onSlaveStepComplete)
-{
-    m_state->AcceptStep(
-        *this,
-        timeout,
-        std::move(onComplete),
-        std::move(onSlaveStepComplete));
-}
-
-
 void ExecutionManagerPrivate::Terminate()
 {
     m_state->Terminate(*this);
@@ -160,7 +240,7 @@ void ExecutionManagerPrivate::Terminate()
 
 void ExecutionManagerPrivate::DoTerminate()
 {
-    for (auto it = begin(slaves); it != end(slaves); ++it) {
+    for (auto it = slaves.begin(); it != slaves.end(); ++it) {
         if (it->second.slave->State() != SLAVE_NOT_CONNECTED) {
             it->second.slave->Terminate();
         }
@@ -190,6 +270,12 @@ void ExecutionManagerPrivate::AdvanceSimTime(coral::model::TimeDuration delta)
 }
 
 
+void ExecutionManagerPrivate::SetCurrentStepID(coral::model::StepID stepID)
+{
+    m_currentStepID = stepID;
+}
+
+
 void ExecutionManagerPrivate::SlaveOpStarted() noexcept
 {
     assert(m_operationCount >= 0);
@@ -221,6 +307,114 @@ void ExecutionManagerPrivate::WhenAllSlaveOpsComplete(
 }
 
 
+void ExecutionManagerPrivate::WhenCommandsIssued(std::function<void()> action)
+{
+    assert(action);
+    if (shards.empty()) {
+        action();
+        return;
+    }
+    // Each shard executes its tasks in order, so once it gets to this one,
+    // it has handed all earlier commands to the messengers.  The last shard
+    // to get there performs the action, and then tells us it's done.
+    SlaveOpStarted();
+    const auto remaining =
+        std::make_shared<std::atomic<int>>(static_cast<int>(shards.size()));
+    const auto sharedAction =
+        std::make_shared<std::function<void()>>(std::move(action));
+    for (auto& shard : shards) {
+        shard->Post([this, remaining, sharedAction] ()
+        {
+            if (remaining->fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+            try {
+                (*sharedAction)();
+            } catch (const std::exception& e) {
+                coral::log::Log(
+                    coral::log::error,
+                    boost::format("Failed to issue slave commands: %s")
+                        % e.what());
+            }
+            homeInbox->Post([this] () { SlaveOpComplete(); });
+        });
+    }
+}
+
+
+SlaveShard* ExecutionManagerPrivate::ShardFor(coral::model::SlaveID slaveID)
+    noexcept
+{
+    if (shards.empty()) return nullptr;
+    assert(slaveID > 0);
+    return shards[(slaveID - 1) % shards.size()].get();
+}
+
+
+ExecutionManagerPrivate::SubMasterGroup* ExecutionManagerPrivate::SubMasterFor(
+    const Slave& slave)
+{
+    const auto& endpoint = slave.locator.SubMasterEndpoint();
+    if (endpoint.Transport().empty()) return nullptr;
+    const auto it = subMasters.find(endpoint.URL());
+    if (it == subMasters.end() || it->second.slaves.size() < 2) return nullptr;
+    return &it->second;
+}
+
+
+void ExecutionManagerPrivate::RelayCommand(
+    coralproto::execution::MessageType command,
+    const coralproto::execution::StepData* step,
+    std::chrono::milliseconds timeout)
+{
+    assert(command == coralproto::execution::MSG_STEP
+        || command == coralproto::execution::MSG_ACCEPT_STEP);
+    assert(command != coralproto::execution::MSG_STEP || step);
+    for (auto& sm : subMasters) {
+        auto& group = sm.second;
+        if (group.pending.empty()) continue;
+        auto slaveIDs = std::move(group.pending);
+        group.pending.clear();
+
+        std::vector<std::string> endpoints;
+        endpoints.reserve(slaveIDs.size());
+        for (const auto id : slaveIDs) {
+            endpoints.push_back(slaves.at(id).locator.ControlEndpoint().URL());
+        }
+        auto onReplies = [this, slaveIDs] (
+            const std::error_code& ec,
+            std::vector<std::vector<zmq::message_t>>& replies)
+        {
+            // If the relaying failed, none of the replies will arrive, so
+            // we fail the slaves' commands rather than letting them wait
+            // for their own timeouts.
+            if (ec) {
+                for (const auto id : slaveIDs) {
+                    const auto it = slaves.find(id);
+                    if (it != slaves.end()) it->second.slave->RelayFailed(ec);
+                }
+                return;
+            }
+            const auto n = std::min(replies.size(), slaveIDs.size());
+            for (std::size_t i = 0; i < n; ++i) {
+                if (replies[i].empty()) continue;
+                slaves.at(slaveIDs[i]).slave->ReceiveRelayedReply(
+                    std::move(replies[i]));
+            }
+        };
+        if (command == coralproto::execution::MSG_STEP) {
+            group.client->Step(
+                endpoints,
+                step->step_id(),
+                step->timepoint(),
+                step->stepsize(),
+                timeout,
+                std::move(onReplies));
+        } else {
+            group.client->AcceptStep(endpoints, timeout, std::move(onReplies));
+        }
+    }
+}
+
+
 std::unique_ptr<ExecutionState> ExecutionManagerPrivate::SwapState(
     std::unique_ptr<ExecutionState> next)
 {
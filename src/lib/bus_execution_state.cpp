@@ -10,15 +10,22 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <iterator>
 #include <limits>
+#include <map>
+#include <set>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <coral/bus/execution_manager_private.hpp>
 #include <coral/bus/slave_control_messenger.hpp>
 #include <coral/bus/slave_controller.hpp>
+#include <coral/bus/variable_io.hpp>
 #include <coral/log.hpp>
+#include <coral/net/ip.hpp>
+#include <coral/protocol/execution.hpp>
 #include <coral/util.hpp>
 
 
@@ -141,6 +148,12 @@ namespace
                 otherVarDesc->Causality(),
                 slaveDesc.Name(),
                 varDesc.Name());
+            if (setting.ConnectionDelay() > 0
+                    && sit->second.slave->ProtocolVersion() < 8) {
+                throw std::runtime_error(
+                    "Failed to connect " + slaveDesc.Name() + '.' + varDesc.Name()
+                    + " with a delay, because the slave does not support it");
+            }
         }
     }
 
@@ -153,6 +166,20 @@ namespace
             VerifyVariableSetting(self, slaveID, setting);
         }
     }
+
+    // Stops broadcasting commands to slaves which have left the execution,
+    // and returns whether all the remaining slaves which support broadcast
+    // commands are listening for them.
+    bool BroadcastReady(ExecutionManagerPrivate& self)
+    {
+        for (const auto& slave : self.slaves) {
+            if (slave.second.slave->State() == SLAVE_NOT_CONNECTED) {
+                self.commandBroadcaster.Disconnect(slave.first);
+            }
+        }
+        return self.commandBroadcaster.ConnectionCount() > 0
+            && self.commandBroadcaster.AllSubscribed();
+    }
 }
 
 
@@ -221,6 +248,27 @@ void ReadyExecutionState::Step(
 }
 
 
+void ReadyExecutionState::Run(
+    ExecutionManagerPrivate& self,
+    coral::model::TimeDuration stepSize,
+    int stepCount,
+    int progressInterval,
+    std::chrono::milliseconds timeout,
+    ExecutionManager::RunProgressHandler onProgress,
+    ExecutionManager::RunHandler onComplete,
+    ExecutionManager::SlaveRunHandler onSlaveRunComplete)
+{
+    self.SwapState(std::make_unique<RunningExecutionState>(
+        stepSize,
+        stepCount,
+        progressInterval,
+        timeout,
+        std::move(onProgress),
+        std::move(onComplete),
+        std::move(onSlaveRunComplete)));
+}
+
+
 void ReadyExecutionState::Terminate(ExecutionManagerPrivate& self)
 {
     self.DoTerminate();
@@ -290,6 +338,7 @@ namespace
                     .SetTypeDescription(sd.TypeDescription());
                 onComplete(ec, id);
             } else {
+                self.commandBroadcaster.Disconnect(id);
                 self.slaves.at(id).slave->Terminate();
                 onComplete(ec, coral::model::INVALID_SLAVE_ID);
             }
@@ -302,6 +351,15 @@ namespace
             (const std::error_code& ec)
         {
             if (!ec) {
+                // Slaves which are served by a sub-master get their STEP and
+                // ACCEPT_STEP commands from it, and must not receive the
+                // broadcast ones as well.
+                const auto& entry = self.slaves.at(id);
+                const auto commandSubEndpoint = entry.slave->CommandSubEndpoint();
+                if (!commandSubEndpoint.Transport().empty()
+                        && entry.locator.SubMasterEndpoint().Transport().empty()) {
+                    self.commandBroadcaster.Connect(id, commandSubEndpoint);
+                }
                 self.slaves.at(id).slave->GetDescription(
                     commTimeout,
                     std::move(onDescriptionReceived));
@@ -312,25 +370,114 @@ namespace
         };
 
         // Initiate the connection and add the slave to the slave list
-        auto slaveController = std::make_unique<coral::bus::SlaveController>(
-            self.reactor,
-            slave.locator,
-            id,
-            realName,
-            self.slaveSetup,
-            commTimeout,
-            std::move(onConnected));
+        const auto shard = self.ShardFor(id);
+        auto slaveController = shard
+            ? std::make_unique<coral::bus::SlaveController>(
+                *shard,
+                *self.homeInbox,
+                slave.locator,
+                id,
+                realName,
+                self.slaveSetup,
+                commTimeout,
+                std::move(onConnected))
+            : std::make_unique<coral::bus::SlaveController>(
+                self.reactor,
+                slave.locator,
+                id,
+                realName,
+                self.slaveSetup,
+                commTimeout,
+                std::move(onConnected));
         self.slaves.insert(std::make_pair(
             id,
             ExecutionManagerPrivate::Slave(
                 std::move(slaveController),
                 slave.locator,
                 coral::model::SlaveDescription(id, realName))));
+
+        const auto& subMasterEndpoint = slave.locator.SubMasterEndpoint();
+        if (!subMasterEndpoint.Transport().empty()) {
+            auto& group = self.subMasters[subMasterEndpoint.URL()];
+            if (!group.client) {
+                group.client = std::make_unique<SubMasterClient>(
+                    self.reactor,
+                    subMasterEndpoint);
+            }
+            group.slaves.push_back(id);
+        }
         return id;
     }
 }
 
 
+namespace
+{
+    // Returns the IDs of the slaves whose outputs the given slave's inputs
+    // are connected to according to `connections`, i.e., the peers it needs
+    // to receive data from.
+    std::set<coral::model::SlaveID> ConnectedPeers(
+        const ExecutionManagerPrivate::ConnectionMap& connections,
+        coral::model::SlaveID slaveID)
+    {
+        std::set<coral::model::SlaveID> peers;
+        const auto inputs = connections.find(slaveID);
+        if (inputs != connections.end()) {
+            for (const auto& input : inputs->second) {
+                peers.insert(input.second.Slave());
+            }
+        }
+        return peers;
+    }
+
+    // Returns whether two data publisher endpoints are TCP endpoints with
+    // the same host address.
+    bool OnSameHost(
+        const coral::net::Endpoint& a,
+        const coral::net::Endpoint& b)
+    {
+        if (a.Transport() != "tcp" || b.Transport() != "tcp") return false;
+        try {
+            return coral::net::ip::Endpoint{a.Address()}.Address()
+                == coral::net::ip::Endpoint{b.Address()}.Address();
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    // Returns the data publisher endpoints of the given slaves, as seen by
+    // the subscribing slave `subscriberID`.  Slaves which support protocol
+    // version 9 get shared memory endpoints for the publishers which are on
+    // the same host as themselves.  IDs which do not refer to slaves in the
+    // execution are ignored.
+    template<typename SlaveIDRange>
+    std::vector<coral::net::Endpoint> DataPubEndpoints(
+        const ExecutionManagerPrivate& self,
+        coral::model::SlaveID subscriberID,
+        const SlaveIDRange& slaveIDs)
+    {
+        const auto subscriber = self.slaves.find(subscriberID);
+        assert(subscriber != self.slaves.end());
+        const bool sharedMemory = subscriber->second.slave->ProtocolVersion() >= 9;
+        const auto& subscriberEndpoint = subscriber->second.locator.DataPubEndpoint();
+
+        std::vector<coral::net::Endpoint> endpoints;
+        for (const auto id : slaveIDs) {
+            const auto slave = self.slaves.find(id);
+            if (slave != self.slaves.end()) {
+                const auto& endpoint = slave->second.locator.DataPubEndpoint();
+                if (sharedMemory && OnSameHost(subscriberEndpoint, endpoint)) {
+                    endpoints.push_back(SharedMemoryEndpoint(endpoint));
+                } else {
+                    endpoints.push_back(endpoint);
+                }
+            }
+        }
+        return endpoints;
+    }
+}
+
+
 ReconstitutingExecutionState::ReconstitutingExecutionState(
     const std::vector<AddedSlave>& slavesToAdd,
     std::chrono::milliseconds commTimeout,
@@ -395,15 +542,31 @@ void ReconstitutingExecutionState::AllSlavesAdded(
     ExecutionManagerPrivate& self)
 {
     // Build a list that contains the endpoints on which the slaves
-    // publish their variable values.
+    // publish their variable values.  Slaves which support protocol
+    // version 4 only get the endpoints of the slaves they are connected
+    // to, while older ones get all of them.  At the same time, we figure out
+    // which protocol version all of them support, since this determines
+    // the data formats they can use among themselves.
     std::vector<coral::net::Endpoint> peers;
+    int commonProtocol = coral::protocol::execution::MAX_PROTOCOL_VERSION;
     for (const auto& slave : self.slaves) {
         if (slave.second.slave->State() != SLAVE_NOT_CONNECTED) {
             peers.push_back(slave.second.locator.DataPubEndpoint());
+            commonProtocol = std::min(
+                commonProtocol,
+                slave.second.slave->ProtocolVersion());
         }
     }
+    const bool batchedData = commonProtocol >= 1;
+    auto encoding = self.variableEncoding;
+    if (encoding == BINARY_VARIABLE_ENCODING && commonProtocol < 2) {
+        coral::log::Log(coral::log::warning,
+            "Not all slaves support binary variable encoding; "
+            "falling back to the default encoding");
+        encoding = PROTOBUF_VARIABLE_ENCODING;
+    }
 
-    // Send that list to all the slaves.  We use opTally to keep track of
+    // Send the peer lists to all the slaves.  We use opTally to keep track of
     // the number of ongoing operations as well as the number of failed
     // operations.  The latter is needed because any failure should be
     // counted as fatal -- the simulation is not likely to run if one of
@@ -415,7 +578,12 @@ void ReconstitutingExecutionState::AllSlavesAdded(
     for (auto& slave : self.slaves) {
         const auto slaveName = slave.second.description.Name();
         slave.second.slave->SetPeers(
-            peers,
+            slave.second.slave->ProtocolVersion() >= 4
+                ? DataPubEndpoints(
+                    self, slave.first, ConnectedPeers(self.connections, slave.first))
+                : peers,
+            batchedData,
+            encoding,
             m_commTimeout,
             [&self, opTally, slaveName, this] (const std::error_code& ec)
             {
@@ -496,26 +664,224 @@ ReconfiguringExecutionState::ReconfiguringExecutionState(
 }
 
 
+namespace
+{
+    typedef std::map<
+            coral::model::SlaveID,
+            std::map<coral::model::VariableID, bool>>
+        PublishingChanges;
+
+    // Adds `delta` to the number of inputs connected to `output`.  The first
+    // time a given output is touched, its previous "is published" status is
+    // recorded in `changes`, so we can compare it to the new one afterwards.
+    void UpdateConsumerCount(
+        ExecutionManagerPrivate::ConsumerCountMap& consumerCounts,
+        const coral::model::Variable& output,
+        int delta,
+        PublishingChanges& changes)
+    {
+        auto& counts = consumerCounts[output.Slave()];
+        auto count = counts.find(output.ID());
+        const bool wasPublished = count != counts.end();
+        changes[output.Slave()].insert(std::make_pair(output.ID(), wasPublished));
+        if (wasPublished) {
+            count->second += delta;
+            assert(count->second >= 0);
+            if (count->second == 0) counts.erase(count);
+        } else {
+            assert(delta > 0);
+            counts.insert(std::make_pair(output.ID(), delta));
+        }
+    }
+
+    // Removes the connections to and from slaves which have dropped out of
+    // the execution.  Outputs of other slaves which were only consumed by
+    // a dropped slave are recorded in `changes`, so that their publishers
+    // can be told to stop publishing them.
+    void ForgetDisconnectedSlaves(
+        const ExecutionManagerPrivate& self,
+        ExecutionManagerPrivate::ConnectionMap& connections,
+        ExecutionManagerPrivate::ConsumerCountMap& consumerCounts,
+        PublishingChanges& changes)
+    {
+        std::set<coral::model::SlaveID> dropped;
+        for (const auto& slave : self.slaves) {
+            if (slave.second.slave->State() == SLAVE_NOT_CONNECTED) {
+                dropped.insert(slave.first);
+            }
+        }
+        if (dropped.empty()) return;
+
+        for (const auto id : dropped) {
+            consumerCounts.erase(id);
+            const auto inputs = connections.find(id);
+            if (inputs == connections.end()) continue;
+            for (const auto& input : inputs->second) {
+                if (!dropped.count(input.second.Slave())) {
+                    UpdateConsumerCount(consumerCounts, input.second, -1, changes);
+                }
+            }
+            connections.erase(inputs);
+        }
+        for (auto& slave : connections) {
+            auto& inputs = slave.second;
+            for (auto it = inputs.begin(); it != inputs.end(); ) {
+                if (dropped.count(it->second.Slave())) {
+                    it = inputs.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    // Applies the connection changes in `slaveConfigs` to `connections`
+    // and `consumerCounts`, recording the outputs whose consumer counts
+    // change in `changes`.
+    void UpdateConnections(
+        const std::vector<SlaveConfig>& slaveConfigs,
+        ExecutionManagerPrivate::ConnectionMap& connections,
+        ExecutionManagerPrivate::ConsumerCountMap& consumerCounts,
+        PublishingChanges& changes)
+    {
+        for (const auto& config : slaveConfigs) {
+            auto& inputs = connections[config.slaveID];
+            for (const auto& setting : config.variableSettings) {
+                if (!setting.IsConnectionChange()) continue;
+                const auto input = inputs.find(setting.Variable());
+                if (input != inputs.end()) {
+                    UpdateConsumerCount(consumerCounts, input->second, -1, changes);
+                    inputs.erase(input);
+                }
+                if (!setting.ConnectedOutput().Empty()) {
+                    inputs.insert(std::make_pair(
+                        setting.Variable(),
+                        setting.ConnectedOutput()));
+                    UpdateConsumerCount(
+                        consumerCounts, setting.ConnectedOutput(), 1, changes);
+                }
+            }
+        }
+    }
+
+    template<typename T>
+    const std::vector<T>& FindOrEmpty(
+        const std::map<coral::model::SlaveID, std::vector<T>>& map,
+        coral::model::SlaveID slaveID)
+    {
+        static const std::vector<T> empty;
+        const auto it = map.find(slaveID);
+        return it == map.end() ? empty : it->second;
+    }
+}
+
+
 void ReconfiguringExecutionState::StateEntered(
     ExecutionManagerPrivate& self)
 {
+    // Work out the new connections in a copy of the current bookkeeping,
+    // which we only commit once all slaves have accepted the changes.
+    // Connections to and from slaves which have dropped out are removed
+    // at the same time.
+    m_connections = self.connections;
+    m_outputConsumerCounts = self.outputConsumerCounts;
+    PublishingChanges changes;
+    ForgetDisconnectedSlaves(
+        self, m_connections, m_outputConsumerCounts, changes);
+    UpdateConnections(
+        m_slaveConfigs, m_connections, m_outputConsumerCounts, changes);
+
+    // Work out which output variables have gained their first consumer or
+    // lost their last one, so that slaves which support it (protocol
+    // version 3 and up) only publish the outputs that someone subscribes to.
+    std::map<coral::model::SlaveID, std::vector<coral::model::VariableID>>
+        startPublishing, stopPublishing;
+    for (const auto& slave : changes) {
+        const auto counts = m_outputConsumerCounts.find(slave.first);
+        for (const auto& output : slave.second) {
+            const bool isPublished = counts != m_outputConsumerCounts.end()
+                && counts->second.count(output.first) > 0;
+            if (isPublished && !output.second) {
+                startPublishing[slave.first].push_back(output.first);
+            } else if (!isPublished && output.second) {
+                stopPublishing[slave.first].push_back(output.first);
+            }
+        }
+    }
+
+    // At the same time, we work out which peers each slave needs to connect
+    // to or may disconnect from, so they don't need to be connected to every
+    // other slave in the execution (protocol version 4 and up).
+    std::map<coral::model::SlaveID, std::vector<coral::net::Endpoint>>
+        connectPeers, disconnectPeers;
+    for (const auto& slave : self.slaves) {
+        if (slave.second.slave->State() == SLAVE_NOT_CONNECTED) continue;
+        const auto oldPeers = ConnectedPeers(self.connections, slave.first);
+        const auto newPeers = ConnectedPeers(m_connections, slave.first);
+        std::vector<coral::model::SlaveID> diff;
+        std::set_difference(
+            newPeers.begin(), newPeers.end(),
+            oldPeers.begin(), oldPeers.end(),
+            std::back_inserter(diff));
+        if (!diff.empty()) {
+            connectPeers[slave.first] = DataPubEndpoints(self, slave.first, diff);
+        }
+        diff.clear();
+        std::set_difference(
+            oldPeers.begin(), oldPeers.end(),
+            newPeers.begin(), newPeers.end(),
+            std::back_inserter(diff));
+        if (!diff.empty()) {
+            disconnectPeers[slave.first] = DataPubEndpoints(self, slave.first, diff);
+        }
+    }
+
+    // Slaves whose outputs or peers are affected, but which are not
+    // themselves being reconfigured, get a SET_VARS message with no
+    // variable settings.
+    std::vector<coral::model::SlaveID> targets;
+    for (const auto& config : m_slaveConfigs) {
+        targets.push_back(config.slaveID);
+    }
+    for (const auto& slave : self.slaves) {
+        if (slave.second.slave->ProtocolVersion() >= 3
+                && slave.second.slave->State() != SLAVE_NOT_CONNECTED
+                && std::find(targets.begin(), targets.end(), slave.first)
+                    == targets.end()
+                && (startPublishing.count(slave.first)
+                    || stopPublishing.count(slave.first)
+                    || connectPeers.count(slave.first)
+                    || disconnectPeers.count(slave.first))) {
+            targets.push_back(slave.first);
+        }
+    }
+
+    static const std::vector<coral::model::VariableSetting> noSettings;
     const auto opTally = std::make_shared<OpTally>();
-    for (std::size_t index = 0; index < m_slaveConfigs.size(); ++index) {
-        const auto slaveID = m_slaveConfigs[index].slaveID;
+    for (std::size_t index = 0; index < targets.size(); ++index) {
+        const auto slaveID = targets[index];
+        const bool isConfigured = index < m_slaveConfigs.size();
         self.slaves.at(slaveID).slave->SetVariables(
-            m_slaveConfigs[index].variableSettings,
+            isConfigured ? m_slaveConfigs[index].variableSettings : noSettings,
+            FindOrEmpty(startPublishing, slaveID),
+            FindOrEmpty(stopPublishing, slaveID),
+            FindOrEmpty(connectPeers, slaveID),
+            FindOrEmpty(disconnectPeers, slaveID),
             m_commTimeout,
-            [&self, opTally, index, slaveID, this] (const std::error_code& ec)
+            [&self, opTally, index, isConfigured, slaveID, this]
+                (const std::error_code& ec)
             {
                 --(opTally->ongoing);
                 if (ec) {
                     ++(opTally->failed);
                 }
-                m_onSlaveComplete(ec, slaveID, index);
+                if (isConfigured) m_onSlaveComplete(ec, slaveID, index);
                 if (opTally->ongoing == 0) {
                     // All per-slave calls complete
                     if (opTally->failed == 0) {
                         // No errors
+                        self.connections = std::move(m_connections);
+                        self.outputConsumerCounts = std::move(m_outputConsumerCounts);
                         m_onComplete(std::error_code{});
                         self.SwapState(std::make_unique<ReadyExecutionState>());
                     } else {
@@ -638,26 +1004,88 @@ SteppingExecutionState::SteppingExecutionState(
 void SteppingExecutionState::StateEntered(ExecutionManagerPrivate& self)
 {
     const auto stepID = self.NextStepID();
-    for (auto it = begin(self.slaves); it != end(self.slaves); ++it) {
+    const auto currentT = self.CurrentSimTime();
+
+    // Once all the slaves that support it are listening for broadcast
+    // commands, we send a single STEP message to all of them after the loop
+    // rather than one message per slave.
+    const bool broadcast = BroadcastReady(self);
+    bool broadcastPending = false;
+
+    // Slaves which are served by a sub-master get the command from it, so
+    // the master only exchanges one message with each sub-master.
+    bool relayPending = false;
+
+    for (auto it = self.slaves.begin(); it != self.slaves.end(); ++it) {
         const auto slaveID = it->first;
-        it->second.slave->Step(
-            stepID,
-            self.CurrentSimTime(),
-            m_stepSize,
-            m_timeout,
+        const auto slave = it->second.slave.get();
+        const auto subMaster = self.SubMasterFor(it->second);
+        auto onStepComplete =
             [&self, slaveID, this] (const std::error_code& ec) {
                 const auto onExit = coral::util::OnScopeExit([&self]() {
                     self.SlaveOpComplete();
                 });
                 if (m_onSlaveStepComplete) m_onSlaveStepComplete(ec, slaveID);
-            });
+            };
+        if (slave->State() == SLAVE_STEP_OK && slave->ProtocolVersion() < 5) {
+            // The previous step was not explicitly accepted, and the slave
+            // doesn't support accepting it as part of STEP, so we have to
+            // do it in a separate request first.
+            slave->AcceptStep(
+                m_timeout,
+                [slave, stepID, currentT, onStepComplete, this]
+                    (const std::error_code& ec)
+                {
+                    if (ec) {
+                        onStepComplete(ec);
+                        return;
+                    }
+                    slave->Step(
+                        stepID,
+                        currentT,
+                        m_stepSize,
+                        m_timeout,
+                        onStepComplete);
+                });
+        } else if (subMaster && !subMaster->client->Busy()) {
+            slave->StepByRelay(m_timeout, std::move(onStepComplete));
+            subMaster->pending.push_back(slaveID);
+            relayPending = true;
+        } else if (broadcast && self.commandBroadcaster.IsConnected(slaveID)) {
+            slave->StepByBroadcast(m_timeout, std::move(onStepComplete));
+            broadcastPending = true;
+        } else {
+            slave->Step(
+                stepID,
+                currentT,
+                m_stepSize,
+                m_timeout,
+                std::move(onStepComplete));
+        }
         self.SlaveOpStarted();
     }
+    coralproto::execution::StepData data;
+    data.set_step_id(stepID);
+    data.set_timepoint(currentT);
+    data.set_stepsize(m_stepSize);
+    if (relayPending) {
+        // The replies reach the shards (if any) after the commands above,
+        // so unlike for broadcasts, we needn't wait for them to be issued.
+        self.RelayCommand(coralproto::execution::MSG_STEP, &data, m_timeout);
+    }
+    if (broadcastPending) {
+        // With shards, the slaves may not be ready to receive the reply
+        // until their shards have processed the commands above.
+        self.WhenCommandsIssued([&self, data] ()
+        {
+            self.commandBroadcaster.Send(coralproto::execution::MSG_STEP, &data);
+        });
+    }
     self.WhenAllSlaveOpsComplete([&self, this] (const std::error_code& ec) {
         assert(!ec);
         bool stepFailed = false;
         bool fatalError = false;
-        for (auto it = begin(self.slaves); it != end(self.slaves); ++it) {
+        for (auto it = self.slaves.begin(); it != self.slaves.end(); ++it) {
             if (it->second.slave->State() == SLAVE_STEP_OK) {
                 // do nothing
             } else if (it->second.slave->State() == SLAVE_STEP_FAILED) {
@@ -703,6 +1131,22 @@ void StepOkExecutionState::Terminate(ExecutionManagerPrivate& self)
 }
 
 
+void StepOkExecutionState::Step(
+    ExecutionManagerPrivate& self,
+    coral::model::TimeDuration stepSize,
+    std::chrono::milliseconds timeout,
+    ExecutionManager::StepHandler onComplete,
+    ExecutionManager::SlaveStepHandler onSlaveStepComplete)
+{
+    // SteppingExecutionState takes care of accepting the current step,
+    // either as part of the STEP request or, for slaves which use protocol
+    // versions older than 5, by sending ACCEPT_STEP first.
+    self.AdvanceSimTime(m_stepSize);
+    self.SwapState(std::make_unique<SteppingExecutionState>(
+        stepSize, timeout, std::move(onComplete), std::move(onSlaveStepComplete)));
+}
+
+
 void StepOkExecutionState::AcceptStep(
     ExecutionManagerPrivate& self,
     std::chrono::milliseconds timeout,
@@ -731,10 +1175,16 @@ AcceptingExecutionState::AcceptingExecutionState(
 
 void AcceptingExecutionState::StateEntered(ExecutionManagerPrivate& self)
 {
-    for (auto it = begin(self.slaves); it != end(self.slaves); ++it) {
+    // See SteppingExecutionState::StateEntered()
+    const bool broadcast = BroadcastReady(self);
+    bool broadcastPending = false;
+    bool relayPending = false;
+
+    for (auto it = self.slaves.begin(); it != self.slaves.end(); ++it) {
         const auto slaveID = it->first;
-        it->second.slave->AcceptStep(
-            m_timeout,
+        const auto slave = it->second.slave.get();
+        const auto subMaster = self.SubMasterFor(it->second);
+        auto onAcceptStepComplete =
             [&self, slaveID, this] (const std::error_code& ec) {
                 const auto onExit = coral::util::OnScopeExit([&self]() {
                     self.SlaveOpComplete();
@@ -742,13 +1192,36 @@ void AcceptingExecutionState::StateEntered(ExecutionManagerPrivate& self)
                 if (m_onSlaveAcceptStepComplete) {
                     m_onSlaveAcceptStepComplete(ec, slaveID);
                 }
-            });
+            };
+        if (subMaster && !subMaster->client->Busy()) {
+            slave->AcceptStepByRelay(m_timeout, std::move(onAcceptStepComplete));
+            subMaster->pending.push_back(slaveID);
+            relayPending = true;
+        } else if (broadcast && self.commandBroadcaster.IsConnected(slaveID)) {
+            slave->AcceptStepByBroadcast(
+                m_timeout,
+                std::move(onAcceptStepComplete));
+            broadcastPending = true;
+        } else {
+            slave->AcceptStep(m_timeout, std::move(onAcceptStepComplete));
+        }
         self.SlaveOpStarted();
     }
+    if (relayPending) {
+        self.RelayCommand(
+            coralproto::execution::MSG_ACCEPT_STEP, nullptr, m_timeout);
+    }
+    if (broadcastPending) {
+        // See above.
+        self.WhenCommandsIssued([&self] ()
+        {
+            self.commandBroadcaster.Send(coralproto::execution::MSG_ACCEPT_STEP);
+        });
+    }
     self.WhenAllSlaveOpsComplete([&self, this] (const std::error_code& ec) {
         assert(!ec);
         bool error = false;
-        for (auto it = begin(self.slaves); it != end(self.slaves); ++it) {
+        for (auto it = self.slaves.begin(); it != self.slaves.end(); ++it) {
             if (it->second.slave->State() != SLAVE_READY) {
                 assert(it->second.slave->State() == SLAVE_NOT_CONNECTED);
                 error = true;
@@ -774,6 +1247,195 @@ void AcceptingExecutionState::StateEntered(ExecutionManagerPrivate& self)
 // =============================================================================
 
 
+RunningExecutionState::RunningExecutionState(
+    coral::model::TimeDuration stepSize,
+    int stepCount,
+    int progressInterval,
+    std::chrono::milliseconds timeout,
+    ExecutionManager::RunProgressHandler onProgress,
+    ExecutionManager::RunHandler onComplete,
+    ExecutionManager::SlaveRunHandler onSlaveRunComplete)
+    : m_stepSize(stepSize),
+      m_stepCount(stepCount),
+      m_progressInterval(progressInterval),
+      m_timeout(timeout),
+      m_onProgress(std::move(onProgress)),
+      m_onComplete(std::move(onComplete)),
+      m_onSlaveRunComplete(std::move(onSlaveRunComplete)),
+      m_firstStepID(coral::model::INVALID_STEP_ID),
+      m_startTime(0.0),
+      m_lastStepIDs(),
+      m_reportedStepID(coral::model::INVALID_STEP_ID),
+      m_interrupted(false),
+      m_catchingUp(false)
+{
+}
+
+
+void RunningExecutionState::StateEntered(ExecutionManagerPrivate& self)
+{
+    m_firstStepID = self.NextStepID();
+    m_startTime = self.CurrentSimTime();
+    m_reportedStepID = m_firstStepID - 1;
+    const auto lastStepID = m_firstStepID + m_stepCount - 1;
+    for (const auto& s : self.slaves) {
+        m_lastStepIDs[s.first] = m_firstStepID - 1;
+        StartRun(self, s.first, m_firstStepID, lastStepID, m_progressInterval);
+    }
+    self.WhenAllSlaveOpsComplete([&self, this] (const std::error_code& ec) {
+        assert(!ec);
+        AllRunsComplete(self);
+    });
+}
+
+
+void RunningExecutionState::Interrupt(ExecutionManagerPrivate& self)
+{
+    // Once we're catching up, the run is nearly over anyway.
+    if (!m_catchingUp) InterruptAll(self);
+}
+
+
+void RunningExecutionState::StartRun(
+    ExecutionManagerPrivate& self,
+    coral::model::SlaveID slaveID,
+    coral::model::StepID firstStepID,
+    coral::model::StepID lastStepID,
+    int progressInterval)
+{
+    const auto slave = self.slaves.at(slaveID).slave.get();
+    slave->Run(
+        firstStepID,
+        lastStepID,
+        m_startTime + (firstStepID - m_firstStepID) * m_stepSize,
+        m_stepSize,
+        progressInterval,
+        m_timeout,
+        [slaveID, this] (coral::model::StepID stepID) {
+            m_lastStepIDs[slaveID] = stepID;
+            ReportProgress();
+        },
+        [&self, slaveID, this]
+            (const std::error_code& ec, coral::model::StepID stepID)
+        {
+            const auto onExit = coral::util::OnScopeExit([&self]() {
+                self.SlaveOpComplete();
+            });
+            if (!ec) {
+                m_lastStepIDs[slaveID] = stepID;
+            } else {
+                // There's no point in the others continuing now.
+                InterruptAll(self);
+            }
+            if (m_onSlaveRunComplete) m_onSlaveRunComplete(ec, slaveID);
+        });
+    self.SlaveOpStarted();
+}
+
+
+void RunningExecutionState::ReportProgress()
+{
+    if (!m_onProgress || m_catchingUp) return;
+    auto minStepID = std::numeric_limits<coral::model::StepID>::max();
+    for (const auto& s : m_lastStepIDs) {
+        minStepID = std::min(minStepID, s.second);
+    }
+    if (minStepID > m_reportedStepID) {
+        m_reportedStepID = minStepID;
+        m_onProgress(
+            m_startTime + (minStepID - m_firstStepID + 1) * m_stepSize);
+    }
+}
+
+
+void RunningExecutionState::InterruptAll(ExecutionManagerPrivate& self)
+{
+    if (m_interrupted) return;
+    m_interrupted = true;
+    for (const auto& s : self.slaves) {
+        if (s.second.slave->State() == SLAVE_BUSY) s.second.slave->Interrupt();
+    }
+}
+
+
+void RunningExecutionState::AllRunsComplete(ExecutionManagerPrivate& self)
+{
+    bool stepFailed = false;
+    bool fatalError = false;
+    for (const auto& s : self.slaves) {
+        const auto state = s.second.slave->State();
+        if (state == SLAVE_READY || state == SLAVE_STEP_OK) {
+            // do nothing
+        } else if (state == SLAVE_STEP_FAILED) {
+            stepFailed = true;
+        } else {
+            assert(state == SLAVE_NOT_CONNECTED);
+            fatalError = true;
+            break;
+        }
+    }
+
+    if (fatalError) {
+        const auto keepMeAlive = self.SwapState(
+            std::make_unique<FatalErrorExecutionState>());
+        assert(keepMeAlive.get() == this);
+        m_onComplete(make_error_code(coral::error::generic_error::operation_failed), 0);
+        return;
+    } else if (stepFailed) {
+        const auto keepMeAlive = self.SwapState(
+            std::make_unique<StepFailedExecutionState>());
+        assert(keepMeAlive.get() == this);
+        m_onComplete(coral::error::sim_error::cannot_perform_timestep, 0);
+        return;
+    }
+
+    // If the run was interrupted, the slaves have most likely stopped at
+    // different time steps, and some may not yet have received their inputs.
+    // The ones that lag behind are brought up to the step reached by the
+    // one that came furthest.
+    auto lastStepID = m_firstStepID + m_stepCount - 1;
+    if (!m_lastStepIDs.empty()) {
+        lastStepID = std::numeric_limits<coral::model::StepID>::min();
+        for (const auto& s : m_lastStepIDs) {
+            lastStepID = std::max(lastStepID, s.second);
+        }
+    }
+    if (!m_catchingUp) {
+        m_catchingUp = true;
+        m_interrupted = false;
+        bool anyBehind = false;
+        for (const auto& s : m_lastStepIDs) {
+            if (s.second < lastStepID
+                    || self.slaves.at(s.first).slave->State() == SLAVE_STEP_OK) {
+                StartRun(self, s.first, s.second + 1, lastStepID, 0);
+                anyBehind = true;
+            }
+        }
+        if (anyBehind) {
+            CORAL_LOG_DEBUG(boost::format(
+                "Run interrupted; bringing slaves up to time step %d")
+                % lastStepID);
+            self.WhenAllSlaveOpsComplete([&self, this] (const std::error_code& ec) {
+                assert(!ec);
+                AllRunsComplete(self);
+            });
+            return;
+        }
+    }
+
+    const auto stepCount = lastStepID - m_firstStepID + 1;
+    self.SetCurrentStepID(lastStepID);
+    self.AdvanceSimTime(stepCount * m_stepSize);
+    const auto keepMeAlive = self.SwapState(
+        std::make_unique<ReadyExecutionState>());
+    assert(keepMeAlive.get() == this);
+    m_onComplete(std::error_code(), stepCount);
+}
+
+
+// =============================================================================
+
+
 void StepFailedExecutionState::Terminate(ExecutionManagerPrivate& self)
 {
     self.DoTerminate();
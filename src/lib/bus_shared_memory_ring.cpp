@@ -0,0 +1,572 @@
+/*
+Copyright 2013-present, SINTEF Ocean.
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+#include <coral/bus/shared_memory_ring.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#ifdef _WIN32
+#   include <Windows.h>
+#else
+#   include <sys/file.h>
+#   include <unistd.h>
+#endif
+
+#include <boost/format.hpp>
+
+#include <coral/error.hpp>
+#include <coral/log.hpp>
+
+
+namespace bi = boost::interprocess;
+
+
+namespace coral
+{
+namespace bus
+{
+
+namespace
+{
+    const std::uint32_t RING_MAGIC = 0x474E5243; // "CRNG"
+    const std::uint32_t RING_VERSION = 2;
+    const std::uint32_t MAX_GENERATIONS = 32;
+
+    // Values of the reader slots in the control segment, other than
+    // (position + 1) for a slot which is in use.
+    const std::uint64_t FREE_SLOT = 0;
+    const std::uint64_t EVICTED_SLOT = std::numeric_limits<std::uint64_t>::max();
+
+    // The header of each record in a data segment.  A record with neither a
+    // header nor a body is padding, which fills the rest of the segment
+    // when the next message doesn't fit there.  Records never wrap around.
+    struct RecordHeader
+    {
+        std::uint32_t size;     // including this header and any alignment
+        std::int32_t stepID;
+        std::uint32_t headerSize;
+        std::uint32_t bodySize;
+    };
+
+    // The size of every record is a multiple of this, so there is always
+    // room for a padding record at the end of a data segment.
+    const std::uint64_t RECORD_ALIGNMENT = sizeof(RecordHeader);
+
+    std::uint64_t AlignedSize(std::uint64_t size)
+    {
+        return (size + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+    }
+
+    // Data segments are named after the ring and the writer instance which
+    // created them, so a new writer never reuses the names of segments
+    // which may still be mapped by the readers of an old one.
+    std::string DataSegmentName(
+        const std::string& ringName,
+        std::uint32_t instanceID,
+        std::uint32_t generation)
+    {
+        return (boost::format("%s.%08x.%d") % ringName % instanceID % generation).str();
+    }
+
+    std::uint32_t RandomInstanceID()
+    {
+        std::random_device rd;
+        return static_cast<std::uint32_t>(rd());
+    }
+
+    std::uint32_t ProcessID() noexcept
+    {
+#ifdef _WIN32
+        return static_cast<std::uint32_t>(GetCurrentProcessId());
+#else
+        return static_cast<std::uint32_t>(getpid());
+#endif
+    }
+}
+
+
+#if ATOMIC_INT_LOCK_FREE != 2 || ATOMIC_LLONG_LOCK_FREE != 2
+#   error "Shared memory rings require lock-free atomic integers"
+#endif
+
+struct SharedMemoryRingControl
+{
+    // Set last, once the rest of the block has been initialised.
+    std::atomic<std::uint32_t> magic;
+    std::uint32_t version;
+
+    // Identifies the writer, and thereby the names of its data segments.
+    // These are set before any data segments are created.
+    std::atomic<std::uint32_t> instanceID;
+    std::atomic<std::uint32_t> ownerPID;
+
+    // The generation which is currently being written to.
+    std::atomic<std::uint32_t> generation;
+
+    // The position at which the next record will be written.
+    std::atomic<std::uint64_t> writePos;
+
+    // The position of the first record in each data segment, and its size.
+    struct Generation
+    {
+        std::atomic<std::uint64_t> start;
+        std::atomic<std::uint64_t> capacity;
+    };
+    Generation generations[MAX_GENERATIONS];
+
+    // The position of the next record each reader will read, plus one.
+    std::atomic<std::uint64_t> readers[SharedMemoryRingWriter::MAX_READERS];
+};
+
+
+namespace
+{
+    // Whether the writer which created the ring whose control segment is
+    // `shm` may still be running.  On POSIX systems, the writer holds an
+    // exclusive flock() on the segment, which the OS releases when the
+    // process dies, even if it is in another PID namespace.  On Windows, we
+    // look for the process whose ID is stored in the segment, which errs on
+    // the side of caution if the ID has been reused.  If in doubt, the
+    // answer is yes.
+    bool OwnerMayBeAlive(
+        bi::shared_memory_object& shm,
+        const SharedMemoryRingControl* control)
+    {
+#ifdef _WIN32
+        if (control == nullptr) return true;
+        const auto process = OpenProcess(
+            SYNCHRONIZE, FALSE, control->ownerPID.load());
+        if (process == NULL) return GetLastError() != ERROR_INVALID_PARAMETER;
+        const auto status = WaitForSingleObject(process, 0);
+        CloseHandle(process);
+        return status != WAIT_OBJECT_0;
+#else
+        (void) control;
+        return flock(shm.get_mapping_handle().handle, LOCK_EX | LOCK_NB) != 0;
+#endif
+    }
+
+    // Removes the ring with the given name if, and only if, its writer is
+    // known to be dead.  Returns whether the name is free afterwards.
+    bool RemoveAbandonedRing(const std::string& name) noexcept
+    {
+        try {
+            bi::shared_memory_object shm(bi::open_only, name.c_str(), bi::read_write);
+            bi::offset_t size = 0;
+            shm.get_size(size);
+            if (size < static_cast<bi::offset_t>(sizeof(SharedMemoryRingControl))) {
+                // The writer died before the segment was set up, or it is
+                // just setting it up now.
+                if (OwnerMayBeAlive(shm, nullptr)) return false;
+                bi::shared_memory_object::remove(name.c_str());
+                return true;
+            }
+            bi::mapped_region region(shm, bi::read_only);
+            const auto control =
+                static_cast<const SharedMemoryRingControl*>(region.get_address());
+            if (OwnerMayBeAlive(shm, control)) return false;
+            coral::log::Log(coral::log::debug, boost::format(
+                "Removing shared memory ring '%s', which was left behind by "
+                "a process that has terminated") % name);
+            const auto instanceID = control->instanceID.load();
+            for (std::uint32_t g = 0; g < MAX_GENERATIONS; ++g) {
+                bi::shared_memory_object::remove(
+                    DataSegmentName(name, instanceID, g).c_str());
+            }
+            bi::shared_memory_object::remove(name.c_str());
+            return true;
+        } catch (const bi::interprocess_exception&) {
+            // It may have been removed in the meantime.
+            return false;
+        }
+    }
+}
+
+
+// =============================================================================
+// class SharedMemoryRingWriter
+// =============================================================================
+
+
+SharedMemoryRingWriter::SharedMemoryRingWriter(
+    const std::string& name,
+    std::size_t initialCapacity,
+    std::size_t maxCapacity,
+    std::chrono::milliseconds stallTimeout)
+    : m_name(name)
+    , m_maxCapacity(maxCapacity)
+    , m_stallTimeout(stallTimeout)
+    , m_control(nullptr)
+    , m_instanceID(RandomInstanceID())
+    , m_oldestGeneration(0)
+    , m_start(0)
+    , m_capacity(0)
+    , m_buffer(nullptr)
+    , m_writePos(0)
+{
+    CORAL_INPUT_CHECK(!name.empty());
+    CORAL_INPUT_CHECK(initialCapacity > 0);
+    for (;;) {
+        try {
+            m_controlShm = bi::shared_memory_object(
+                bi::create_only, m_name.c_str(), bi::read_write);
+            break;
+        } catch (const bi::interprocess_exception& e) {
+            if (e.get_error_code() != bi::already_exists_error) throw;
+        }
+        if (!RemoveAbandonedRing(m_name)) {
+            throw std::runtime_error(
+                "Shared memory ring '" + m_name + "' is in use by another process");
+        }
+    }
+    try {
+#ifndef _WIN32
+        // Tell others that we're alive (see OwnerMayBeAlive()).
+        if (flock(m_controlShm.get_mapping_handle().handle, LOCK_EX | LOCK_NB) != 0) {
+            throw std::runtime_error(coral::error::ErrnoMessage(
+                "Failed to lock shared memory ring '" + m_name + "'", errno));
+        }
+#endif
+        m_controlShm.truncate(sizeof(SharedMemoryRingControl));
+        m_controlRegion = bi::mapped_region(m_controlShm, bi::read_write);
+
+        // The segment is zero-filled, which leaves all reader slots free.
+        m_control = new (m_controlRegion.get_address()) SharedMemoryRingControl;
+        m_control->version = RING_VERSION;
+        m_control->instanceID.store(m_instanceID);
+        m_control->ownerPID.store(ProcessID());
+        m_control->writePos.store(0);
+        NewGeneration(initialCapacity);
+        m_control->magic.store(RING_MAGIC, std::memory_order_release);
+    } catch (...) {
+        RemoveAll();
+        throw;
+    }
+}
+
+
+SharedMemoryRingWriter::~SharedMemoryRingWriter() noexcept
+{
+    RemoveAll();
+}
+
+
+bool SharedMemoryRingWriter::HasReaders() const noexcept
+{
+    for (const auto& slot : m_control->readers) {
+        const auto value = slot.load(std::memory_order_relaxed);
+        if (value != FREE_SLOT && value != EVICTED_SLOT) return true;
+    }
+    return false;
+}
+
+
+void SharedMemoryRingWriter::Write(
+    coral::model::StepID stepID,
+    const void* header,
+    std::size_t headerSize,
+    const void* body,
+    std::size_t bodySize)
+{
+    CORAL_INPUT_CHECK(headerSize + bodySize > 0);
+    const auto recordSize = AlignedSize(sizeof(RecordHeader) + headerSize + bodySize);
+    CORAL_INPUT_CHECK(recordSize <= std::numeric_limits<std::uint32_t>::max());
+    RemoveOldGenerations();
+
+    std::uint64_t offset = 0;
+    std::uint64_t padding = 0;
+    for (;;) {
+        offset = (m_writePos - m_start) % m_capacity;
+        padding = m_capacity - offset < recordSize ? m_capacity - offset : 0;
+        const auto end = m_writePos + padding + recordSize;
+        // Readers which are still in an older generation don't hold us back.
+        const auto readPos = std::max(ReadPosition(), m_start);
+        if (recordSize <= m_capacity / 2 && end - readPos <= m_capacity) break;
+        if (m_capacity < m_maxCapacity || recordSize > m_capacity / 2) {
+            NewGeneration(std::max(2 * m_capacity, 2 * recordSize));
+        } else {
+            WaitForReaders(end - m_capacity);
+        }
+    }
+
+    if (padding > 0) {
+        const RecordHeader pad = { static_cast<std::uint32_t>(padding), stepID, 0, 0 };
+        std::memcpy(m_buffer + offset, &pad, sizeof pad);
+        offset = 0;
+    }
+    const RecordHeader rh = {
+        static_cast<std::uint32_t>(recordSize),
+        stepID,
+        static_cast<std::uint32_t>(headerSize),
+        static_cast<std::uint32_t>(bodySize)
+    };
+    const auto record = m_buffer + offset;
+    std::memcpy(record, &rh, sizeof rh);
+    if (headerSize > 0) std::memcpy(record + sizeof rh, header, headerSize);
+    if (bodySize > 0) std::memcpy(record + sizeof rh + headerSize, body, bodySize);
+
+    // This must be sequentially consistent with the loads of the reader
+    // slots in ReadPosition(); see the SharedMemoryRingReader constructor.
+    m_writePos += padding + recordSize;
+    m_control->writePos.store(m_writePos);
+}
+
+
+std::uint64_t SharedMemoryRingWriter::ReadPosition() const noexcept
+{
+    auto pos = m_writePos;
+    for (const auto& slot : m_control->readers) {
+        const auto value = slot.load();
+        if (value != FREE_SLOT && value != EVICTED_SLOT) {
+            pos = std::min(pos, value - 1);
+        }
+    }
+    return pos;
+}
+
+
+void SharedMemoryRingWriter::NewGeneration(std::size_t minCapacity)
+{
+    const auto generation = static_cast<std::uint32_t>(m_data.size());
+    if (generation == MAX_GENERATIONS) {
+        throw std::runtime_error(
+            "Shared memory ring '" + m_name + "' cannot grow any further");
+    }
+    const auto capacity = AlignedSize(minCapacity);
+    bi::shared_memory_object shm(
+        bi::create_only,
+        DataSegmentName(m_name, m_instanceID, generation).c_str(),
+        bi::read_write);
+    shm.truncate(static_cast<bi::offset_t>(capacity));
+    auto region = std::make_unique<bi::mapped_region>(shm, bi::read_write);
+    m_buffer = static_cast<char*>(region->get_address());
+    m_data.push_back(std::move(region));
+    m_start = m_writePos;
+    m_capacity = capacity;
+
+    // Readers look up the new generation's position and size after they
+    // see the updated generation number.
+    auto& g = m_control->generations[generation];
+    g.start.store(m_start, std::memory_order_relaxed);
+    g.capacity.store(m_capacity, std::memory_order_relaxed);
+    m_control->generation.store(generation, std::memory_order_release);
+}
+
+
+void SharedMemoryRingWriter::WaitForReaders(std::uint64_t neededPosition)
+{
+    const auto deadline = std::chrono::steady_clock::now() + m_stallTimeout;
+    auto sleepTime = std::chrono::microseconds(1);
+    while (ReadPosition() < neededPosition) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            for (auto& slot : m_control->readers) {
+                auto value = slot.load();
+                if (value != FREE_SLOT && value != EVICTED_SLOT
+                        && value - 1 < neededPosition
+                        && slot.compare_exchange_strong(value, EVICTED_SLOT)) {
+                    coral::log::Log(coral::log::warning, boost::format(
+                        "Evicted a reader from shared memory ring '%s' "
+                        "for falling too far behind") % m_name);
+                }
+            }
+            continue;
+        }
+        std::this_thread::sleep_for(sleepTime);
+        sleepTime = std::min(2 * sleepTime, std::chrono::microseconds(1000));
+    }
+}
+
+
+void SharedMemoryRingWriter::RemoveOldGenerations() noexcept
+{
+    const auto current = static_cast<std::uint32_t>(m_data.size() - 1);
+    if (m_oldestGeneration == current) return;
+    const auto readPos = ReadPosition();
+    while (m_oldestGeneration < current
+            && readPos >= m_control->generations[m_oldestGeneration + 1]
+                .start.load(std::memory_order_relaxed)) {
+        m_data[m_oldestGeneration].reset();
+        bi::shared_memory_object::remove(
+            DataSegmentName(m_name, m_instanceID, m_oldestGeneration).c_str());
+        ++m_oldestGeneration;
+    }
+}
+
+
+void SharedMemoryRingWriter::RemoveAll() noexcept
+{
+    // Readers which still have the segments mapped may keep using them,
+    // but no-one else will find them.
+    bi::shared_memory_object::remove(m_name.c_str());
+    for (std::uint32_t g = 0; g < MAX_GENERATIONS; ++g) {
+        bi::shared_memory_object::remove(
+            DataSegmentName(m_name, m_instanceID, g).c_str());
+    }
+}
+
+
+// =============================================================================
+// class SharedMemoryRingReader
+// =============================================================================
+
+
+SharedMemoryRingReader::SharedMemoryRingReader(const std::string& name)
+    : m_name(name)
+    , m_control(nullptr)
+    , m_slot(-1)
+    , m_generation(0)
+    , m_start(0)
+    , m_capacity(0)
+    , m_buffer(nullptr)
+    , m_committed(0)
+    , m_cursor(0)
+{
+    try {
+        bi::shared_memory_object shm(bi::open_only, m_name.c_str(), bi::read_write);
+        m_controlRegion = bi::mapped_region(shm, bi::read_write);
+    } catch (const bi::interprocess_exception& e) {
+        throw std::runtime_error(
+            "Cannot open shared memory ring '" + m_name + "': " + e.what());
+    }
+    m_control = static_cast<SharedMemoryRingControl*>(m_controlRegion.get_address());
+    if (m_controlRegion.get_size() < sizeof(SharedMemoryRingControl)
+            || m_control->magic.load(std::memory_order_acquire) != RING_MAGIC
+            || m_control->version != RING_VERSION) {
+        throw std::runtime_error(
+            "Shared memory ring '" + m_name + "' is not ready or incompatible");
+    }
+
+    // The generation is read first, so it can't be later than the one
+    // which contains our starting position.  MapGeneration() catches up.
+    m_generation = m_control->generation.load(std::memory_order_acquire);
+    auto pos = m_control->writePos.load();
+    for (int i = 0; i < SharedMemoryRingWriter::MAX_READERS; ++i) {
+        auto expected = FREE_SLOT;
+        if (m_control->readers[i].compare_exchange_strong(expected, pos + 1)) {
+            m_slot = i;
+            break;
+        }
+    }
+    if (m_slot < 0) {
+        throw std::runtime_error(
+            "Shared memory ring '" + m_name + "' has too many readers");
+    }
+
+    // The writer may have checked the reader slots for the record it is
+    // writing now (or has just written) before we claimed ours, in which
+    // case that record may overwrite data at the position we started from.
+    // From here on, the writer will see our slot, so we simply start after
+    // whatever it had published by now.
+    const auto newPos = m_control->writePos.load();
+    if (newPos != pos) {
+        auto expected = pos + 1;
+        m_control->readers[m_slot].compare_exchange_strong(expected, newPos + 1);
+        pos = newPos;
+    }
+    m_committed = pos;
+    m_cursor = pos;
+}
+
+
+SharedMemoryRingReader::~SharedMemoryRingReader() noexcept
+{
+    m_control->readers[m_slot].store(FREE_SLOT);
+}
+
+
+bool SharedMemoryRingReader::HasData() const noexcept
+{
+    return m_control->writePos.load(std::memory_order_acquire) != m_cursor;
+}
+
+
+bool SharedMemoryRingReader::Next(Message& message)
+{
+    auto& slot = m_control->readers[m_slot];
+    if (m_cursor != m_committed) {
+        // Release the previous message to the writer.
+        auto expected = m_committed + 1;
+        if (!slot.compare_exchange_strong(expected, m_cursor + 1)) {
+            assert(expected == EVICTED_SLOT);
+            throw std::runtime_error(
+                "Fell too far behind the writer of shared memory ring '"
+                + m_name + "'");
+        }
+        m_committed = m_cursor;
+    } else if (slot.load(std::memory_order_relaxed) == EVICTED_SLOT) {
+        throw std::runtime_error(
+            "Fell too far behind the writer of shared memory ring '"
+            + m_name + "'");
+    }
+
+    const auto writePos = m_control->writePos.load(std::memory_order_acquire);
+    while (m_cursor != writePos) {
+        MapGeneration();
+        const auto offset = (m_cursor - m_start) % m_capacity;
+        RecordHeader rh;
+        std::memcpy(&rh, m_buffer + offset, sizeof rh);
+        if (rh.size < sizeof rh
+                || rh.size > m_capacity - offset
+                || sizeof rh + rh.headerSize + rh.bodySize > rh.size) {
+            throw std::runtime_error(
+                "Shared memory ring '" + m_name + "' is corrupt");
+        }
+        m_cursor += rh.size;
+        if (rh.headerSize == 0 && rh.bodySize == 0) continue; // padding
+
+        message.stepID = rh.stepID;
+        message.header = m_buffer + offset + sizeof rh;
+        message.headerSize = rh.headerSize;
+        message.body = message.header + rh.headerSize;
+        message.bodySize = rh.bodySize;
+        return true;
+    }
+    return false;
+}
+
+
+void SharedMemoryRingReader::MapGeneration()
+{
+    const auto latest = m_control->generation.load(std::memory_order_acquire);
+    auto generation = m_generation;
+    while (generation < latest
+            && m_cursor >= m_control->generations[generation + 1]
+                .start.load(std::memory_order_relaxed)) {
+        ++generation;
+    }
+    if (m_buffer && generation == m_generation) return;
+
+    const auto segmentName = DataSegmentName(
+        m_name, m_control->instanceID.load(std::memory_order_relaxed), generation);
+    try {
+        bi::shared_memory_object shm(bi::open_only, segmentName.c_str(), bi::read_only);
+        m_data = bi::mapped_region(shm, bi::read_only);
+    } catch (const bi::interprocess_exception& e) {
+        throw std::runtime_error(
+            "Cannot open shared memory segment '" + segmentName + "': " + e.what());
+    }
+    m_generation = generation;
+    m_start = m_control->generations[generation].start.load(std::memory_order_relaxed);
+    m_capacity = m_control->generations[generation].capacity.load(std::memory_order_relaxed);
+    m_buffer = static_cast<const char*>(m_data.get_address());
+    if (m_data.get_size() < m_capacity) {
+        throw std::runtime_error(
+            "Shared memory segment '" + segmentName + "' is too small");
+    }
+}
+
+
+}} // namespace
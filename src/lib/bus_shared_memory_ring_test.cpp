@@ -0,0 +1,201 @@
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#   include <sys/types.h>
+#   include <sys/wait.h>
+#   include <unistd.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <coral/bus/shared_memory_ring.hpp>
+
+
+namespace
+{
+    std::string RingName()
+    {
+        return std::string("coral-test-")
+            + ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    }
+
+    void Write(
+        coral::bus::SharedMemoryRingWriter& writer,
+        coral::model::StepID stepID,
+        const std::string& header,
+        const std::string& body)
+    {
+        writer.Write(stepID, header.data(), header.size(), body.data(), body.size());
+    }
+
+    std::string Header(const coral::bus::SharedMemoryRingReader::Message& m)
+    {
+        return std::string(m.header, m.headerSize);
+    }
+
+    std::string Body(const coral::bus::SharedMemoryRingReader::Message& m)
+    {
+        return std::string(m.body, m.bodySize);
+    }
+}
+
+
+TEST(coral_bus, SharedMemoryRing)
+{
+    EXPECT_THROW(coral::bus::SharedMemoryRingReader{RingName()}, std::runtime_error);
+
+    coral::bus::SharedMemoryRingWriter writer(RingName(), 4096);
+    EXPECT_FALSE(writer.HasReaders());
+    // Nobody will read this.
+    Write(writer, 0, "h0", "b0");
+
+    coral::bus::SharedMemoryRingReader reader1(RingName());
+    EXPECT_TRUE(writer.HasReaders());
+    EXPECT_FALSE(reader1.HasData());
+    coral::bus::SharedMemoryRingReader::Message m;
+    EXPECT_FALSE(reader1.Next(m));
+
+    Write(writer, 1, "h1", "b1");
+    Write(writer, 2, "", "b2");
+    EXPECT_TRUE(reader1.HasData());
+    coral::bus::SharedMemoryRingReader reader2(RingName());
+    Write(writer, 3, "h3", "");
+
+    ASSERT_TRUE(reader1.Next(m));
+    EXPECT_EQ(1, m.stepID);
+    EXPECT_EQ("h1", Header(m));
+    EXPECT_EQ("b1", Body(m));
+    ASSERT_TRUE(reader1.Next(m));
+    EXPECT_EQ(2, m.stepID);
+    EXPECT_EQ("", Header(m));
+    EXPECT_EQ("b2", Body(m));
+    ASSERT_TRUE(reader1.Next(m));
+    EXPECT_EQ(3, m.stepID);
+    EXPECT_EQ("h3", Header(m));
+    EXPECT_EQ("", Body(m));
+    EXPECT_FALSE(reader1.Next(m));
+    EXPECT_FALSE(reader1.HasData());
+
+    // The second reader only sees what was written after it was attached.
+    ASSERT_TRUE(reader2.Next(m));
+    EXPECT_EQ(3, m.stepID);
+    EXPECT_FALSE(reader2.Next(m));
+}
+
+
+TEST(coral_bus, SharedMemoryRingGrows)
+{
+    coral::bus::SharedMemoryRingWriter writer(RingName(), 1024);
+    coral::bus::SharedMemoryRingReader reader(RingName());
+
+    // Fill the ring several times over without reading anything, and with
+    // a message which is larger than the initial capacity.  Nothing may be
+    // lost or overwritten.
+    const auto bigBody = std::string(5000, 'x');
+    for (int i = 0; i < 100; ++i) {
+        Write(writer, i, "header", i == 50 ? bigBody : std::to_string(i));
+    }
+    coral::bus::SharedMemoryRingReader::Message m;
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_TRUE(reader.Next(m));
+        EXPECT_EQ(i, m.stepID);
+        EXPECT_EQ("header", Header(m));
+        EXPECT_EQ(i == 50 ? bigBody : std::to_string(i), Body(m));
+    }
+    EXPECT_FALSE(reader.Next(m));
+
+    // Carry on in the newest generation.
+    Write(writer, 100, "header", "100");
+    ASSERT_TRUE(reader.Next(m));
+    EXPECT_EQ(100, m.stepID);
+    EXPECT_FALSE(reader.Next(m));
+}
+
+
+TEST(coral_bus, SharedMemoryRingEvictsStalledReader)
+{
+    coral::bus::SharedMemoryRingWriter writer(
+        RingName(), 1024, 1024, std::chrono::milliseconds(10));
+    coral::bus::SharedMemoryRingReader stalled(RingName());
+    const auto body = std::string(100, 'x');
+    for (int i = 0; i < 20; ++i) Write(writer, i, "header", body);
+    coral::bus::SharedMemoryRingReader::Message m;
+    EXPECT_THROW(stalled.Next(m), std::runtime_error);
+    EXPECT_FALSE(writer.HasReaders());
+}
+
+
+TEST(coral_bus, SharedMemoryRingConcurrent)
+{
+    const int messageCount = 100000;
+    coral::bus::SharedMemoryRingWriter writer(RingName(), 4096, 16384);
+    coral::bus::SharedMemoryRingReader reader1(RingName());
+    coral::bus::SharedMemoryRingReader reader2(RingName());
+
+    const auto read = [messageCount] (coral::bus::SharedMemoryRingReader& reader)
+    {
+        coral::bus::SharedMemoryRingReader::Message m;
+        for (int i = 0; i < messageCount; ) {
+            if (!reader.Next(m)) continue;
+            ASSERT_EQ(i, m.stepID);
+            ASSERT_EQ(sizeof i, m.bodySize);
+            int value = -1;
+            std::memcpy(&value, m.body, sizeof value);
+            ASSERT_EQ(i, value);
+            ++i;
+        }
+    };
+    std::thread thread1(read, std::ref(reader1));
+    std::thread thread2(read, std::ref(reader2));
+    for (int i = 0; i < messageCount; ++i) {
+        writer.Write(i, "h", 1, &i, sizeof i);
+    }
+    thread1.join();
+    thread2.join();
+}
+
+
+TEST(coral_bus, SharedMemoryRingInUse)
+{
+    // A ring whose writer is alive is left alone.
+    coral::bus::SharedMemoryRingWriter writer(RingName(), 4096);
+    coral::bus::SharedMemoryRingReader reader(RingName());
+    EXPECT_THROW(
+        coral::bus::SharedMemoryRingWriter(RingName(), 4096),
+        std::runtime_error);
+    Write(writer, 1, "h1", "b1");
+    coral::bus::SharedMemoryRingReader::Message m;
+    ASSERT_TRUE(reader.Next(m));
+    EXPECT_EQ("b1", Body(m));
+}
+
+
+#ifndef _WIN32
+TEST(coral_bus, SharedMemoryRingAbandoned)
+{
+    // A process which dies without removing its ring.
+    const auto pid = fork();
+    ASSERT_NE(-1, pid);
+    if (pid == 0) {
+        new coral::bus::SharedMemoryRingWriter(RingName(), 4096);
+        _exit(0);
+    }
+    int status = 0;
+    ASSERT_EQ(pid, waitpid(pid, &status, 0));
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_NO_THROW(coral::bus::SharedMemoryRingReader{RingName()});
+
+    // The ring is taken over by the next writer.
+    coral::bus::SharedMemoryRingWriter writer(RingName(), 4096);
+    coral::bus::SharedMemoryRingReader reader(RingName());
+    Write(writer, 1, "h1", "b1");
+    coral::bus::SharedMemoryRingReader::Message m;
+    ASSERT_TRUE(reader.Next(m));
+    EXPECT_EQ("b1", Body(m));
+}
+#endif
@@ -6,8 +6,10 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 */
 #include <coral/bus/slave_agent.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <limits>
+#include <stdexcept>
 #include <utility>
 
 #include <coral/error.hpp>
@@ -45,6 +47,34 @@ namespace
     }
 
     const size_t DATA_HEADER_SIZE = 4;
+
+    // The limits of the interval with which RunSteps() polls for inputs
+    // which arrive through shared memory (see
+    // SlaveAgent::Connections::HasLocalPeers()).  The interval starts at
+    // the minimum and is doubled for every poll that comes up empty.
+    const auto MIN_LOCAL_INPUT_POLL_INTERVAL = std::chrono::microseconds(20);
+    const auto MAX_LOCAL_INPUT_POLL_INTERVAL = std::chrono::microseconds(1000);
+
+    // How long SET_PEERS and SET_VARS wait for new peer connections to be
+    // established.  The master is waiting for our reply in the meantime, so
+    // this should be well below any reasonable command timeout.
+    const auto PEER_CONNECT_TIMEOUT = std::chrono::milliseconds(200);
+
+    // Returns an endpoint for the command subscriber, which is on the same
+    // network interface(s) as `controlEndpoint` but uses an ephemeral port.
+    coral::net::Endpoint CommandSubEndpoint(
+        const coral::net::Endpoint& controlEndpoint)
+    {
+        if (controlEndpoint.Transport() == "tcp") {
+            auto ep = coral::net::ip::Endpoint{controlEndpoint.Address()};
+            ep.SetPort_("*");
+            return ep.ToEndpoint("tcp");
+        } else {
+            return coral::net::Endpoint{
+                controlEndpoint.Transport(),
+                controlEndpoint.Address() + ".commands"};
+        }
+    }
 }
 
 
@@ -61,11 +91,15 @@ SlaveAgent::SlaveAgent(
     const coral::net::Endpoint& dataPubEndpoint,
     std::chrono::milliseconds masterInactivityTimeout)
     : m_stateHandler(&SlaveAgent::NotConnectedHandler),
+      m_reactor(reactor),
       m_slaveInstance(slaveInstance),
       m_masterInactivityTimeout(reactor, masterInactivityTimeout),
       m_variableRecvTimeout(std::chrono::seconds(1)),
       m_id(coral::model::INVALID_SLAVE_ID),
-      m_currentStepID(coral::model::INVALID_STEP_ID)
+      m_currentStepID(coral::model::INVALID_STEP_ID),
+      m_maxProtocolVersion(coral::protocol::execution::MAX_PROTOCOL_VERSION),
+      m_protocolVersion(0),
+      m_batchedData(false)
 {
     m_control.Bind(controlEndpoint);
     CORAL_LOG_TRACE("Slave bound to control endpoint: " + BoundControlEndpoint().URL());
@@ -73,35 +107,21 @@ SlaveAgent::SlaveAgent(
     m_publisher.Bind(dataPubEndpoint);
     CORAL_LOG_TRACE("Slave bound to data publisher endpoint: " + BoundDataPubEndpoint().URL());
 
+    m_commandSub.Bind(CommandSubEndpoint(controlEndpoint));
+    CORAL_LOG_TRACE("Slave bound to command subscriber endpoint: "
+        + m_commandSub.BoundEndpoint().URL());
+
     reactor.AddSocket(
         m_control.Socket(),
         [this](coral::net::Reactor& r, zmq::socket_t& s) {
             assert(&s == &m_control.Socket());
-            m_masterInactivityTimeout.Reset();
-            std::vector<zmq::message_t> msg;
-            try {
-                m_control.Receive(msg);
-                RequestReply(msg);
-            } catch (const coral::bus::Shutdown&) {
-                r.Stop();
-                return;
-            } catch (const zmq::error_t&) {
-                throw; // Not much we can do about this...
-            } catch (const std::runtime_error& e) {
-                coral::protocol::execution::CreateFatalErrorMessage(
-                    msg,
-                    coralproto::execution::ErrorInfo::UNSPECIFIED_ERROR,
-                    e.what());
-                m_control.Send(msg);
-                throw;
-            }
-#ifdef CORAL_LOG_TRACE_ENABLED
-            const auto replyType = static_cast<coralproto::execution::MessageType>(
-                coral::protocol::execution::ParseMessageType(msg.front()));
-#endif
-            m_control.Send(msg);
-            CORAL_LOG_TRACE(boost::format("Sent %s")
-                % coralproto::execution::MessageType_Name(replyType));
+            HandleRequest(r, false);
+        });
+    reactor.AddSocket(
+        m_commandSub.Socket(),
+        [this](coral::net::Reactor& r, zmq::socket_t& s) {
+            assert(&s == &m_commandSub.Socket());
+            HandleRequest(r, true);
         });
 }
 
@@ -118,6 +138,71 @@ coral::net::Endpoint SlaveAgent::BoundDataPubEndpoint() const
 }
 
 
+void SlaveAgent::SetSpinBudget(std::chrono::microseconds spinBudget) noexcept
+{
+    m_connections.SetSpinBudget(spinBudget);
+}
+
+
+const coral::net::BusyPollStats& SlaveAgent::PollStats() const noexcept
+{
+    return m_connections.PollStats();
+}
+
+
+void SlaveAgent::SetMaxProtocolVersion(int version)
+{
+    CORAL_INPUT_CHECK(version >= 0
+        && version <= coral::protocol::execution::MAX_PROTOCOL_VERSION);
+    m_maxProtocolVersion = version;
+}
+
+
+void SlaveAgent::HandleRequest(coral::net::Reactor& reactor, bool broadcast)
+{
+    m_masterInactivityTimeout.Reset();
+    std::vector<zmq::message_t> msg;
+    // Replies to broadcast commands are sent through the control socket too,
+    // even though there is no request on it to reply to.
+    const auto sendReply = [&] () {
+        if (broadcast) m_control.SendToLastClient(msg);
+        else           m_control.Send(msg);
+    };
+    try {
+        if (broadcast) {
+            if (!m_commandSub.Receive(msg)) {
+                CORAL_LOG_TRACE("Ignoring stale broadcast command");
+                return;
+            }
+        } else {
+            m_control.Receive(msg);
+        }
+        RequestReply(msg);
+    } catch (const coral::bus::Shutdown&) {
+        reactor.Stop();
+        return;
+    } catch (const zmq::error_t&) {
+        throw; // Not much we can do about this...
+    } catch (const std::runtime_error& e) {
+        coral::protocol::execution::CreateFatalErrorMessage(
+            msg,
+            coralproto::execution::ErrorInfo::UNSPECIFIED_ERROR,
+            e.what());
+        sendReply();
+        throw;
+    }
+    // RUN and INTERRUPT are answered later, when the run is over.
+    if (msg.empty()) return;
+#ifdef CORAL_LOG_TRACE_ENABLED
+    const auto replyType = static_cast<coralproto::execution::MessageType>(
+        coral::protocol::execution::ParseMessageType(msg.front()));
+#endif
+    sendReply();
+    CORAL_LOG_TRACE(boost::format("Sent %s")
+        % coralproto::execution::MessageType_Name(replyType));
+}
+
+
 void SlaveAgent::RequestReply(std::vector<zmq::message_t>& msg)
 {
     (this->*m_stateHandler)(msg);
@@ -131,7 +216,29 @@ void SlaveAgent::NotConnectedHandler(std::vector<zmq::message_t>& msg)
         throw std::runtime_error("Master required unsupported protocol");
     }
     CORAL_LOG_TRACE("Received HELLO");
-    coral::protocol::execution::CreateHelloMessage(msg, 0);
+    // A master which supports newer protocol versions tells us which is the
+    // highest one, and we pick the highest one we have in common.
+    m_protocolVersion = 0;
+    if (msg.size() > 1) {
+        coralproto::execution::HelloData helloData;
+        coral::protobuf::ParseFromFrame(msg[1], helloData);
+        if (helloData.has_max_protocol_version()) {
+            m_protocolVersion = static_cast<int>(std::min<google::protobuf::uint32>(
+                helloData.max_protocol_version(),
+                m_maxProtocolVersion));
+        }
+    }
+    CORAL_LOG_DEBUG(boost::format("Using protocol version %d") % m_protocolVersion);
+    if (m_protocolVersion >= 6) {
+        coralproto::execution::HelloReplyData helloReplyData;
+        helloReplyData.set_command_sub_endpoint(
+            m_commandSub.BoundEndpoint().URL());
+        coral::protocol::execution::CreateHelloMessage(
+            msg, static_cast<uint16_t>(m_protocolVersion), helloReplyData);
+    } else {
+        coral::protocol::execution::CreateHelloMessage(
+            msg, static_cast<uint16_t>(m_protocolVersion));
+    }
     m_stateHandler = &SlaveAgent::ConnectedHandler;
 }
 
@@ -150,6 +257,7 @@ void SlaveAgent::ConnectedHandler(std::vector<zmq::message_t>& msg)
         % data.start_time()
         % (data.has_stop_time() ? data.stop_time() : std::numeric_limits<double>::infinity()));
     m_id = data.slave_id();
+    m_commandSub.Identify(m_id);
     m_slaveInstance.Setup(
         data.slave_name(),
         data.execution_name(),
@@ -158,6 +266,20 @@ void SlaveAgent::ConnectedHandler(std::vector<zmq::message_t>& msg)
         false,
         1.0 /* not used */);
 
+    m_outputTypes.clear();
+    for (const auto& varInfo : m_slaveInstance.TypeDescription().Variables()) {
+        if (varInfo.Causality() != coral::model::OUTPUT_CAUSALITY) continue;
+        m_outputTypes.insert(std::make_pair(varInfo.ID(), varInfo.DataType()));
+    }
+
+    // Older masters don't tell us which variables to publish, so in that
+    // case we publish all outputs.
+    m_publishedOutputs.clear();
+    if (m_protocolVersion < 3) {
+        m_publishedOutputs.insert(m_outputTypes.begin(), m_outputTypes.end());
+    }
+    UpdatePublishedOutputs();
+
     if (data.has_variable_recv_timeout_ms()) {
         m_variableRecvTimeout =
             std::chrono::milliseconds(data.variable_recv_timeout_ms());
@@ -172,21 +294,9 @@ void SlaveAgent::ReadyHandler(std::vector<zmq::message_t>& msg)
 {
     CORAL_LOG_TRACE("READY state: incoming message");
     switch (NormalMessageType(msg)) {
-        case coralproto::execution::MSG_STEP: {
-            if (msg.size() != 2) {
-                throw coral::error::ProtocolViolationException(
-                    "Wrong number of frames in STEP message");
-            }
-            coralproto::execution::StepData stepData;
-            coral::protobuf::ParseFromFrame(msg[1], stepData);
-            if (Step(stepData)) {
-                coral::protocol::execution::CreateMessage(msg, coralproto::execution::MSG_STEP_OK);
-                m_stateHandler = &SlaveAgent::PublishedHandler;
-            } else {
-                coral::protocol::execution::CreateMessage(msg, coralproto::execution::MSG_STEP_FAILED);
-                m_stateHandler = &SlaveAgent::StepFailedHandler;
-            }
-            break; }
+        case coralproto::execution::MSG_STEP:
+            HandleStep(msg);
+            break;
         case coralproto::execution::MSG_SET_VARS:
             HandleSetVars(msg);
             break;
@@ -199,6 +309,15 @@ void SlaveAgent::ReadyHandler(std::vector<zmq::message_t>& msg)
         case coralproto::execution::MSG_RESEND_VARS:
             HandleResendVars(msg);
             break;
+        case coralproto::execution::MSG_RUN:
+            if (m_protocolVersion < 7) InvalidReplyFromMaster();
+            HandleRun(msg, false);
+            break;
+        case coralproto::execution::MSG_INTERRUPT:
+            // The run ended before the INTERRUPT arrived.
+            if (m_protocolVersion < 7) InvalidReplyFromMaster();
+            msg.clear();
+            break;
         default:
             InvalidReplyFromMaster();
     }
@@ -208,23 +327,51 @@ void SlaveAgent::ReadyHandler(std::vector<zmq::message_t>& msg)
 void SlaveAgent::PublishedHandler(std::vector<zmq::message_t>& msg)
 {
     CORAL_LOG_TRACE("STEP OK state: incoming message");
-    EnforceMessageType(msg, coralproto::execution::MSG_ACCEPT_STEP);
-    // TODO: Use a different timeout here?
-    if (!m_connections.Update(m_slaveInstance, m_currentStepID, m_variableRecvTimeout)) {
-        throw std::runtime_error("Timeout waiting for variable values from other slaves");
+    const auto msgType = NormalMessageType(msg);
+    if (msgType == coralproto::execution::MSG_ACCEPT_STEP) {
+        AcceptStep();
+        coral::protocol::execution::CreateMessage(msg, coralproto::execution::MSG_READY);
+        m_stateHandler = &SlaveAgent::ReadyHandler;
+    } else if (msgType == coralproto::execution::MSG_STEP
+            && m_protocolVersion >= 5) {
+        // Accept the previous step and perform the next one in one go.
+        AcceptStep();
+        HandleStep(msg);
+    } else if (msgType == coralproto::execution::MSG_RUN
+            && m_protocolVersion >= 7) {
+        HandleRun(msg, true);
+    } else if (msgType == coralproto::execution::MSG_INTERRUPT
+            && m_protocolVersion >= 7) {
+        // The run ended before the INTERRUPT arrived.
+        msg.clear();
+    } else {
+        InvalidReplyFromMaster();
     }
-    coral::protocol::execution::CreateMessage(msg, coralproto::execution::MSG_READY);
-    m_stateHandler = &SlaveAgent::ReadyHandler;
+}
+
+
+void SlaveAgent::RunningHandler(std::vector<zmq::message_t>& msg)
+{
+    CORAL_LOG_TRACE("RUNNING state: incoming message");
+    EnforceMessageType(msg, coralproto::execution::MSG_INTERRUPT);
+    m_run.interrupted = true;
+    ScheduleContinueRun();
+    msg.clear();
 }
 
 
 void SlaveAgent::StepFailedHandler(std::vector<zmq::message_t>& msg)
 {
     CORAL_LOG_TRACE("STEP FAILED state: incoming message");
-    EnforceMessageType(msg, coralproto::execution::MSG_TERMINATE);
-    // We never get here, because EnforceMessageType() always throws either
-    // Shutdown or ProtocolViolationException.
-    assert (false);
+    // Only TERMINATE is allowed here, and NormalMessageType() throws
+    // Shutdown for that.  The exception is an INTERRUPT which arrives after
+    // a run has failed, which we ignore.
+    if (NormalMessageType(msg) == coralproto::execution::MSG_INTERRUPT
+            && m_protocolVersion >= 7) {
+        msg.clear();
+        return;
+    }
+    InvalidReplyFromMaster();
 }
 
 
@@ -282,6 +429,11 @@ void SlaveAgent::HandleSetVars(std::vector<zmq::message_t>& msg)
     coralproto::execution::SetVarsData data;
     coral::protobuf::ParseFromFrame(msg[1], data);
 
+    if (m_protocolVersion >= 4) {
+        for (const auto& peer : data.connect_peer()) {
+            m_connections.ConnectTo(coral::net::Endpoint{peer});
+        }
+    }
     bool allGood = true;
     for (const auto& varSetting : data.variable()) {
         // TODO: Catch and report errors
@@ -297,10 +449,38 @@ void SlaveAgent::HandleSetVars(std::vector<zmq::message_t>& msg)
             }
         }
         if (varSetting.has_connected_output()) {
+            const auto delay = m_protocolVersion >= 8
+                ? varSetting.connection_delay()
+                : 0;
+            if (delay < 0) {
+                throw coral::error::ProtocolViolationException(
+                    "Negative connection delay in SET_VARS message");
+            }
             m_connections.Couple(
                 coral::protocol::FromProto(varSetting.connected_output()),
-                varSetting.variable_id());
+                varSetting.variable_id(),
+                delay);
+        }
+    }
+    if (m_protocolVersion >= 3) {
+        for (const auto id : data.start_publishing()) {
+            const auto output = m_outputTypes.find(id);
+            if (output == m_outputTypes.end()) {
+                throw coral::error::ProtocolViolationException(
+                    "Master requested publishing of nonexistent output variable");
+            }
+            m_publishedOutputs.insert(*output);
+        }
+        for (const auto id : data.stop_publishing()) {
+            m_publishedOutputs.erase(id);
         }
+        UpdatePublishedOutputs();
+    }
+    if (m_protocolVersion >= 4) {
+        for (const auto& peer : data.disconnect_peer()) {
+            m_connections.DisconnectFrom(coral::net::Endpoint{peer});
+        }
+        if (data.connect_peer_size() > 0) WaitForPeers();
     }
     CORAL_LOG_TRACE("Done setting/connecting variables");
     if (allGood) {
@@ -330,21 +510,42 @@ void SlaveAgent::HandleSetPeers(std::vector<zmq::message_t>& msg)
         m_endpoints.emplace_back(peer);
     }
     m_connections.Connect(m_endpoints.data(), m_endpoints.size());
+    WaitForPeers();
+    m_batchedData = m_protocolVersion >= 1 && data.batched_data();
+    m_publisher.SetEncoding(
+        m_protocolVersion >= 2
+            && data.variable_encoding() == coralproto::execution::SetPeersData::BINARY
+        ? BINARY_VARIABLE_ENCODING
+        : PROTOBUF_VARIABLE_ENCODING);
     CORAL_LOG_TRACE("Done reconnecting to peers");
     coral::protocol::execution::CreateMessage(msg, coralproto::execution::MSG_READY);
 }
 
 
+void SlaveAgent::WaitForPeers()
+{
+    // If this times out, the values which are published before the
+    // connections are up may be lost.  The master primes the slaves with
+    // RESEND_VARS before stepping, and that will then time out and be
+    // retried, so all we lose is time.
+    if (!m_connections.WaitForPeers(PEER_CONNECT_TIMEOUT)) {
+        CORAL_LOG_DEBUG("Timeout waiting for connections to peers");
+    }
+}
+
+
 void SlaveAgent::HandleResendVars(std::vector<zmq::message_t>& msg)
 {
     // Publish all own variable values
     PublishAll();
 
-    // Wait for all values from others
+    // Wait for all values from others.  Connection delays are ignored here,
+    // so that resent values take effect immediately (e.g. as initial values).
     CORAL_LOG_TRACE(
         boost::format("Waiting for variable values (timeout = %d ms)")
         % m_variableRecvTimeout.count());
-    if (m_connections.Update(m_slaveInstance, m_currentStepID, m_variableRecvTimeout)) {
+    if (m_connections.Update(
+            m_slaveInstance, m_currentStepID, m_variableRecvTimeout, true)) {
         coral::protocol::execution::CreateMessage(msg, coralproto::execution::MSG_READY);
     } else {
         CORAL_LOG_TRACE("RESEND_VARS timed out");
@@ -357,36 +558,243 @@ void SlaveAgent::HandleResendVars(std::vector<zmq::message_t>& msg)
 }
 
 
-namespace
+void SlaveAgent::HandleStep(std::vector<zmq::message_t>& msg)
 {
-    coral::model::ScalarValue GetVariable(
-        const coral::slave::Instance& slave,
-        const coral::model::VariableDescription& variable)
-    {
-        switch (variable.DataType()) {
-            case coral::model::REAL_DATATYPE:
-                return slave.GetRealVariable(variable.ID());
-            case coral::model::INTEGER_DATATYPE:
-                return slave.GetIntegerVariable(variable.ID());
-            case coral::model::BOOLEAN_DATATYPE:
-                return slave.GetBooleanVariable(variable.ID());
-            case coral::model::STRING_DATATYPE:
-                return slave.GetStringVariable(variable.ID());
-            default:
-                assert (!"Variable has unknown data type");
-                return coral::model::ScalarValue();
+    if (msg.size() != 2) {
+        throw coral::error::ProtocolViolationException(
+            "Wrong number of frames in STEP message");
+    }
+    coralproto::execution::StepData stepData;
+    coral::protobuf::ParseFromFrame(msg[1], stepData);
+    if (Step(stepData.step_id(), stepData.timepoint(), stepData.stepsize())) {
+        coral::protocol::execution::CreateMessage(msg, coralproto::execution::MSG_STEP_OK);
+        m_stateHandler = &SlaveAgent::PublishedHandler;
+    } else {
+        coral::protocol::execution::CreateMessage(msg, coralproto::execution::MSG_STEP_FAILED);
+        m_stateHandler = &SlaveAgent::StepFailedHandler;
+    }
+}
+
+
+void SlaveAgent::AcceptStep()
+{
+    // TODO: Use a different timeout here?
+    if (!m_connections.Update(m_slaveInstance, m_currentStepID, m_variableRecvTimeout)) {
+        throw std::runtime_error("Timeout waiting for variable values from other slaves");
+    }
+}
+
+
+void SlaveAgent::HandleRun(std::vector<zmq::message_t>& msg, bool inputsPending)
+{
+    if (msg.size() != 2) {
+        throw coral::error::ProtocolViolationException(
+            "Wrong number of frames in RUN message");
+    }
+    coralproto::execution::RunData runData;
+    coral::protobuf::ParseFromFrame(msg[1], runData);
+    if (runData.first_step_id() <= m_currentStepID
+            || runData.last_step_id() < runData.first_step_id() - 1
+            || runData.stepsize() < 0.0
+            || runData.progress_interval() < 0) {
+        throw coral::error::ProtocolViolationException("Invalid RUN parameters");
+    }
+    CORAL_LOG_DEBUG(boost::format("Running time steps %d through %d")
+        % runData.first_step_id() % runData.last_step_id());
+
+    m_run = Run{};
+    m_run.firstStepID = runData.first_step_id();
+    m_run.lastStepID = runData.last_step_id();
+    m_run.startTime = runData.start_time();
+    m_run.stepSize = runData.stepsize();
+    m_run.progressInterval = runData.progress_interval();
+    m_run.inputsPending = inputsPending;
+
+    // From now on, we're driven by incoming variable values rather than by
+    // the master.  We get going once the reply has been dealt with (there
+    // is none) and the reactor is back in control.
+    m_reactor.AddSocket(
+        m_connections.Socket(),
+        [this] (coral::net::Reactor&, zmq::socket_t&) { ContinueRun(); });
+    ScheduleContinueRun();
+    m_stateHandler = &SlaveAgent::RunningHandler;
+    msg.clear();
+}
+
+
+void SlaveAgent::ContinueRun()
+{
+    try {
+        RunSteps();
+    } catch (const zmq::error_t&) {
+        throw; // Not much we can do about this...
+    } catch (const std::runtime_error& e) {
+        std::vector<zmq::message_t> msg;
+        coral::protocol::execution::CreateFatalErrorMessage(
+            msg,
+            coralproto::execution::ErrorInfo::UNSPECIFIED_ERROR,
+            e.what());
+        m_control.SendToLastClient(msg);
+        throw;
+    }
+}
+
+
+void SlaveAgent::RunSteps()
+{
+    // We may get a late call from a timer or socket event after the run
+    // has ended.
+    if (m_stateHandler != &SlaveAgent::RunningHandler) return;
+
+    for (;;) {
+        if (m_run.inputsPending) {
+            // Values which arrive through shared memory don't wake the
+            // reactor, so if we have such peers, we have to poll for them.
+            // We never wait in here, though, since the reactor must be free
+            // to handle INTERRUPT and other control messages.
+            const bool polling = m_connections.HasLocalPeers();
+            if (m_connections.Update(
+                    m_slaveInstance,
+                    m_currentStepID,
+                    std::chrono::milliseconds(0))) {
+                m_run.inputsPending = false;
+                m_run.pollInterval = std::chrono::microseconds(0);
+                if (m_run.inputTimeoutTimer != coral::net::Reactor::invalidTimerID) {
+                    m_reactor.RemoveTimer(m_run.inputTimeoutTimer);
+                    m_run.inputTimeoutTimer = coral::net::Reactor::invalidTimerID;
+                }
+                const auto stepsDone = m_currentStepID - m_run.firstStepID + 1;
+                if (m_run.progressInterval > 0
+                        && stepsDone > 0
+                        && stepsDone % m_run.progressInterval == 0
+                        && m_currentStepID < m_run.lastStepID) {
+                    coralproto::execution::ProgressData progress;
+                    progress.set_step_id(m_currentStepID);
+                    std::vector<zmq::message_t> msg;
+                    coral::protocol::execution::CreateMessage(
+                        msg, coralproto::execution::MSG_PROGRESS, progress);
+                    m_control.SendToLastClient(msg);
+                }
+            } else if (m_run.interrupted) {
+                // Stop without the inputs, since the peers we're waiting for
+                // may have been interrupted too.
+            } else if (m_run.inputsTimedOut) {
+                throw std::runtime_error(
+                    "Timeout waiting for variable values from other slaves");
+            } else {
+                // Wait for more data.  The timeout is restarted whenever
+                // some arrives, as it is for a blocking Update().  When
+                // polling, we can't tell whether it has, so then the
+                // timeout applies to the whole wait.
+                if (m_run.inputTimeoutTimer != coral::net::Reactor::invalidTimerID) {
+                    if (!polling) m_reactor.RestartTimerInterval(m_run.inputTimeoutTimer);
+                } else if (m_variableRecvTimeout >= std::chrono::milliseconds(0)) {
+                    m_run.inputTimeoutTimer = m_reactor.AddTimer(
+                        m_variableRecvTimeout,
+                        1,
+                        [this] (coral::net::Reactor&, int) {
+                            m_run.inputTimeoutTimer =
+                                coral::net::Reactor::invalidTimerID;
+                            m_run.inputsTimedOut = true;
+                            ContinueRun();
+                        });
+                }
+                if (polling) {
+                    // Poll again after a while, returning to the reactor in
+                    // the meantime.  The interval grows the longer we wait,
+                    // so a slow peer doesn't keep the reactor spinning.
+                    m_run.pollInterval = std::min(
+                        std::max(2 * m_run.pollInterval, MIN_LOCAL_INPUT_POLL_INTERVAL),
+                        MAX_LOCAL_INPUT_POLL_INTERVAL);
+                    ScheduleContinueRun(m_run.pollInterval);
+                }
+                return;
+            }
+        }
+
+        const auto nextStepID = m_currentStepID + 1 > m_run.firstStepID
+            ? m_currentStepID + 1
+            : m_run.firstStepID;
+        if (m_run.interrupted || nextStepID > m_run.lastStepID) {
+            EndRun(coralproto::execution::MSG_READY);
+            return;
         }
+        const auto currentT = m_run.startTime
+            + (nextStepID - m_run.firstStepID) * m_run.stepSize;
+        if (!Step(nextStepID, currentT, m_run.stepSize)) {
+            EndRun(coralproto::execution::MSG_STEP_FAILED);
+            return;
+        }
+        m_run.inputsPending = true;
+        m_masterInactivityTimeout.Reset();
+
+        // Give the reactor a chance to handle INTERRUPT (or TERMINATE) if
+        // the master has sent it.
+        if (coral::net::zmqx::WaitForIncoming(
+                m_control.Socket(),
+                std::chrono::milliseconds(0))) {
+            ScheduleContinueRun();
+            return;
+        }
+    }
+}
+
+
+void SlaveAgent::ScheduleContinueRun(std::chrono::microseconds delay)
+{
+    if (m_run.continueTimer != coral::net::Reactor::invalidTimerID) return;
+    m_run.continueTimer = m_reactor.AddTimer(
+        delay,
+        1,
+        [this] (coral::net::Reactor&, int) {
+            m_run.continueTimer = coral::net::Reactor::invalidTimerID;
+            ContinueRun();
+        });
+}
+
+
+void SlaveAgent::EndRun(coralproto::execution::MessageType reply)
+{
+    m_reactor.RemoveSocket(m_connections.Socket());
+    if (m_run.continueTimer != coral::net::Reactor::invalidTimerID) {
+        m_reactor.RemoveTimer(m_run.continueTimer);
+        m_run.continueTimer = coral::net::Reactor::invalidTimerID;
+    }
+    if (m_run.inputTimeoutTimer != coral::net::Reactor::invalidTimerID) {
+        m_reactor.RemoveTimer(m_run.inputTimeoutTimer);
+        m_run.inputTimeoutTimer = coral::net::Reactor::invalidTimerID;
+    }
+    CORAL_LOG_DEBUG(boost::format("Run ended after time step %d%s")
+        % m_currentStepID
+        % (m_run.interrupted ? " (interrupted)" : ""));
+
+    coralproto::execution::ProgressData progress;
+    progress.set_step_id(m_currentStepID);
+    progress.set_inputs_pending(m_run.inputsPending);
+    std::vector<zmq::message_t> msg;
+    coral::protocol::execution::CreateMessage(msg, reply, progress);
+    m_control.SendToLastClient(msg);
+
+    if (reply == coralproto::execution::MSG_STEP_FAILED) {
+        m_stateHandler = &SlaveAgent::StepFailedHandler;
+    } else if (m_run.inputsPending) {
+        m_stateHandler = &SlaveAgent::PublishedHandler;
+    } else {
+        m_stateHandler = &SlaveAgent::ReadyHandler;
     }
 }
 
 
-bool SlaveAgent::Step(const coralproto::execution::StepData& stepInfo)
+bool SlaveAgent::Step(
+    coral::model::StepID stepID,
+    coral::model::TimePoint currentT,
+    coral::model::TimeDuration deltaT)
 {
     if (m_currentStepID == coral::model::INVALID_STEP_ID) {
         m_slaveInstance.StartSimulation();
     }
-    m_currentStepID = stepInfo.step_id();
-    if (!m_slaveInstance.DoStep(stepInfo.timepoint(), stepInfo.stepsize())) {
+    m_currentStepID = stepID;
+    if (!m_slaveInstance.DoStep(currentT, deltaT)) {
         return false;
     }
     PublishAll();
@@ -394,17 +802,61 @@ bool SlaveAgent::Step(const coralproto::execution::StepData& stepInfo)
 }
 
 
+namespace
+{
+    // Publishes the values in `column` one by one.
+    template<typename T>
+    void PublishEach(
+        coral::bus::VariablePublisher& publisher,
+        coral::model::StepID stepID,
+        coral::model::SlaveID slaveID,
+        const coral::model::ValueColumn<T>& column)
+    {
+        for (std::size_t i = 0; i < column.Size(); ++i) {
+            publisher.Publish(stepID, slaveID, column.ID(i), column.Value(i));
+        }
+    }
+}
+
+
 void SlaveAgent::PublishAll()
 {
     CORAL_LOG_TRACE("Publishing output variable values");
-    const auto typeDescription = m_slaveInstance.TypeDescription();
-    for (const auto& varInfo : typeDescription.Variables()) {
-        if (varInfo.Causality() != coral::model::OUTPUT_CAUSALITY) continue;
-        m_publisher.Publish(
-            m_currentStepID,
-            m_id,
-            varInfo.ID(),
-            GetVariable(m_slaveInstance, varInfo));
+    coral::slave::GetVariables(m_slaveInstance, m_outputValues);
+    if (m_batchedData) {
+        if (!m_outputValues.Empty()) {
+            m_publisher.Publish(m_currentStepID, m_id, m_outputValues);
+        }
+    } else {
+        const auto& v = m_outputValues;
+        PublishEach(m_publisher, m_currentStepID, m_id, v.Reals());
+        PublishEach(m_publisher, m_currentStepID, m_id, v.Integers());
+        PublishEach(m_publisher, m_currentStepID, m_id, v.Booleans());
+        PublishEach(m_publisher, m_currentStepID, m_id, v.Strings());
+    }
+}
+
+
+void SlaveAgent::UpdatePublishedOutputs()
+{
+    m_outputValues.Clear();
+    for (const auto& var : m_publishedOutputs) {
+        switch (var.second) {
+            case coral::model::REAL_DATATYPE:
+                m_outputValues.Reals().Add(var.first, 0.0);
+                break;
+            case coral::model::INTEGER_DATATYPE:
+                m_outputValues.Integers().Add(var.first, 0);
+                break;
+            case coral::model::BOOLEAN_DATATYPE:
+                m_outputValues.Booleans().Add(var.first, false);
+                break;
+            case coral::model::STRING_DATATYPE:
+                m_outputValues.Strings().Add(var.first, std::string());
+                break;
+            default:
+                assert (!"Variable has unknown data type");
+        }
     }
 }
 
@@ -471,14 +923,41 @@ void SlaveAgent::Connections::Connect(
 }
 
 
+void SlaveAgent::Connections::ConnectTo(const coral::net::Endpoint& endpoint)
+{
+    m_subscriber.ConnectTo(endpoint);
+}
+
+
+void SlaveAgent::Connections::DisconnectFrom(
+    const coral::net::Endpoint& endpoint)
+{
+    m_subscriber.DisconnectFrom(endpoint);
+}
+
+
+bool SlaveAgent::Connections::WaitForPeers(std::chrono::milliseconds timeout)
+{
+    return m_subscriber.WaitForPeers(timeout);
+}
+
+
 void SlaveAgent::Connections::Couple(
     coral::model::Variable remoteOutput,
-    coral::model::VariableID localInput)
+    coral::model::VariableID localInput,
+    int delay)
 {
     Decouple(localInput);
     if (!remoteOutput.Empty()) {
-        m_subscriber.Subscribe(remoteOutput);
+        std::size_t slot;
+        try {
+            slot = m_subscriber.Subscribe(remoteOutput, delay);
+        } catch (const std::invalid_argument& e) {
+            throw coral::error::ProtocolViolationException(
+                std::string("Invalid connection: ") + e.what());
+        }
         m_connections.insert(ConnectionBimap::value_type(remoteOutput, localInput));
+        m_inputSlots.push_back(std::make_pair(slot, localInput));
     }
 }
 
@@ -486,24 +965,57 @@ void SlaveAgent::Connections::Couple(
 bool SlaveAgent::Connections::Update(
     coral::slave::Instance& slaveInstance,
     coral::model::StepID stepID,
-    std::chrono::milliseconds timeout)
+    std::chrono::milliseconds timeout,
+    bool ignoreDelays)
 {
-    if (!m_subscriber.Update(stepID, timeout)) return false;
-    for (const auto& conn : m_connections.left) {
-        boost::apply_visitor(
-            SetVariable(slaveInstance, conn.second),
-            m_subscriber.Value(conn.first));
+    if (!m_subscriber.Update(stepID, timeout, ignoreDelays)) return false;
+    m_inputValues.Clear();
+    for (const auto& input : m_inputSlots) {
+        m_inputValues.Add(input.second, m_subscriber.Value(input.first));
     }
+    coral::slave::SetVariables(slaveInstance, m_inputValues);
     return true;
 }
 
 
+zmq::socket_t& SlaveAgent::Connections::Socket()
+{
+    return m_subscriber.Socket();
+}
+
+
+bool SlaveAgent::Connections::HasLocalPeers() const noexcept
+{
+    return m_subscriber.HasLocalPeers();
+}
+
+
+void SlaveAgent::Connections::SetSpinBudget(
+    std::chrono::microseconds spinBudget) noexcept
+{
+    m_subscriber.SetSpinBudget(spinBudget);
+}
+
+
+const coral::net::BusyPollStats& SlaveAgent::Connections::PollStats()
+    const noexcept
+{
+    return m_subscriber.PollStats();
+}
+
+
 void SlaveAgent::Connections::Decouple(coral::model::VariableID localInput)
 {
     const auto conn = m_connections.right.find(localInput);
     if (conn == m_connections.right.end()) return;
     const auto remoteOutput = conn->second;
     m_connections.right.erase(conn);
+    m_inputSlots.erase(std::find_if(
+        m_inputSlots.begin(),
+        m_inputSlots.end(),
+        [localInput] (const std::pair<std::size_t, coral::model::VariableID>& s) {
+            return s.second == localInput;
+        }));
     if (m_connections.left.count(remoteOutput) == 0) {
         m_subscriber.Unsubscribe(remoteOutput);
     }
@@ -13,6 +13,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include <coral/error.hpp>
 #include <coral/log.hpp>
 #include <coral/net/zmqx.hpp>
+#include <coral/protobuf.hpp>
 #include <coral/protocol/execution.hpp>
 
 
@@ -24,6 +25,27 @@ namespace bus
 namespace
 {
     const int NO_TIMER = -1;
+
+    // If the slave's command subscriber endpoint has "*" as its address,
+    // it means that it is listening on the same interface(s) as its control
+    // socket, so we replace the address with that of the control endpoint.
+    coral::net::Endpoint MakeCommandSubEndpoint(
+        const coral::net::Endpoint& controlEndpoint,
+        const std::string& commandSubEndpointURL)
+    {
+        const auto ep = coral::net::Endpoint{commandSubEndpointURL};
+        if (ep.Transport() == "tcp" && controlEndpoint.Transport() == "tcp") {
+            auto inEp = coral::net::ip::Endpoint{ep.Address()};
+            if (inEp.Address().IsAnyAddress()) {
+                inEp.SetAddress(
+                    coral::net::ip::Endpoint{controlEndpoint.Address()}
+                        .Address());
+            }
+            return inEp.ToEndpoint("tcp");
+        } else {
+            return ep;
+        }
+    }
 }
 
 
@@ -81,6 +103,7 @@ struct SlaveControlConnectionPrivate
     coral::net::zmqx::ReqSocket socket;
     std::chrono::milliseconds timeout;
     int protocol;
+    coral::net::Endpoint commandSubEndpoint;
 };
 
 
@@ -140,7 +163,10 @@ void PendingSlaveControlConnectionPrivate::TryConnect(int remainingAttempts)
         % this % m_slaveLocator.ControlEndpoint().URL());
 
     std::vector<zmq::message_t> msg;
-    coral::protocol::execution::CreateHelloMessage(msg, 0);
+    coralproto::execution::HelloData helloData;
+    helloData.set_max_protocol_version(
+        coral::protocol::execution::MAX_PROTOCOL_VERSION);
+    coral::protocol::execution::CreateHelloMessage(msg, 0, helloData);
     m_socket.Send(msg);
     CORAL_LOG_TRACE(
         boost::format("PendingSlaveControlConnectionPrivate  %x: Sent HELLO")
@@ -198,6 +224,15 @@ void PendingSlaveControlConnectionPrivate::HandleHelloReply()
         p->socket = std::move(m_socket);
         p->timeout = m_timeout;
         p->protocol = coral::protocol::execution::ParseHelloMessage(msg);
+        if (p->protocol >= 6 && msg.size() > 1) {
+            coralproto::execution::HelloReplyData helloReplyData;
+            coral::protobuf::ParseFromFrame(msg[1], helloReplyData);
+            if (helloReplyData.has_command_sub_endpoint()) {
+                p->commandSubEndpoint = MakeCommandSubEndpoint(
+                    m_slaveLocator.ControlEndpoint(),
+                    helloReplyData.command_sub_endpoint());
+            }
+        }
         OnComplete(std::error_code(), SlaveControlConnection(std::move(p)));
     } else {
         m_socket.Close();
@@ -349,10 +384,18 @@ std::unique_ptr<ISlaveControlMessenger> MakeSlaveControlMessenger(
     CORAL_INPUT_CHECK(connection);
     CORAL_INPUT_CHECK(slaveID != coral::model::INVALID_SLAVE_ID);
     CORAL_INPUT_CHECK(onComplete);
-    if (connection.Private().protocol == 0) {
+    const auto protocol = connection.Private().protocol;
+    if (protocol >= 0
+        && protocol <= coral::protocol::execution::MAX_PROTOCOL_VERSION)
+    {
+        // Versions 0 through 6 differ only in the contents of messages and
+        // in which messages are allowed in which states, so they are all
+        // handled by the same messenger.
         return std::make_unique<coral::bus::SlaveControlMessengerV0>(
             *connection.Private().reactor,
             std::move(connection.Private().socket),
+            protocol,
+            connection.Private().commandSubEndpoint,
             slaveID,
             slaveName,
             setup,
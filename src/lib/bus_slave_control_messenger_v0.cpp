@@ -55,6 +55,11 @@ namespace
             c(m_ec, coral::model::SlaveDescription());
         }
 
+        void operator()(const ISlaveControlMessenger::RunHandler& c) const
+        {
+            c(m_ec, coral::model::INVALID_STEP_ID);
+        }
+
     private:
         std::error_code m_ec;
     };
@@ -76,6 +81,8 @@ namespace
 SlaveControlMessengerV0::SlaveControlMessengerV0(
     coral::net::Reactor& reactor,
     coral::net::zmqx::ReqSocket socket,
+    int protocolVersion,
+    const coral::net::Endpoint& commandSubEndpoint,
     coral::model::SlaveID slaveID,
     const std::string& slaveName,
     const SlaveSetup& setup,
@@ -83,14 +90,18 @@ SlaveControlMessengerV0::SlaveControlMessengerV0(
     MakeSlaveControlMessengerHandler onComplete)
     : m_reactor(reactor),
       m_socket(std::move(socket)),
+      m_protocolVersion(protocolVersion),
+      m_commandSubEndpoint(commandSubEndpoint),
       m_state(SLAVE_CONNECTED),
       m_attachedToReactor(false),
       m_currentCommand(NO_COMMAND_ACTIVE),
+      m_relayed(false),
       m_onComplete(),
-      m_replyTimeoutTimerId(NO_TIMER_ACTIVE)
+      m_replyTimeoutTimerId(NO_TIMER_ACTIVE),
+      m_runTimeout(-1)
 {
-    CORAL_LOG_TRACE(boost::format("SlaveControlMessengerV0 %x: connected to \"%s\" (ID = %d)")
-        % this % slaveName % slaveID);
+    CORAL_LOG_TRACE(boost::format("SlaveControlMessengerV0 %x: connected to \"%s\" (ID = %d, protocol = %d)")
+        % this % slaveName % slaveID % protocolVersion);
     reactor.AddSocket(m_socket.Socket(), [=](coral::net::Reactor& r, zmq::socket_t& s) {
         assert (&s == &m_socket.Socket());
         OnReply();
@@ -121,6 +132,19 @@ SlaveState SlaveControlMessengerV0::State() const noexcept
 }
 
 
+int SlaveControlMessengerV0::ProtocolVersion() const noexcept
+{
+    return m_protocolVersion;
+}
+
+
+const coral::net::Endpoint& SlaveControlMessengerV0::CommandSubEndpoint()
+    const noexcept
+{
+    return m_commandSubEndpoint;
+}
+
+
 void SlaveControlMessengerV0::Close()
 {
     CheckInvariant();
@@ -128,6 +152,7 @@ void SlaveControlMessengerV0::Close()
         UnregisterTimeout();
         auto onComplete = std::move(m_onComplete);
         m_currentCommand = NO_COMMAND_ACTIVE;
+        m_onRunProgress = nullptr;
         Reset();
         boost::apply_visitor(
             CallWithError(make_error_code(std::errc::operation_canceled)),
@@ -157,6 +182,10 @@ void SlaveControlMessengerV0::GetDescription(
 
 void SlaveControlMessengerV0::SetVariables(
     const std::vector<coral::model::VariableSetting>& settings,
+    const std::vector<coral::model::VariableID>& startPublishing,
+    const std::vector<coral::model::VariableID>& stopPublishing,
+    const std::vector<coral::net::Endpoint>& connectPeers,
+    const std::vector<coral::net::Endpoint>& disconnectPeers,
     std::chrono::milliseconds timeout,
     SetVariablesHandler onComplete)
 {
@@ -173,8 +202,20 @@ void SlaveControlMessengerV0::SetVariables(
         }
         if (it->IsConnectionChange()) {
             coral::protocol::ConvertToProto(it->ConnectedOutput(), *v->mutable_connected_output());
+            if (it->ConnectionDelay() > 0) {
+                CORAL_PRECONDITION_CHECK(m_protocolVersion >= 8);
+                v->set_connection_delay(it->ConnectionDelay());
+            }
         }
     }
+    if (m_protocolVersion >= 3) {
+        for (const auto id : startPublishing) data.add_start_publishing(id);
+        for (const auto id : stopPublishing) data.add_stop_publishing(id);
+    }
+    if (m_protocolVersion >= 4) {
+        for (const auto& p : connectPeers) data.add_connect_peer(p.URL());
+        for (const auto& p : disconnectPeers) data.add_disconnect_peer(p.URL());
+    }
     SendCommand(coralproto::execution::MSG_SET_VARS, &data, timeout, std::move(onComplete));
     assert(State() == SLAVE_BUSY);
 }
@@ -182,15 +223,24 @@ void SlaveControlMessengerV0::SetVariables(
 
 void SlaveControlMessengerV0::SetPeers(
     const std::vector<coral::net::Endpoint>& peers,
+    bool batchedData,
+    VariableEncoding encoding,
     std::chrono::milliseconds timeout,
     SetPeersHandler onComplete)
 {
     CORAL_PRECONDITION_CHECK(State() == SLAVE_READY);
+    CORAL_PRECONDITION_CHECK(!batchedData || m_protocolVersion >= 1);
+    CORAL_PRECONDITION_CHECK(
+        encoding == PROTOBUF_VARIABLE_ENCODING || m_protocolVersion >= 2);
     CORAL_INPUT_CHECK(onComplete);
     CheckInvariant();
 
     coralproto::execution::SetPeersData data;
     for (const auto peer: peers) data.add_peer(peer.URL());
+    if (batchedData) data.set_batched_data(true);
+    if (encoding == BINARY_VARIABLE_ENCODING) {
+        data.set_variable_encoding(coralproto::execution::SetPeersData::BINARY);
+    }
     SendCommand(coralproto::execution::MSG_SET_PEERS, &data, timeout, std::move(onComplete));
     assert(State() == SLAVE_BUSY);
 }
@@ -216,7 +266,8 @@ void SlaveControlMessengerV0::Step(
     std::chrono::milliseconds timeout,
     StepHandler onComplete)
 {
-    CORAL_PRECONDITION_CHECK(State() == SLAVE_READY);
+    CORAL_PRECONDITION_CHECK(State() == SLAVE_READY
+        || (State() == SLAVE_STEP_OK && m_protocolVersion >= 5));
     CORAL_INPUT_CHECK(onComplete);
     CheckInvariant();
 
@@ -243,6 +294,138 @@ void SlaveControlMessengerV0::AcceptStep(
 }
 
 
+void SlaveControlMessengerV0::StepByBroadcast(
+    std::chrono::milliseconds timeout,
+    StepHandler onComplete)
+{
+    CORAL_PRECONDITION_CHECK(m_protocolVersion >= 6);
+    CORAL_PRECONDITION_CHECK(State() == SLAVE_READY || State() == SLAVE_STEP_OK);
+    CORAL_INPUT_CHECK(onComplete);
+    CheckInvariant();
+
+    PostSendCommand(coralproto::execution::MSG_STEP, timeout, std::move(onComplete));
+    assert(State() == SLAVE_BUSY);
+}
+
+
+void SlaveControlMessengerV0::AcceptStepByBroadcast(
+    std::chrono::milliseconds timeout,
+    AcceptStepHandler onComplete)
+{
+    CORAL_PRECONDITION_CHECK(m_protocolVersion >= 6);
+    CORAL_PRECONDITION_CHECK(m_state == SLAVE_STEP_OK);
+    CORAL_INPUT_CHECK(onComplete);
+    CheckInvariant();
+
+    PostSendCommand(coralproto::execution::MSG_ACCEPT_STEP, timeout, std::move(onComplete));
+    assert(State() == SLAVE_BUSY);
+}
+
+
+void SlaveControlMessengerV0::StepByRelay(
+    std::chrono::milliseconds timeout,
+    StepHandler onComplete)
+{
+    CORAL_PRECONDITION_CHECK(State() == SLAVE_READY
+        || (State() == SLAVE_STEP_OK && m_protocolVersion >= 5));
+    CORAL_INPUT_CHECK(onComplete);
+    CheckInvariant();
+
+    PostSendCommand(coralproto::execution::MSG_STEP, timeout, std::move(onComplete));
+    m_relayed = true;
+    assert(State() == SLAVE_BUSY);
+}
+
+
+void SlaveControlMessengerV0::AcceptStepByRelay(
+    std::chrono::milliseconds timeout,
+    AcceptStepHandler onComplete)
+{
+    CORAL_PRECONDITION_CHECK(m_state == SLAVE_STEP_OK);
+    CORAL_INPUT_CHECK(onComplete);
+    CheckInvariant();
+
+    PostSendCommand(coralproto::execution::MSG_ACCEPT_STEP, timeout, std::move(onComplete));
+    m_relayed = true;
+    assert(State() == SLAVE_BUSY);
+}
+
+
+void SlaveControlMessengerV0::ReceiveRelayedReply(std::vector<zmq::message_t>& msg)
+{
+    CheckInvariant();
+    if (State() != SLAVE_BUSY || !m_relayed) {
+        // Unlike for direct replies, this is to be expected if the sub-master
+        // was slower than our own timeout.
+        CORAL_LOG_TRACE(boost::format(
+            "SlaveControlMessengerV0 %x: Ignoring late relayed reply") % this);
+        return;
+    }
+    CORAL_INPUT_CHECK(!msg.empty());
+    ReplyReceived(msg);
+}
+
+
+void SlaveControlMessengerV0::RelayFailed(const std::error_code& ec)
+{
+    CheckInvariant();
+    if (State() != SLAVE_BUSY || !m_relayed) return;
+    // See OnReplyTimeout()
+    m_currentCommand = NO_COMMAND_ACTIVE;
+    const auto onComplete = std::move(m_onComplete);
+    UnregisterTimeout();
+    m_onRunProgress = nullptr;
+    Reset();
+
+    boost::apply_visitor(CallWithError(ec), onComplete);
+}
+
+
+void SlaveControlMessengerV0::Run(
+    coral::model::StepID firstStepID,
+    coral::model::StepID lastStepID,
+    coral::model::TimePoint startT,
+    coral::model::TimeDuration deltaT,
+    int progressInterval,
+    std::chrono::milliseconds timeout,
+    RunProgressHandler onProgress,
+    RunHandler onComplete)
+{
+    CORAL_PRECONDITION_CHECK(m_protocolVersion >= 7);
+    CORAL_PRECONDITION_CHECK(State() == SLAVE_READY || State() == SLAVE_STEP_OK);
+    CORAL_INPUT_CHECK(lastStepID >= firstStepID - 1);
+    CORAL_INPUT_CHECK(progressInterval >= 0);
+    CORAL_INPUT_CHECK(onComplete);
+    CheckInvariant();
+
+    coralproto::execution::RunData data;
+    data.set_first_step_id(firstStepID);
+    data.set_last_step_id(lastStepID);
+    data.set_start_time(startT);
+    data.set_stepsize(deltaT);
+    if (progressInterval > 0) data.set_progress_interval(progressInterval);
+
+    m_onRunProgress = std::move(onProgress);
+    m_runTimeout = timeout;
+    SendCommand(coralproto::execution::MSG_RUN, &data, timeout, std::move(onComplete));
+    assert(State() == SLAVE_BUSY);
+}
+
+
+void SlaveControlMessengerV0::Interrupt()
+{
+    CORAL_PRECONDITION_CHECK(m_currentCommand == coralproto::execution::MSG_RUN);
+    CheckInvariant();
+
+    CORAL_LOG_TRACE(
+        boost::format("SlaveControlMessengerV0 %x: Sending MSG_INTERRUPT")
+        % this);
+    std::vector<zmq::message_t> msg;
+    coral::protocol::execution::CreateMessage(msg, coralproto::execution::MSG_INTERRUPT);
+    m_socket.Send(msg);
+}
+
+
 void SlaveControlMessengerV0::Terminate()
 {
     CORAL_PRECONDITION_CHECK(m_state != SLAVE_NOT_CONNECTED);
@@ -325,6 +508,7 @@ void SlaveControlMessengerV0::PostSendCommand(
     if (timeout >= std::chrono::milliseconds(0)) RegisterTimeout(timeout);
     m_state = SLAVE_BUSY;
     m_currentCommand = command;
+    m_relayed = false;
     m_onComplete = std::move(onComplete);
 }
 
@@ -367,21 +551,36 @@ void SlaveControlMessengerV0::OnReply()
         return;
     }
 
+    std::vector<zmq::message_t> msg;
+    m_socket.Receive(msg);
+    ReplyReceived(msg);
+}
+
+
+void SlaveControlMessengerV0::ReplyReceived(std::vector<zmq::message_t>& msg)
+{
+    const auto reply = coral::protocol::execution::ParseMessageType(msg.front());
+    CORAL_LOG_TRACE(boost::format("SlaveControlMessengerV0 %x: Received %s")
+        % this
+        % coralproto::execution::MessageType_Name(
+            static_cast<coralproto::execution::MessageType>(reply)));
+
+    // A running slave reports its progress without ending the operation.
+    if (m_currentCommand == coralproto::execution::MSG_RUN
+            && reply == coralproto::execution::MSG_PROGRESS) {
+        RunProgressReceived(msg);
+        return;
+    }
+
     // Clean up before any callbacks are called, in case they throw or initiate
     // a new command.  We don't touch m_state, though; that must be done inside
     // the reply handlers, based on the actual reply.
     const auto currentCommand = coral::util::MoveAndReplace(m_currentCommand, NO_COMMAND_ACTIVE);
     const auto onComplete = std::move(m_onComplete);
     UnregisterTimeout();
+    m_onRunProgress = nullptr;
 
     // Delegate different replies to different functions.
-    std::vector<zmq::message_t> msg;
-    m_socket.Receive(msg);
-    CORAL_LOG_TRACE(boost::format("SlaveControlMessengerV0 %x: Received %s")
-        % this
-        % coralproto::execution::MessageType_Name(
-            static_cast<coralproto::execution::MessageType>(
-                coral::protocol::execution::ParseMessageType(msg.front()))));
     switch (currentCommand) {
         case coralproto::execution::MSG_SETUP:
             SetupReplyReceived(
@@ -418,6 +617,11 @@ void SlaveControlMessengerV0::OnReply()
                 msg,
                 std::move(boost::get<VoidHandler>(onComplete)));
             break;
+        case coralproto::execution::MSG_RUN:
+            RunReplyReceived(
+                msg,
+                std::move(boost::get<RunHandler>(onComplete)));
+            break;
         default: assert(!"Invalid currentCommand value");
     }
 }
@@ -431,6 +635,7 @@ void SlaveControlMessengerV0::OnReplyTimeout()
     m_currentCommand = NO_COMMAND_ACTIVE;
     const auto onComplete = std::move(m_onComplete);
     m_replyTimeoutTimerId = NO_TIMER_ACTIVE;
+    m_onRunProgress = nullptr;
     Reset();
 
     boost::apply_visitor(
@@ -539,6 +744,52 @@ void SlaveControlMessengerV0::AcceptStepReplyReceived(
 }
 
 
+void SlaveControlMessengerV0::RunProgressReceived(
+    const std::vector<zmq::message_t>& msg)
+{
+    assert (m_state == SLAVE_BUSY);
+    if (msg.size() != 2) {
+        throw coral::error::ProtocolViolationException(
+            "Wrong number of frames in PROGRESS message");
+    }
+    coralproto::execution::ProgressData progress;
+    coral::protobuf::ParseFromFrame(msg[1], progress);
+
+    // The timeout applies to the time between messages.
+    if (m_replyTimeoutTimerId != NO_TIMER_ACTIVE) {
+        UnregisterTimeout();
+        RegisterTimeout(m_runTimeout);
+    }
+    if (m_onRunProgress) m_onRunProgress(progress.step_id());
+}
+
+
+void SlaveControlMessengerV0::RunReplyReceived(
+    const std::vector<zmq::message_t>& msg,
+    RunHandler onComplete)
+{
+    assert (m_state == SLAVE_BUSY);
+    const auto msgType = coral::protocol::execution::ParseMessageType(msg.front());
+    if ((msgType == coralproto::execution::MSG_READY
+            || msgType == coralproto::execution::MSG_STEP_FAILED)
+            && msg.size() == 2) {
+        coralproto::execution::ProgressData progress;
+        coral::protobuf::ParseFromFrame(msg[1], progress);
+        if (msgType == coralproto::execution::MSG_STEP_FAILED) {
+            m_state = SLAVE_STEP_FAILED;
+            onComplete(
+                coral::error::sim_error::cannot_perform_timestep,
+                progress.step_id());
+        } else {
+            m_state = progress.inputs_pending() ? SLAVE_STEP_OK : SLAVE_READY;
+            onComplete(std::error_code(), progress.step_id());
+        }
+    } else {
+        HandleErrorReply(msgType, std::move(onComplete));
+    }
+}
+
+
 void SlaveControlMessengerV0::HandleExpectedReadyReply(
     const std::vector<zmq::message_t>& msg,
     VoidHandler onComplete)
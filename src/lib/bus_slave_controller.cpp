@@ -7,8 +7,12 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include <coral/bus/slave_controller.hpp>
 
 #include <cassert>
+#include <exception>
+#include <type_traits>
 #include <utility>
+
 #include <coral/error.hpp>
+#include <coral/log.hpp>
 
 
 namespace coral
@@ -17,6 +21,61 @@ namespace bus
 {
 
 
+template<typename... Args>
+std::function<void(Args...)> SlaveController::ToHome(
+    std::function<void(Args...)> handler)
+{
+    assert(m_shard);
+    return [this, handler] (Args... args)
+    {
+        const auto state = m_messenger ? m_messenger->State() : SLAVE_NOT_CONNECTED;
+        m_home->Post(std::bind(
+            [this, state] (
+                const std::function<void(Args...)>& h,
+                const typename std::decay<Args>::type&... a)
+            {
+                // Once disconnected, we stay disconnected, even if a
+                // handler for an earlier operation arrives late.
+                if (m_state != SLAVE_NOT_CONNECTED) m_state = state;
+                h(a...);
+            },
+            handler,
+            typename std::decay<Args>::type(args)...));
+    };
+}
+
+
+template<typename Op, typename... Args>
+void SlaveController::Perform(
+    Op op,
+    std::function<void(const std::error_code&, Args...)> onComplete)
+{
+    if (!m_shard) {
+        op(std::move(onComplete));
+        return;
+    }
+    // Like the messenger would, we consider the slave busy from the moment
+    // the operation is started.
+    m_state = SLAVE_BUSY;
+    const auto handler = ToHome(std::move(onComplete));
+    m_shard->Post([op, handler] ()
+    {
+        try {
+            op(handler);
+        } catch (const std::exception& e) {
+            // This is most likely a precondition violation, which we would
+            // have thrown to the caller if we weren't sharded.
+            coral::log::Log(
+                coral::log::error,
+                boost::format("Slave operation failed: %s") % e.what());
+            handler(
+                make_error_code(coral::error::generic_error::operation_failed),
+                typename std::decay<Args>::type()...);
+        }
+    });
+}
+
+
 SlaveController::SlaveController(
     coral::net::Reactor& reactor,
     const coral::net::SlaveLocator& slaveLocator,
@@ -28,23 +87,62 @@ SlaveController::SlaveController(
     int maxConnectionAttempts)
 {
     CORAL_INPUT_CHECK(slaveID != coral::model::INVALID_SLAVE_ID);
-    m_pendingConnection = ConnectToSlave(
-        reactor,
-        slaveLocator,
-        maxConnectionAttempts,
-        timeout,
-        [=] (const std::error_code& ec, SlaveControlConnection scc) {
-            if (!ec) {
-                m_messenger = MakeSlaveControlMessenger(
-                    std::move(scc),
-                    slaveID,
-                    slaveName,
-                    setup,
-                    onComplete);
-            } else {
-                onComplete(ec);
-            }
-        });
+    Connect(
+        reactor, slaveLocator, slaveID, slaveName, setup, timeout,
+        std::move(onComplete), maxConnectionAttempts);
+}
+
+
+SlaveController::SlaveController(
+    SlaveShard& shard,
+    TaskInbox& home,
+    const coral::net::SlaveLocator& slaveLocator,
+    coral::model::SlaveID slaveID,
+    const std::string& slaveName,
+    const SlaveSetup& setup,
+    std::chrono::milliseconds timeout,
+    ConnectHandler onComplete,
+    int maxConnectionAttempts)
+    : m_shard{&shard}
+    , m_home{&home}
+    , m_state{SLAVE_BUSY}
+{
+    // Perform the checks that Connect() would otherwise report in the
+    // shard's thread.
+    CORAL_INPUT_CHECK(slaveID != coral::model::INVALID_SLAVE_ID);
+    CORAL_INPUT_CHECK(onComplete);
+    CORAL_INPUT_CHECK(maxConnectionAttempts > 0);
+    const auto homeHandler = ToHome(std::move(onComplete));
+    m_shard->Post([=] ()
+    {
+        try {
+            Connect(
+                m_shard->Reactor(), slaveLocator, slaveID, slaveName, setup,
+                timeout,
+                [this, homeHandler] (const std::error_code& ec)
+                {
+                    // These never change once the connection is established.
+                    const auto protocolVersion =
+                        m_messenger ? m_messenger->ProtocolVersion() : -1;
+                    const auto commandSubEndpoint = m_messenger
+                        ? m_messenger->CommandSubEndpoint()
+                        : coral::net::Endpoint{};
+                    m_home->Post([this, protocolVersion, commandSubEndpoint] ()
+                    {
+                        m_protocolVersion = protocolVersion;
+                        m_commandSubEndpoint = commandSubEndpoint;
+                    });
+                    homeHandler(ec);
+                },
+                maxConnectionAttempts);
+        } catch (const std::exception& e) {
+            coral::log::Log(
+                coral::log::error,
+                boost::format("Failed to connect to slave %s: %s")
+                    % slaveName % e.what());
+            homeHandler(make_error_code(coral::error::generic_error::operation_failed));
+        }
+    });
 }
 
 
@@ -58,57 +156,109 @@ SlaveController::~SlaveController()
 
 void SlaveController::Close()
 {
-    m_pendingConnection.Close();
-    if (m_messenger) m_messenger->Close();
+    if (m_shard) m_state = SLAVE_NOT_CONNECTED;
+    InShard([this] ()
+    {
+        m_pendingConnection.Close();
+        if (m_messenger) m_messenger->Close();
+    });
 }
 
 
 SlaveState SlaveController::State() const noexcept
 {
-    if (m_messenger) return m_messenger->State();
+    if (m_shard) return m_state;
+    else if (m_messenger) return m_messenger->State();
     else if (m_pendingConnection) return SLAVE_BUSY;
     else return SLAVE_NOT_CONNECTED;
 }
 
 
+int SlaveController::ProtocolVersion() const noexcept
+{
+    if (m_shard) return m_protocolVersion;
+    return m_messenger ? m_messenger->ProtocolVersion() : -1;
+}
+
+
+coral::net::Endpoint SlaveController::CommandSubEndpoint() const
+{
+    if (m_shard) return m_commandSubEndpoint;
+    return m_messenger
+        ? m_messenger->CommandSubEndpoint()
+        : coral::net::Endpoint{};
+}
+
+
 void SlaveController::GetDescription(
     std::chrono::milliseconds timeout,
     GetDescriptionHandler onComplete)
 {
-    if (m_messenger) {
-        m_messenger->GetDescription(timeout, std::move(onComplete));
-    } else {
-        onComplete(
-            std::make_error_code(std::errc::not_connected),
-            coral::model::SlaveDescription());
-    }
+    Perform(
+        [this, timeout] (GetDescriptionHandler handler)
+        {
+            if (m_messenger) {
+                m_messenger->GetDescription(timeout, std::move(handler));
+            } else {
+                handler(
+                    std::make_error_code(std::errc::not_connected),
+                    coral::model::SlaveDescription());
+            }
+        },
+        std::move(onComplete));
 }
 
 
 void SlaveController::SetVariables(
     const std::vector<coral::model::VariableSetting>& settings,
+    const std::vector<coral::model::VariableID>& startPublishing,
+    const std::vector<coral::model::VariableID>& stopPublishing,
+    const std::vector<coral::net::Endpoint>& connectPeers,
+    const std::vector<coral::net::Endpoint>& disconnectPeers,
     std::chrono::milliseconds timeout,
     SetVariablesHandler onComplete)
 {
-    CORAL_INPUT_CHECK(!settings.empty());
-    if (m_messenger) {
-        m_messenger->SetVariables(settings, timeout, std::move(onComplete));
-    } else {
-        onComplete(std::make_error_code(std::errc::not_connected));
-    }
+    CORAL_INPUT_CHECK(
+        !settings.empty() || !startPublishing.empty() || !stopPublishing.empty()
+        || !connectPeers.empty() || !disconnectPeers.empty());
+    Perform(
+        [=] (SetVariablesHandler handler)
+        {
+            if (m_messenger) {
+                m_messenger->SetVariables(
+                    settings,
+                    startPublishing,
+                    stopPublishing,
+                    connectPeers,
+                    disconnectPeers,
+                    timeout,
+                    std::move(handler));
+            } else {
+                handler(std::make_error_code(std::errc::not_connected));
+            }
+        },
+        std::move(onComplete));
 }
 
 
 void SlaveController::SetPeers(
     const std::vector<coral::net::Endpoint>& peers,
+    bool batchedData,
+    VariableEncoding encoding,
     std::chrono::milliseconds timeout,
     SetPeersHandler onComplete)
 {
-    if (m_messenger) {
-        m_messenger->SetPeers(peers, timeout, std::move(onComplete));
-    } else {
-        onComplete(std::make_error_code(std::errc::not_connected));
-    }
+    Perform(
+        [=] (SetPeersHandler handler)
+        {
+            if (m_messenger) {
+                m_messenger->SetPeers(
+                    peers, batchedData, encoding, timeout, std::move(handler));
+            } else {
+                handler(std::make_error_code(std::errc::not_connected));
+            }
+        },
+        std::move(onComplete));
 }
 
 
@@ -116,11 +266,16 @@ void SlaveController::ResendVars(
     std::chrono::milliseconds timeout,
     ResendVarsHandler onComplete)
 {
-    if (m_messenger) {
-        m_messenger->ResendVars(timeout, std::move(onComplete));
-    } else {
-        onComplete(std::make_error_code(std::errc::not_connected));
-    }
+    Perform(
+        [this, timeout] (ResendVarsHandler handler)
+        {
+            if (m_messenger) {
+                m_messenger->ResendVars(timeout, std::move(handler));
+            } else {
+                handler(std::make_error_code(std::errc::not_connected));
+            }
+        },
+        std::move(onComplete));
 }
 
 
@@ -132,31 +287,215 @@ void SlaveController::Step(
     StepHandler onComplete)
 {
     CORAL_INPUT_CHECK(deltaT >= 0.0);
-    if (m_messenger) {
-        m_messenger->Step(stepID, currentT, deltaT, timeout, std::move(onComplete));
-    } else {
-        onComplete(std::make_error_code(std::errc::not_connected));
-    }
+    Perform(
+        [=] (StepHandler handler)
+        {
+            if (m_messenger) {
+                m_messenger->Step(stepID, currentT, deltaT, timeout, std::move(handler));
+            } else {
+                handler(std::make_error_code(std::errc::not_connected));
+            }
+        },
+        std::move(onComplete));
 }
 
 void SlaveController::AcceptStep(
     std::chrono::milliseconds timeout,
     AcceptStepHandler onComplete)
 {
-    if (m_messenger) {
-        m_messenger->AcceptStep(timeout, std::move(onComplete));
-    } else {
-        onComplete(std::make_error_code(std::errc::not_connected));
-    }
+    Perform(
+        [this, timeout] (AcceptStepHandler handler)
+        {
+            if (m_messenger) {
+                m_messenger->AcceptStep(timeout, std::move(handler));
+            } else {
+                handler(std::make_error_code(std::errc::not_connected));
+            }
+        },
+        std::move(onComplete));
+}
+
+
+void SlaveController::StepByBroadcast(
+    std::chrono::milliseconds timeout,
+    StepHandler onComplete)
+{
+    Perform(
+        [this, timeout] (StepHandler handler)
+        {
+            if (m_messenger) {
+                m_messenger->StepByBroadcast(timeout, std::move(handler));
+            } else {
+                handler(std::make_error_code(std::errc::not_connected));
+            }
+        },
+        std::move(onComplete));
+}
+
+
+void SlaveController::AcceptStepByBroadcast(
+    std::chrono::milliseconds timeout,
+    AcceptStepHandler onComplete)
+{
+    Perform(
+        [this, timeout] (AcceptStepHandler handler)
+        {
+            if (m_messenger) {
+                m_messenger->AcceptStepByBroadcast(timeout, std::move(handler));
+            } else {
+                handler(std::make_error_code(std::errc::not_connected));
+            }
+        },
+        std::move(onComplete));
+}
+
+
+void SlaveController::StepByRelay(
+    std::chrono::milliseconds timeout,
+    StepHandler onComplete)
+{
+    Perform(
+        [this, timeout] (StepHandler handler)
+        {
+            if (m_messenger) {
+                m_messenger->StepByRelay(timeout, std::move(handler));
+            } else {
+                handler(std::make_error_code(std::errc::not_connected));
+            }
+        },
+        std::move(onComplete));
+}
+
+
+void SlaveController::AcceptStepByRelay(
+    std::chrono::milliseconds timeout,
+    AcceptStepHandler onComplete)
+{
+    Perform(
+        [this, timeout] (AcceptStepHandler handler)
+        {
+            if (m_messenger) {
+                m_messenger->AcceptStepByRelay(timeout, std::move(handler));
+            } else {
+                handler(std::make_error_code(std::errc::not_connected));
+            }
+        },
+        std::move(onComplete));
+}
+
+
+void SlaveController::ReceiveRelayedReply(std::vector<zmq::message_t> msg)
+{
+    // std::function requires a copyable function object.
+    const auto sharedMsg =
+        std::make_shared<std::vector<zmq::message_t>>(std::move(msg));
+    InShard([this, sharedMsg] ()
+    {
+        if (m_messenger) m_messenger->ReceiveRelayedReply(*sharedMsg);
+    });
+}
+
+
+void SlaveController::RelayFailed(const std::error_code& ec)
+{
+    InShard([this, ec] ()
+    {
+        if (m_messenger) m_messenger->RelayFailed(ec);
+    });
+}
+
+
+void SlaveController::Run(
+    coral::model::StepID firstStepID,
+    coral::model::StepID lastStepID,
+    coral::model::TimePoint startT,
+    coral::model::TimeDuration deltaT,
+    int progressInterval,
+    std::chrono::milliseconds timeout,
+    RunProgressHandler onProgress,
+    RunHandler onComplete)
+{
+    CORAL_INPUT_CHECK(deltaT >= 0.0);
+    if (m_shard && onProgress) onProgress = ToHome(std::move(onProgress));
+    Perform(
+        [=] (RunHandler handler)
+        {
+            if (m_messenger) {
+                m_messenger->Run(
+                    firstStepID,
+                    lastStepID,
+                    startT,
+                    deltaT,
+                    progressInterval,
+                    timeout,
+                    onProgress,
+                    std::move(handler));
+            } else {
+                handler(
+                    std::make_error_code(std::errc::not_connected),
+                    coral::model::INVALID_STEP_ID);
+            }
+        },
+        std::move(onComplete));
+}
+
+
+void SlaveController::Interrupt()
+{
+    InShard([this] ()
+    {
+        if (m_messenger) m_messenger->Interrupt();
+    });
 }
 
 
 void SlaveController::Terminate()
 {
-    m_pendingConnection.Close();
-    if (m_messenger) {
-        m_messenger->Terminate();
-    }
+    if (m_shard) m_state = SLAVE_NOT_CONNECTED;
+    InShard([this] ()
+    {
+        m_pendingConnection.Close();
+        if (m_messenger) {
+            m_messenger->Terminate();
+        }
+    });
+}
+
+
+void SlaveController::Connect(
+    coral::net::Reactor& reactor,
+    const coral::net::SlaveLocator& slaveLocator,
+    coral::model::SlaveID slaveID,
+    const std::string& slaveName,
+    const SlaveSetup& setup,
+    std::chrono::milliseconds timeout,
+    ConnectHandler onComplete,
+    int maxConnectionAttempts)
+{
+    m_pendingConnection = ConnectToSlave(
+        reactor,
+        slaveLocator,
+        maxConnectionAttempts,
+        timeout,
+        [=] (const std::error_code& ec, SlaveControlConnection scc) {
+            if (!ec) {
+                m_messenger = MakeSlaveControlMessenger(
+                    std::move(scc),
+                    slaveID,
+                    slaveName,
+                    setup,
+                    onComplete);
+            } else {
+                onComplete(ec);
+            }
+        });
+}
+
+
+void SlaveController::InShard(std::function<void()> action)
+{
+    if (m_shard) m_shard->Post(std::move(action));
+    else action();
 }
 
 
@@ -198,13 +198,13 @@ private:
             if (replyData.ParseFromArray(replyBody, boost::numeric_cast<int>(replyBodySize))) {
                 // Trandlate "*" in the slave addresses with the slave
                 // provider address.
+                const auto& loc = replyData.slave_locator();
                 const auto slaveLocator = coral::net::SlaveLocator{
-                    MakeSlaveEndpoint(
-                        m_address,
-                        replyData.slave_locator().control_endpoint()),
-                    MakeSlaveEndpoint(
-                        m_address,
-                        replyData.slave_locator().data_pub_endpoint())
+                    MakeSlaveEndpoint(m_address, loc.control_endpoint()),
+                    MakeSlaveEndpoint(m_address, loc.data_pub_endpoint()),
+                    loc.has_sub_master_endpoint()
+                        ? MakeSlaveEndpoint(m_address, loc.sub_master_endpoint())
+                        : coral::net::Endpoint{}
                 };
 
                 completionHandler(
@@ -410,6 +410,10 @@ private:
                 slaveLocator.ControlEndpoint().URL());
             data.mutable_slave_locator()->set_data_pub_endpoint(
                 slaveLocator.DataPubEndpoint().URL());
+            if (!slaveLocator.SubMasterEndpoint().Transport().empty()) {
+                data.mutable_slave_locator()->set_sub_master_endpoint(
+                    slaveLocator.SubMasterEndpoint().URL());
+            }
             m_replyBodyBuffer = data.SerializeAsString();
         } catch (const std::runtime_error& e) {
              replyHeader = ERROR_REPLY.data();
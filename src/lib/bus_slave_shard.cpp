@@ -0,0 +1,123 @@
+/*
+Copyright 2013-present, SINTEF Ocean.
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+#include <coral/bus/slave_shard.hpp>
+
+#include <cassert>
+#include <exception>
+#include <utility>
+
+#include <coral/log.hpp>
+#include <coral/util.hpp>
+
+
+namespace coral
+{
+namespace bus
+{
+
+
+// =============================================================================
+// class TaskInbox
+// =============================================================================
+
+
+TaskInbox::TaskInbox(coral::net::Reactor& reactor)
+    : m_reactor(reactor)
+{
+    m_wakeup.Register(reactor, [this] (coral::net::Reactor&) { RunTasks(); });
+}
+
+
+TaskInbox::~TaskInbox() noexcept
+{
+    m_wakeup.Unregister(m_reactor);
+}
+
+
+void TaskInbox::Post(std::function<void()> task)
+{
+    assert(task);
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        wasEmpty = m_tasks.empty();
+        m_tasks.push_back(std::move(task));
+    }
+    // If the queue wasn't empty, a signal is already on its way.
+    if (wasEmpty) m_wakeup.Signal();
+}
+
+
+void TaskInbox::RunTasks()
+{
+    assert(m_batch.empty());
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_batch.swap(m_tasks);
+    }
+    // Tasks may not throw, but if one does anyway, we must at least leave
+    // the inbox in a usable state.
+    const auto clearBatch = coral::util::OnScopeExit([this] () { m_batch.clear(); });
+    for (auto& task : m_batch) task();
+}
+
+
+// =============================================================================
+// class SlaveShard
+// =============================================================================
+
+
+SlaveShard::SlaveShard()
+    : m_reactor{}
+    , m_inbox{m_reactor}
+{
+    m_thread = std::thread([this] ()
+    {
+        for (;;) {
+            try {
+                m_reactor.Run();
+                return;
+            } catch (const std::exception& e) {
+                // There is nobody to report the error to, but the slaves'
+                // own timeouts will make the current operation fail.
+                coral::log::Log(
+                    coral::log::error,
+                    boost::format("Unexpected error in slave shard thread: %s")
+                        % e.what());
+            }
+        }
+    });
+}
+
+
+SlaveShard::~SlaveShard() noexcept
+{
+    Stop();
+}
+
+
+coral::net::Reactor& SlaveShard::Reactor() noexcept
+{
+    return m_reactor;
+}
+
+
+void SlaveShard::Post(std::function<void()> task)
+{
+    m_inbox.Post(std::move(task));
+}
+
+
+void SlaveShard::Stop() noexcept
+{
+    if (!m_thread.joinable()) return;
+    m_inbox.Post([this] () { m_reactor.Stop(); });
+    m_thread.join();
+}
+
+
+}} // namespace
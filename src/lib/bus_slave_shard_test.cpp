@@ -0,0 +1,62 @@
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <coral/bus/slave_shard.hpp>
+
+
+TEST(coral_bus, SlaveShard)
+{
+    coral::bus::SlaveShard shard;
+
+    // Tasks run in the shard's thread, and in the order they were posted.
+    const int taskCount = 1000;
+    std::vector<int> order;
+    std::promise<std::thread::id> threadID;
+    for (int i = 0; i < taskCount; ++i) {
+        shard.Post([&order, i] () { order.push_back(i); });
+    }
+    shard.Post([&threadID] () { threadID.set_value(std::this_thread::get_id()); });
+    const auto shardThreadID = threadID.get_future().get();
+    EXPECT_NE(std::this_thread::get_id(), shardThreadID);
+    ASSERT_EQ(taskCount, static_cast<int>(order.size()));
+    for (int i = 0; i < taskCount; ++i) EXPECT_EQ(i, order[i]);
+
+    // Tasks may be posted from several threads at once.
+    std::atomic<int> count{0};
+    std::vector<std::thread> posters;
+    for (int t = 0; t < 4; ++t) {
+        posters.emplace_back([&shard, &count] ()
+        {
+            for (int i = 0; i < taskCount; ++i) {
+                shard.Post([&count] () { ++count; });
+            }
+        });
+    }
+    for (auto& t : posters) t.join();
+    std::promise<void> done;
+    shard.Post([&done] () { done.set_value(); });
+    done.get_future().get();
+    EXPECT_EQ(4*taskCount, count.load());
+
+    shard.Stop();
+    shard.Stop(); // no-op
+}
+
+
+TEST(coral_bus, TaskInbox)
+{
+    // Tasks posted to an inbox from another thread run in the reactor's thread.
+    coral::net::Reactor reactor;
+    coral::bus::TaskInbox inbox{reactor};
+    int count = 0;
+    std::thread poster([&] ()
+    {
+        for (int i = 0; i < 10; ++i) inbox.Post([&count] () { ++count; });
+        inbox.Post([&reactor] () { reactor.Stop(); });
+    });
+    reactor.Run();
+    poster.join();
+    EXPECT_EQ(10, count);
+}
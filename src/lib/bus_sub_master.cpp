@@ -0,0 +1,427 @@
+/*
+Copyright 2013-present, SINTEF Ocean.
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+#include <coral/bus/sub_master.hpp>
+
+#include <cassert>
+#include <exception>
+#include <utility>
+
+#include <boost/numeric/conversion/cast.hpp>
+
+#include <coral/error.hpp>
+#include <coral/log.hpp>
+#include <coral/protobuf.hpp>
+#include <coral/protocol/execution.hpp>
+
+
+namespace coral
+{
+namespace bus
+{
+
+namespace
+{
+    // A link to a slave which has not been used for this many requests is
+    // closed, as the slave has most likely been shut down.
+    const std::uint64_t LINK_IDLE_LIMIT = 1000;
+
+    // How much longer than the slaves' timeout the client waits for the
+    // sub-master's reply, to allow for the sub-master's own timeout to
+    // expire and its reply to be transferred.
+    const std::chrono::milliseconds CLIENT_TIMEOUT_MARGIN(100);
+
+    coralproto::execution::MessageType MessageTypeOf(
+        const std::vector<zmq::message_t>& msg)
+    {
+        return static_cast<coralproto::execution::MessageType>(
+            coral::protocol::execution::ParseMessageType(msg.front()));
+    }
+}
+
+
+// =============================================================================
+// class SubMaster
+// =============================================================================
+
+
+SubMaster::SubMaster(
+    coral::net::Reactor& reactor,
+    const coral::net::Endpoint& endpoint)
+    : m_reactor(reactor)
+{
+    m_socket.Bind(endpoint);
+    m_reactor.AddSocket(
+        m_socket.Socket(),
+        [this] (coral::net::Reactor&, zmq::socket_t&) { OnRequest(); });
+}
+
+
+SubMaster::~SubMaster() noexcept
+{
+    if (m_timeoutTimer >= 0) m_reactor.RemoveTimer(m_timeoutTimer);
+    for (auto& link : m_links) {
+        m_reactor.RemoveSocket(link.second->socket.Socket());
+    }
+    if (!m_busy) m_reactor.RemoveSocket(m_socket.Socket());
+}
+
+
+const coral::net::Endpoint& SubMaster::BoundEndpoint() const
+{
+    return m_socket.BoundEndpoint();
+}
+
+
+void SubMaster::OnRequest()
+{
+    assert(!m_busy);
+    std::vector<zmq::message_t> msg;
+    m_socket.Receive(msg);
+    try {
+        if (msg.size() != 2) {
+            throw coral::error::ProtocolViolationException(
+                "Wrong number of frames in relay request");
+        }
+        const auto command = MessageTypeOf(msg);
+        if (command != coralproto::execution::MSG_STEP
+                && command != coralproto::execution::MSG_ACCEPT_STEP) {
+            throw coral::error::ProtocolViolationException(
+                "Command cannot be relayed");
+        }
+        coralproto::execution::RelayCommandData data;
+        coral::protobuf::ParseFromFrame(msg[1], data);
+        if (command == coralproto::execution::MSG_STEP && !data.has_step()) {
+            throw coral::error::ProtocolViolationException(
+                "Missing step data in relay request");
+        }
+        Relay(command, data);
+    } catch (const std::exception& e) {
+        CORAL_LOG_DEBUG(boost::format("SubMaster: Invalid request: %s")
+            % e.what());
+        coral::protocol::execution::CreateErrorMessage(
+            msg,
+            coralproto::execution::ErrorInfo::INVALID_REQUEST,
+            e.what());
+        m_socket.Send(msg);
+    }
+}
+
+
+void SubMaster::Relay(
+    coralproto::execution::MessageType command,
+    const coralproto::execution::RelayCommandData& data)
+{
+    ++m_requestCount;
+    m_endpoints.assign(data.control_endpoint().begin(), data.control_endpoint().end());
+    m_replies.Clear();
+
+    // The command is the same for all slaves, so we only serialize it once.
+    std::vector<zmq::message_t> commandMsg;
+    if (command == coralproto::execution::MSG_STEP) {
+        coral::protocol::execution::CreateMessage(commandMsg, command, data.step());
+    } else {
+        coral::protocol::execution::CreateMessage(commandMsg, command);
+    }
+
+    m_remainingReplies = 0;
+    for (int i = 0; i < static_cast<int>(m_endpoints.size()); ++i) {
+        m_replies.add_reply();
+        auto& link = GetLink(m_endpoints[i]);
+        if (link.pendingIndex >= 0) {
+            // The same slave is listed twice.  It only gets one command.
+            continue;
+        }
+        std::vector<zmq::message_t> msg(commandMsg.size());
+        for (std::size_t f = 0; f < commandMsg.size(); ++f) {
+            msg[f].copy(&commandMsg[f]);
+        }
+        link.socket.Send(msg);
+        link.pendingIndex = i;
+        link.lastUsed = m_requestCount;
+        ++m_remainingReplies;
+    }
+    if (m_remainingReplies == 0) {
+        Finish();
+        return;
+    }
+
+    // Stop listening for new requests until this one has been dealt with.
+    m_busy = true;
+    m_reactor.RemoveSocket(m_socket.Socket());
+    if (data.timeout_ms() >= 0) {
+        m_timeoutTimer = m_reactor.AddTimer(
+            std::chrono::milliseconds(data.timeout_ms()),
+            1,
+            [this] (coral::net::Reactor&, int)
+            {
+                m_timeoutTimer = -1;
+                Finish();
+            });
+    }
+}
+
+
+SubMaster::Link& SubMaster::GetLink(const std::string& endpoint)
+{
+    const auto it = m_links.find(endpoint);
+    if (it != m_links.end()) return *it->second;
+
+    auto link = std::make_unique<Link>();
+    link->socket.Connect(coral::net::Endpoint{endpoint});
+    const auto linkPtr = link.get();
+    m_reactor.AddSocket(
+        link->socket.Socket(),
+        [this, linkPtr] (coral::net::Reactor&, zmq::socket_t&)
+        {
+            OnSlaveReply(*linkPtr);
+        });
+    m_links.insert(std::make_pair(endpoint, std::move(link)));
+    return *linkPtr;
+}
+
+
+void SubMaster::OnSlaveReply(Link& link)
+{
+    std::vector<zmq::message_t> msg;
+    link.socket.Receive(msg);
+    if (link.pendingIndex < 0) {
+        // This can only be a late reply, which we drop the link to avoid.
+        CORAL_LOG_DEBUG("SubMaster: Ignoring unexpected reply from slave");
+        return;
+    }
+    auto& reply = *m_replies.mutable_reply(link.pendingIndex);
+    for (const auto& frame : msg) {
+        reply.add_frame(static_cast<const char*>(frame.data()), frame.size());
+    }
+    link.pendingIndex = -1;
+    if (--m_remainingReplies == 0) {
+        if (m_timeoutTimer >= 0) {
+            m_reactor.RemoveTimer(m_timeoutTimer);
+            m_timeoutTimer = -1;
+        }
+        Finish();
+    }
+}
+
+
+void SubMaster::Finish()
+{
+    // Slaves which haven't replied by now have timed out.
+    if (m_remainingReplies > 0) {
+        for (const auto& endpoint : m_endpoints) {
+            const auto it = m_links.find(endpoint);
+            if (it != m_links.end() && it->second->pendingIndex >= 0) {
+                CORAL_LOG_DEBUG(boost::format("SubMaster: Slave at %s timed out")
+                    % endpoint);
+                DropLink(endpoint);
+            }
+        }
+        m_remainingReplies = 0;
+    }
+
+    std::vector<zmq::message_t> msg;
+    coral::protocol::execution::CreateMessage(
+        msg, coralproto::execution::MSG_RELAYED, m_replies);
+    m_socket.Send(msg);
+    m_replies.Clear();
+    m_endpoints.clear();
+
+    if (m_requestCount % LINK_IDLE_LIMIT == 0) PruneLinks();
+    if (m_busy) {
+        m_busy = false;
+        m_reactor.AddSocket(
+            m_socket.Socket(),
+            [this] (coral::net::Reactor&, zmq::socket_t&) { OnRequest(); });
+    }
+}
+
+
+void SubMaster::DropLink(const std::string& endpoint) noexcept
+{
+    const auto it = m_links.find(endpoint);
+    if (it == m_links.end()) return;
+    m_reactor.RemoveSocket(it->second->socket.Socket());
+    m_links.erase(it);
+}
+
+
+void SubMaster::PruneLinks() noexcept
+{
+    std::vector<std::string> idle;
+    for (const auto& link : m_links) {
+        if (m_requestCount - link.second->lastUsed >= LINK_IDLE_LIMIT) {
+            idle.push_back(link.first);
+        }
+    }
+    for (const auto& endpoint : idle) DropLink(endpoint);
+}
+
+
+// =============================================================================
+// class SubMasterClient
+// =============================================================================
+
+
+SubMasterClient::SubMasterClient(
+    coral::net::Reactor& reactor,
+    const coral::net::Endpoint& endpoint)
+    : m_reactor(reactor)
+    , m_endpoint(endpoint)
+{
+    Connect();
+}
+
+
+SubMasterClient::~SubMasterClient() noexcept
+{
+    if (m_timeoutTimer >= 0) m_reactor.RemoveTimer(m_timeoutTimer);
+    m_reactor.RemoveSocket(m_socket.Socket());
+}
+
+
+bool SubMasterClient::Busy() const noexcept
+{
+    return !!m_onComplete;
+}
+
+
+void SubMasterClient::Step(
+    const std::vector<std::string>& slaves,
+    coral::model::StepID stepID,
+    coral::model::TimePoint currentT,
+    coral::model::TimeDuration deltaT,
+    std::chrono::milliseconds timeout,
+    ReplyHandler onComplete)
+{
+    coralproto::execution::RelayCommandData data;
+    auto& step = *data.mutable_step();
+    step.set_step_id(stepID);
+    step.set_timepoint(currentT);
+    step.set_stepsize(deltaT);
+    Send(
+        coralproto::execution::MSG_STEP, data, slaves, timeout,
+        std::move(onComplete));
+}
+
+
+void SubMasterClient::AcceptStep(
+    const std::vector<std::string>& slaves,
+    std::chrono::milliseconds timeout,
+    ReplyHandler onComplete)
+{
+    coralproto::execution::RelayCommandData data;
+    Send(
+        coralproto::execution::MSG_ACCEPT_STEP, data, slaves, timeout,
+        std::move(onComplete));
+}
+
+
+void SubMasterClient::Send(
+    coralproto::execution::MessageType command,
+    coralproto::execution::RelayCommandData& data,
+    const std::vector<std::string>& slaves,
+    std::chrono::milliseconds timeout,
+    ReplyHandler onComplete)
+{
+    CORAL_PRECONDITION_CHECK(!Busy());
+    CORAL_INPUT_CHECK(onComplete);
+    for (const auto& s : slaves) data.add_control_endpoint(s);
+    data.set_timeout_ms(timeout >= std::chrono::milliseconds(0)
+        ? boost::numeric_cast<google::protobuf::int32>(timeout.count())
+        : -1);
+    std::vector<zmq::message_t> msg;
+    coral::protocol::execution::CreateMessage(msg, command, data);
+    m_socket.Send(msg);
+    m_onComplete = std::move(onComplete);
+    if (timeout >= std::chrono::milliseconds(0)) {
+        m_timeoutTimer = m_reactor.AddTimer(
+            timeout + CLIENT_TIMEOUT_MARGIN,
+            1,
+            [this] (coral::net::Reactor&, int)
+            {
+                m_timeoutTimer = -1;
+                OnReplyTimeout();
+            });
+    }
+}
+
+
+void SubMasterClient::OnReply()
+{
+    std::vector<zmq::message_t> msg;
+    m_socket.Receive(msg);
+    if (!m_onComplete) {
+        CORAL_LOG_DEBUG("SubMasterClient: Ignoring unexpected reply");
+        return;
+    }
+    const auto onComplete = std::move(m_onComplete);
+    m_onComplete = nullptr;
+    if (m_timeoutTimer >= 0) {
+        m_reactor.RemoveTimer(m_timeoutTimer);
+        m_timeoutTimer = -1;
+    }
+
+    std::vector<std::vector<zmq::message_t>> replies;
+    try {
+        if (coral::protocol::execution::NonErrorMessageType(msg)
+                    != coralproto::execution::MSG_RELAYED
+                || msg.size() != 2) {
+            throw coral::error::ProtocolViolationException(
+                "Invalid reply from sub-master");
+        }
+        coralproto::execution::RelayedRepliesData data;
+        coral::protobuf::ParseFromFrame(msg[1], data);
+        replies.resize(data.reply_size());
+        for (int i = 0; i < data.reply_size(); ++i) {
+            for (const auto& frame : data.reply(i).frame()) {
+                replies[i].push_back(coral::net::zmqx::ToFrame(frame));
+            }
+        }
+    } catch (const std::exception& e) {
+        coral::log::Log(
+            coral::log::error,
+            boost::format("Relayed command failed: %s") % e.what());
+        replies.clear();
+        onComplete(
+            make_error_code(coral::error::generic_error::operation_failed),
+            replies);
+        return;
+    }
+    onComplete(std::error_code(), replies);
+}
+
+
+void SubMasterClient::OnReplyTimeout()
+{
+    assert(m_onComplete);
+    coral::log::Log(
+        coral::log::error,
+        boost::format("Sub-master at %s did not reply in time") % m_endpoint.URL());
+    const auto onComplete = std::move(m_onComplete);
+    m_onComplete = nullptr;
+
+    // Start over with a new connection, so the reply to this request is
+    // dropped if it arrives after all.
+    m_reactor.RemoveSocket(m_socket.Socket());
+    m_socket.Close();
+    Connect();
+
+    std::vector<std::vector<zmq::message_t>> replies;
+    onComplete(std::make_error_code(std::errc::timed_out), replies);
+}
+
+
+void SubMasterClient::Connect()
+{
+    m_socket.Connect(m_endpoint);
+    m_reactor.AddSocket(
+        m_socket.Socket(),
+        [this] (coral::net::Reactor&, zmq::socket_t&) { OnReply(); });
+}
+
+
+}} // namespace
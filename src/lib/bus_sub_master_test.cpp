@@ -0,0 +1,181 @@
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <zmq.hpp>
+
+#include <coral/bus/sub_master.hpp>
+#include <coral/net.hpp>
+#include <coral/net/reactor.hpp>
+#include <coral/net/zmqx.hpp>
+#include <coral/protobuf.hpp>
+#include <coral/protocol/execution.hpp>
+
+#include <execution.pb.h>
+
+
+namespace
+{
+    // A slave which replies STEP_OK to STEP and READY to ACCEPT_STEP, unless
+    // it has been told to stay silent.
+    class FakeSlave
+    {
+    public:
+        FakeSlave(coral::net::Reactor& reactor, const std::string& endpoint)
+            : m_reactor(reactor)
+        {
+            m_socket.Bind(coral::net::Endpoint{endpoint});
+            m_reactor.AddSocket(
+                m_socket.Socket(),
+                [this] (coral::net::Reactor&, zmq::socket_t&) { OnRequest(); });
+        }
+
+        ~FakeSlave() { m_reactor.RemoveSocket(m_socket.Socket()); }
+
+        bool silent = false;
+        int lastStepID = -1;
+        int requestCount = 0;
+
+    private:
+        void OnRequest()
+        {
+            std::vector<zmq::message_t> msg;
+            m_socket.Receive(msg);
+            ++requestCount;
+            const auto type = coral::protocol::execution::ParseMessageType(msg.front());
+            if (type == coralproto::execution::MSG_STEP) {
+                coralproto::execution::StepData data;
+                coral::protobuf::ParseFromFrame(msg.at(1), data);
+                lastStepID = data.step_id();
+            }
+            if (silent) {
+                m_socket.Ignore();
+                return;
+            }
+            coral::protocol::execution::CreateMessage(msg,
+                type == coralproto::execution::MSG_STEP
+                    ? coralproto::execution::MSG_STEP_OK
+                    : coralproto::execution::MSG_READY);
+            m_socket.Send(msg);
+        }
+
+        coral::net::Reactor& m_reactor;
+        coral::net::zmqx::RepSocket m_socket;
+    };
+
+    const std::string SLAVE1 = "inproc://coral_bus_SubMaster_slave1";
+    const std::string SLAVE2 = "inproc://coral_bus_SubMaster_slave2";
+}
+
+
+TEST(coral_bus, SubMaster)
+{
+    coral::net::Reactor reactor;
+    FakeSlave slave1(reactor, SLAVE1);
+    FakeSlave slave2(reactor, SLAVE2);
+    coral::bus::SubMaster subMaster(
+        reactor,
+        coral::net::Endpoint{"inproc://coral_bus_SubMaster"});
+    coral::bus::SubMasterClient client(reactor, subMaster.BoundEndpoint());
+    EXPECT_FALSE(client.Busy());
+
+    // Normal STEP followed by ACCEPT_STEP
+    std::vector<int> replyTypes;
+    bool stepDone = false;
+    client.Step(
+        { SLAVE1, SLAVE2 }, 7, 1.0, 0.5, std::chrono::seconds(10),
+        [&] (const std::error_code& ec, std::vector<std::vector<zmq::message_t>>& replies)
+        {
+            EXPECT_FALSE(ec);
+            ASSERT_EQ(2u, replies.size());
+            for (const auto& r : replies) {
+                ASSERT_EQ(1u, r.size());
+                replyTypes.push_back(
+                    coral::protocol::execution::ParseMessageType(r.front()));
+            }
+            stepDone = true;
+
+            client.AcceptStep(
+                { SLAVE2, SLAVE1 }, std::chrono::seconds(10),
+                [&] (const std::error_code& ec, std::vector<std::vector<zmq::message_t>>& replies)
+                {
+                    EXPECT_FALSE(ec);
+                    ASSERT_EQ(2u, replies.size());
+                    for (const auto& r : replies) {
+                        ASSERT_EQ(1u, r.size());
+                        replyTypes.push_back(
+                            coral::protocol::execution::ParseMessageType(r.front()));
+                    }
+                    reactor.Stop();
+                });
+            EXPECT_TRUE(client.Busy());
+        });
+    EXPECT_TRUE(client.Busy());
+    reactor.Run();
+    EXPECT_TRUE(stepDone);
+    EXPECT_FALSE(client.Busy());
+    EXPECT_EQ(7, slave1.lastStepID);
+    EXPECT_EQ(7, slave2.lastStepID);
+    ASSERT_EQ(4u, replyTypes.size());
+    EXPECT_EQ(coralproto::execution::MSG_STEP_OK, replyTypes[0]);
+    EXPECT_EQ(coralproto::execution::MSG_STEP_OK, replyTypes[1]);
+    EXPECT_EQ(coralproto::execution::MSG_READY, replyTypes[2]);
+    EXPECT_EQ(coralproto::execution::MSG_READY, replyTypes[3]);
+
+    // A slave which doesn't reply in time is left out.
+    slave2.silent = true;
+    std::vector<std::size_t> replySizes;
+    client.Step(
+        { SLAVE1, SLAVE2 }, 8, 1.5, 0.5, std::chrono::milliseconds(100),
+        [&] (const std::error_code& ec, std::vector<std::vector<zmq::message_t>>& replies)
+        {
+            EXPECT_FALSE(ec);
+            for (const auto& r : replies) replySizes.push_back(r.size());
+            reactor.Stop();
+        });
+    reactor.Run();
+    ASSERT_EQ(2u, replySizes.size());
+    EXPECT_EQ(1u, replySizes[0]);
+    EXPECT_EQ(0u, replySizes[1]);
+    EXPECT_EQ(8, slave2.lastStepID);
+}
+
+
+TEST(coral_bus, SubMasterClientTimeout)
+{
+    // A sub-master which has stopped responding
+    coral::net::Reactor reactor;
+    coral::net::zmqx::RepSocket deadSubMaster;
+    deadSubMaster.Bind(coral::net::Endpoint{"inproc://coral_bus_SubMasterClientTimeout"});
+    int requestCount = 0;
+    reactor.AddSocket(
+        deadSubMaster.Socket(),
+        [&] (coral::net::Reactor&, zmq::socket_t&)
+        {
+            std::vector<zmq::message_t> msg;
+            deadSubMaster.Receive(msg);
+            deadSubMaster.Ignore();
+            ++requestCount;
+        });
+
+    coral::bus::SubMasterClient client(reactor, deadSubMaster.BoundEndpoint());
+    for (int i = 0; i < 2; ++i) {
+        bool failed = false;
+        client.Step(
+            { SLAVE1, SLAVE2 }, i, 1.0, 0.5, std::chrono::milliseconds(100),
+            [&] (const std::error_code& ec, std::vector<std::vector<zmq::message_t>>& replies)
+            {
+                EXPECT_EQ(std::errc::timed_out, ec);
+                EXPECT_TRUE(replies.empty());
+                failed = true;
+                reactor.Stop();
+            });
+        EXPECT_TRUE(client.Busy());
+        reactor.Run();
+        EXPECT_TRUE(failed);
+        EXPECT_FALSE(client.Busy());
+        EXPECT_EQ(i + 1, requestCount);
+    }
+    reactor.RemoveSocket(deadSubMaster.Socket());
+}
@@ -6,11 +6,27 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 */
 #include <coral/bus/variable_io.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
 #include <utility>
+#include <vector>
+
+#ifdef __linux__
+#   include <unistd.h>
+#endif
+
 #include <zmq.hpp>
 
+#include <coral/bus/shared_memory_ring.hpp>
 #include <coral/error.hpp>
 #include <coral/log.hpp>
+#include <coral/net/ip.hpp>
 #include <coral/net/zmqx.hpp>
 #include <coral/protocol/exe_data.hpp>
 
@@ -29,6 +45,68 @@ namespace
                 state ? "Not connected" : "Already connected");
         }
     }
+
+    const std::string SHARED_MEMORY_TRANSPORT = "shm";
+
+    // Identifies the network namespace of this process on Linux, where
+    // processes in different namespaces may share /dev/shm and still bind
+    // to the same addresses and ports.  Empty elsewhere.
+    std::string NetworkNamespace()
+    {
+        std::string id;
+#ifdef __linux__
+        char link[64];
+        const auto n = readlink("/proc/self/ns/net", link, sizeof link);
+        for (ssize_t i = 0; i < n; ++i) {
+            if (std::isdigit(static_cast<unsigned char>(link[i]))) id += link[i];
+        }
+#endif
+        return id;
+    }
+
+    // The name of the shared memory ring of the publisher which is bound to
+    // the given address and port.  These identify the publisher uniquely
+    // within a network namespace.
+    std::string RingName(
+        const coral::net::ip::Address& address,
+        const coral::net::ip::Port& port)
+    {
+        static const auto networkNamespace = NetworkNamespace();
+        std::string name = "coral-vars-";
+        if (!networkNamespace.empty()) name += networkNamespace + '-';
+        const auto addressString =
+            address.IsAnyAddress() || address.ToString() == "0.0.0.0"
+                ? std::string("any")
+                : address.ToString();
+        for (const char c : addressString) {
+            name += std::isalnum(static_cast<unsigned char>(c)) || c == '.' ? c : '_';
+        }
+        return name + '-' + port.ToString();
+    }
+
+    // The names under which the publisher at `tcpEndpoint` may have created
+    // its ring, most specific first.  The publisher may have bound to the
+    // wildcard address, while the subscriber knows one of the host's
+    // addresses.
+    std::vector<std::string> RingNameCandidates(const coral::net::Endpoint& tcpEndpoint)
+    {
+        const auto ipEndpoint = coral::net::ip::Endpoint{tcpEndpoint.Address()};
+        std::vector<std::string> names;
+        names.push_back(RingName(ipEndpoint.Address(), ipEndpoint.Port()));
+        const auto anyName = RingName(coral::net::ip::Address{}, ipEndpoint.Port());
+        if (anyName != names.front()) names.push_back(anyName);
+        return names;
+    }
+}
+
+
+coral::net::Endpoint SharedMemoryEndpoint(
+    const coral::net::Endpoint& dataPubEndpoint)
+{
+    CORAL_INPUT_CHECK(dataPubEndpoint.Transport() == "tcp");
+    return coral::net::Endpoint{
+        SHARED_MEMORY_TRANSPORT,
+        dataPubEndpoint.Address()};
 }
 
 
@@ -37,13 +115,18 @@ namespace
 // =============================================================================
 
 VariablePublisher::VariablePublisher()
+    : m_encoding(PROTOBUF_VARIABLE_ENCODING)
+    , m_tcpSubscriptions(0)
 { }
 
 
 void VariablePublisher::Bind(const coral::net::Endpoint& endpoint)
 {
     EnforceConnected(m_socket, false);
-    m_socket = std::make_unique<zmq::socket_t>(coral::net::zmqx::GlobalContext(), ZMQ_PUB);
+    // An XPUB socket tells us about subscriptions, so we know when nobody
+    // is listening on it.
+    m_socket = std::make_unique<zmq::socket_t>(coral::net::zmqx::GlobalContext(), ZMQ_XPUB);
+    m_tcpSubscriptions = 0;
     try {
         m_socket->setsockopt(ZMQ_SNDHWM, 0);
         m_socket->setsockopt(ZMQ_RCVHWM, 0);
@@ -53,6 +136,21 @@ void VariablePublisher::Bind(const coral::net::Endpoint& endpoint)
         m_socket.reset();
         throw;
     }
+
+    // The ring is only a supplement to the socket, so we can do without it.
+    const auto boundEndpoint = BoundEndpoint();
+    if (boundEndpoint.Transport() == "tcp") {
+        try {
+            const auto ipEndpoint =
+                coral::net::ip::Endpoint{boundEndpoint.Address()};
+            m_ring = std::make_shared<SharedMemoryRingWriter>(
+                RingName(ipEndpoint.Address(), ipEndpoint.Port()));
+        } catch (const std::exception& e) {
+            coral::log::Log(coral::log::warning, boost::format(
+                "Variable values will not be available through shared memory: %s")
+                % e.what());
+        }
+    }
 }
 
 
@@ -63,6 +161,18 @@ coral::net::Endpoint VariablePublisher::BoundEndpoint() const
 }
 
 
+void VariablePublisher::SetEncoding(VariableEncoding encoding) noexcept
+{
+    m_encoding = encoding;
+}
+
+
+VariableEncoding VariablePublisher::Encoding() const noexcept
+{
+    return m_encoding;
+}
+
+
 void VariablePublisher::Publish(
     coral::model::StepID stepID,
     coral::model::SlaveID slaveID,
@@ -70,14 +180,124 @@ void VariablePublisher::Publish(
     coral::model::ScalarValue value)
 {
     EnforceConnected(m_socket, true);
+    if (!HasListeners()) return;
     coral::protocol::exe_data::Message m = {
         coral::model::Variable(slaveID, variableID),
         stepID,
         value
     };
     std::vector<zmq::message_t> d;
-    coral::protocol::exe_data::CreateMessage(m, d);
-    coral::net::zmqx::Send(*m_socket, d);
+    if (m_encoding == BINARY_VARIABLE_ENCODING) {
+        coral::protocol::exe_data::CreateBinaryMessage(m, d);
+    } else {
+        coral::protocol::exe_data::CreateMessage(m, d);
+    }
+    Send(stepID, d);
+}
+
+
+void VariablePublisher::Publish(
+    coral::model::StepID stepID,
+    coral::model::SlaveID slaveID,
+    const coral::model::VariableID* variableIDs,
+    const coral::model::ScalarValue* values,
+    std::size_t count)
+{
+    EnforceConnected(m_socket, true);
+    if (!HasListeners()) return;
+    coral::protocol::exe_data::BatchMessage m;
+    m.slaveID = slaveID;
+    m.timestepID = stepID;
+    m.values.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        m.values.emplace_back(variableIDs[i], values[i]);
+    }
+    std::vector<zmq::message_t> d;
+    if (m_encoding == BINARY_VARIABLE_ENCODING) {
+        coral::protocol::exe_data::CreateBinaryBatchMessage(m, d);
+    } else {
+        coral::protocol::exe_data::CreateBatchMessage(m, d);
+    }
+    Send(stepID, d);
+}
+
+
+namespace
+{
+    template<typename T>
+    void AddColumn(
+        const coral::model::ValueColumn<T>& column,
+        coral::protocol::exe_data::BatchMessage& batch)
+    {
+        for (std::size_t i = 0; i < column.Size(); ++i) {
+            batch.values.emplace_back(column.ID(i), column.Value(i));
+        }
+    }
+}
+
+
+void VariablePublisher::Publish(
+    coral::model::StepID stepID,
+    coral::model::SlaveID slaveID,
+    const coral::model::ValueBlock& values)
+{
+    EnforceConnected(m_socket, true);
+    if (!HasListeners()) return;
+    std::vector<zmq::message_t> d;
+    if (m_encoding == BINARY_VARIABLE_ENCODING) {
+        coral::protocol::exe_data::CreateBinaryBatchMessage(
+            slaveID, stepID, values, d);
+    } else {
+        coral::protocol::exe_data::BatchMessage m;
+        m.slaveID = slaveID;
+        m.timestepID = stepID;
+        m.values.reserve(values.Size());
+        AddColumn(values.Reals(), m);
+        AddColumn(values.Integers(), m);
+        AddColumn(values.Booleans(), m);
+        AddColumn(values.Strings(), m);
+        coral::protocol::exe_data::CreateBatchMessage(m, d);
+    }
+    Send(stepID, d);
+}
+
+
+void VariablePublisher::Send(
+    coral::model::StepID stepID,
+    std::vector<zmq::message_t>& msg)
+{
+    if (m_ring && m_ring->HasReaders()) {
+        assert(msg.size() == 2);
+        m_ring->Write(
+            stepID,
+            msg[0].data(), msg[0].size(),
+            msg[1].data(), msg[1].size());
+    }
+    if (HasTcpSubscribers()) coral::net::zmqx::Send(*m_socket, msg);
+}
+
+
+bool VariablePublisher::HasListeners()
+{
+    return (m_ring && m_ring->HasReaders()) || HasTcpSubscribers();
+}
+
+
+bool VariablePublisher::HasTcpSubscribers()
+{
+    // The socket reports each topic once when it gets its first subscriber
+    // and once when it loses its last, so a count is all we need.
+    zmq::message_t msg;
+    while (m_socket->recv(&msg, ZMQ_DONTWAIT)) {
+        if (msg.size() == 0) continue;
+        const auto marker = static_cast<const char*>(msg.data())[0];
+        if (marker == 1) {
+            ++m_tcpSubscriptions;
+        } else if (marker == 0 && m_tcpSubscriptions > 0) {
+            --m_tcpSubscriptions;
+        }
+    }
+    return m_tcpSubscriptions > 0;
 }
 
 
@@ -86,8 +306,85 @@ void VariablePublisher::Publish(
 // =============================================================================
 
 
+namespace
+{
+    // The initial number of values that can be queued per subscription.
+    // Normally, we only ever need room for the current and the next time
+    // step, plus one for each step of delay.
+    const std::size_t INITIAL_RING_CAPACITY = 2;
+
+    const std::size_t NO_SLOT = std::size_t(-1);
+
+    // The longest time WaitForData() sleeps between checks of the shared
+    // memory rings.
+    const auto MAX_LOCAL_POLL_INTERVAL = std::chrono::microseconds(100);
+
+    // Returns whether a socket has incoming messages, without blocking.
+    bool HasIncoming(zmq::socket_t& socket)
+    {
+        int events = 0;
+        std::size_t len = sizeof(events);
+        socket.getsockopt(ZMQ_EVENTS, &events, &len);
+        return (events & ZMQ_POLLIN) != 0;
+    }
+
+#ifdef ZMQ_EVENT_HANDSHAKE_SUCCEEDED
+    // Newer ZMQ versions tell us when the handshake is complete, at which
+    // point our subscriptions are on their way to the publisher.
+    const int PEER_CONNECTED_EVENT = ZMQ_EVENT_HANDSHAKE_SUCCEEDED;
+#else
+    const int PEER_CONNECTED_EVENT = ZMQ_EVENT_CONNECTED;
+#endif
+
+    // Starts monitoring `socket` for established connections, and returns
+    // a socket on which the events can be received.
+    std::unique_ptr<zmq::socket_t> MonitorConnections(zmq::socket_t& socket)
+    {
+        static std::atomic<unsigned> monitorCount{0};
+        const auto endpoint = "inproc://coral.bus.VariableSubscriber.monitor."
+            + std::to_string(++monitorCount);
+        if (zmq_socket_monitor(
+                static_cast<void*>(socket),
+                endpoint.c_str(),
+                PEER_CONNECTED_EVENT) != 0) {
+            throw zmq::error_t();
+        }
+        auto monitor = std::make_unique<zmq::socket_t>(
+            coral::net::zmqx::GlobalContext(),
+            ZMQ_PAIR);
+        monitor->setsockopt(ZMQ_LINGER, 0);
+        monitor->connect(endpoint.c_str());
+        return monitor;
+    }
+
+    // Returns whether a connection event for `eventAddress` may be for the
+    // peer at `url`.  Depending on its version, ZMQ reports either the URL
+    // we connected to or the address it resolved the host name to, so a
+    // peer which is given by name is matched on its port alone.
+    bool IsEventForPeer(const std::string& eventAddress, const std::string& url)
+    {
+        if (eventAddress == url) return true;
+        try {
+            const auto peer = coral::net::ip::Endpoint{
+                coral::net::Endpoint{url}.Address()};
+            const auto event = coral::net::ip::Endpoint{
+                coral::net::Endpoint{eventAddress}.Address()};
+            return peer.Address().IsName()
+                && peer.Port().ToString() == event.Port().ToString();
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+}
+
+
 VariableSubscriber::VariableSubscriber()
-    : m_currentStepID(coral::model::INVALID_STEP_ID)
+    : m_currentStepID(coral::model::INVALID_STEP_ID),
+      m_ignoreDelays(false),
+      m_maxDelay(0),
+      m_ringCapacity(INITIAL_RING_CAPACITY),
+      m_spinBudget(0),
+      m_batch(std::make_shared<coral::protocol::exe_data::BatchMessage>())
 { }
 
 
@@ -95,88 +392,474 @@ void VariableSubscriber::Connect(
     const coral::net::Endpoint* endpoints,
     std::size_t endpointsSize)
 {
+    m_localPeers.clear();
+    m_monitor.reset();
+    m_pendingPeers.clear();
     m_socket = std::make_unique<zmq::socket_t>(coral::net::zmqx::GlobalContext(), ZMQ_SUB);
     try {
         m_socket->setsockopt(ZMQ_SNDHWM, 0);
         m_socket->setsockopt(ZMQ_RCVHWM, 0);
         m_socket->setsockopt(ZMQ_LINGER, 0);
+        m_monitor = MonitorConnections(*m_socket);
         for (std::size_t i = 0; i < endpointsSize; ++i) {
-            m_socket->connect(endpoints[i].URL().c_str());
+            AddPeer(endpoints[i]);
         }
-        for (const auto& variable : m_values) {
-            coral::protocol::exe_data::Subscribe(*m_socket, variable.first);
+        for (const auto& sub : m_subscriptions) {
+            if (sub.variable.Empty()) continue;
+            coral::protocol::exe_data::Subscribe(*m_socket, sub.variable);
+            coral::protocol::exe_data::SubscribeBatch(
+                *m_socket, sub.variable.Slave());
         }
     } catch (...) {
+        m_localPeers.clear();
+        m_monitor.reset();
         m_socket.reset();
         throw;
     }
 }
 
 
-void VariableSubscriber::Subscribe(const coral::model::Variable& variable)
+void VariableSubscriber::ConnectTo(const coral::net::Endpoint& endpoint)
+{
+    EnforceConnected(m_socket, true);
+    AddPeer(endpoint);
+}
+
+
+void VariableSubscriber::DisconnectFrom(const coral::net::Endpoint& endpoint)
+{
+    EnforceConnected(m_socket, true);
+    if (endpoint.Transport() == SHARED_MEMORY_TRANSPORT) {
+        const auto url = endpoint.URL();
+        const auto peer = std::find_if(
+            m_localPeers.begin(), m_localPeers.end(),
+            [&url] (const LocalPeer& p) { return p.endpoint == url; });
+        if (peer != m_localPeers.end()) {
+            m_localPeers.erase(peer);
+        } else {
+            // We must have fallen back to TCP in AddPeer().
+            const auto tcpURL = coral::net::Endpoint{"tcp", endpoint.Address()}.URL();
+            m_socket->disconnect(tcpURL.c_str());
+            m_pendingPeers.erase(tcpURL);
+        }
+    } else {
+        m_socket->disconnect(endpoint.URL().c_str());
+        m_pendingPeers.erase(endpoint.URL());
+    }
+}
+
+
+void VariableSubscriber::AddPeer(const coral::net::Endpoint& endpoint)
+{
+    if (endpoint.Transport() != SHARED_MEMORY_TRANSPORT) {
+        m_socket->connect(endpoint.URL().c_str());
+        if (endpoint.Transport() == "tcp") m_pendingPeers.insert(endpoint.URL());
+        return;
+    }
+    const auto tcpEndpoint = coral::net::Endpoint{"tcp", endpoint.Address()};
+    for (const auto& ringName : RingNameCandidates(tcpEndpoint)) {
+        try {
+            LocalPeer peer = {
+                endpoint.URL(),
+                std::make_shared<SharedMemoryRingReader>(ringName)
+            };
+            m_localPeers.push_back(std::move(peer));
+            return;
+        } catch (const std::runtime_error& e) {
+            CORAL_LOG_DEBUG(
+                boost::format("Shared memory ring for %s not available: %s")
+                % tcpEndpoint.URL() % e.what());
+        }
+    }
+    CORAL_LOG_DEBUG(
+        boost::format("Connecting to %s over TCP instead of shared memory")
+        % tcpEndpoint.URL());
+    m_socket->connect(tcpEndpoint.URL().c_str());
+    m_pendingPeers.insert(tcpEndpoint.URL());
+}
+
+
+bool VariableSubscriber::WaitForPeers(std::chrono::milliseconds timeout)
+{
+    EnforceConnected(m_socket, true);
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::vector<zmq::message_t> event;
+    while (!m_pendingPeers.empty()) {
+        auto remaining = std::chrono::milliseconds(-1);
+        if (timeout >= std::chrono::milliseconds(0)) {
+            remaining = std::max(
+                std::chrono::milliseconds(0),
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()));
+        }
+        if (!coral::net::zmqx::WaitForIncoming(*m_monitor, remaining)) {
+            return false;
+        }
+        // The first frame of an event starts with a 16-bit event number,
+        // and the second contains the address of the peer.  Reconnections,
+        // and connections to peers we have since disconnected from, are not
+        // pending, so they don't count.
+        coral::net::zmqx::Receive(*m_monitor, event);
+        std::uint16_t eventNumber = 0;
+        if (event.size() < 2 || event[0].size() < sizeof eventNumber) continue;
+        std::memcpy(&eventNumber, event[0].data(), sizeof eventNumber);
+        if (eventNumber != PEER_CONNECTED_EVENT) continue;
+        const auto address = std::string(
+            static_cast<const char*>(event[1].data()),
+            event[1].size());
+        auto peer = m_pendingPeers.find(address);
+        if (peer == m_pendingPeers.end()) {
+            peer = std::find_if(
+                m_pendingPeers.begin(), m_pendingPeers.end(),
+                [&address] (const std::string& url) {
+                    return IsEventForPeer(address, url);
+                });
+        }
+        if (peer != m_pendingPeers.end()) m_pendingPeers.erase(peer);
+    }
+    return true;
+}
+
+
+std::size_t VariableSubscriber::Subscribe(
+    const coral::model::Variable& variable,
+    int delay)
 {
+    CORAL_INPUT_CHECK(delay >= 0);
     EnforceConnected(m_socket, true);
+    const auto existing = m_index.find(variable);
+    if (existing != m_index.end()) {
+        CORAL_INPUT_CHECK(m_subscriptions[existing->second].delay == delay);
+        return existing->second;
+    }
+
+    Subscription sub = { variable, delay, 0, 0 };
+    std::size_t slot;
+    if (m_freeSlots.empty()) {
+        slot = m_subscriptions.size();
+        m_ringSteps.resize(m_ringSteps.size() + m_ringCapacity);
+        m_ringValues.resize(m_ringValues.size() + m_ringCapacity);
+        m_subscriptions.push_back(sub);
+    } else {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        m_subscriptions[slot] = sub;
+    }
+    m_index.insert(std::make_pair(variable, slot));
+    if (delay > m_maxDelay) m_maxDelay = delay;
+
+    // We don't know which data format the publisher uses, so we
+    // subscribe to both.  Batch subscriptions are reference counted by
+    // ZMQ, so we simply make one for each variable.
     coral::protocol::exe_data::Subscribe(*m_socket, variable);
-    m_values.insert(std::make_pair(variable, ValueQueue()));
+    coral::protocol::exe_data::SubscribeBatch(*m_socket, variable.Slave());
+    return slot;
 }
 
 
 void VariableSubscriber::Unsubscribe(const coral::model::Variable& variable)
 {
     EnforceConnected(m_socket, true);
-    if (m_values.erase(variable)) {
-        coral::protocol::exe_data::Unsubscribe(*m_socket, variable);
+    const auto it = m_index.find(variable);
+    if (it == m_index.end()) return;
+
+    // The slot's ring buffer is left allocated for whichever subscription
+    // gets the slot next.
+    const auto slot = it->second;
+    m_index.erase(it);
+    m_subscriptions[slot] = Subscription{ coral::model::Variable(), 0, 0, 0 };
+    m_freeSlots.push_back(slot);
+    m_maxDelay = 0;
+    for (const auto& sub : m_subscriptions) {
+        if (sub.delay > m_maxDelay) m_maxDelay = sub.delay;
     }
+
+    coral::protocol::exe_data::Unsubscribe(*m_socket, variable);
+    coral::protocol::exe_data::UnsubscribeBatch(*m_socket, variable.Slave());
 }
 
 
 bool VariableSubscriber::Update(
     coral::model::StepID stepID,
-    std::chrono::milliseconds timeout)
+    std::chrono::milliseconds timeout,
+    bool ignoreDelays)
 {
     CORAL_PRECONDITION_CHECK(stepID >= m_currentStepID);
     m_currentStepID = stepID;
+    m_ignoreDelays = ignoreDelays;
+
+    // Messages from before this step are of no interest to any subscription.
+    const auto oldestStepID = ignoreDelays
+        ? m_currentStepID
+        : m_currentStepID - m_maxDelay;
 
-    std::vector<zmq::message_t> rawMsg;
-    for (auto& entry : m_values) {
-        auto& valQueue = entry.second;
+    for (std::size_t index = 0; index < m_subscriptions.size(); ++index) {
+        auto& sub = m_subscriptions[index];
+        if (sub.variable.Empty()) continue;
+        const auto dueStepID = DueStepID(sub);
         // Pop off old data
-        while (!valQueue.empty() && valQueue.front().first < m_currentStepID) {
-            valQueue.pop();
+        while (sub.size > 0
+                && m_ringSteps[index*m_ringCapacity + sub.head] < dueStepID) {
+            sub.head = (sub.head + 1) % m_ringCapacity;
+            --sub.size;
         }
         // If necessary, wait for new data
-        while (valQueue.empty()) {
-            if (!coral::net::zmqx::WaitForIncoming(*m_socket, timeout)) {
+        while (sub.size == 0) {
+            if (ReceiveLocal(oldestStepID)) continue;
+            if (!WaitForData(timeout)) {
                 CORAL_LOG_DEBUG(
                     boost::format("Timeout waiting for variable %d from slave %d")
-                    % entry.first.ID() % entry.first.Slave());
+                    % sub.variable.ID() % sub.variable.Slave());
                 return false;
             }
-            coral::net::zmqx::Receive(*m_socket, rawMsg);
-            const auto msg = coral::protocol::exe_data::ParseMessage(rawMsg);
-            // Queue the variable value iff it is from the current (or a newer)
-            // timestep and it is one we're listening for. (Wrt. the latter,
-            // unsubscriptions may take time to come into effect.)
-            if (msg.timestepID >= m_currentStepID) {
-                auto it = m_values.find(msg.variable);
-                if (it != m_values.end()) {
-                    it->second.emplace(msg.timestepID, msg.value);
-                }
-            }
+            if (!m_localPeers.empty() && !HasIncoming(*m_socket)) continue;
+            coral::net::zmqx::Receive(*m_socket, m_rawMsg);
+            ReceiveMessage(m_rawMsg, oldestStepID);
         }
     }
     return true;
 }
 
 
+bool VariableSubscriber::WaitForData(std::chrono::milliseconds timeout)
+{
+    if (m_localPeers.empty()) {
+        return coral::net::zmqx::WaitForIncoming(
+            *m_socket, timeout, m_spinBudget, &m_pollStats);
+    }
+
+    // The shared memory rings can't be polled along with the socket, so we
+    // check them all in turn: continuously for as long as the spin budget
+    // allows, and then with increasingly long sleeps in between.
+    const auto t0 = std::chrono::steady_clock::now();
+    const auto spinEnd = t0 + m_spinBudget;
+    auto sleepTime = std::chrono::microseconds(1);
+    for (;;) {
+        bool ready = HasIncoming(*m_socket);
+        for (const auto& peer : m_localPeers) {
+            if (ready) break;
+            ready = peer.ring->HasData();
+        }
+        const auto t1 = std::chrono::steady_clock::now();
+        if (ready
+                || (timeout >= std::chrono::milliseconds(0) && t1 - t0 >= timeout)) {
+            if (ready && t1 < spinEnd) {
+                m_pollStats.spinTime += t1 - t0;
+                ++m_pollStats.spinWakeups;
+            } else {
+                const auto t = std::min(t1, spinEnd);
+                m_pollStats.spinTime += t - t0;
+                m_pollStats.sleepTime += t1 - t;
+                ++m_pollStats.sleepWakeups;
+            }
+            return ready;
+        }
+        if (t1 >= spinEnd) {
+            std::this_thread::sleep_for(sleepTime);
+            sleepTime = std::min(2 * sleepTime, MAX_LOCAL_POLL_INTERVAL);
+        }
+    }
+}
+
+
+bool VariableSubscriber::ReceiveLocal(coral::model::StepID oldestStepID)
+{
+    bool received = false;
+    SharedMemoryRingReader::Message msg;
+    for (auto& peer : m_localPeers) {
+        while (peer.ring->Next(msg)) {
+            received = true;
+            if (msg.stepID < oldestStepID) continue;
+            if (msg.bodySize > 0
+                    && static_cast<std::uint8_t>(*msg.body)
+                        == coral::protocol::exe_data::BINARY_FORMAT_VERSION) {
+                ReceiveBinary(
+                    msg.header, msg.headerSize, msg.body, msg.bodySize,
+                    oldestStepID);
+            } else {
+                m_rawMsg.clear();
+                m_rawMsg.emplace_back(msg.header, msg.headerSize);
+                m_rawMsg.emplace_back(msg.body, msg.bodySize);
+                ReceiveMessage(m_rawMsg, oldestStepID);
+            }
+        }
+    }
+    return received;
+}
+
+
+void VariableSubscriber::ReceiveMessage(
+    const std::vector<zmq::message_t>& rawMsg,
+    coral::model::StepID oldestStepID)
+{
+    if (coral::protocol::exe_data::IsBinaryMessage(rawMsg)) {
+        ReceiveBinary(
+            static_cast<const char*>(rawMsg[0].data()), rawMsg[0].size(),
+            static_cast<const char*>(rawMsg[1].data()), rawMsg[1].size(),
+            oldestStepID);
+    } else if (coral::protocol::exe_data::IsBatchMessage(rawMsg)) {
+        auto& batch = *m_batch;
+        coral::protocol::exe_data::ParseBatchMessage(rawMsg, batch);
+        if (batch.timestepID < oldestStepID) return;
+        for (const auto& value : batch.values) {
+            Enqueue(
+                coral::model::Variable(batch.slaveID, value.first),
+                batch.timestepID,
+                value.second);
+        }
+    } else {
+        const auto msg = coral::protocol::exe_data::ParseMessage(rawMsg);
+        Enqueue(msg.variable, msg.timestepID, msg.value);
+    }
+}
+
+
+void VariableSubscriber::ReceiveBinary(
+    const char* header,
+    std::size_t headerSize,
+    const char* body,
+    std::size_t bodySize,
+    coral::model::StepID oldestStepID)
+{
+    // Read the values straight out of the message buffer and into the
+    // value store, without going via a temporary ScalarValue.
+    coral::protocol::exe_data::BinaryMessageReader reader(
+        header, headerSize, body, bodySize);
+    if (reader.TimestepID() < oldestStepID) return;
+    while (reader.Next()) {
+        const auto pos = EnqueueSlot(
+            coral::model::Variable(reader.Slave(), reader.VariableID()),
+            reader.TimestepID());
+        if (pos == NO_SLOT) continue;
+        switch (reader.DataType()) {
+            case coral::model::REAL_DATATYPE:
+                m_ringValues[pos] = reader.RealValue();
+                break;
+            case coral::model::INTEGER_DATATYPE:
+                m_ringValues[pos] = reader.IntegerValue();
+                break;
+            case coral::model::BOOLEAN_DATATYPE:
+                m_ringValues[pos] = reader.BooleanValue();
+                break;
+            default:
+                m_ringValues[pos] = reader.Value();
+        }
+    }
+}
+
+
+void VariableSubscriber::Enqueue(
+    const coral::model::Variable& variable,
+    coral::model::StepID stepID,
+    const coral::model::ScalarValue& value)
+{
+    const auto pos = EnqueueSlot(variable, stepID);
+    if (pos != NO_SLOT) m_ringValues[pos] = value;
+}
+
+
+std::size_t VariableSubscriber::EnqueueSlot(
+    const coral::model::Variable& variable,
+    coral::model::StepID stepID)
+{
+    // Queue the variable value iff it is one we're listening for and it is
+    // from the time step that is currently due (or a newer one). (Wrt. the
+    // former, unsubscriptions may take time to come into effect, and batches
+    // generally contain more variables than we are interested in.)
+    const auto it = m_index.find(variable);
+    if (it == m_index.end()) return NO_SLOT;
+    const auto index = it->second;
+    auto& sub = m_subscriptions[index];
+    if (stepID < DueStepID(sub)) return NO_SLOT;
+
+    // If we already have a value for this time step (e.g. because it was
+    // resent), it is simply replaced.  Values normally arrive in step order,
+    // so we search from the back.
+    for (std::size_t i = sub.size; i > 0; --i) {
+        const auto pos = index*m_ringCapacity + (sub.head + i - 1) % m_ringCapacity;
+        if (m_ringSteps[pos] == stepID) return pos;
+        if (m_ringSteps[pos] < stepID) break;
+    }
+    if (sub.size == m_ringCapacity) GrowRings();
+
+    const auto pos = index*m_ringCapacity + (sub.head + sub.size) % m_ringCapacity;
+    m_ringSteps[pos] = stepID;
+    ++sub.size;
+    return pos;
+}
+
+
+coral::model::StepID VariableSubscriber::DueStepID(const Subscription& sub)
+    const noexcept
+{
+    return m_ignoreDelays ? m_currentStepID : m_currentStepID - sub.delay;
+}
+
+
+void VariableSubscriber::GrowRings()
+{
+    const auto newCapacity = 2 * m_ringCapacity;
+    std::vector<coral::model::StepID> newSteps(
+        m_subscriptions.size() * newCapacity);
+    std::vector<coral::model::ScalarValue> newValues(
+        m_subscriptions.size() * newCapacity);
+    for (std::size_t index = 0; index < m_subscriptions.size(); ++index) {
+        auto& sub = m_subscriptions[index];
+        for (std::size_t i = 0; i < sub.size; ++i) {
+            const auto oldPos = index*m_ringCapacity + (sub.head + i) % m_ringCapacity;
+            newSteps[index*newCapacity + i] = m_ringSteps[oldPos];
+            std::swap(newValues[index*newCapacity + i], m_ringValues[oldPos]);
+        }
+        sub.head = 0;
+    }
+    m_ringCapacity = newCapacity;
+    m_ringSteps.swap(newSteps);
+    m_ringValues.swap(newValues);
+}
+
+
 const coral::model::ScalarValue& VariableSubscriber::Value(
    const coral::model::Variable& variable) const
 {
-    const auto& valQueue = m_values.at(variable);
-    if (valQueue.empty()) {
+    return Value(m_index.at(variable));
+}
+
+
+const coral::model::ScalarValue& VariableSubscriber::Value(std::size_t slot)
+    const
+{
+    assert(slot < m_subscriptions.size());
+    const auto& sub = m_subscriptions[slot];
+    if (sub.size == 0) {
         throw std::logic_error("Variable not updated yet");
     }
-    return valQueue.front().second;
+    return m_ringValues[slot*m_ringCapacity + sub.head];
+}
+
+
+zmq::socket_t& VariableSubscriber::Socket()
+{
+    EnforceConnected(m_socket, true);
+    return *m_socket;
+}
+
+
+bool VariableSubscriber::HasLocalPeers() const noexcept
+{
+    return !m_localPeers.empty();
+}
+
+
+void VariableSubscriber::SetSpinBudget(std::chrono::microseconds spinBudget)
+    noexcept
+{
+    m_spinBudget = spinBudget;
+}
+
+
+const coral::net::BusyPollStats& VariableSubscriber::PollStats() const noexcept
+{
+    return m_pollStats;
 }
 
 }} // header guard
@@ -100,6 +100,443 @@ TEST(coral_bus, VariablePublishSubscribe)
 }
 
 
+TEST(coral_bus, VariableSubscriberSlots)
+{
+    const coral::model::SlaveID slaveID = 1;
+    const auto varX = coral::model::Variable(slaveID, 100);
+    const auto varY = coral::model::Variable(slaveID, 200);
+    const auto varZ = coral::model::Variable(slaveID, 300);
+
+    auto pub = coral::bus::VariablePublisher();
+    pub.Bind(coral::net::Endpoint{"tcp://*:*"});
+
+    auto inetEndpoint = coral::net::ip::Endpoint{pub.BoundEndpoint().Address()};
+    inetEndpoint.SetAddress(coral::net::ip::Address{"localhost"});
+    const auto endpoint = inetEndpoint.ToEndpoint("tcp");
+
+    auto sub = coral::bus::VariableSubscriber();
+    sub.Connect(&endpoint, 1);
+    const auto slotX = sub.Subscribe(varX);
+    const auto slotY = sub.Subscribe(varY);
+    EXPECT_NE(slotX, slotY);
+    EXPECT_EQ(slotX, sub.Subscribe(varX));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    coral::model::StepID t = 0;
+    pub.Publish(t, slaveID, varX.ID(), 1);
+    pub.Publish(t, slaveID, varY.ID(), 2);
+    ASSERT_TRUE(sub.Update(t, std::chrono::seconds(1)));
+    EXPECT_EQ(1, boost::get<int>(sub.Value(slotX)));
+    EXPECT_EQ(2, boost::get<int>(sub.Value(slotY)));
+
+    // A freed slot is reused, and doesn't carry over the old value, while
+    // the other subscription keeps its slot.
+    sub.Unsubscribe(varX);
+    const auto slotZ = sub.Subscribe(varZ);
+    EXPECT_EQ(slotX, slotZ);
+    EXPECT_THROW(sub.Value(slotZ), std::logic_error);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    ++t;
+    pub.Publish(t, slaveID, varX.ID(), 10);
+    pub.Publish(t, slaveID, varY.ID(), 20);
+    pub.Publish(t, slaveID, varZ.ID(), 30);
+    ASSERT_TRUE(sub.Update(t, std::chrono::seconds(1)));
+    EXPECT_EQ(20, boost::get<int>(sub.Value(slotY)));
+    EXPECT_EQ(30, boost::get<int>(sub.Value(slotZ)));
+    EXPECT_EQ(30, boost::get<int>(sub.Value(varZ)));
+    EXPECT_THROW(sub.Value(varX), std::logic_error);
+}
+
+
+TEST(coral_bus, VariablePublishSubscribeBatch)
+{
+    const coral::model::SlaveID slaveID = 1;
+    const coral::model::VariableID varXID = 100;
+    const coral::model::VariableID varYID = 200;
+    const coral::model::VariableID varZID = 300;
+    const auto varX = coral::model::Variable(slaveID, varXID);
+    const auto varY = coral::model::Variable(slaveID, varYID);
+
+    auto pub = coral::bus::VariablePublisher();
+    pub.Bind(coral::net::Endpoint{"tcp://*:*"});
+
+    auto inetEndpoint = coral::net::ip::Endpoint{pub.BoundEndpoint().Address()};
+    inetEndpoint.SetAddress(coral::net::ip::Address{"localhost"});
+    const auto endpoint = inetEndpoint.ToEndpoint("tcp");
+
+    auto sub = coral::bus::VariableSubscriber();
+    sub.Connect(&endpoint, 1);
+    sub.Subscribe(varX);
+    sub.Subscribe(varY);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // A batch which contains a variable we're not interested in
+    const coral::model::VariableID ids[3] = { varXID, varYID, varZID };
+    const coral::model::ScalarValue values[3] = { 1.0, 2, true };
+    coral::model::StepID t = 0;
+    pub.Publish(t, slaveID, ids, values, 3);
+    ASSERT_TRUE(sub.Update(t, std::chrono::seconds(1)));
+    EXPECT_EQ(1.0, boost::get<double>(sub.Value(varX)));
+    EXPECT_EQ(2, boost::get<int>(sub.Value(varY)));
+
+    // Old batches are discarded, and batches may be mixed with individual
+    // values.
+    ++t;
+    pub.Publish(t-1, slaveID, ids, values, 2);
+    pub.Publish(t, slaveID, varXID, 3.0);
+    const coral::model::ScalarValue newValues[1] = { 4 };
+    pub.Publish(t, slaveID, ids + 1, newValues, 1);
+    ASSERT_TRUE(sub.Update(t, std::chrono::seconds(1)));
+    EXPECT_EQ(3.0, boost::get<double>(sub.Value(varX)));
+    EXPECT_EQ(4, boost::get<int>(sub.Value(varY)));
+
+    // Unsubscribing from one variable doesn't affect the others
+    ++t;
+    sub.Unsubscribe(varX);
+    pub.Publish(t, slaveID, ids, values, 3);
+    ASSERT_TRUE(sub.Update(t, std::chrono::seconds(1)));
+    EXPECT_THROW(sub.Value(varX), std::logic_error);
+    EXPECT_EQ(2, boost::get<int>(sub.Value(varY)));
+}
+
+
+TEST(coral_bus, VariablePublishSubscribeBinary)
+{
+    const coral::model::SlaveID slaveID = 1;
+    const coral::model::VariableID varXID = 100;
+    const coral::model::VariableID varYID = 200;
+    const auto varX = coral::model::Variable(slaveID, varXID);
+    const auto varY = coral::model::Variable(slaveID, varYID);
+
+    auto pub = coral::bus::VariablePublisher();
+    pub.Bind(coral::net::Endpoint{"tcp://*:*"});
+    EXPECT_EQ(coral::bus::PROTOBUF_VARIABLE_ENCODING, pub.Encoding());
+    pub.SetEncoding(coral::bus::BINARY_VARIABLE_ENCODING);
+    EXPECT_EQ(coral::bus::BINARY_VARIABLE_ENCODING, pub.Encoding());
+
+    auto inetEndpoint = coral::net::ip::Endpoint{pub.BoundEndpoint().Address()};
+    inetEndpoint.SetAddress(coral::net::ip::Address{"localhost"});
+    const auto endpoint = inetEndpoint.ToEndpoint("tcp");
+
+    auto sub = coral::bus::VariableSubscriber();
+    sub.Connect(&endpoint, 1);
+    sub.Subscribe(varX);
+    sub.Subscribe(varY);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Single values and batches in the binary encoding
+    coral::model::StepID t = 0;
+    pub.Publish(t, slaveID, varXID, 1.5);
+    pub.Publish(t, slaveID, varYID, std::string("Hello World"));
+    ASSERT_TRUE(sub.Update(t, std::chrono::seconds(1)));
+    EXPECT_EQ(1.5, boost::get<double>(sub.Value(varX)));
+    EXPECT_EQ("Hello World", boost::get<std::string>(sub.Value(varY)));
+
+    ++t;
+    const coral::model::VariableID ids[2] = { varXID, varYID };
+    const coral::model::ScalarValue values[2] = { -2.5, std::string("Bye") };
+    pub.Publish(t, slaveID, ids, values, 2);
+    ASSERT_TRUE(sub.Update(t, std::chrono::seconds(1)));
+    EXPECT_EQ(-2.5, boost::get<double>(sub.Value(varX)));
+    EXPECT_EQ("Bye", boost::get<std::string>(sub.Value(varY)));
+
+    // Switching encodings on the fly
+    ++t;
+    pub.SetEncoding(coral::bus::PROTOBUF_VARIABLE_ENCODING);
+    pub.Publish(t, slaveID, varXID, 3.5);
+    pub.SetEncoding(coral::bus::BINARY_VARIABLE_ENCODING);
+    pub.Publish(t, slaveID, varYID, std::string("Again"));
+    ASSERT_TRUE(sub.Update(t, std::chrono::seconds(1)));
+    EXPECT_EQ(3.5, boost::get<double>(sub.Value(varX)));
+    EXPECT_EQ("Again", boost::get<std::string>(sub.Value(varY)));
+
+    // Blocks of typed values, in both encodings
+    coral::model::ValueBlock block;
+    block.Reals().Add(varXID, 4.5);
+    block.Strings().Add(varYID, "Block");
+    for (const auto encoding : { coral::bus::PROTOBUF_VARIABLE_ENCODING,
+                                 coral::bus::BINARY_VARIABLE_ENCODING }) {
+        ++t;
+        pub.SetEncoding(encoding);
+        pub.Publish(t, slaveID, block);
+        ASSERT_TRUE(sub.Update(t, std::chrono::seconds(1)));
+        EXPECT_EQ(4.5, boost::get<double>(sub.Value(varX)));
+        EXPECT_EQ("Block", boost::get<std::string>(sub.Value(varY)));
+    }
+}
+
+
+TEST(coral_bus, VariableSubscriberConnectIncrementally)
+{
+    const coral::model::VariableID varID = 100;
+    const auto var1 = coral::model::Variable(1, varID);
+    const auto var2 = coral::model::Variable(2, varID);
+
+    const auto localEndpoint = [] (const coral::bus::VariablePublisher& p) {
+        auto e = coral::net::ip::Endpoint{p.BoundEndpoint().Address()};
+        e.SetAddress(coral::net::ip::Address{"localhost"});
+        return e.ToEndpoint("tcp");
+    };
+    auto pub1 = coral::bus::VariablePublisher();
+    pub1.Bind(coral::net::Endpoint{"tcp://*:*"});
+    const auto endpoint1 = localEndpoint(pub1);
+    auto pub2 = coral::bus::VariablePublisher();
+    pub2.Bind(coral::net::Endpoint{"tcp://*:*"});
+    const auto endpoint2 = localEndpoint(pub2);
+
+    auto sub = coral::bus::VariableSubscriber();
+    sub.Connect(nullptr, 0);
+    sub.ConnectTo(endpoint1);
+    sub.Subscribe(var1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    coral::model::StepID t = 0;
+    pub1.Publish(t, 1, varID, 1);
+    ASSERT_TRUE(sub.Update(t, std::chrono::seconds(1)));
+    EXPECT_EQ(1, boost::get<int>(sub.Value(var1)));
+
+    // Adding a peer doesn't affect the existing connection
+    sub.ConnectTo(endpoint2);
+    sub.Subscribe(var2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    ++t;
+    pub1.Publish(t, 1, varID, 2);
+    pub2.Publish(t, 2, varID, 3);
+    ASSERT_TRUE(sub.Update(t, std::chrono::seconds(1)));
+    EXPECT_EQ(2, boost::get<int>(sub.Value(var1)));
+    EXPECT_EQ(3, boost::get<int>(sub.Value(var2)));
+
+    // Nor does removing one
+    sub.Unsubscribe(var1);
+    sub.DisconnectFrom(endpoint1);
+    ++t;
+    pub2.Publish(t, 2, varID, 4);
+    ASSERT_TRUE(sub.Update(t, std::chrono::seconds(1)));
+    EXPECT_EQ(4, boost::get<int>(sub.Value(var2)));
+}
+
+
+TEST(coral_bus, VariableSubscriberWaitForPeers)
+{
+    const auto localEndpoint = [] (const coral::bus::VariablePublisher& p) {
+        auto e = coral::net::ip::Endpoint{p.BoundEndpoint().Address()};
+        e.SetAddress(coral::net::ip::Address{"localhost"});
+        return e.ToEndpoint("tcp");
+    };
+    auto pub = coral::bus::VariablePublisher();
+    pub.Bind(coral::net::Endpoint{"tcp://*:*"});
+    const auto endpoint = localEndpoint(pub);
+
+    auto sub = coral::bus::VariableSubscriber();
+    sub.Connect(nullptr, 0);
+    EXPECT_TRUE(sub.WaitForPeers(std::chrono::milliseconds(0)));
+    sub.ConnectTo(endpoint);
+    sub.Subscribe(coral::model::Variable(1, 100));
+    EXPECT_TRUE(sub.WaitForPeers(std::chrono::seconds(1)));
+
+    // A publisher which has gone away is never connected to.
+    coral::net::Endpoint deadEndpoint;
+    {
+        auto deadPub = coral::bus::VariablePublisher();
+        deadPub.Bind(coral::net::Endpoint{"tcp://*:*"});
+        deadEndpoint = localEndpoint(deadPub);
+    }
+    auto sub2 = coral::bus::VariableSubscriber();
+    sub2.Connect(&deadEndpoint, 1);
+    EXPECT_FALSE(sub2.WaitForPeers(std::chrono::milliseconds(100)));
+
+    // ...and once we give up on it, it is no longer waited for.
+    sub2.ConnectTo(endpoint);
+    sub2.DisconnectFrom(deadEndpoint);
+    EXPECT_TRUE(sub2.WaitForPeers(std::chrono::seconds(1)));
+}
+
+
+TEST(coral_bus, VariableSubscriberQueuesManySteps)
+{
+    const coral::model::SlaveID slaveID = 1;
+    const coral::model::VariableID varXID = 100;
+    const coral::model::VariableID varYID = 200;
+    const auto varX = coral::model::Variable(slaveID, varXID);
+    const auto varY = coral::model::Variable(slaveID, varYID);
+
+    auto pub = coral::bus::VariablePublisher();
+    pub.Bind(coral::net::Endpoint{"tcp://*:*"});
+
+    auto inetEndpoint = coral::net::ip::Endpoint{pub.BoundEndpoint().Address()};
+    inetEndpoint.SetAddress(coral::net::ip::Address{"localhost"});
+    const auto endpoint = inetEndpoint.ToEndpoint("tcp");
+
+    auto sub = coral::bus::VariableSubscriber();
+    sub.Connect(&endpoint, 1);
+    sub.Subscribe(varX);
+    sub.Subscribe(varY);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // All values of X arrive before the first value of Y, including a
+    // resent one, so the subscriber has to queue many more values than it
+    // normally would.
+    const int stepCount = 10;
+    for (int t = 0; t < stepCount; ++t) pub.Publish(t, slaveID, varXID, t);
+    pub.Publish(0, slaveID, varXID, 0);
+    for (int t = 0; t < stepCount; ++t) {
+        pub.Publish(t, slaveID, varYID, std::to_string(t));
+    }
+    ASSERT_TRUE(sub.Update(0, std::chrono::seconds(1)));
+    EXPECT_EQ(0, boost::get<int>(sub.Value(varX)));
+    EXPECT_EQ("0", boost::get<std::string>(sub.Value(varY)));
+
+    // Removing a subscription must not disturb the values queued for others
+    sub.Unsubscribe(varX);
+    for (int t = 1; t < stepCount; ++t) {
+        ASSERT_TRUE(sub.Update(t, std::chrono::seconds(1)));
+        EXPECT_EQ(std::to_string(t), boost::get<std::string>(sub.Value(varY)));
+    }
+    EXPECT_THROW(sub.Value(varX), std::logic_error);
+}
+
+
+TEST(coral_bus, VariableSubscriberDelay)
+{
+    const coral::model::SlaveID slaveID = 1;
+    const coral::model::VariableID varXID = 100;
+    const coral::model::VariableID varYID = 200;
+    const auto varX = coral::model::Variable(slaveID, varXID);
+    const auto varY = coral::model::Variable(slaveID, varYID);
+
+    auto pub = coral::bus::VariablePublisher();
+    pub.Bind(coral::net::Endpoint{"tcp://*:*"});
+
+    auto inetEndpoint = coral::net::ip::Endpoint{pub.BoundEndpoint().Address()};
+    inetEndpoint.SetAddress(coral::net::ip::Address{"localhost"});
+    const auto endpoint = inetEndpoint.ToEndpoint("tcp");
+
+    auto sub = coral::bus::VariableSubscriber();
+    sub.Connect(&endpoint, 1);
+    EXPECT_THROW(sub.Subscribe(varX, -1), std::invalid_argument);
+    sub.Subscribe(varX);
+    sub.Subscribe(varY, 2);
+    EXPECT_NO_THROW(sub.Subscribe(varY, 2));
+    EXPECT_THROW(sub.Subscribe(varY, 1), std::invalid_argument);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Initial values take effect immediately when delays are ignored.
+    pub.Publish(0, slaveID, varXID, 0);
+    pub.Publish(0, slaveID, varYID, 0);
+    ASSERT_TRUE(sub.Update(0, std::chrono::seconds(1), true));
+    EXPECT_EQ(0, boost::get<int>(sub.Value(varX)));
+    EXPECT_EQ(0, boost::get<int>(sub.Value(varY)));
+
+    // Y lags two steps behind X, and we don't have to wait for its most
+    // recent values.
+    const int stepCount = 6;
+    for (int t = 1; t < stepCount; ++t) {
+        pub.Publish(t, slaveID, varXID, t);
+        ASSERT_TRUE(sub.Update(t, std::chrono::seconds(1)));
+        EXPECT_EQ(t, boost::get<int>(sub.Value(varX)));
+        EXPECT_EQ(std::max(t - 2, 0), boost::get<int>(sub.Value(varY)));
+        pub.Publish(t, slaveID, varYID, t);
+    }
+
+    // ...but we do have to wait for the ones that are due.
+    EXPECT_FALSE(sub.Update(stepCount + 2, std::chrono::milliseconds(100)));
+}
+
+
+TEST(coral_bus, VariableSubscriberBusyPoll)
+{
+    const coral::model::SlaveID slaveID = 1;
+    const coral::model::VariableID varID = 100;
+    const auto var = coral::model::Variable(slaveID, varID);
+
+    auto pub = coral::bus::VariablePublisher();
+    pub.Bind(coral::net::Endpoint{"tcp://*:*"});
+
+    auto inetEndpoint = coral::net::ip::Endpoint{pub.BoundEndpoint().Address()};
+    inetEndpoint.SetAddress(coral::net::ip::Address{"localhost"});
+    const auto endpoint = inetEndpoint.ToEndpoint("tcp");
+
+    auto sub = coral::bus::VariableSubscriber();
+    sub.Connect(&endpoint, 1);
+    sub.Subscribe(var);
+    sub.SetSpinBudget(std::chrono::seconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto pubThread = std::thread([&] () {
+        for (int t = 0; t < 10; ++t) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            pub.Publish(t, slaveID, varID, t);
+        }
+    });
+    for (int t = 0; t < 10; ++t) {
+        ASSERT_TRUE(sub.Update(t, std::chrono::seconds(5)));
+        EXPECT_EQ(t, boost::get<int>(sub.Value(var)));
+    }
+    pubThread.join();
+
+    const auto& stats = sub.PollStats();
+    EXPECT_GT(stats.spinWakeups, 0u);
+    EXPECT_EQ(0u, stats.sleepWakeups);
+    EXPECT_GT(stats.spinTime, std::chrono::nanoseconds(0));
+}
+
+
+TEST(coral_bus, VariablePublishSubscribeSharedMemory)
+{
+    const coral::model::SlaveID slaveID = 1;
+    const coral::model::VariableID varXID = 100;
+    const coral::model::VariableID varYID = 200;
+    const auto varX = coral::model::Variable(slaveID, varXID);
+    const auto varY = coral::model::Variable(slaveID, varYID);
+
+    auto pub = coral::bus::VariablePublisher();
+    pub.Bind(coral::net::Endpoint{"tcp://*:*"});
+
+    auto inetEndpoint = coral::net::ip::Endpoint{pub.BoundEndpoint().Address()};
+    inetEndpoint.SetAddress(coral::net::ip::Address{"localhost"});
+    const auto endpoint = coral::bus::SharedMemoryEndpoint(inetEndpoint.ToEndpoint("tcp"));
+    EXPECT_EQ("shm", endpoint.Transport());
+
+    // No waiting for subscriptions to take effect here; the subscriber is
+    // attached as soon as it has connected.
+    auto sub = coral::bus::VariableSubscriber();
+    sub.Connect(&endpoint, 1);
+    EXPECT_TRUE(sub.HasLocalPeers());
+    sub.Subscribe(varX);
+    sub.Subscribe(varY, 1);
+
+    coral::model::StepID t = 0;
+    EXPECT_FALSE(sub.Update(t, std::chrono::milliseconds(1)));
+    const coral::model::VariableID ids[2] = { varXID, varYID };
+    const coral::model::ScalarValue values0[2] = { 1.0, std::string("foo") };
+    pub.Publish(t, slaveID, ids, values0, 2);
+    ASSERT_TRUE(sub.Update(t, std::chrono::seconds(1), true));
+    EXPECT_EQ(1.0, boost::get<double>(sub.Value(varX)));
+    EXPECT_EQ("foo", boost::get<std::string>(sub.Value(varY)));
+
+    pub.SetEncoding(coral::bus::BINARY_VARIABLE_ENCODING);
+    ++t;
+    const coral::model::ScalarValue values1[2] = { 2.0, std::string("bar") };
+    pub.Publish(t, slaveID, ids, values1, 2);
+    auto pubThread = std::thread([&] () {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        pub.Publish(t + 1, slaveID, varXID, 3.0);
+    });
+    ASSERT_TRUE(sub.Update(t, std::chrono::seconds(1)));
+    EXPECT_EQ(2.0, boost::get<double>(sub.Value(varX)));
+    EXPECT_EQ("foo", boost::get<std::string>(sub.Value(varY)));
+    ASSERT_TRUE(sub.Update(t + 1, std::chrono::seconds(1)));
+    pubThread.join();
+    EXPECT_EQ(3.0, boost::get<double>(sub.Value(varX)));
+    EXPECT_EQ("bar", boost::get<std::string>(sub.Value(varY)));
+
+    sub.DisconnectFrom(endpoint);
+    EXPECT_FALSE(sub.HasLocalPeers());
+}
+
+
 TEST(coral_bus, VariablePublishSubscribePerformance)
 {
     const int VAR_COUNT = 5000;
@@ -13,6 +13,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include <cstring>
 #include <mutex>
 #include <stdexcept>
+#include <type_traits>
 #include <unordered_map>
 
 #include <boost/numeric/conversion/cast.hpp>
@@ -73,12 +74,17 @@ FMU1::FMU1(
         std::string(fmi1_import_get_author(m_handle)),
         std::string(fmi1_import_get_model_version(m_handle)),
         variables);
+    m_spareHandles.push_back(m_handle);
 }
 
 
 FMU1::~FMU1()
 {
-    fmi1_import_free(m_handle);
+    // All instances hold a reference to this object, so by now they have
+    // returned their handles, m_handle included.
+    for (const auto handle : m_spareHandles) {
+        fmi1_import_free(handle);
+    }
 }
 
 
@@ -159,6 +165,33 @@ fmi1_import_t* FMU1::FmilibHandle() const
 }
 
 
+fmi1_import_t* FMU1::AcquireHandle()
+{
+    std::lock_guard<std::mutex> lock(m_spareHandlesMutex);
+    if (!m_spareHandles.empty()) {
+        const auto handle = m_spareHandles.back();
+        m_spareHandles.pop_back();
+        return handle;
+    }
+    // All parsed handles have an instance loaded into them, so we have no
+    // choice but to parse the model description again.
+    const auto handle = fmi1_import_parse_xml(
+        m_importer->FmilibHandle(),
+        m_dir.string().c_str());
+    if (handle == nullptr) {
+        throw std::runtime_error(m_importer->LastErrorMessage());
+    }
+    return handle;
+}
+
+
+void FMU1::ReleaseHandle(fmi1_import_t* handle) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_spareHandlesMutex);
+    m_spareHandles.push_back(handle);
+}
+
+
 // =============================================================================
 // SlaveInstance1
 // =============================================================================
@@ -260,12 +293,8 @@ namespace
 
 SlaveInstance1::SlaveInstance1(std::shared_ptr<coral::fmi::FMU1> fmu)
     : m_fmu{fmu}
-    , m_handle{fmi1_import_parse_xml(fmu->Importer()->FmilibHandle(), fmu->Directory().string().c_str())}
+    , m_handle{fmu->AcquireHandle()}
 {
-    if (m_handle == nullptr) {
-        throw std::runtime_error(fmu->Importer()->LastErrorMessage());
-    }
-
     fmi1_callback_functions_t callbacks;
     callbacks.allocateMemory = std::calloc;
     callbacks.freeMemory     = std::free;
@@ -274,7 +303,7 @@ SlaveInstance1::SlaveInstance1(std::shared_ptr<coral::fmi::FMU1> fmu)
 
     if (fmi1_import_create_dllfmu(m_handle, callbacks, false) != jm_status_success) {
         const auto msg = fmu->Importer()->LastErrorMessage();
-        fmi1_import_free(m_handle);
+        fmu->ReleaseHandle(m_handle);
         throw std::runtime_error(msg);
     }
 }
@@ -289,13 +318,13 @@ SlaveInstance1::~SlaveInstance1() noexcept
         fmi1_import_free_slave_instance(m_handle);
     }
     fmi1_import_destroy_dllfmu(m_handle);
-    fmi1_import_free(m_handle);
+    m_fmu->ReleaseHandle(m_handle);
 }
 
 
-coral::model::SlaveTypeDescription SlaveInstance1::TypeDescription() const
+const coral::model::SlaveTypeDescription& SlaveInstance1::TypeDescription() const
 {
-    return FMU()->Description();
+    return m_fmu->Description();
 }
 
 
@@ -509,6 +538,211 @@ bool SlaveInstance1::SetStringVariable(coral::model::VariableID varID, const std
 }
 
 
+namespace
+{
+    static_assert(
+        std::is_same<fmi1_real_t, double>::value
+            && std::is_same<fmi1_integer_t, int>::value
+            && std::is_same<fmi1_string_t, const char*>::value,
+        "FMI Library types don't match those used by the batch functions");
+
+    std::runtime_error MakeBatchGetOrSetException(
+        const std::string& getOrSet,
+        std::size_t count,
+        const std::string& instanceName)
+    {
+        return std::runtime_error(
+            "Failed to " + getOrSet + " values of " + std::to_string(count)
+            + " variables (" + LastLogRecord(instanceName).message + ")");
+    }
+
+    // Looks up the value references of `count` variables in `table`, which
+    // is the FMU's list of value references indexed by variable ID, stores
+    // them in `buffer` and returns a pointer to its contents.
+    const fmi1_value_reference_t* ValueReferences(
+        const std::vector<fmi1_value_reference_t>& table,
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        std::vector<fmi1_value_reference_t>& buffer)
+    {
+        buffer.resize(count);
+        const auto tableSize = table.size();
+        for (std::size_t i = 0; i < count; ++i) {
+            if (variables[i] >= tableSize) {
+                throw std::out_of_range(
+                    "Invalid variable ID: " + std::to_string(variables[i]));
+            }
+            buffer[i] = table[variables[i]];
+        }
+        return buffer.data();
+    }
+
+    void CheckGetStatus(
+        fmi1_status_t status,
+        std::size_t count,
+        const std::string& instanceName)
+    {
+        if (status != fmi1_status_ok && status != fmi1_status_warning) {
+            throw MakeBatchGetOrSetException("get", count, instanceName);
+        }
+    }
+
+    bool CheckSetStatus(
+        fmi1_status_t status,
+        std::size_t count,
+        const std::string& instanceName)
+    {
+        if (status == fmi1_status_ok || status == fmi1_status_warning) {
+            return true;
+        } else if (status == fmi1_status_discard) {
+            return false;
+        } else {
+            throw MakeBatchGetOrSetException("set", count, instanceName);
+        }
+    }
+}
+
+
+void SlaveInstance1::GetRealVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    double* values) const
+{
+    assert(m_setupComplete);
+    const auto status = fmi1_import_get_real(
+        m_handle,
+        ValueReferences(m_fmu->m_valueReferences, variables, count, m_valueReferenceBuffer),
+        count,
+        values);
+    CheckGetStatus(status, count, m_instanceName);
+}
+
+
+void SlaveInstance1::GetIntegerVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    int* values) const
+{
+    assert(m_setupComplete);
+    const auto status = fmi1_import_get_integer(
+        m_handle,
+        ValueReferences(m_fmu->m_valueReferences, variables, count, m_valueReferenceBuffer),
+        count,
+        values);
+    CheckGetStatus(status, count, m_instanceName);
+}
+
+
+void SlaveInstance1::GetBooleanVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    bool* values) const
+{
+    assert(m_setupComplete);
+    m_booleanBuffer.resize(count);
+    const auto status = fmi1_import_get_boolean(
+        m_handle,
+        ValueReferences(m_fmu->m_valueReferences, variables, count, m_valueReferenceBuffer),
+        count,
+        m_booleanBuffer.data());
+    CheckGetStatus(status, count, m_instanceName);
+    for (std::size_t i = 0; i < count; ++i) {
+        values[i] = m_booleanBuffer[i] != 0;
+    }
+}
+
+
+void SlaveInstance1::GetStringVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    std::string* values) const
+{
+    assert(m_setupComplete);
+    m_stringBuffer.assign(count, nullptr);
+    const auto status = fmi1_import_get_string(
+        m_handle,
+        ValueReferences(m_fmu->m_valueReferences, variables, count, m_valueReferenceBuffer),
+        count,
+        m_stringBuffer.data());
+    CheckGetStatus(status, count, m_instanceName);
+    for (std::size_t i = 0; i < count; ++i) {
+        if (m_stringBuffer[i]) {
+            values[i] = m_stringBuffer[i];
+        } else {
+            values[i].clear();
+        }
+    }
+}
+
+
+bool SlaveInstance1::SetRealVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    const double* values)
+{
+    assert(m_setupComplete);
+    const auto status = fmi1_import_set_real(
+        m_handle,
+        ValueReferences(m_fmu->m_valueReferences, variables, count, m_valueReferenceBuffer),
+        count,
+        values);
+    return CheckSetStatus(status, count, m_instanceName);
+}
+
+
+bool SlaveInstance1::SetIntegerVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    const int* values)
+{
+    assert(m_setupComplete);
+    const auto status = fmi1_import_set_integer(
+        m_handle,
+        ValueReferences(m_fmu->m_valueReferences, variables, count, m_valueReferenceBuffer),
+        count,
+        values);
+    return CheckSetStatus(status, count, m_instanceName);
+}
+
+
+bool SlaveInstance1::SetBooleanVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    const bool* values)
+{
+    assert(m_setupComplete);
+    m_booleanBuffer.resize(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        m_booleanBuffer[i] = values[i] ? fmi1_true : fmi1_false;
+    }
+    const auto status = fmi1_import_set_boolean(
+        m_handle,
+        ValueReferences(m_fmu->m_valueReferences, variables, count, m_valueReferenceBuffer),
+        count,
+        m_booleanBuffer.data());
+    return CheckSetStatus(status, count, m_instanceName);
+}
+
+
+bool SlaveInstance1::SetStringVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    const std::string* values)
+{
+    assert(m_setupComplete);
+    m_stringBuffer.resize(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        m_stringBuffer[i] = values[i].c_str();
+    }
+    const auto status = fmi1_import_set_string(
+        m_handle,
+        ValueReferences(m_fmu->m_valueReferences, variables, count, m_valueReferenceBuffer),
+        count,
+        m_stringBuffer.data());
+    return CheckSetStatus(status, count, m_instanceName);
+}
+
+
 std::shared_ptr<coral::fmi::FMU> SlaveInstance1::FMU() const
 {
     return FMU1();
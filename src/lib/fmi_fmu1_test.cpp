@@ -1,4 +1,7 @@
 #include <cstdlib>
+#include <map>
+#include <stdexcept>
+#include <string>
 #include <boost/filesystem.hpp>
 #include <gtest/gtest.h>
 
@@ -107,3 +110,72 @@ TEST(coral_fmi, Fmu1_unpacked)
     importer->CleanCache();
     EXPECT_TRUE(boost::filesystem::exists(unpackDir.Path()));
 }
+
+
+TEST(coral_fmi, Fmu1_batchVariables)
+{
+    const auto testDataDir = std::getenv("CORAL_TEST_DATA_DIR");
+    auto importer = coral::fmi::Importer::Create();
+    auto fmu = importer->Import(
+        boost::filesystem::path(testDataDir) / "fmi1_cs" / "identity.fmu");
+
+    std::map<std::string, coral::model::VariableID> ids;
+    for (const auto& v : fmu->Description().Variables()) ids[v.Name()] = v.ID();
+
+    auto instance = fmu->InstantiateSlave();
+    instance->Setup("testSlave", "testExecution", 0.0, 1.0, false, 0.0);
+    instance->StartSimulation();
+
+    // The identity FMU copies its inputs to its outputs in DoStep(), so
+    // values set with the batch setters come back through the batch getters.
+    const coral::model::VariableID realIn[] = { ids.at("realIn") };
+    const coral::model::VariableID integerIn[] = { ids.at("integerIn") };
+    const coral::model::VariableID booleanIn[] = { ids.at("booleanIn") };
+    const coral::model::VariableID stringIn[] = { ids.at("stringIn") };
+    const double realVals[] = { 1.5 };
+    const int integerVals[] = { 42 };
+    const bool booleanVals[] = { true };
+    const std::string stringVals[] = { "foo" };
+    EXPECT_TRUE(instance->SetRealVariables(realIn, 1, realVals));
+    EXPECT_TRUE(instance->SetIntegerVariables(integerIn, 1, integerVals));
+    EXPECT_TRUE(instance->SetBooleanVariables(booleanIn, 1, booleanVals));
+    EXPECT_TRUE(instance->SetStringVariables(stringIn, 1, stringVals));
+    EXPECT_TRUE(instance->DoStep(0.0, 0.1));
+
+    // Get each output twice in the same call, and the input alongside it.
+    const coral::model::VariableID reals[] =
+        { ids.at("realOut"), ids.at("realIn"), ids.at("realOut") };
+    const coral::model::VariableID integers[] =
+        { ids.at("integerOut"), ids.at("integerIn"), ids.at("integerOut") };
+    const coral::model::VariableID booleans[] =
+        { ids.at("booleanOut"), ids.at("booleanIn"), ids.at("booleanOut") };
+    const coral::model::VariableID strings[] =
+        { ids.at("stringOut"), ids.at("stringIn"), ids.at("stringOut") };
+    double realOut[3] = { 0.0, 0.0, 0.0 };
+    int integerOut[3] = { 0, 0, 0 };
+    bool booleanOut[3] = { false, false, false };
+    std::string stringOut[3];
+    instance->GetRealVariables(reals, 3, realOut);
+    instance->GetIntegerVariables(integers, 3, integerOut);
+    instance->GetBooleanVariables(booleans, 3, booleanOut);
+    instance->GetStringVariables(strings, 3, stringOut);
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(1.5, realOut[i]);
+        EXPECT_EQ(42, integerOut[i]);
+        EXPECT_TRUE(booleanOut[i]);
+        EXPECT_EQ("foo", stringOut[i]);
+    }
+
+    // The batch functions agree with the single-variable ones.
+    EXPECT_EQ(1.5, instance->GetRealVariable(ids.at("realOut")));
+    EXPECT_EQ("foo", instance->GetStringVariable(ids.at("stringOut")));
+
+    // Invalid variable IDs are rejected.
+    const coral::model::VariableID invalid[] =
+        { ids.at("realOut"), static_cast<coral::model::VariableID>(ids.size()) };
+    EXPECT_THROW(
+        instance->GetRealVariables(invalid, 2, realOut),
+        std::out_of_range);
+
+    instance->EndSimulation();
+}
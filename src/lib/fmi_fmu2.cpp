@@ -7,13 +7,15 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include <coral/fmi/fmu2.hpp>
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cstdarg>
 #include <cstdlib>
+#include <cstdio>
 #include <cstring>
 #include <mutex>
 #include <stdexcept>
-#include <unordered_map>
+#include <type_traits>
 
 #include <boost/numeric/conversion/cast.hpp>
 #include <fmilib.h>
@@ -72,12 +74,17 @@ FMU2::FMU2(
         std::string(fmi2_import_get_author(m_handle)),
         std::string(fmi2_import_get_model_version(m_handle)),
         variables);
+    m_spareHandles.push_back(m_handle);
 }
 
 
 FMU2::~FMU2()
 {
-    fmi2_import_free(m_handle);
+    // All instances hold a reference to this object, so by now they have
+    // returned their handles, m_handle included.
+    for (const auto handle : m_spareHandles) {
+        fmi2_import_free(handle);
+    }
 }
 
 
@@ -159,6 +166,33 @@ fmi2_import_t* FMU2::FmilibHandle() const
 }
 
 
+fmi2_import_t* FMU2::AcquireHandle()
+{
+    std::lock_guard<std::mutex> lock(m_spareHandlesMutex);
+    if (!m_spareHandles.empty()) {
+        const auto handle = m_spareHandles.back();
+        m_spareHandles.pop_back();
+        return handle;
+    }
+    // All parsed handles have an instance loaded into them, so we have no
+    // choice but to parse the model description again.
+    const auto handle = fmi2_import_parse_xml(
+        m_importer->FmilibHandle(),
+        m_dir.string().c_str(), nullptr);
+    if (handle == nullptr) {
+        throw std::runtime_error(m_importer->LastErrorMessage());
+    }
+    return handle;
+}
+
+
+void FMU2::ReleaseHandle(fmi2_import_t* handle) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_spareHandlesMutex);
+    m_spareHandles.push_back(handle);
+}
+
+
 // =============================================================================
 // SlaveInstance2
 // =============================================================================
@@ -171,111 +205,95 @@ namespace
             "but this feature is currently not supported");
     }
 
-    struct LogRecord
-    {
-        LogRecord() { }
-        LogRecord(fmi2_status_t s, const std::string& m) : status{s}, message(m) { }
-        fmi2_status_t status = fmi2_status_ok;
-        std::string message;
-    };
-    std::unordered_map<std::string, LogRecord> g_logRecords;
-    std::mutex g_logMutex;
+    // The type of SlaveInstance2::m_lastLogMessage, which the logger
+    // receives a pointer to as its component environment.
+    typedef std::array<char, 1024> LogMessageBuffer;
 
-    void LogMessage(
-        fmi2_component_environment_t,
-        fmi2_string_t instanceName,
-        fmi2_status_t status,
-        fmi2_string_t category,
-        fmi2_string_t message,
-        ...)
+    coral::log::Level ToLogLevel(fmi2_status_t status)
     {
-        std::va_list args;
-        va_start(args, message);
-        const auto msgLength = std::vsnprintf(nullptr, 0, message, args);
-        va_end(args);
-        auto msgBuffer = std::vector<char>(msgLength);
-        va_start(args, message);
-        std::vsnprintf(msgBuffer.data(), msgBuffer.size(), message, args);
-        va_end(args);
-
-        std::string logMessage = category;
-        logMessage.append(": ");
-        logMessage.append(msgBuffer.begin(), msgBuffer.end());
-
-        coral::log::Level logLevel = coral::log::error;
         switch (status) {
             case fmi2_status_ok:
-                logLevel = coral::log::info;
-                break;
+                return coral::log::info;
             case fmi2_status_warning:
-                logLevel = coral::log::warning;
-                break;
+                return coral::log::warning;
             case fmi2_status_discard:
                 // Don't know if this ever happens, but we should at least
                 // print a debug message if it does.
-                logLevel = coral::log::debug;
-                break;
-            case fmi2_status_error:
-                logLevel = coral::log::error;
-                break;
-            case fmi2_status_fatal:
-                logLevel = coral::log::error;
-                break;
+                return coral::log::debug;
             case fmi2_status_pending:
                 // Don't know if this ever happens, but we should at least
                 // print a debug message if it does.
-                logLevel = coral::log::debug;
-                break;
+                return coral::log::debug;
+            default:
+                return coral::log::error;
         }
-
-        if (logLevel < coral::log::error) {
-            // Errors are not logged; we handle them with exceptions instead.
-            coral::log::Log(logLevel, logMessage);
-        }
-
-        g_logMutex.lock();
-        g_logRecords[instanceName] = LogRecord{status, logMessage};
-        g_logMutex.unlock();
     }
 
-    LogRecord LastLogRecord(const std::string& instanceName)
+    void LogMessage(
+        fmi2_component_environment_t env,
+        fmi2_string_t,
+        fmi2_status_t status,
+        fmi2_string_t category,
+        fmi2_string_t message,
+        ...)
     {
-        std::lock_guard<std::mutex> lock(g_logMutex);
-        const auto it = g_logRecords.find(instanceName);
-        if (it == g_logRecords.end()) {
-            return LogRecord{};
-        } else {
-            // Note the use of c_str() here, to force the string to be copied.
-            // The C++ standard now disallows copy-on-write, but some compilers
-            // still use it, which could lead to problems in multithreaded
-            // programs.
-            return LogRecord{
-                it->second.status,
-                std::string(it->second.message.c_str())
-            };
+        // Errors are not logged; we handle them with exceptions instead.
+        // Other messages are only formatted if they will be logged, or if
+        // they might explain a subsequent error.
+        auto logLevel = ToLogLevel(status);
+        bool log = logLevel < coral::log::error
+            && coral::log::IsEnabled(logLevel);
+        if (!log && status == fmi2_status_ok) return;
+
+        // The message is formatted directly into the instance's buffer,
+        // truncating it if necessary.  Should the FMU fail to pass on the
+        // component environment, there is nowhere to keep the message for
+        // the exception, so we log it as an error instead.
+        LogMessageBuffer tempBuffer;
+        if (!env && !log) {
+            logLevel = coral::log::error;
+            log = true;
         }
+        auto& buffer = env
+            ? *static_cast<LogMessageBuffer*>(env)
+            : tempBuffer;
+        const auto prefixLength = std::snprintf(
+            buffer.data(), buffer.size(), "%s: ", category ? category : "");
+        if (prefixLength >= 0 && std::size_t(prefixLength) < buffer.size()) {
+            std::va_list args;
+            va_start(args, message);
+            std::vsnprintf(
+                buffer.data() + prefixLength,
+                buffer.size() - prefixLength,
+                message,
+                args);
+            va_end(args);
+        }
+
+        if (log) coral::log::Log(logLevel, buffer.data());
     }
 }
 
 
 SlaveInstance2::SlaveInstance2(std::shared_ptr<coral::fmi::FMU2> fmu)
     : m_fmu{fmu}
-    , m_handle{fmi2_import_parse_xml(fmu->Importer()->FmilibHandle(), fmu->Directory().string().c_str(), nullptr)}
+    , m_handle{fmu->AcquireHandle()}
 {
-    if (m_handle == nullptr) {
-        throw std::runtime_error(fmu->Importer()->LastErrorMessage());
-    }
+    static_assert(
+        std::is_same<decltype(m_lastLogMessage), LogMessageBuffer>::value,
+        "Log message buffer type mismatch");
+    m_lastLogMessage.front() = '\0';
 
     fmi2_callback_functions_t callbacks;
     callbacks.allocateMemory       = std::calloc;
     callbacks.freeMemory           = std::free;
     callbacks.logger               = LogMessage;
     callbacks.stepFinished         = StepFinishedPlaceholder;
-    callbacks.componentEnvironment = nullptr;
+    callbacks.componentEnvironment = &m_lastLogMessage;
 
     if (fmi2_import_create_dllfmu(m_handle, fmi2_fmu_kind_cs, &callbacks) != jm_status_success) {
         const auto msg = fmu->Importer()->LastErrorMessage();
-        fmi2_import_free(m_handle);
+        fmu->ReleaseHandle(m_handle);
         throw std::runtime_error(msg);
     }
 }
@@ -290,13 +308,13 @@ SlaveInstance2::~SlaveInstance2() noexcept
         fmi2_import_free_instance(m_handle);
     }
     fmi2_import_destroy_dllfmu(m_handle);
-    fmi2_import_free(m_handle);
+    m_fmu->ReleaseHandle(m_handle);
 }
 
 
-coral::model::SlaveTypeDescription SlaveInstance2::TypeDescription() const
+const coral::model::SlaveTypeDescription& SlaveInstance2::TypeDescription() const
 {
-    return FMU()->Description();
+    return m_fmu->Description();
 }
 
 
@@ -318,7 +336,7 @@ void SlaveInstance2::Setup(
     if (rci != jm_status_success) {
         throw std::runtime_error(
             "FMI error: Slave instantiation failed ("
-            + LastLogRecord(slaveName).message + ')');
+            + std::string(m_lastLogMessage.data()) + ')');
     }
 
     const auto rcs = fmi2_import_setup_experiment(
@@ -331,18 +349,17 @@ void SlaveInstance2::Setup(
     if (rcs != fmi2_status_ok && rcs != fmi2_status_warning) {
         throw std::runtime_error(
             "FMI error: Slave setup failed ("
-            + LastLogRecord(slaveName).message + ')');
+            + std::string(m_lastLogMessage.data()) + ')');
     }
 
     const auto rce = fmi2_import_enter_initialization_mode(m_handle);
     if (rce != fmi2_status_ok && rce != fmi2_status_warning) {
         throw std::runtime_error(
             "FMI error: Slave failed to enter initialization mode ("
-            + LastLogRecord(slaveName).message + ')');
+            + std::string(m_lastLogMessage.data()) + ')');
     }
 
     m_setupComplete = true;
-    m_instanceName = slaveName;
 }
 
 
@@ -354,7 +371,7 @@ void SlaveInstance2::StartSimulation()
     if (rc != fmi2_status_ok && rc != fmi2_status_warning) {
         throw std::runtime_error(
             "FMI error: Slave failed to exit initialization mode ("
-            + LastLogRecord(m_instanceName).message + ')');
+            + std::string(m_lastLogMessage.data()) + ')');
     }
     m_simStarted = true;
 }
@@ -368,7 +385,7 @@ void SlaveInstance2::EndSimulation()
     if (rc != fmi2_status_ok && rc != fmi2_status_warning) {
         throw std::runtime_error(
             "FMI error: Failed to terminate slave ("
-            + LastLogRecord(m_instanceName).message + ')');
+            + std::string(m_lastLogMessage.data()) + ')');
     }
 }
 
@@ -390,7 +407,7 @@ bool SlaveInstance2::DoStep(
     } else {
         throw std::runtime_error(
             "Failed to perform time step ("
-            + LastLogRecord(m_instanceName).message + ')');
+            + std::string(m_lastLogMessage.data()) + ')');
     }
 }
 
@@ -401,13 +418,13 @@ namespace
         const std::string& getOrSet,
         coral::model::VariableID varID,
         const FMU2& fmu,
-        const std::string& instanceName)
+        const char* logMessage)
     {
         return std::runtime_error(
             "Failed to " + getOrSet + "value of variable with ID "
             + std::to_string(varID) + " and FMI value reference "
             + std::to_string(fmu.FMIValueReference(varID))
-            + " (" + LastLogRecord(instanceName).message + ")");
+            + " (" + logMessage + ")");
     }
 }
 
@@ -418,7 +435,7 @@ double SlaveInstance2::GetRealVariable(coral::model::VariableID varID) const
     fmi2_real_t value = 0.0;
     const auto status = fmi2_import_get_real(m_handle, &valRef, 1, &value);
     if (status != fmi2_status_ok && status != fmi2_status_warning) {
-        throw MakeGetOrSetException("get", varID, *FMU2(), m_instanceName);
+        throw MakeGetOrSetException("get", varID, *FMU2(), m_lastLogMessage.data());
     }
     return value;
 }
@@ -430,7 +447,7 @@ int SlaveInstance2::GetIntegerVariable(coral::model::VariableID varID) const
     fmi2_integer_t value = 0;
     const auto status = fmi2_import_get_integer(m_handle, &valRef, 1, &value);
     if (status != fmi2_status_ok && status != fmi2_status_warning) {
-        throw MakeGetOrSetException("get", varID, *FMU2(), m_instanceName);
+        throw MakeGetOrSetException("get", varID, *FMU2(), m_lastLogMessage.data());
     }
     return value;
 }
@@ -442,7 +459,7 @@ bool SlaveInstance2::GetBooleanVariable(coral::model::VariableID varID) const
     fmi2_boolean_t value = 0;
     const auto status = fmi2_import_get_boolean(m_handle, &valRef, 1, &value);
     if (status != fmi2_status_ok && status != fmi2_status_warning) {
-        throw MakeGetOrSetException("get", varID, *FMU2(), m_instanceName);
+        throw MakeGetOrSetException("get", varID, *FMU2(), m_lastLogMessage.data());
     }
     return value != fmi2_false;
 }
@@ -454,7 +471,7 @@ std::string SlaveInstance2::GetStringVariable(coral::model::VariableID varID) co
     fmi2_string_t value = nullptr;
     const auto status = fmi2_import_get_string(m_handle, &valRef, 1, &value);
     if (status != fmi2_status_ok && status != fmi2_status_warning) {
-        throw MakeGetOrSetException("get", varID, *FMU2(), m_instanceName);
+        throw MakeGetOrSetException("get", varID, *FMU2(), m_lastLogMessage.data());
     }
     return value ? std::string(value) : std::string();
 }
@@ -469,7 +486,7 @@ bool SlaveInstance2::SetRealVariable(coral::model::VariableID varID, double valu
     } else if (status == fmi2_status_discard) {
         return false;
     } else {
-        throw MakeGetOrSetException("set", varID, *FMU2(), m_instanceName);
+        throw MakeGetOrSetException("set", varID, *FMU2(), m_lastLogMessage.data());
     }
 }
 
@@ -483,7 +500,7 @@ bool SlaveInstance2::SetIntegerVariable(coral::model::VariableID varID, int valu
     } else if (status == fmi2_status_discard) {
         return false;
     } else {
-        throw MakeGetOrSetException("set", varID, *FMU2(), m_instanceName);
+        throw MakeGetOrSetException("set", varID, *FMU2(), m_lastLogMessage.data());
     }
 }
 
@@ -498,7 +515,7 @@ bool SlaveInstance2::SetBooleanVariable(coral::model::VariableID varID, bool val
     } else if (status == fmi2_status_discard) {
         return false;
     } else {
-        throw MakeGetOrSetException("set", varID, *FMU2(), m_instanceName);
+        throw MakeGetOrSetException("set", varID, *FMU2(), m_lastLogMessage.data());
     }
 }
 
@@ -513,11 +530,208 @@ bool SlaveInstance2::SetStringVariable(coral::model::VariableID varID, const std
     } else if (status == fmi2_status_discard) {
         return false;
     } else {
-        throw MakeGetOrSetException("set", varID, *FMU2(), m_instanceName);
+        throw MakeGetOrSetException("set", varID, *FMU2(), m_lastLogMessage.data());
     }
 }
 
 
+namespace
+{
+    static_assert(
+        std::is_same<fmi2_real_t, double>::value
+            && std::is_same<fmi2_integer_t, int>::value
+            && std::is_same<fmi2_string_t, const char*>::value,
+        "FMI Library types don't match those used by the batch functions");
+
+    std::runtime_error MakeBatchGetOrSetException(
+        const std::string& getOrSet,
+        std::size_t count,
+        const char* logMessage)
+    {
+        return std::runtime_error(
+            "Failed to " + getOrSet + " values of " + std::to_string(count)
+            + " variables (" + logMessage + ")");
+    }
+
+    // Looks up the value references of `count` variables in `table`, which
+    // is the FMU's list of value references indexed by variable ID, stores
+    // them in `buffer` and returns a pointer to its contents.
+    const fmi2_value_reference_t* ValueReferences(
+        const std::vector<fmi2_value_reference_t>& table,
+        const coral::model::VariableID* variables,
+        std::size_t count,
+        std::vector<fmi2_value_reference_t>& buffer)
+    {
+        buffer.resize(count);
+        const auto tableSize = table.size();
+        for (std::size_t i = 0; i < count; ++i) {
+            if (variables[i] >= tableSize) {
+                throw std::out_of_range(
+                    "Invalid variable ID: " + std::to_string(variables[i]));
+            }
+            buffer[i] = table[variables[i]];
+        }
+        return buffer.data();
+    }
+
+    void CheckGetStatus(
+        fmi2_status_t status,
+        std::size_t count,
+        const char* logMessage)
+    {
+        if (status != fmi2_status_ok && status != fmi2_status_warning) {
+            throw MakeBatchGetOrSetException("get", count, logMessage);
+        }
+    }
+
+    bool CheckSetStatus(
+        fmi2_status_t status,
+        std::size_t count,
+        const char* logMessage)
+    {
+        if (status == fmi2_status_ok || status == fmi2_status_warning) {
+            return true;
+        } else if (status == fmi2_status_discard) {
+            return false;
+        } else {
+            throw MakeBatchGetOrSetException("set", count, logMessage);
+        }
+    }
+}
+
+
+void SlaveInstance2::GetRealVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    double* values) const
+{
+    const auto status = fmi2_import_get_real(
+        m_handle,
+        ValueReferences(m_fmu->m_valueReferences, variables, count, m_valueReferenceBuffer),
+        count,
+        values);
+    CheckGetStatus(status, count, m_lastLogMessage.data());
+}
+
+
+void SlaveInstance2::GetIntegerVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    int* values) const
+{
+    const auto status = fmi2_import_get_integer(
+        m_handle,
+        ValueReferences(m_fmu->m_valueReferences, variables, count, m_valueReferenceBuffer),
+        count,
+        values);
+    CheckGetStatus(status, count, m_lastLogMessage.data());
+}
+
+
+void SlaveInstance2::GetBooleanVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    bool* values) const
+{
+    m_booleanBuffer.resize(count);
+    const auto status = fmi2_import_get_boolean(
+        m_handle,
+        ValueReferences(m_fmu->m_valueReferences, variables, count, m_valueReferenceBuffer),
+        count,
+        m_booleanBuffer.data());
+    CheckGetStatus(status, count, m_lastLogMessage.data());
+    for (std::size_t i = 0; i < count; ++i) {
+        values[i] = m_booleanBuffer[i] != 0;
+    }
+}
+
+
+void SlaveInstance2::GetStringVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    std::string* values) const
+{
+    m_stringBuffer.assign(count, nullptr);
+    const auto status = fmi2_import_get_string(
+        m_handle,
+        ValueReferences(m_fmu->m_valueReferences, variables, count, m_valueReferenceBuffer),
+        count,
+        m_stringBuffer.data());
+    CheckGetStatus(status, count, m_lastLogMessage.data());
+    for (std::size_t i = 0; i < count; ++i) {
+        if (m_stringBuffer[i]) {
+            values[i] = m_stringBuffer[i];
+        } else {
+            values[i].clear();
+        }
+    }
+}
+
+
+bool SlaveInstance2::SetRealVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    const double* values)
+{
+    const auto status = fmi2_import_set_real(
+        m_handle,
+        ValueReferences(m_fmu->m_valueReferences, variables, count, m_valueReferenceBuffer),
+        count,
+        values);
+    return CheckSetStatus(status, count, m_lastLogMessage.data());
+}
+
+
+bool SlaveInstance2::SetIntegerVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    const int* values)
+{
+    const auto status = fmi2_import_set_integer(
+        m_handle,
+        ValueReferences(m_fmu->m_valueReferences, variables, count, m_valueReferenceBuffer),
+        count,
+        values);
+    return CheckSetStatus(status, count, m_lastLogMessage.data());
+}
+
+
+bool SlaveInstance2::SetBooleanVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    const bool* values)
+{
+    m_booleanBuffer.resize(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        m_booleanBuffer[i] = values[i] ? fmi2_true : fmi2_false;
+    }
+    const auto status = fmi2_import_set_boolean(
+        m_handle,
+        ValueReferences(m_fmu->m_valueReferences, variables, count, m_valueReferenceBuffer),
+        count,
+        m_booleanBuffer.data());
+    return CheckSetStatus(status, count, m_lastLogMessage.data());
+}
+
+
+bool SlaveInstance2::SetStringVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    const std::string* values)
+{
+    m_stringBuffer.resize(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        m_stringBuffer[i] = values[i].c_str();
+    }
+    const auto status = fmi2_import_set_string(
+        m_handle,
+        ValueReferences(m_fmu->m_valueReferences, variables, count, m_valueReferenceBuffer),
+        count,
+        m_stringBuffer.data());
+    return CheckSetStatus(status, count, m_lastLogMessage.data());
+}
+
+
 std::shared_ptr<coral::fmi::FMU> SlaveInstance2::FMU() const
 {
     return FMU2();
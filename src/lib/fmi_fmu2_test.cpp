@@ -1,3 +1,5 @@
+#include <stdexcept>
+
 #include <boost/filesystem.hpp>
 #include <gtest/gtest.h>
 
@@ -5,6 +7,8 @@
 #include <coral/fmi/fmu2.hpp>
 #include <coral/util.hpp>
 
+#include <fmilib.h>
+
 
 #define STRINGIFY_IMPL(x) #x
 #define STRINGIFY(x) STRINGIFY_IMPL(x)
@@ -51,3 +55,124 @@ TEST(coral_fmi, Fmu2)
     EXPECT_TRUE(foundValve);
     EXPECT_TRUE(foundMinlevel);
 }
+
+
+TEST(coral_fmi, Fmu2MultipleInstances)
+{
+    auto importer = coral::fmi::Importer::Create();
+    auto fmu = std::static_pointer_cast<coral::fmi::FMU2>(importer->Import(
+        boost::filesystem::path(fmuDir) / "fmi2_cs" / "WaterTank_Control.fmu"));
+
+    // The first instance reuses the model description which was parsed
+    // when the FMU was imported, while the second one needs its own.
+    auto instance1 = fmu->InstantiateSlave2();
+    auto instance2 = fmu->InstantiateSlave2();
+    EXPECT_EQ(fmu->FmilibHandle(), instance1->FmilibHandle());
+    EXPECT_NE(instance1->FmilibHandle(), instance2->FmilibHandle());
+    instance1->Setup("testSlave1", "testExecution", 0.0, 1.0, false, 0.0);
+    instance2->Setup("testSlave2", "testExecution", 0.0, 1.0, false, 0.0);
+
+    coral::model::VariableID minlevel = 0;
+    for (const auto& v : fmu->Description().Variables()) {
+        if (v.Name() == "minlevel") minlevel = v.ID();
+    }
+    EXPECT_EQ(1.0, instance1->GetRealVariable(minlevel));
+    EXPECT_EQ(1.0, instance2->GetRealVariable(minlevel));
+
+    // Handles are reused once their instances are gone.
+    const auto handle2 = instance2->FmilibHandle();
+    instance2.reset();
+    auto instance3 = fmu->InstantiateSlave2();
+    EXPECT_EQ(handle2, instance3->FmilibHandle());
+    instance3->Setup("testSlave3", "testExecution", 0.0, 1.0, false, 0.0);
+    EXPECT_EQ(1.0, instance3->GetRealVariable(minlevel));
+}
+
+
+TEST(coral_fmi, Fmu2BatchVariables)
+{
+    auto importer = coral::fmi::Importer::Create();
+    auto fmu = importer->Import(
+        boost::filesystem::path(fmuDir) / "fmi2_cs" / "WaterTank_Control.fmu");
+
+    coral::model::VariableID minlevel = 0, maxlevel = 0;
+    for (const auto& v : fmu->Description().Variables()) {
+        if (v.Name() == "minlevel") minlevel = v.ID();
+        else if (v.Name() == "maxlevel") maxlevel = v.ID();
+    }
+
+    auto instance = fmu->InstantiateSlave();
+    instance->Setup("testSlave", "testExecution", 0.0, 1.0, false, 0.0);
+
+    // The parameters can be set during initialisation, and values set with
+    // the batch setter come back through the batch getter.
+    const coral::model::VariableID params[] = { minlevel, maxlevel };
+    const double newValues[] = { 0.5, 3.5 };
+    EXPECT_TRUE(instance->SetRealVariables(params, 2, newValues));
+
+    const coral::model::VariableID reversed[] = { maxlevel, minlevel, maxlevel };
+    double values[3] = { 0.0, 0.0, 0.0 };
+    instance->GetRealVariables(reversed, 3, values);
+    EXPECT_EQ(3.5, values[0]);
+    EXPECT_EQ(0.5, values[1]);
+    EXPECT_EQ(3.5, values[2]);
+    EXPECT_EQ(0.5, instance->GetRealVariable(minlevel));
+
+    // An empty batch is a no-op.
+    EXPECT_TRUE(instance->SetRealVariables(params, 0, newValues));
+    instance->GetRealVariables(params, 0, values);
+    EXPECT_EQ(3.5, values[0]);
+
+    // Invalid variable IDs are rejected.
+    const coral::model::VariableID invalid[] = { minlevel, 1000 };
+    EXPECT_THROW(instance->GetRealVariables(invalid, 2, values), std::out_of_range);
+    EXPECT_THROW(instance->SetRealVariables(invalid, 2, newValues), std::out_of_range);
+}
+
+
+TEST(coral_fmi, Fmu2ErrorMessage)
+{
+    auto importer = coral::fmi::Importer::Create();
+    auto fmu = std::static_pointer_cast<coral::fmi::FMU2>(importer->Import(
+        boost::filesystem::path(fmuDir) / "fmi2_cs" / "WaterTank_Control.fmu"));
+
+    coral::model::VariableID minlevel = 0;
+    for (const auto& v : fmu->Description().Variables()) {
+        if (v.Name() == "minlevel") minlevel = v.ID();
+    }
+
+    auto instance1 = fmu->InstantiateSlave2();
+    auto instance2 = fmu->InstantiateSlave2();
+    instance1->Setup("testSlave1", "testExecution", 0.0, 1.0, false, 0.0);
+    instance2->Setup("testSlave2", "testExecution", 0.0, 1.0, false, 0.0);
+
+    // This FMU only reports errors in the categories that are enabled.
+    fmi2_string_t categories[] = { "logStatusError" };
+    for (const auto& instance : { instance1, instance2 }) {
+        ASSERT_EQ(fmi2_status_ok, fmi2_import_set_debug_logging(
+            instance->FmilibHandle(), fmi2_true, 1, categories));
+        instance->StartSimulation();
+        instance->EndSimulation();
+    }
+
+    // Setting a variable after termination is an error, and the FMU's
+    // explanation ends up in the exception.  Each instance has its own
+    // message buffer, so the other instance's error is explained by its
+    // own message.
+    try {
+        instance1->SetRealVariable(minlevel, 2.0);
+        ADD_FAILURE() << "Expected exception";
+    } catch (const std::runtime_error& e) {
+        const std::string msg = e.what();
+        EXPECT_NE(std::string::npos, msg.find("fmi2SetReal"));
+        EXPECT_NE(std::string::npos, msg.find("Illegal call sequence"));
+    }
+    try {
+        instance2->StartSimulation();
+        ADD_FAILURE() << "Expected exception";
+    } catch (const std::runtime_error& e) {
+        const std::string msg = e.what();
+        EXPECT_NE(std::string::npos, msg.find("fmi2ExitInitializationMode"));
+        EXPECT_EQ(std::string::npos, msg.find("fmi2SetReal"));
+    }
+}
@@ -6,14 +6,27 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 */
 #include <coral/fmi/importer.hpp>
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
 #include <new>
+#include <set>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/interprocess/sync/file_lock.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 
@@ -34,9 +47,10 @@ namespace fmi
 
 
 std::shared_ptr<Importer> Importer::Create(
-    const boost::filesystem::path& cachePath)
+    const boost::filesystem::path& cachePath,
+    std::uint64_t maxCacheSize)
 {
-    return std::shared_ptr<Importer>(new Importer(cachePath));
+    return std::shared_ptr<Importer>(new Importer(cachePath, maxCacheSize));
 }
 
 
@@ -103,18 +117,23 @@ namespace
 }
 
 
-Importer::Importer(const boost::filesystem::path& cachePath)
+Importer::Importer(
+    const boost::filesystem::path& cachePath,
+    std::uint64_t maxCacheSize)
     : m_callbacks{MakeCallbacks()}
     , m_handle{fmi_import_allocate_context(m_callbacks.get()), &fmi_import_free_context}
     , m_fmuDir{cachePath / "fmu"}
     , m_workDir{cachePath / "tmp"}
+    , m_lockFile{cachePath / "lock"}
+    , m_indexFile{cachePath / "index"}
+    , m_maxCacheSize{maxCacheSize}
 {
     if (m_handle == nullptr) throw std::bad_alloc();
 }
 
 
 Importer::Importer(coral::util::TempDir tempDir)
-    : Importer{tempDir.Path()}
+    : Importer{tempDir.Path(), UNLIMITED_CACHE_SIZE}
 {
     m_tempCacheDir = std::make_unique<coral::util::TempDir>(std::move(tempDir));
 }
@@ -167,33 +186,473 @@ namespace
         return md;
     }
 
-    // Replaces all characters which are not printable ASCII characters or
-    // not valid for use in a path with their percent-encoded equivalents.
-    // References:
-    //     https://en.wikipedia.org/wiki/Percent-encoding
-    //     https://msdn.microsoft.com/en-us/library/aa365247.aspx
-    std::string SanitisePath(const std::string& str)
+    // Opens a file for use with inter-process locking, creating it (and its
+    // parent directory) first if necessary.
+    boost::interprocess::file_lock OpenLockFile(const boost::filesystem::path& path)
     {
-        CORAL_INPUT_CHECK(!str.empty());
-        std::ostringstream sanitised;
-        sanitised.fill('0');
-        sanitised << std::hex;
-        for (const char c : str) {
-            if (c < 0x20 || c > 0x7E
-#ifdef _WIN32
-                || c == '<'  || c == '>' || c == ':' || c == '"' || c == '/'
-                || c == '\\' || c == '|' || c == '?' || c == '*'
-#endif
-            ) {
-                sanitised
-                    << '%'
-                    << std::setw(2)
-                    << static_cast<int>(static_cast<unsigned char>(c));
+        boost::filesystem::create_directories(path.parent_path());
+        std::ofstream(path.string(), std::ios::app);
+        return boost::interprocess::file_lock(path.string().c_str());
+    }
+
+    // Returns the path to the lock file which protects `path`.
+    boost::filesystem::path LockFilePath(const boost::filesystem::path& path)
+    {
+        return path.string() + ".lock";
+    }
+
+    // The cache-wide locks which are held by this process, keyed on the path
+    // to the lock file.  Like the entry locks below, each is a single lock
+    // object shared by all threads, since closing any handle to the file
+    // would release the process' lock on it.  A shared lock is held as long
+    // as any thread uses it.
+    struct CacheLockState
+    {
+        boost::interprocess::file_lock lock;
+        int sharedCount;
+        bool exclusive;
+    };
+    std::map<std::string, CacheLockState> g_cacheLocks;
+    std::mutex g_cacheLocksMutex;
+    std::condition_variable g_cacheLockReleased;
+
+    // A shared or exclusive lock on a cache-wide lock file, which excludes
+    // other threads in this process as well as other processes.
+    class CacheLock
+    {
+    public:
+        CacheLock(const boost::filesystem::path& lockFile, bool exclusive)
+            : m_key(lockFile.string())
+        {
+            std::unique_lock<std::mutex> lock(g_cacheLocksMutex);
+            if (exclusive) {
+                g_cacheLockReleased.wait(lock, [this] () {
+                    return g_cacheLocks.count(m_key) == 0;
+                });
+                auto lockFileHandle = OpenLockFile(lockFile);
+                lockFileHandle.lock();
+                g_cacheLocks.emplace(
+                    m_key,
+                    CacheLockState{std::move(lockFileHandle), 0, true});
             } else {
-                sanitised << c;
+                g_cacheLockReleased.wait(lock, [this] () {
+                    const auto it = g_cacheLocks.find(m_key);
+                    return it == g_cacheLocks.end() || !it->second.exclusive;
+                });
+                auto it = g_cacheLocks.find(m_key);
+                if (it == g_cacheLocks.end()) {
+                    auto lockFileHandle = OpenLockFile(lockFile);
+                    lockFileHandle.lock_sharable();
+                    it = g_cacheLocks.emplace(
+                        m_key,
+                        CacheLockState{std::move(lockFileHandle), 0, false}).first;
+                }
+                ++it->second.sharedCount;
+            }
+            m_locked = true;
+        }
+
+        // Tries to take an exclusive lock without waiting.  Whether it
+        // succeeded is reported by OwnsLock().
+        CacheLock(const boost::filesystem::path& lockFile, std::try_to_lock_t)
+            : m_key(lockFile.string())
+        {
+            std::lock_guard<std::mutex> lock(g_cacheLocksMutex);
+            // This check must come first, since a failed attempt closes the
+            // file handle, which would release a lock held by another thread.
+            if (g_cacheLocks.count(m_key)) return;
+            auto lockFileHandle = OpenLockFile(lockFile);
+            if (!lockFileHandle.try_lock()) return;
+            g_cacheLocks.emplace(
+                m_key,
+                CacheLockState{std::move(lockFileHandle), 0, true});
+            m_locked = true;
+        }
+
+        ~CacheLock() noexcept
+        {
+            if (!m_locked) return;
+            {
+                std::lock_guard<std::mutex> lock(g_cacheLocksMutex);
+                const auto it = g_cacheLocks.find(m_key);
+                assert(it != g_cacheLocks.end());
+                if (it->second.exclusive) {
+                    it->second.lock.unlock();
+                    g_cacheLocks.erase(it);
+                } else if (--it->second.sharedCount == 0) {
+                    it->second.lock.unlock_sharable();
+                    g_cacheLocks.erase(it);
+                }
+            }
+            g_cacheLockReleased.notify_all();
+        }
+
+        CacheLock(const CacheLock&) = delete;
+        CacheLock& operator=(const CacheLock&) = delete;
+
+        bool OwnsLock() const noexcept { return m_locked; }
+
+    private:
+        std::string m_key;
+        bool m_locked = false;
+    };
+
+    // Computes a name for the cache entry of an FMU from the name, size and
+    // CRC of each file in the archive.  This only involves the archive
+    // directory, so it is cheap, yet any change to the contents of the FMU
+    // is practically certain to produce a different name.
+    std::string ContentKey(const coral::util::zip::Archive& zip)
+    {
+        // 64-bit FNV-1a, which, unlike std::hash, gives the same result
+        // everywhere.  Integers are added byte by byte for the same reason.
+        std::uint64_t hash = 14695981039346656037ull;
+        const auto addByte = [&hash] (unsigned char b) {
+            hash = (hash ^ b) * 1099511628211ull;
+        };
+        const auto addInt = [&] (std::uint64_t n) {
+            for (int i = 0; i < 8; ++i) addByte((n >> (8*i)) & 0xFF);
+        };
+        const auto entryCount = zip.EntryCount();
+        for (coral::util::zip::EntryIndex i = 0; i < entryCount; ++i) {
+            const auto name = zip.EntryName(i);
+            for (const char c : name) addByte(static_cast<unsigned char>(c));
+            addByte(0);
+            addInt(zip.EntrySize(i));
+            addInt(zip.EntryCRC(i));
+        }
+        std::ostringstream key;
+        key << std::hex << std::setfill('0') << std::setw(16) << hash;
+        return key.str();
+    }
+
+    // Returns the total size of the files in the archive.
+    std::uint64_t UnpackedSize(const coral::util::zip::Archive& zip)
+    {
+        std::uint64_t size = 0;
+        const auto entryCount = zip.EntryCount();
+        for (coral::util::zip::EntryIndex i = 0; i < entryCount; ++i) {
+            size += zip.EntrySize(i);
+        }
+        return size;
+    }
+
+    // Checks that all files in the archive are present in an unpacked
+    // directory, and have the right sizes.  This catches cache entries which
+    // have been damaged, e.g. by someone deleting files by hand.
+    bool IsIntact(
+        const coral::util::zip::Archive& zip,
+        const boost::filesystem::path& dir)
+    {
+        if (!boost::filesystem::exists(dir)) return false;
+        const auto entryCount = zip.EntryCount();
+        for (coral::util::zip::EntryIndex i = 0; i < entryCount; ++i) {
+            if (zip.IsDirEntry(i)) continue;
+            boost::system::error_code ec;
+            const auto size = boost::filesystem::file_size(dir / zip.EntryName(i), ec);
+            if (ec || size != zip.EntrySize(i)) return false;
+        }
+        return true;
+    }
+
+    // Extracts the contents of an FMU into a temporary directory and then
+    // moves it into place, so nobody ever sees a partially unpacked FMU.
+    // The caller must hold the lock for the target directory.
+    void Unpack(
+        const coral::util::zip::Archive& zip,
+        const boost::filesystem::path& workDir,
+        const boost::filesystem::path& targetDir)
+    {
+        const auto tempDir = workDir / coral::util::RandomUUID();
+        try {
+            boost::filesystem::create_directories(tempDir);
+            zip.ExtractAll(tempDir);
+            if (boost::filesystem::exists(targetDir)) {
+                // The old contents are damaged.  They are moved out of
+                // the way first, since they may not be possible to delete
+                // right away.
+                const auto oldDir = workDir / coral::util::RandomUUID();
+                boost::filesystem::rename(targetDir, oldDir);
+                boost::system::error_code ignoreErrors;
+                boost::filesystem::remove_all(oldDir, ignoreErrors);
+            }
+            boost::filesystem::rename(tempDir, targetDir);
+        } catch (...) {
+            boost::system::error_code ignoreErrors;
+            boost::filesystem::remove_all(tempDir, ignoreErrors);
+            throw;
+        }
+    }
+
+    // Protects g_entryLocks, and serialises cache updates between threads,
+    // which file locks don't do since they are held per process.
+    std::mutex g_cacheMutex;
+
+    // The cache entries which are in use by this process, keyed on the
+    // path to their lock files.  Each is protected from eviction by other
+    // processes with a shared lock, which is held as long as the use count
+    // is nonzero.  Closing any handle to a file releases all of a process'
+    // locks on it, so there must be only one lock object per entry.
+    struct EntryLock
+    {
+        boost::interprocess::file_lock lock;
+        int useCount;
+    };
+    std::map<std::string, EntryLock> g_entryLocks;
+
+    // Makes sure that the cache entry in `entryDir` is unpacked and intact,
+    // and registers a use of it.  This never waits for other processes, so
+    // it returns false if one of them holds a conflicting lock on the entry.
+    // The caller must hold g_cacheMutex.
+    bool TryAcquireEntry(
+        const coral::util::zip::Archive& zip,
+        const boost::filesystem::path& workDir,
+        const boost::filesystem::path& entryDir)
+    {
+        const auto lockPath = LockFilePath(entryDir);
+        const auto it = g_entryLocks.find(lockPath.string());
+        if (it != g_entryLocks.end()) {
+            ++it->second.useCount;
+            return true;
+        }
+
+        auto lockFile = OpenLockFile(lockPath);
+        if (lockFile.try_lock_sharable()) {
+            if (IsIntact(zip, entryDir)) {
+                g_entryLocks.emplace(lockPath.string(), EntryLock{std::move(lockFile), 1});
+                return true;
+            }
+            lockFile.unlock_sharable();
+        }
+
+        // Only one process at a time gets to unpack the FMU, and only when
+        // nobody else is using the damaged copy.
+        if (!lockFile.try_lock()) return false;
+        {
+            const auto unlock = coral::util::OnScopeExit([&] () { lockFile.unlock(); });
+            if (!IsIntact(zip, entryDir)) Unpack(zip, workDir, entryDir);
+        }
+        // The entry could be evicted again before we get the shared lock,
+        // so we have to check it once more.
+        if (!lockFile.try_lock_sharable()) return false;
+        if (!IsIntact(zip, entryDir)) {
+            lockFile.unlock_sharable();
+            return false;
+        }
+        g_entryLocks.emplace(lockPath.string(), EntryLock{std::move(lockFile), 1});
+        return true;
+    }
+
+    // Acquires the cache entry called `entryName`, as TryAcquireEntry()
+    // does, and returns its directory.  If another process is in the way,
+    // the FMU is unpacked afresh under a name nobody else knows, rather
+    // than waiting for that process while holding g_cacheMutex and the
+    // shared cache lock.  The duplicate is evicted like any other entry
+    // once it falls out of use.  The caller must hold g_cacheMutex.
+    boost::filesystem::path AcquireEntry(
+        const coral::util::zip::Archive& zip,
+        const boost::filesystem::path& workDir,
+        const boost::filesystem::path& fmuDir,
+        const std::string& entryName)
+    {
+        const auto entryDir = fmuDir / entryName;
+        if (TryAcquireEntry(zip, workDir, entryDir)) return entryDir;
+        const auto freshDir = fmuDir / (entryName + '-' + coral::util::RandomUUID());
+        if (TryAcquireEntry(zip, workDir, freshDir)) return freshDir;
+        throw std::runtime_error(
+            "FMU cache entry is locked by another process: " + entryDir.string());
+    }
+
+    // Unregisters a use of a cache entry.
+    void ReleaseEntry(const boost::filesystem::path& entryDir) noexcept
+    {
+        std::lock_guard<std::mutex> lock(g_cacheMutex);
+        const auto it = g_entryLocks.find(LockFilePath(entryDir).string());
+        assert(it != g_entryLocks.end());
+        if (--it->second.useCount == 0) {
+            it->second.lock.unlock_sharable();
+            g_entryLocks.erase(it);
+        }
+    }
+
+    // The cache index, which records the size and time of last use (in
+    // seconds since the epoch) of each cache entry.  It is stored as a text
+    // file with one entry per line.
+    struct IndexRecord
+    {
+        std::uint64_t size;
+        std::int64_t lastUse;
+    };
+    typedef std::map<std::string, IndexRecord> CacheIndex;
+
+    CacheIndex ReadIndex(const boost::filesystem::path& file)
+    {
+        CacheIndex index;
+        std::ifstream stream(file.string());
+        std::string entryName;
+        IndexRecord record;
+        while (stream >> entryName >> record.size >> record.lastUse) {
+            index[entryName] = record;
+        }
+        return index;
+    }
+
+    // Writes to a temporary file which then replaces the index, so a crash
+    // never leaves a truncated index behind.  The caller must hold the index
+    // lock.
+    void WriteIndex(const CacheIndex& index, const boost::filesystem::path& file)
+    {
+        const auto tempFile = file.string() + ".tmp";
+        {
+            std::ofstream stream(tempFile, std::ios::trunc);
+            for (const auto& entry : index) {
+                stream << entry.first
+                    << ' ' << entry.second.size
+                    << ' ' << entry.second.lastUse
+                    << '\n';
+            }
+            stream.close();
+            if (!stream) {
+                throw std::runtime_error("Failed to write FMU cache index: " + tempFile);
+            }
+        }
+        boost::filesystem::rename(tempFile, file);
+    }
+
+    // Removes the least recently used entries from the cache until its total
+    // size is within `maxSize`, skipping the ones which are in use by this or
+    // other processes.  The caller must hold g_cacheMutex and the index lock.
+    void Evict(
+        CacheIndex& index,
+        const boost::filesystem::path& fmuDir,
+        std::uint64_t maxSize)
+    {
+        std::uint64_t totalSize = 0;
+        std::vector<std::pair<std::int64_t, std::string>> byLastUse;
+        for (const auto& entry : index) {
+            totalSize += entry.second.size;
+            byLastUse.emplace_back(entry.second.lastUse, entry.first);
+        }
+        if (totalSize <= maxSize) return;
+        std::sort(byLastUse.begin(), byLastUse.end());
+
+        for (const auto& entry : byLastUse) {
+            if (totalSize <= maxSize) break;
+            const auto entryDir = fmuDir / entry.second;
+            const auto lockPath = LockFilePath(entryDir);
+            if (g_entryLocks.count(lockPath.string())) continue;
+            auto lockFile = OpenLockFile(lockPath);
+            if (!lockFile.try_lock()) continue;
+            // The lock file stays behind, since another process may be about
+            // to lock it.  RemoveStaleLockFiles() takes care of it later.
+            boost::system::error_code ec;
+            boost::filesystem::remove_all(entryDir, ec);
+            lockFile.unlock();
+            if (ec) {
+                coral::log::Log(coral::log::warning, boost::format(
+                    "Failed to evict %s from FMU cache: %s")
+                    % entryDir.string() % ec.message());
+                continue;
+            }
+            totalSize -= index[entry.second].size;
+            index.erase(entry.second);
+        }
+        if (totalSize > maxSize) {
+            coral::log::Log(coral::log::warning, boost::format(
+                "FMU cache size (%d bytes) exceeds the limit (%d bytes), "
+                "but the remaining FMUs are in use")
+                % totalSize % maxSize);
+        }
+    }
+
+    // Adds index records for the entries in `fmuDir` which are missing from
+    // the index, e.g. because the index was lost or an import failed before
+    // updating it, so they count toward the size limit too.  Their time of
+    // last use is taken to be the time they were unpacked.
+    void AddMissingIndexRecords(
+        CacheIndex& index,
+        const boost::filesystem::path& fmuDir)
+    {
+        if (!boost::filesystem::exists(fmuDir)) return;
+        for (auto it = boost::filesystem::directory_iterator(fmuDir);
+             it != boost::filesystem::directory_iterator();
+             ++it)
+        {
+            const auto& entryDir = it->path();
+            const auto entryName = entryDir.filename().string();
+            if (!boost::filesystem::is_directory(it->status())
+                || index.count(entryName))
+            {
+                continue;
+            }
+            IndexRecord record{0, 0};
+            boost::system::error_code ec;
+            for (auto fit = boost::filesystem::recursive_directory_iterator(entryDir, ec);
+                 !ec && fit != boost::filesystem::recursive_directory_iterator();
+                 fit.increment(ec))
+            {
+                if (!boost::filesystem::is_regular_file(fit->status())) continue;
+                boost::system::error_code sizeError;
+                const auto size = boost::filesystem::file_size(fit->path(), sizeError);
+                if (!sizeError) record.size += size;
+            }
+            const auto unpackTime = boost::filesystem::last_write_time(entryDir, ec);
+            if (!ec) record.lastUse = static_cast<std::int64_t>(unpackTime);
+            index[entryName] = record;
+        }
+    }
+
+    // Records that a cache entry has just been used, and evicts others if
+    // the cache has grown too big.  The caller must hold g_cacheMutex.
+    void RecordUse(
+        const boost::filesystem::path& indexFile,
+        const boost::filesystem::path& fmuDir,
+        const std::string& entryName,
+        std::uint64_t entrySize,
+        std::uint64_t maxCacheSize)
+    {
+        auto indexLockFile = OpenLockFile(LockFilePath(indexFile));
+        boost::interprocess::scoped_lock<boost::interprocess::file_lock>
+            indexLock(indexLockFile);
+        auto index = ReadIndex(indexFile);
+        index[entryName] = IndexRecord{
+            entrySize,
+            std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count()
+        };
+        AddMissingIndexRecords(index, fmuDir);
+        Evict(index, fmuDir, maxCacheSize);
+        WriteIndex(index, indexFile);
+    }
+
+    // Removes the lock files which Evict() leaves behind.  Like CleanCache(),
+    // this requires the exclusive cache lock, as nobody can be about to lock
+    // an entry then, but it simply gives up if anyone else is using the cache.
+    void RemoveStaleLockFiles(
+        const boost::filesystem::path& cacheLockFile,
+        const boost::filesystem::path& fmuDir)
+    {
+        CacheLock cacheLock(cacheLockFile, std::try_to_lock);
+        if (!cacheLock.OwnsLock()) return;
+        std::lock_guard<std::mutex> lock(g_cacheMutex);
+        if (!boost::filesystem::exists(fmuDir)) return;
+
+        std::vector<boost::filesystem::path> staleLockFiles;
+        for (auto it = boost::filesystem::directory_iterator(fmuDir);
+             it != boost::filesystem::directory_iterator();
+             ++it)
+        {
+            const auto& path = it->path();
+            if (path.extension() == ".lock"
+                && !boost::filesystem::exists(fmuDir / path.stem())
+                && !g_entryLocks.count(path.string()))
+            {
+                staleLockFiles.push_back(path);
             }
         }
-        return sanitised.str();
+        boost::system::error_code ignoredError;
+        for (const auto& path : staleLockFiles) {
+            boost::filesystem::remove(path, ignoredError);
+        }
     }
 }
 
@@ -204,6 +663,12 @@ std::shared_ptr<FMU> Importer::Import(const boost::filesystem::path& fmuPath)
     auto pit = m_pathCache.find(fmuPath);
     if (pit != end(m_pathCache)) return pit->second.lock();
 
+    RemoveStaleLockFiles(m_lockFile, m_fmuDir);
+
+    // Prevent CleanCache() from running in other threads or processes while
+    // we're using the cache.
+    CacheLock cacheLock(m_lockFile, false);
+
     const auto zip = coral::util::zip::Archive(fmuPath);
     const auto tempMdDir = m_workDir / coral::util::RandomUUID();
     boost::filesystem::create_directories(tempMdDir);
@@ -227,24 +692,37 @@ std::shared_ptr<FMU> Importer::Import(const boost::filesystem::path& fmuPath)
     auto git = m_guidCache.find(minModelDesc.guid);
     if (git != end(m_guidCache)) return git->second.lock();
 
-    const auto fmuUnpackDir = m_fmuDir / SanitisePath(minModelDesc.guid);
-    if (!boost::filesystem::exists(fmuUnpackDir) ||
-        !boost::filesystem::exists(fmuUnpackDir / "modelDescription.xml") ||
-        boost::filesystem::last_write_time(fmuPath) > boost::filesystem::last_write_time(fmuUnpackDir / "modelDescription.xml"))
+    // The cache entry is named after the contents of the FMU, so a
+    // modified FMU gets a new entry rather than overwriting the old one,
+    // which may be in use.
+    boost::filesystem::path fmuUnpackDir;
     {
-        boost::filesystem::create_directories(fmuUnpackDir);
+        std::lock_guard<std::mutex> lock(g_cacheMutex);
+        fmuUnpackDir = AcquireEntry(zip, m_workDir, m_fmuDir, ContentKey(zip));
         try {
-            zip.ExtractAll(fmuUnpackDir);
-        } catch (...) {
-            boost::system::error_code ignoreErrors;
-            boost::filesystem::remove_all(fmuUnpackDir, ignoreErrors);
-            throw;
+            RecordUse(
+                m_indexFile,
+                m_fmuDir,
+                fmuUnpackDir.filename().string(),
+                UnpackedSize(zip),
+                m_maxCacheSize);
+        } catch (const std::exception& e) {
+            coral::log::Log(coral::log::warning, boost::format(
+                "Failed to update FMU cache index: %s") % e.what());
         }
     }
+    // The FMU object holds on to the cache entry for as long as it exists.
+    const auto entryGuard = std::shared_ptr<void>(
+        nullptr,
+        [fmuUnpackDir] (void*) { ReleaseEntry(fmuUnpackDir); });
 
     auto fmu = minModelDesc.fmiVersion == FMIVersion::v1_0
-        ? std::shared_ptr<FMU>(new FMU1(shared_from_this(), fmuUnpackDir))
-        : std::shared_ptr<FMU>(new FMU2(shared_from_this(), fmuUnpackDir));
+        ? std::shared_ptr<FMU>(
+            new FMU1(shared_from_this(), fmuUnpackDir),
+            [entryGuard] (FMU1* p) { delete p; })
+        : std::shared_ptr<FMU>(
+            new FMU2(shared_from_this(), fmuUnpackDir),
+            [entryGuard] (FMU2* p) { delete p; });
     m_pathCache[fmuPath] = fmu;
     m_guidCache[minModelDesc.guid] = fmu;
     return fmu;
@@ -274,22 +752,56 @@ std::shared_ptr<FMU> Importer::ImportUnpacked(
 
 void Importer::CleanCache()
 {
+    // Wait for imports in other threads and processes to finish, and keep
+    // new ones from starting until we're done.
+    CacheLock cacheLock(m_lockFile, true);
+    std::lock_guard<std::mutex> lock(g_cacheMutex);
+
     // Remove unused FMUs
     if (boost::filesystem::exists(m_fmuDir)) {
-        boost::system::error_code ignoredError;
+        std::set<std::string> entryNames;
         for (auto it = boost::filesystem::directory_iterator(m_fmuDir);
              it != boost::filesystem::directory_iterator();
              ++it)
         {
-            if (m_guidCache.count(it->path().filename().string()) == 0) {
-                boost::filesystem::remove_all(*it, ignoredError);
+            const auto& path = it->path();
+            entryNames.insert(path.extension() == ".lock"
+                ? path.stem().string()
+                : path.filename().string());
+        }
+        boost::system::error_code ignoredError;
+        for (const auto& entryName : entryNames) {
+            const auto entryDir = m_fmuDir / entryName;
+            const auto lockPath = LockFilePath(entryDir);
+            if (g_entryLocks.count(lockPath.string())) continue;
+            {
+                auto lockFile = OpenLockFile(lockPath);
+                if (!lockFile.try_lock()) continue; // In use by another process
+                boost::filesystem::remove_all(entryDir, ignoredError);
+                lockFile.unlock();
             }
+            // Nobody can be about to lock the lock file, since that only
+            // happens during import, so it is safe to remove it too.
+            boost::filesystem::remove(lockPath, ignoredError);
         }
         if (boost::filesystem::is_empty(m_fmuDir)) {
             boost::filesystem::remove(m_fmuDir, ignoredError);
         }
     }
 
+    // Remove the index records of the entries which are gone
+    {
+        auto indexLockFile = OpenLockFile(LockFilePath(m_indexFile));
+        boost::interprocess::scoped_lock<boost::interprocess::file_lock>
+            indexLock(indexLockFile);
+        auto index = ReadIndex(m_indexFile);
+        for (auto it = begin(index); it != end(index);) {
+            if (boost::filesystem::exists(m_fmuDir / it->first)) ++it;
+            else index.erase(it++);
+        }
+        WriteIndex(index, m_indexFile);
+    }
+
     // Delete the temp-files directory
     boost::system::error_code ec;
     boost::filesystem::remove_all(m_workDir, ec);
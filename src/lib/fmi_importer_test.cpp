@@ -0,0 +1,189 @@
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+
+#include <coral/fmi/importer.hpp>
+#include <coral/fmi/fmu.hpp>
+#include <coral/util/filesystem.hpp>
+
+#ifndef _WIN32
+#   include <sys/types.h>
+#   include <sys/wait.h>
+#   include <unistd.h>
+#endif
+
+
+#define STRINGIFY_IMPL(x) #x
+#define STRINGIFY(x) STRINGIFY_IMPL(x)
+namespace
+{
+    const std::string fmuDir = STRINGIFY(CORAL_TEST_FMU_DIRECTORY);
+
+    // Counts the unpacked FMUs in a cache directory, regardless of its layout.
+    int UnpackedCount(const boost::filesystem::path& cacheDir)
+    {
+        int count = 0;
+        for (auto it = boost::filesystem::recursive_directory_iterator(cacheDir);
+             it != boost::filesystem::recursive_directory_iterator();
+             ++it)
+        {
+            if (it->path().filename() == "modelDescription.xml") ++count;
+        }
+        return count;
+    }
+
+#ifndef _WIN32
+    // The work done by each of the processes in ImporterCacheMultiProcess.
+    // Two threads repeatedly import and instantiate an FMU and clean the
+    // cache, so the process' cache locks are shared between threads too.
+    // Returns the number of failures.
+    int UseCache(
+        const boost::filesystem::path& cacheDir,
+        const boost::filesystem::path& fmuPath)
+    {
+        std::atomic<int> failures(0);
+        const auto work = [&] () {
+            for (int i = 0; i < 10; ++i) {
+                try {
+                    auto importer = coral::fmi::Importer::Create(cacheDir);
+                    auto fmu = importer->Import(fmuPath);
+                    if (fmu->Description().UUID() !=
+                            "{ad6d7bad-97d1-4fb9-ab3e-00a0d051e42c}") {
+                        ++failures;
+                    }
+                    fmu->InstantiateSlave();
+                    fmu.reset();
+                    importer->CleanCache();
+                } catch (...) {
+                    ++failures;
+                }
+            }
+        };
+        std::thread thread(work);
+        work();
+        thread.join();
+        return failures;
+    }
+#endif
+}
+
+
+TEST(coral_fmi, ImporterSharedCache)
+{
+    const auto fmuPath =
+        boost::filesystem::path(fmuDir) / "fmi2_cs" / "WaterTank_Control.fmu";
+    coral::util::TempDir cacheDir;
+
+    // Several importers which share a cache, importing the same FMU at the
+    // same time.
+    const int importerCount = 8;
+    std::vector<std::string> uuids(importerCount);
+    std::vector<std::string> errors(importerCount);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < importerCount; ++i) {
+        threads.emplace_back([&, i] () {
+            try {
+                auto importer = coral::fmi::Importer::Create(cacheDir.Path());
+                uuids[i] = importer->Import(fmuPath)->Description().UUID();
+            } catch (const std::exception& e) {
+                errors[i] = e.what();
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    for (int i = 0; i < importerCount; ++i) {
+        EXPECT_EQ("", errors[i]);
+        EXPECT_EQ("{ad6d7bad-97d1-4fb9-ab3e-00a0d051e42c}", uuids[i]);
+    }
+    EXPECT_EQ(1, UnpackedCount(cacheDir.Path()));
+
+    // The unpacked FMU is reused by later imports, and can be cleaned away
+    // when it is no longer in use.
+    auto importer = coral::fmi::Importer::Create(cacheDir.Path());
+    auto fmu = importer->Import(fmuPath);
+    EXPECT_EQ(1, UnpackedCount(cacheDir.Path()));
+    importer->CleanCache();
+    EXPECT_EQ(1, UnpackedCount(cacheDir.Path()));
+    fmu.reset();
+    importer->CleanCache();
+    EXPECT_EQ(0, UnpackedCount(cacheDir.Path()));
+}
+
+
+TEST(coral_fmi, ImporterCacheEviction)
+{
+    const auto fmu1Path =
+        boost::filesystem::path(std::getenv("CORAL_TEST_DATA_DIR")) / "fmi1_cs" / "identity.fmu";
+    const auto fmu2Path =
+        boost::filesystem::path(fmuDir) / "fmi2_cs" / "WaterTank_Control.fmu";
+    coral::util::TempDir cacheDir;
+
+    // A copy of an FMU has the same contents, and therefore reuses the
+    // cache entry.
+    const auto fmu1Copy = cacheDir.Path() / "copy.fmu";
+    boost::filesystem::copy_file(fmu1Path, fmu1Copy);
+    {
+        auto importer = coral::fmi::Importer::Create(cacheDir.Path());
+        importer->Import(fmu1Path);
+        EXPECT_EQ(1, UnpackedCount(cacheDir.Path()));
+    }
+    {
+        auto importer = coral::fmi::Importer::Create(cacheDir.Path());
+        importer->Import(fmu1Copy);
+        EXPECT_EQ(1, UnpackedCount(cacheDir.Path()));
+    }
+
+    // With a tiny cache, only the FMUs which are in use are kept.
+    auto importer = coral::fmi::Importer::Create(cacheDir.Path(), 1);
+    auto fmu1 = importer->Import(fmu1Path);
+    EXPECT_EQ(1, UnpackedCount(cacheDir.Path()));
+    auto fmu2 = importer->Import(fmu2Path);
+    EXPECT_EQ(2, UnpackedCount(cacheDir.Path()));
+    fmu1.reset();
+    fmu2.reset();
+    fmu2 = importer->Import(fmu2Path);
+    EXPECT_EQ(1, UnpackedCount(cacheDir.Path()));
+    EXPECT_EQ("WaterTank.Control", fmu2->Description().Name());
+}
+
+
+#ifndef _WIN32
+TEST(coral_fmi, ImporterCacheMultiProcess)
+{
+    const auto fmuPath =
+        boost::filesystem::path(fmuDir) / "fmi2_cs" / "WaterTank_Control.fmu";
+    coral::util::TempDir cacheDir;
+
+    // Several processes which import FMUs from, and clean, the same cache
+    // at the same time.  An FMU which is cleaned away while another process
+    // is using it fails to instantiate.
+    const int processCount = 4;
+    std::vector<pid_t> children;
+    for (int i = 0; i < processCount; ++i) {
+        const auto pid = fork();
+        ASSERT_NE(-1, pid);
+        if (pid == 0) _exit(UseCache(cacheDir.Path(), fmuPath) == 0 ? 0 : 1);
+        children.push_back(pid);
+    }
+    for (const auto pid : children) {
+        int status = 0;
+        ASSERT_EQ(pid, waitpid(pid, &status, 0));
+        ASSERT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(0, WEXITSTATUS(status));
+    }
+
+    // The cache is left in a usable state.
+    auto importer = coral::fmi::Importer::Create(cacheDir.Path());
+    auto fmu = importer->Import(fmuPath);
+    EXPECT_EQ("WaterTank.Control", fmu->Description().Name());
+    EXPECT_EQ(1, UnpackedCount(cacheDir.Path()));
+    fmu.reset();
+    importer->CleanCache();
+    EXPECT_EQ(0, UnpackedCount(cacheDir.Path()));
+}
+#endif
@@ -6,6 +6,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 */
 #include <coral/log.hpp>
 
+#include <atomic>
 #include <iostream>
 #include <mutex>
 #include <vector>
@@ -42,6 +43,10 @@ namespace
     std::vector<Sink> g_sinks{{error, CLogPtr()}};
     bool g_sinksAdded = false;
 
+    // The lowest level of any sink.  This is only modified while g_mutex
+    // is held, but it is read without it.
+    std::atomic<int> g_minLevel{error};
+
     // Returns a space-padded, human-readable string for each log level.
     const char* LevelNamePadded(Level level)
     {
@@ -79,6 +84,12 @@ namespace
     }
 
 
+bool IsEnabled(Level level) noexcept
+{
+    return level >= g_minLevel.load(std::memory_order_relaxed);
+}
+
+
 void Log(Level level, const char* message) noexcept
 {
     CORAL_IMPLEMENT_LOG
@@ -122,8 +133,10 @@ void AddSink(std::shared_ptr<std::ostream> stream, Level level)
         g_sinks.front().level = level;
         g_sinks.front().stream = stream;
         g_sinksAdded = true;
+        g_minLevel = level;
     } else {
         g_sinks.push_back({level, stream});
+        if (level < g_minLevel) g_minLevel = level;
     }
 }
 
@@ -0,0 +1,45 @@
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <coral/log.hpp>
+
+
+TEST(coral_log, IsEnabled)
+{
+    using namespace coral::log;
+
+    // Sinks can't be removed again, so this only adds sinks at levels which
+    // are checked relative to the state the rest of the process left.
+    EXPECT_TRUE(IsEnabled(error));
+    const bool traceEnabled = IsEnabled(trace);
+
+    const auto warningSink = std::make_shared<std::ostringstream>();
+    AddSink(warningSink, warning);
+    EXPECT_TRUE(IsEnabled(error));
+    EXPECT_TRUE(IsEnabled(warning));
+    EXPECT_EQ(traceEnabled, IsEnabled(trace));
+
+    const auto infoSink = std::make_shared<std::ostringstream>();
+    AddSink(infoSink, info);
+    EXPECT_TRUE(IsEnabled(warning));
+    EXPECT_TRUE(IsEnabled(info));
+    EXPECT_EQ(traceEnabled, IsEnabled(trace));
+
+    // A sink with a higher level doesn't disable the lower ones.
+    const auto errorSink = std::make_shared<std::ostringstream>();
+    AddSink(errorSink, error);
+    EXPECT_TRUE(IsEnabled(info));
+    EXPECT_EQ(traceEnabled, IsEnabled(trace));
+
+    // Each sink only gets the messages at or above its own level.
+    Log(info, "coral_log_IsEnabled info");
+    Log(warning, "coral_log_IsEnabled warning");
+    EXPECT_EQ(std::string::npos, warningSink->str().find("coral_log_IsEnabled info"));
+    EXPECT_NE(std::string::npos, warningSink->str().find("coral_log_IsEnabled warning"));
+    EXPECT_NE(std::string::npos, infoSink->str().find("coral_log_IsEnabled info"));
+    EXPECT_NE(std::string::npos, infoSink->str().find("coral_log_IsEnabled warning"));
+    EXPECT_TRUE(errorSink->str().empty());
+}
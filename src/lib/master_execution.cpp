@@ -6,8 +6,15 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 */
 #include <coral/master/execution.hpp>
 
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
 #include <exception>
+#include <map>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
 #include <utility>
 
 #include <zmq.hpp>
@@ -25,26 +32,633 @@ namespace
         return message + " (" + code.message() + ")";
     }
 
-    template<typename T, typename E>
-    void SetException(std::promise<T>& promise, E exception)
+    std::exception_ptr ErrPtr(const std::string& message, std::error_code code)
     {
-        promise.set_exception(std::make_exception_ptr(std::move(exception)));
+        return std::make_exception_ptr(std::runtime_error(ErrMsg(message, code)));
     }
 
-    std::function<void(const std::error_code&)> SimpleHandler(
-        std::promise<void> promise,
-        const std::string& errMsg)
+
+    // Completion handlers which forward the result of an operation to a
+    // CommThreadCompletion or a std::promise.
+    // Note: The shared_ptrs are there because std::function must be copyable.
+    coral::master::Execution::AsyncHandler MakeHandler(
+        coral::async::CommThreadCompletion<void> completion)
+    {
+        const auto sharedCompletion =
+            std::make_shared<decltype(completion)>(std::move(completion));
+        return [sharedCompletion] (std::exception_ptr e)
+        {
+            if (e) sharedCompletion->SetException(e);
+            else sharedCompletion->SetValue();
+        };
+    }
+
+    template<typename Result>
+    std::function<void(std::exception_ptr, Result)> MakeHandler(
+        coral::async::CommThreadCompletion<Result> completion)
+    {
+        const auto sharedCompletion =
+            std::make_shared<decltype(completion)>(std::move(completion));
+        return [sharedCompletion] (std::exception_ptr e, Result r)
+        {
+            if (e) sharedCompletion->SetException(e);
+            else sharedCompletion->SetValue(std::move(r));
+        };
+    }
+
+    coral::master::Execution::AsyncHandler MakeHandler(
+        std::shared_ptr<std::promise<void>> promise)
+    {
+        return [promise] (std::exception_ptr e)
+        {
+            if (e) promise->set_exception(e);
+            else promise->set_value();
+        };
+    }
+
+    template<typename Result>
+    std::function<void(std::exception_ptr, Result)> MakeHandler(
+        std::shared_ptr<std::promise<Result>> promise)
+    {
+        return [promise] (std::exception_ptr e, Result r)
+        {
+            if (e) promise->set_exception(e);
+            else promise->set_value(std::move(r));
+        };
+    }
+
+
+    // Keeps track of the number of operations that have been submitted
+    // but not completed, and enforces an upper limit.
+    class OperationLimiter
+    {
+    public:
+        explicit OperationLimiter(int maxCount)
+            : m_maxCount{maxCount}
+            , m_count{0}
+        { }
+
+        // Waits until there is room for another operation.
+        void Reserve()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_released.wait(lock, [this] () { return m_count < m_maxCount; });
+            ++m_count;
+        }
+
+        // Like Reserve(), but returns `false` rather than waiting.
+        bool TryReserve()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_count >= m_maxCount) return false;
+            ++m_count;
+            return true;
+        }
+
+        void Release()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            assert(m_count > 0);
+            --m_count;
+            m_released.notify_all();
+        }
+
+    private:
+        const int m_maxCount;
+        int m_count;
+        std::mutex m_mutex;
+        std::condition_variable m_released;
+    };
+
+
+    /*
+    An operation on the ExecutionManager.  It must call `done` exactly once,
+    when the ExecutionManager is ready for the next operation, and then
+    report its result to whoever submitted it.
+    */
+    struct Background;
+    using Operation = std::function<void(
+        Background& bg,
+        std::function<void()> done)>;
+
+
+    // The data which lives in the background thread.
+    struct Background
     {
-        // Note: This is because std::function must be copyable.
-        auto sharedPromise =
-            std::make_shared<decltype(promise)>(std::move(promise));
-        return [=] (const std::error_code& ec)
+        // Starts an operation, or queues it if another one is in progress.
+        void Start(Operation op)
         {
-            if (ec) {
-                SetException(*sharedPromise, std::runtime_error(ErrMsg(errMsg, ec)));
+            if (busy) {
+                queuedOps.push_back(std::move(op));
             } else {
-                sharedPromise->set_value();
+                Run(std::move(op));
+            }
+        }
+
+        void Run(Operation op)
+        {
+            busy = true;
+            op(*this, [this] () { Done(); });
+        }
+
+        void Done()
+        {
+            limiter->Release();
+            if (queuedOps.empty()) {
+                busy = false;
+                return;
+            }
+            // We are probably inside an ExecutionManager completion handler,
+            // and it may not be ready for the next operation until the
+            // handler has returned.
+            reactor->AddTimer(
+                std::chrono::microseconds(0),
+                1,
+                [this] (coral::net::Reactor&, int)
+                {
+                    auto op = std::move(queuedOps.front());
+                    queuedOps.pop_front();
+                    Run(std::move(op));
+                });
+        }
+
+        std::unique_ptr<coral::bus::ExecutionManager> execMgr;
+        coral::net::Reactor* reactor = nullptr;
+        OperationLimiter* limiter = nullptr;
+        coral::model::TimePoint currentTime = 0.0;
+        std::deque<Operation> queuedOps;
+        bool busy = false;
+    };
+
+
+    Operation ReconstituteOperation(
+        std::vector<coral::master::AddedSlave>& slavesToAdd,
+        std::chrono::milliseconds timeout,
+        coral::master::Execution::AsyncHandler onComplete)
+    {
+        return [&slavesToAdd, timeout, onComplete] (
+            Background& bg,
+            std::function<void()> done)
+        {
+            try {
+                std::vector<coral::bus::AddedSlave> slavesToAdd2;
+                for (const auto& sta : slavesToAdd) {
+                    slavesToAdd2.emplace_back(sta.locator, sta.name);
+                }
+                bg.execMgr->Reconstitute(
+                    slavesToAdd2,
+                    timeout,
+                    [done, onComplete] (const std::error_code& ec) {
+                        done();
+                        onComplete(ec
+                            ? ErrPtr("Failed to perform reconstitution", ec)
+                            : nullptr);
+                    },
+                    [&slavesToAdd] (
+                        const std::error_code& ec,
+                        const coral::model::SlaveDescription& info,
+                        std::size_t index)
+                    {
+                        slavesToAdd[index].info = info;
+                        slavesToAdd[index].error = ec;
+                    });
+            } catch (...) {
+                done();
+                onComplete(std::current_exception());
+            }
+        };
+    }
+
+
+    Operation ReconfigureOperation(
+        std::vector<coral::master::SlaveConfig>& slaveConfigs,
+        std::chrono::milliseconds timeout,
+        coral::master::Execution::AsyncHandler onComplete)
+    {
+        return [&slaveConfigs, timeout, onComplete] (
+            Background& bg,
+            std::function<void()> done)
+        {
+            try {
+                std::vector<coral::bus::SlaveConfig> slaveConfigs2;
+                for (const auto& sc : slaveConfigs) {
+                    slaveConfigs2.emplace_back(
+                        sc.slaveID,
+                        sc.variableSettings);
+                }
+                bg.execMgr->Reconfigure(
+                    slaveConfigs2,
+                    timeout,
+                    [done, onComplete] (const std::error_code& ec) {
+                        done();
+                        onComplete(ec
+                            ? ErrPtr("Failed to perform reconfiguration", ec)
+                            : nullptr);
+                    },
+                    [&slaveConfigs]
+                        (const std::error_code& ec, coral::model::SlaveID id, std::size_t index)
+                    {
+                        assert(slaveConfigs[index].slaveID = id);
+                        slaveConfigs[index].error = ec;
+                    });
+            } catch (...) {
+                done();
+                onComplete(std::current_exception());
+            }
+        };
+    }
+
+
+    Operation StepOperation(
+        coral::model::TimeDuration stepSize,
+        std::chrono::milliseconds timeout,
+        std::vector<std::pair<coral::model::SlaveID, coral::master::StepResult>>* slaveResults,
+        coral::master::Execution::AsyncStepHandler onComplete)
+    {
+        using coral::master::StepResult;
+        return [=] (
+            Background& bg,
+            std::function<void()> done)
+        {
+            std::function<void(const std::error_code&, coral::model::SlaveID)>
+                perSlaveHandler = [slaveResults]
+                    (const std::error_code& ec, coral::model::SlaveID slaveID)
+                {
+                    if (!ec) {
+                        if (slaveResults) {
+                            slaveResults->push_back(
+                                std::make_pair(slaveID, StepResult::completed));
+                        }
+                    } else if (ec == coral::error::sim_error::cannot_perform_timestep
+                            && slaveResults) {
+                        slaveResults->push_back(
+                            std::make_pair(slaveID, StepResult::failed));
+                    } else {
+                        coral::log::Log(
+                            coral::log::error,
+                            boost::format("Slave %d failed to perform time step (%s)")
+                                % slaveID
+                                % ec.message());
+                    }
+                };
+
+            try {
+                bg.execMgr->Step(
+                    stepSize,
+                    timeout,
+                    [&bg, stepSize, done, onComplete] (const std::error_code& ec)
+                    {
+                        if (!ec) bg.currentTime += stepSize;
+                        done();
+                        if (!ec || ec == coral::error::sim_error::cannot_perform_timestep) {
+                            onComplete(
+                                nullptr,
+                                ec == coral::error::sim_error::cannot_perform_timestep
+                                    ? StepResult::failed
+                                    : StepResult::completed);
+                        } else {
+                            onComplete(
+                                ErrPtr("Failed to perform time step", ec),
+                                StepResult::failed);
+                        }
+                    },
+                    std::move(perSlaveHandler));
+            } catch (...) {
+                done();
+                onComplete(std::current_exception(), StepResult::failed);
+            }
+        };
+    }
+
+
+    Operation AcceptStepOperation(
+        std::chrono::milliseconds timeout,
+        coral::master::Execution::AsyncHandler onComplete)
+    {
+        return [timeout, onComplete] (
+            Background& bg,
+            std::function<void()> done)
+        {
+            try {
+                bg.execMgr->AcceptStep(
+                    timeout,
+                    [done, onComplete] (const std::error_code& ec)
+                    {
+                        done();
+                        onComplete(ec
+                            ? ErrPtr("Failed to complete time step", ec)
+                            : nullptr);
+                    });
+            } catch (...) {
+                done();
+                onComplete(std::current_exception());
+            }
+        };
+    }
+
+
+    Operation RunDecentralizedOperation(
+        coral::model::TimeDuration stepSize,
+        int stepCount,
+        std::chrono::milliseconds timeout,
+        int progressInterval,
+        std::function<bool(coral::model::TimePoint)> onProgress,
+        std::function<void(std::exception_ptr, int)> onComplete)
+    {
+        return [=] (
+            Background& bg,
+            std::function<void()> done)
+        {
+            const auto mgr = bg.execMgr.get();
+            try {
+                bg.execMgr->Run(
+                    stepSize,
+                    stepCount,
+                    progressInterval,
+                    timeout,
+                    [mgr, onProgress] (coral::model::TimePoint t)
+                    {
+                        if (onProgress && !onProgress(t)) mgr->Interrupt();
+                    },
+                    [&bg, stepSize, done, onComplete] (const std::error_code& ec, int stepsDone)
+                    {
+                        bg.currentTime += stepsDone * stepSize;
+                        done();
+                        onComplete(
+                            ec ? ErrPtr("Failed to perform time steps", ec) : nullptr,
+                            stepsDone);
+                    },
+                    [] (const std::error_code& ec, coral::model::SlaveID slaveID)
+                    {
+                        if (ec) {
+                            coral::log::Log(
+                                coral::log::error,
+                                boost::format("Slave %d failed to perform time steps (%s)")
+                                    % slaveID
+                                    % ec.message());
+                        }
+                    });
+            } catch (...) {
+                done();
+                onComplete(std::current_exception(), 0);
+            }
+        };
+    }
+
+
+    /*
+    Performs the time stepping loop of Execution::RunUntil().  It starts
+    each step, acceptance and reconfiguration from the completion handler
+    of the previous one, so the loop never leaves the background thread.
+    The object keeps itself alive through the handlers until the run is
+    complete.
+    */
+    class RunUntilDriver : public std::enable_shared_from_this<RunUntilDriver>
+    {
+    public:
+        RunUntilDriver(
+            Background& bg,
+            coral::model::TimePoint stopTime,
+            coral::model::TimeDuration stepSize,
+            const coral::master::RunOptions& options,
+            std::function<void()> done,
+            std::function<void(std::exception_ptr, coral::model::TimePoint)> onComplete)
+            : m_bg(bg)
+            , m_maxTime{stopTime - 0.9*stepSize}
+            , m_stepSize{stepSize}
+            , m_options(options)
+            , m_done{std::move(done)}
+            , m_onComplete{std::move(onComplete)}
+            , m_lastProgress{std::chrono::steady_clock::now()}
+        {
+            std::stable_sort(
+                m_options.scenario.begin(),
+                m_options.scenario.end(),
+                [] (const coral::master::ScenarioEvent& a, const coral::master::ScenarioEvent& b)
+                {
+                    return a.timePoint < b.timePoint;
+                });
+        }
+
+        void Start()
+        {
+            Continue();
+        }
+
+    private:
+        // Decides what to do next, based on the current time and on
+        // whether a step is waiting to be accepted.
+        void Continue()
+        {
+            try {
+                const bool finished = m_stopRequested || m_bg.currentTime >= m_maxTime;
+                const bool eventsDue = !finished
+                    && m_nextEvent < m_options.scenario.size()
+                    && m_options.scenario[m_nextEvent].timePoint <= m_bg.currentTime;
+                if (m_stepPending && (finished || eventsDue)) {
+                    AcceptStep();
+                } else if (finished) {
+                    Finish(m_progressError);
+                } else if (eventsDue) {
+                    ApplyEvents();
+                } else {
+                    // If the previous step has not been accepted, this
+                    // accepts it implicitly.
+                    Step();
+                }
+            } catch (...) {
+                Finish(std::current_exception());
+            }
+        }
+
+        void Step()
+        {
+            const auto self = shared_from_this();
+            m_bg.execMgr->Step(
+                m_stepSize,
+                m_options.stepTimeout,
+                [self] (const std::error_code& ec)
+                {
+                    self->Defer([self, ec] () { self->Stepped(ec); });
+                },
+                [] (const std::error_code& ec, coral::model::SlaveID slaveID)
+                {
+                    if (ec) {
+                        coral::log::Log(
+                            coral::log::error,
+                            boost::format("Slave %d failed to perform time step (%s)")
+                                % slaveID
+                                % ec.message());
+                    }
+                });
+        }
+
+        void Stepped(const std::error_code& ec)
+        {
+            if (ec == coral::error::sim_error::cannot_perform_timestep) {
+                Finish(std::make_exception_ptr(std::runtime_error(
+                    "One or more slaves failed to perform the time step")));
+            } else if (ec) {
+                Finish(ErrPtr("Failed to perform time step", ec));
+            } else {
+                m_stepPending = true;
+                m_bg.currentTime += m_stepSize;
+                ReportProgress();
+                Continue();
+            }
+        }
+
+        void AcceptStep()
+        {
+            const auto self = shared_from_this();
+            m_bg.execMgr->AcceptStep(
+                m_options.commTimeout,
+                [self] (const std::error_code& ec)
+                {
+                    self->Defer([self, ec] ()
+                    {
+                        if (ec) {
+                            self->Finish(ErrPtr("Failed to complete time step", ec));
+                        } else {
+                            self->m_stepPending = false;
+                            self->Continue();
+                        }
+                    });
+                });
+        }
+
+        // Applies all scenario events that are due, with one SlaveConfig
+        // per affected slave.
+        void ApplyEvents()
+        {
+            std::vector<coral::bus::SlaveConfig> slaveConfigs;
+            std::map<coral::model::SlaveID, std::size_t> indexes;
+            const auto& scenario = m_options.scenario;
+            for (;
+                 m_nextEvent < scenario.size()
+                    && scenario[m_nextEvent].timePoint <= m_bg.currentTime;
+                 ++m_nextEvent)
+            {
+                const auto& event = scenario[m_nextEvent];
+                auto indexIt = indexes.find(event.slaveID);
+                if (indexIt == indexes.end()) {
+                    indexIt = indexes.insert(
+                            std::make_pair(event.slaveID, slaveConfigs.size())
+                        ).first;
+                    slaveConfigs.emplace_back(
+                        event.slaveID,
+                        std::vector<coral::model::VariableSetting>{});
+                }
+                slaveConfigs[indexIt->second].variableSettings.push_back(
+                    event.setting);
+            }
+
+            const auto self = shared_from_this();
+            m_bg.execMgr->Reconfigure(
+                slaveConfigs,
+                m_options.commTimeout,
+                [self] (const std::error_code& ec)
+                {
+                    // The ExecutionManager is not ready for the next
+                    // operation until this handler has returned.
+                    self->Defer([self, ec] ()
+                    {
+                        if (ec) {
+                            self->Finish(ErrPtr("Failed to apply scenario events", ec));
+                        } else {
+                            self->Continue();
+                        }
+                    });
+                },
+                [] (const std::error_code& ec, coral::model::SlaveID slaveID, std::size_t)
+                {
+                    if (ec) {
+                        coral::log::Log(
+                            coral::log::error,
+                            boost::format("Slave %d failed to apply scenario events (%s)")
+                                % slaveID
+                                % ec.message());
+                    }
+                });
+        }
+
+        void ReportProgress()
+        {
+            if (!m_options.onProgress) return;
+            const auto now = std::chrono::steady_clock::now();
+            if (now - m_lastProgress < m_options.progressInterval) return;
+            m_lastProgress = now;
+            // If the handler throws, the run is stopped as if it had
+            // returned false, and then completed with the exception.
+            try {
+                if (!m_options.onProgress(m_bg.currentTime)) m_stopRequested = true;
+            } catch (...) {
+                m_progressError = std::current_exception();
+                m_stopRequested = true;
             }
+        }
+
+        // Runs `action` once the current handler has returned.
+        void Defer(std::function<void()> action)
+        {
+            m_bg.reactor->AddTimer(
+                std::chrono::microseconds(0),
+                1,
+                [action] (coral::net::Reactor&, int) { action(); });
+        }
+
+        void Finish(std::exception_ptr error)
+        {
+            m_done();
+            m_onComplete(error, m_bg.currentTime);
+        }
+
+        Background& m_bg;
+        const coral::model::TimePoint m_maxTime;
+        const coral::model::TimeDuration m_stepSize;
+        coral::master::RunOptions m_options;
+        const std::function<void()> m_done;
+        const std::function<void(std::exception_ptr, coral::model::TimePoint)> m_onComplete;
+
+        std::size_t m_nextEvent = 0;
+        bool m_stepPending = false;
+        bool m_stopRequested = false;
+        std::exception_ptr m_progressError;
+        std::chrono::steady_clock::time_point m_lastProgress;
+    };
+
+
+    Operation RunUntilOperation(
+        coral::model::TimePoint stopTime,
+        coral::model::TimeDuration stepSize,
+        const coral::master::RunOptions& options,
+        std::function<void(std::exception_ptr, coral::model::TimePoint)> onComplete)
+    {
+        return [=] (
+            Background& bg,
+            std::function<void()> done)
+        {
+            std::make_shared<RunUntilDriver>(
+                bg, stopTime, stepSize, options, std::move(done), onComplete
+            )->Start();
+        };
+    }
+
+
+    Operation TerminateOperation(coral::master::Execution::AsyncHandler onComplete)
+    {
+        return [onComplete] (
+            Background& bg,
+            std::function<void()> done)
+        {
+            std::exception_ptr error;
+            try {
+                bg.execMgr->Terminate();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            done();
+            onComplete(error);
         };
     }
 }
@@ -57,24 +671,31 @@ public:
     Private(
         const std::string& executionName,
         const ExecutionOptions& options)
-        : m_thread{}
+        : m_limiter{options.maxPendingOperations}
+        , m_thread{}
     {
-        m_thread.Execute<void>(
+        CORAL_INPUT_CHECK(options.maxPendingOperations > 0);
+        m_thread.ExecuteAndWait<void>(
             [&] (
                 coral::net::Reactor& reactor,
-                ExecMgr& execMgr,
-                std::promise<void> status)
+                Background& bg,
+                coral::async::CommThreadCompletion<void> completion)
             {
                 try {
-                    execMgr = std::make_unique<coral::bus::ExecutionManager>(
+                    bg.execMgr = std::make_unique<coral::bus::ExecutionManager>(
                         reactor,
                         executionName,
                         options);
-                    status.set_value();
+                    bg.reactor = &reactor;
+                    bg.limiter = &m_limiter;
+                    bg.currentTime = options.startTime;
+                    m_background = &bg;
+                    m_backgroundThreadID = std::this_thread::get_id();
+                    completion.SetValue();
                 } catch (...) {
-                    status.set_exception(std::current_exception());
+                    completion.SetException(std::current_exception());
                 }
-            }).get();
+            });
     }
 
     Private(const Private&) = delete;
@@ -86,194 +707,123 @@ public:
         std::vector<AddedSlave>& slavesToAdd,
         std::chrono::milliseconds timeout)
     {
-        m_thread.Execute<void>(
-            [&slavesToAdd, timeout] (
-                coral::net::Reactor&,
-                ExecMgr& execMgr,
-                std::promise<void> promise)
-            {
-                const auto sharedPromise =
-                    std::make_shared<decltype(promise)>(std::move(promise));
-                try {
-                    std::vector<coral::bus::AddedSlave> slavesToAdd2;
-                    for (const auto& sta : slavesToAdd) {
-                        slavesToAdd2.emplace_back(sta.locator, sta.name);
-                    }
-                    execMgr->Reconstitute(
-                        slavesToAdd2,
-                        timeout,
-                        [sharedPromise] (const std::error_code& ec) {
-                            if (!ec) {
-                                sharedPromise->set_value();
-                            } else {
-                                SetException(
-                                    *sharedPromise,
-                                    std::runtime_error(
-                                        ErrMsg("Failed to perform reconstitution", ec)));
-                            }
-                        },
-                        [&slavesToAdd] (
-                            const std::error_code& ec,
-                            const coral::model::SlaveDescription& info,
-                            std::size_t index)
-                        {
-                            slavesToAdd[index].info = info;
-                            slavesToAdd[index].error = ec;
-                        });
-                } catch (...) {
-                    sharedPromise->set_exception(std::current_exception());
-                }
-            }
-        ).get();
+        Perform<void>([&] (AsyncHandler onComplete)
+        {
+            return ReconstituteOperation(slavesToAdd, timeout, std::move(onComplete));
+        });
     }
 
     void Reconfigure(
         std::vector<SlaveConfig>& slaveConfigs,
         std::chrono::milliseconds timeout)
     {
-        m_thread.Execute<void>(
-            [&slaveConfigs, timeout] (
-                coral::net::Reactor&,
-                ExecMgr& execMgr,
-                std::promise<void> promise)
-            {
-                const auto sharedPromise =
-                    std::make_shared<decltype(promise)>(std::move(promise));
-                try {
-                    std::vector<coral::bus::SlaveConfig> slaveConfigs2;
-                    for (const auto& sc : slaveConfigs) {
-                        slaveConfigs2.emplace_back(
-                            sc.slaveID,
-                            sc.variableSettings);
-                    }
-                    execMgr->Reconfigure(
-                        slaveConfigs2,
-                        timeout,
-                        [sharedPromise] (const std::error_code& ec) {
-                            if (!ec) {
-                                sharedPromise->set_value();
-                            } else {
-                                SetException(
-                                    *sharedPromise,
-                                    std::runtime_error(
-                                        ErrMsg("Failed to perform reconfiguration", ec)));
-                            }
-                        },
-                        [&slaveConfigs]
-                            (const std::error_code& ec, coral::model::SlaveID id, std::size_t index)
-                        {
-                            assert(slaveConfigs[index].slaveID = id);
-                            slaveConfigs[index].error = ec;
-                        });
-                } catch (...) {
-                    sharedPromise->set_exception(std::current_exception());
-                }
-            }
-        ).get();
+        Perform<void>([&] (AsyncHandler onComplete)
+        {
+            return ReconfigureOperation(slaveConfigs, timeout, std::move(onComplete));
+        });
     }
 
-
     StepResult Step(
         coral::model::TimeDuration stepSize,
         std::chrono::milliseconds timeout,
         std::vector<std::pair<coral::model::SlaveID, StepResult>>* slaveResults)
     {
-        return m_thread.Execute<StepResult>(
-            [=] (
-                coral::net::Reactor&,
-                ExecMgr& execMgr,
-                std::promise<StepResult> promise)
-            {
-                std::function<void(const std::error_code&, coral::model::SlaveID)>
-                    perSlaveHandler = [slaveResults]
-                        (const std::error_code& ec, coral::model::SlaveID slaveID)
-                    {
-                        if (!ec) {
-                            if (slaveResults) {
-                                slaveResults->push_back(
-                                    std::make_pair(slaveID, StepResult::completed));
-                            }
-                        } else if (ec == coral::error::sim_error::cannot_perform_timestep
-                                && slaveResults) {
-                            slaveResults->push_back(
-                                std::make_pair(slaveID, StepResult::failed));
-                        } else {
-                            coral::log::Log(
-                                coral::log::error,
-                                boost::format("Slave %d failed to perform time step (%s)")
-                                    % slaveID
-                                    % ec.message());
-                        }
-                    };
+        return Perform<StepResult>([&] (AsyncStepHandler onComplete)
+        {
+            return StepOperation(stepSize, timeout, slaveResults, std::move(onComplete));
+        });
+    }
 
-                auto sharedPromise =
-                    std::make_shared<decltype(promise)>(std::move(promise));
-                execMgr->Step(
-                    stepSize,
-                    timeout,
-                    [sharedPromise] (const std::error_code& ec)
-                    {
-                        if (!ec || ec == coral::error::sim_error::cannot_perform_timestep) {
-                            sharedPromise->set_value(ec == coral::error::sim_error::cannot_perform_timestep
-                                ? StepResult::failed
-                                : StepResult::completed);
-                        } else {
-                            SetException(
-                                *sharedPromise,
-                                std::runtime_error(
-                                    ErrMsg("Failed to perform time step", ec)));
-                        }
-                    },
-                    std::move(perSlaveHandler));
-            }
-        ).get();
+    void AcceptStep(std::chrono::milliseconds timeout)
+    {
+        Perform<void>([&] (AsyncHandler onComplete)
+        {
+            return AcceptStepOperation(timeout, std::move(onComplete));
+        });
     }
 
+    int RunDecentralized(
+        coral::model::TimeDuration stepSize,
+        int stepCount,
+        std::chrono::milliseconds timeout,
+        int progressInterval,
+        std::function<bool(coral::model::TimePoint)> onProgress)
+    {
+        return Perform<int>([&] (std::function<void(std::exception_ptr, int)> onComplete)
+        {
+            return RunDecentralizedOperation(
+                stepSize, stepCount, timeout, progressInterval,
+                std::move(onProgress), std::move(onComplete));
+        });
+    }
 
-    void AcceptStep(std::chrono::milliseconds timeout)
+    coral::model::TimePoint RunUntil(
+        coral::model::TimePoint stopTime,
+        coral::model::TimeDuration stepSize,
+        const RunOptions& options)
     {
-        m_thread.Execute<void>(
-            [timeout] (
-                coral::net::Reactor&,
-                ExecMgr& execMgr,
-                std::promise<void> promise)
+        return Perform<coral::model::TimePoint>(
+            [&] (std::function<void(std::exception_ptr, coral::model::TimePoint)> onComplete)
             {
-                try {
-                    execMgr->AcceptStep(
-                        timeout,
-                        SimpleHandler(
-                            std::move(promise),
-                            "Failed to complete time step"));
-                } catch (...) {
-                    promise.set_exception(std::current_exception());
-                }
-            }
-        ).get();
+                return RunUntilOperation(stopTime, stepSize, options, std::move(onComplete));
+            });
     }
 
-
     void Terminate()
     {
-        m_thread.Execute<void>(
-            [] (coral::net::Reactor&, ExecMgr& execMgr, std::promise<void> promise)
-            {
-                try {
-                    execMgr->Terminate();
-                    promise.set_value();
-                } catch (...) {
-                    promise.set_exception(std::current_exception());
-                }
-            }
-        ).get();
+        Perform<void>([] (AsyncHandler onComplete)
+        {
+            return TerminateOperation(std::move(onComplete));
+        });
         m_thread.Shutdown();
     }
 
+    // Submits an operation without waiting for it to complete.
+    void Submit(Operation op)
+    {
+        if (std::this_thread::get_id() == m_backgroundThreadID) {
+            // We are in a completion handler, so we cannot wait for room.
+            if (!m_limiter.TryReserve()) {
+                throw std::length_error("Too many pending operations");
+            }
+            m_background->Start(std::move(op));
+            return;
+        }
+        m_limiter.Reserve();
+        m_thread.ExecuteAndWait<void>(
+            [&op] (
+                coral::net::Reactor&,
+                Background& bg,
+                coral::async::CommThreadCompletion<void> completion)
+            {
+                bg.Start(std::move(op));
+                completion.SetValue();
+            });
+    }
+
 private:
-    // TODO: Replace std::unique_ptr with boost::optional (when we no longer
-    //       need to support Boost < 1.56) or std::optional (when all our
-    //       compilers support it).
-    using ExecMgr = std::unique_ptr<coral::bus::ExecutionManager>;
-    coral::async::CommThread<ExecMgr> m_thread;
+    // Submits an operation, created by `makeOp` from a completion handler,
+    // and waits for its result.
+    template<typename Result, typename MakeOp>
+    Result Perform(MakeOp makeOp)
+    {
+        m_limiter.Reserve();
+        return m_thread.ExecuteAndWait<Result>(
+            [&makeOp] (
+                coral::net::Reactor&,
+                Background& bg,
+                coral::async::CommThreadCompletion<Result> completion)
+            {
+                bg.Start(makeOp(MakeHandler(std::move(completion))));
+            });
+    }
+
+    OperationLimiter m_limiter;
+    coral::async::CommThread<Background> m_thread;
+    std::thread::id m_backgroundThreadID;
+
+    // Only accessed in the background thread.
+    Background* m_background = nullptr;
 };
 
 
@@ -336,6 +886,115 @@ void coral::master::Execution::AcceptStep(std::chrono::milliseconds timeout)
 }
 
 
+int coral::master::Execution::RunDecentralized(
+    coral::model::TimeDuration stepSize,
+    int stepCount,
+    std::chrono::milliseconds timeout,
+    int progressInterval,
+    std::function<bool(coral::model::TimePoint)> onProgress)
+{
+    return m_private->RunDecentralized(
+        stepSize, stepCount, timeout, progressInterval, std::move(onProgress));
+}
+
+
+coral::model::TimePoint coral::master::Execution::RunUntil(
+    coral::model::TimePoint stopTime,
+    coral::model::TimeDuration stepSize,
+    const RunOptions& options)
+{
+    CORAL_INPUT_CHECK(stepSize > 0.0);
+    return m_private->RunUntil(stopTime, stepSize, options);
+}
+
+
+std::future<void> coral::master::Execution::ReconstituteAsync(
+    std::vector<AddedSlave>& slavesToAdd,
+    std::chrono::milliseconds commTimeout)
+{
+    const auto promise = std::make_shared<std::promise<void>>();
+    auto future = promise->get_future();
+    ReconstituteAsync(slavesToAdd, commTimeout, MakeHandler(promise));
+    return future;
+}
+
+
+void coral::master::Execution::ReconstituteAsync(
+    std::vector<AddedSlave>& slavesToAdd,
+    std::chrono::milliseconds commTimeout,
+    AsyncHandler onComplete)
+{
+    CORAL_INPUT_CHECK(onComplete);
+    m_private->Submit(
+        ReconstituteOperation(slavesToAdd, commTimeout, std::move(onComplete)));
+}
+
+
+std::future<void> coral::master::Execution::ReconfigureAsync(
+    std::vector<SlaveConfig>& slaveConfigs,
+    std::chrono::milliseconds commTimeout)
+{
+    const auto promise = std::make_shared<std::promise<void>>();
+    auto future = promise->get_future();
+    ReconfigureAsync(slaveConfigs, commTimeout, MakeHandler(promise));
+    return future;
+}
+
+
+void coral::master::Execution::ReconfigureAsync(
+    std::vector<SlaveConfig>& slaveConfigs,
+    std::chrono::milliseconds commTimeout,
+    AsyncHandler onComplete)
+{
+    CORAL_INPUT_CHECK(onComplete);
+    m_private->Submit(
+        ReconfigureOperation(slaveConfigs, commTimeout, std::move(onComplete)));
+}
+
+
+std::future<coral::master::StepResult> coral::master::Execution::StepAsync(
+    coral::model::TimeDuration stepSize,
+    std::chrono::milliseconds timeout,
+    std::vector<std::pair<coral::model::SlaveID, StepResult>>* slaveResults)
+{
+    const auto promise = std::make_shared<std::promise<StepResult>>();
+    auto future = promise->get_future();
+    StepAsync(stepSize, timeout, slaveResults, MakeHandler(promise));
+    return future;
+}
+
+
+void coral::master::Execution::StepAsync(
+    coral::model::TimeDuration stepSize,
+    std::chrono::milliseconds timeout,
+    std::vector<std::pair<coral::model::SlaveID, StepResult>>* slaveResults,
+    AsyncStepHandler onComplete)
+{
+    CORAL_INPUT_CHECK(onComplete);
+    m_private->Submit(
+        StepOperation(stepSize, timeout, slaveResults, std::move(onComplete)));
+}
+
+
+std::future<void> coral::master::Execution::AcceptStepAsync(
+    std::chrono::milliseconds timeout)
+{
+    const auto promise = std::make_shared<std::promise<void>>();
+    auto future = promise->get_future();
+    AcceptStepAsync(timeout, MakeHandler(promise));
+    return future;
+}
+
+
+void coral::master::Execution::AcceptStepAsync(
+    std::chrono::milliseconds timeout,
+    AsyncHandler onComplete)
+{
+    CORAL_INPUT_CHECK(onComplete);
+    m_private->Submit(AcceptStepOperation(timeout, std::move(onComplete)));
+}
+
+
 void coral::master::Execution::Terminate()
 {
     m_private->Terminate();
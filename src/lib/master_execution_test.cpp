@@ -1,6 +1,10 @@
 #include <algorithm>
+#include <atomic>
+#include <future>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <vector>
@@ -8,11 +12,14 @@
 #include <boost/filesystem.hpp>
 #include <gtest/gtest.h>
 
+#include <coral/bus/slave_agent.hpp>
+#include <coral/bus/sub_master.hpp>
 #include <coral/fmi/importer.hpp>
 #include <coral/fmi/fmu.hpp>
 #include <coral/master/execution.hpp>
 #include <coral/model.hpp>
 #include <coral/net.hpp>
+#include <coral/net/reactor.hpp>
 #include <coral/slave/instance.hpp>
 #include <coral/slave/runner.hpp>
 #include <coral/util.hpp>
@@ -20,11 +27,34 @@
 
 namespace
 {
+    coral::model::SlaveTypeDescription SimpleLoggerDescription(
+        std::size_t inputCount)
+    {
+        std::vector<coral::model::VariableDescription> variableDescriptions;
+        for (std::size_t i = 0; i < inputCount; ++i) {
+            variableDescriptions.emplace_back(
+                static_cast<coral::model::VariableID>(i),
+                "input[" + std::to_string(i) + "]",
+                coral::model::REAL_DATATYPE,
+                coral::model::INPUT_CAUSALITY,
+                coral::model::CONTINUOUS_VARIABILITY);
+        }
+        return coral::model::SlaveTypeDescription(
+            "coral.test.internal.SimpleLogger",
+            "4a29b80c-bd70-4d86-b1ea-fc1b48b86ebe",
+            "Slave type used internally in Coral test suite",
+            "Coral developers",
+            "0.1",
+            variableDescriptions);
+    }
+
+
     class SimpleLogger : public coral::slave::Instance
     {
     public:
         SimpleLogger(std::size_t inputCount)
             : m_inputCount(inputCount)
+            , m_typeDescription(SimpleLoggerDescription(inputCount))
             , m_currentValues(inputCount, 0.0)
         {
         }
@@ -36,24 +66,10 @@ namespace
 
         // === coral::slave::Instance interface implementation ===
 
-        coral::model::SlaveTypeDescription TypeDescription() const override
+        const coral::model::SlaveTypeDescription& TypeDescription()
+            const override
         {
-            std::vector<coral::model::VariableDescription> variableDescriptions;
-            for (std::size_t i = 0; i < m_inputCount; ++i) {
-                variableDescriptions.emplace_back(
-                    static_cast<coral::model::VariableID>(i),
-                    "input[" + std::to_string(i) + "]",
-                    coral::model::REAL_DATATYPE,
-                    coral::model::INPUT_CAUSALITY,
-                    coral::model::CONTINUOUS_VARIABILITY);
-            }
-            return coral::model::SlaveTypeDescription(
-                "coral.test.internal.SimpleLogger",
-                "4a29b80c-bd70-4d86-b1ea-fc1b48b86ebe",
-                "Slave type used internally in Coral test suite",
-                "Coral developers",
-                "0.1",
-                variableDescriptions);
+            return m_typeDescription;
         }
 
         void Setup(
@@ -104,10 +120,130 @@ namespace
 
     private:
         std::size_t m_inputCount;
+        coral::model::SlaveTypeDescription m_typeDescription;
         std::vector<double> m_currentValues;
         std::map<coral::model::TimePoint, std::vector<double>> m_previousValues;
     };
 
+    // A SimpleLogger which also counts the time steps it performs, so that
+    // a command which reaches it twice is detected.
+    class StepCounter : public SimpleLogger
+    {
+    public:
+        StepCounter() : SimpleLogger(1) { }
+
+        int StepCount() const { return m_stepCount; }
+
+        bool DoStep(
+            coral::model::TimePoint currentT,
+            coral::model::TimeDuration deltaT) override
+        {
+            ++m_stepCount;
+            return SimpleLogger::DoStep(currentT, deltaT);
+        }
+
+    private:
+        int m_stepCount = 0;
+    };
+
+    // A slave with real-valued outputs only, which counts how many times
+    // the value of each of them is read (e.g. for publishing).
+    class OutputSource : public coral::slave::Instance
+    {
+    public:
+        OutputSource(std::size_t outputCount)
+            : m_typeDescription(OutputSourceDescription(outputCount))
+            , m_readCounts(outputCount, 0)
+        {
+        }
+
+        int ReadCount(coral::model::VariableID variable) const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_readCounts.at(variable);
+        }
+
+        void ResetReadCounts()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::fill(m_readCounts.begin(), m_readCounts.end(), 0);
+        }
+
+        // === coral::slave::Instance interface implementation ===
+
+        const coral::model::SlaveTypeDescription& TypeDescription()
+            const override
+        {
+            return m_typeDescription;
+        }
+
+        void Setup(
+            const std::string& /*slaveName*/,
+            const std::string& /*executionName*/,
+            coral::model::TimePoint /*startTime*/,
+            coral::model::TimePoint /*stopTime*/,
+            bool /*adaptiveStepSize*/,
+            double /*relativeTolerance*/) override { }
+
+        void StartSimulation() override { }
+
+        void EndSimulation() override { }
+
+        bool DoStep(
+            coral::model::TimePoint /*currentT*/,
+            coral::model::TimeDuration /*deltaT*/) override
+        {
+            return true;
+        }
+
+        double GetRealVariable(coral::model::VariableID variable) const override
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_readCounts.at(variable);
+            return variable + 1.0;
+        }
+
+        int GetIntegerVariable(coral::model::VariableID /*variable*/) const override { assert(false); return 0; }
+
+        bool GetBooleanVariable(coral::model::VariableID /*variable*/) const override { assert(false); return false; }
+
+        std::string GetStringVariable(coral::model::VariableID /*variable*/) const override { assert(false); return std::string(); }
+
+        bool SetRealVariable(coral::model::VariableID /*variable*/, double /*value*/) override { assert(false); return false; }
+
+        bool SetIntegerVariable(coral::model::VariableID /*variable*/, int /*value*/) override { assert(false); return false; }
+
+        bool SetBooleanVariable(coral::model::VariableID /*variable*/, bool /*value*/) override { assert(false); return false; }
+
+        bool SetStringVariable(coral::model::VariableID /*variable*/, const std::string& /*value*/) override { assert(false); return false; }
+
+    private:
+        static coral::model::SlaveTypeDescription OutputSourceDescription(
+            std::size_t outputCount)
+        {
+            std::vector<coral::model::VariableDescription> variableDescriptions;
+            for (std::size_t i = 0; i < outputCount; ++i) {
+                variableDescriptions.emplace_back(
+                    static_cast<coral::model::VariableID>(i),
+                    "output[" + std::to_string(i) + "]",
+                    coral::model::REAL_DATATYPE,
+                    coral::model::OUTPUT_CAUSALITY,
+                    coral::model::CONTINUOUS_VARIABILITY);
+            }
+            return coral::model::SlaveTypeDescription(
+                "coral.test.internal.OutputSource",
+                "0f4d63a5-6f3e-4b8c-9a51-3c1b8e3f2d7a",
+                "Slave type used internally in Coral test suite",
+                "Coral developers",
+                "0.1",
+                variableDescriptions);
+        }
+
+        coral::model::SlaveTypeDescription m_typeDescription;
+        mutable std::mutex m_mutex;
+        mutable std::vector<int> m_readCounts;
+    };
+
     struct Slave
     {
         std::shared_ptr<coral::slave::Instance> instance;
@@ -125,18 +261,45 @@ namespace
             .Run();
     }
 
-    Slave SpawnSlave(std::shared_ptr<coral::slave::Instance> instance)
+    // Runs a slave which only supports protocol versions up to and
+    // including `maxProtocolVersion`.
+    void RunOldSlave(
+        std::shared_ptr<coral::slave::Instance> instance,
+        const coral::net::Endpoint& controlEndpoint,
+        const coral::net::Endpoint& dataPubEndpoint,
+        std::chrono::seconds commTimeout,
+        int maxProtocolVersion)
+    {
+        coral::net::Reactor reactor;
+        coral::bus::SlaveAgent agent(
+            reactor, *instance, controlEndpoint, dataPubEndpoint, commTimeout);
+        agent.SetMaxProtocolVersion(maxProtocolVersion);
+        reactor.Run();
+    }
+
+    Slave SpawnSlave(
+        std::shared_ptr<coral::slave::Instance> instance,
+        int maxProtocolVersion = -1)
     {
         Slave s;
         s.instance = instance;
         s.locator = coral::net::SlaveLocator(
             coral::net::Endpoint("inproc", coral::util::RandomUUID()),
             coral::net::Endpoint("inproc", coral::util::RandomUUID()));
-        s.thread = std::thread(RunSlave,
-            instance,
-            s.locator.ControlEndpoint(),
-            s.locator.DataPubEndpoint(),
-            std::chrono::seconds(10));
+        if (maxProtocolVersion < 0) {
+            s.thread = std::thread(RunSlave,
+                instance,
+                s.locator.ControlEndpoint(),
+                s.locator.DataPubEndpoint(),
+                std::chrono::seconds(10));
+        } else {
+            s.thread = std::thread(RunOldSlave,
+                instance,
+                s.locator.ControlEndpoint(),
+                s.locator.DataPubEndpoint(),
+                std::chrono::seconds(10),
+                maxProtocolVersion);
+        }
         return s;
     }
 }
@@ -300,3 +463,689 @@ TEST(coral_master, Execution)
 
     execution.Terminate();
 }
+
+
+TEST(coral_master, Execution_PublishConnectedOutputsOnly)
+{
+    using namespace coral::master;
+    using namespace coral::model;
+    const auto timeout = std::chrono::seconds(1);
+
+    auto sourceInstance = std::make_shared<OutputSource>(3);
+    auto sourceSlave = SpawnSlave(sourceInstance);
+    auto joinSource = coral::util::OnScopeExit([&sourceSlave] () { sourceSlave.thread.join(); });
+
+    auto logSlaveInstance = std::make_shared<SimpleLogger>(1);
+    auto logSlave = SpawnSlave(logSlaveInstance);
+    auto joinLog = coral::util::OnScopeExit([&logSlave] () { logSlave.thread.join(); });
+
+    auto execution = Execution("coral_test_execution");
+    auto slaves = std::vector<coral::master::AddedSlave>{
+        AddedSlave(sourceSlave.locator, "source"),
+        AddedSlave(logSlave.locator, "log")
+    };
+    execution.Reconstitute(slaves, timeout);
+    const auto sourceSlaveID = slaves[0].info.ID();
+    const auto logSlaveID = slaves[1].info.ID();
+
+    const auto connectLogTo = [&] (Variable output)
+    {
+        auto settings = std::vector<SlaveConfig>{
+            SlaveConfig(
+                logSlaveID,
+                std::vector<VariableSetting>{ VariableSetting(0, output) })
+        };
+        execution.Reconfigure(settings, timeout);
+        sourceInstance->ResetReadCounts();
+        EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+        execution.AcceptStep(timeout);
+    };
+
+    // Only the output which is connected is published.
+    connectLogTo(Variable(sourceSlaveID, 1));
+    EXPECT_EQ(0, sourceInstance->ReadCount(0));
+    EXPECT_LT(0, sourceInstance->ReadCount(1));
+    EXPECT_EQ(0, sourceInstance->ReadCount(2));
+
+    connectLogTo(Variable(sourceSlaveID, 2));
+    EXPECT_EQ(0, sourceInstance->ReadCount(0));
+    EXPECT_EQ(0, sourceInstance->ReadCount(1));
+    EXPECT_LT(0, sourceInstance->ReadCount(2));
+
+    // Once the last consumer is gone, nothing is published.
+    connectLogTo(Variable());
+    EXPECT_EQ(0, sourceInstance->ReadCount(0));
+    EXPECT_EQ(0, sourceInstance->ReadCount(1));
+    EXPECT_EQ(0, sourceInstance->ReadCount(2));
+
+    const auto& log = logSlaveInstance->Log();
+    ASSERT_EQ(3U, log.size());
+    EXPECT_EQ(3.0, log.at(1.0).at(0));
+
+    execution.Terminate();
+}
+
+
+TEST(coral_master, Execution_StepWithoutAccept)
+{
+    using namespace coral::master;
+    using namespace coral::model;
+    const auto timeout = std::chrono::seconds(1);
+
+    const auto testDataDir = std::getenv("CORAL_TEST_DATA_DIR");
+    auto importer = coral::fmi::Importer::Create();
+    auto idFMU = importer->Import(
+        boost::filesystem::path(testDataDir) / "fmi1_cs" / "identity.fmu");
+
+    const auto variableDescriptions = idFMU->Description().Variables();
+    const auto idRealInIt = std::find_if(
+        variableDescriptions.begin(),
+        variableDescriptions.end(),
+        [] (const VariableDescription& v) { return v.Name() == "realIn"; });
+    ASSERT_FALSE(idRealInIt == variableDescriptions.end());
+    const auto idRealOutIt = std::find_if(
+        variableDescriptions.begin(),
+        variableDescriptions.end(),
+        [] (const VariableDescription& v) { return v.Name() == "realOut"; });
+    ASSERT_FALSE(idRealOutIt == variableDescriptions.end());
+
+    auto idSlave = SpawnSlave(idFMU->InstantiateSlave());
+    auto joinID = coral::util::OnScopeExit([&idSlave] () { idSlave.thread.join(); });
+
+    auto logSlaveInstance = std::make_shared<SimpleLogger>(1);
+    auto logSlave = SpawnSlave(logSlaveInstance);
+    auto joinLog = coral::util::OnScopeExit([&logSlave] () { logSlave.thread.join(); });
+
+    auto execution = Execution("coral_test_execution");
+    auto slaves = std::vector<coral::master::AddedSlave>{
+        AddedSlave(idSlave.locator, "id"),
+        AddedSlave(logSlave.locator, "log")
+    };
+    execution.Reconstitute(slaves, timeout);
+    const auto idSlaveID = slaves[0].info.ID();
+    const auto logSlaveID = slaves[1].info.ID();
+
+    auto settings = std::vector<SlaveConfig>{
+        SlaveConfig(
+            idSlaveID,
+            std::vector<VariableSetting>{
+                VariableSetting(idRealInIt->ID(), 1.0)
+            }),
+        SlaveConfig(
+            logSlaveID,
+            std::vector<VariableSetting>{
+                VariableSetting(0, Variable(idSlaveID, idRealOutIt->ID()))
+            })
+    };
+    execution.Reconfigure(settings, timeout);
+
+    // Each step after the first one implicitly accepts the previous one.
+    EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+    EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+    EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+    execution.AcceptStep(timeout);
+
+    // An explicit accept is still required before reconfiguring.
+    settings.resize(1);
+    settings[0].variableSettings[0] = VariableSetting(idRealInIt->ID(), 2.0);
+    execution.Reconfigure(settings, timeout);
+    EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+    EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+    execution.AcceptStep(timeout);
+
+    const auto log = logSlaveInstance->Log();
+    ASSERT_EQ(5U, log.size());
+    EXPECT_EQ(1.0, log.at(0.0).at(0));
+    EXPECT_EQ(1.0, log.at(1.0).at(0));
+    EXPECT_EQ(1.0, log.at(2.0).at(0));
+    EXPECT_EQ(1.0, log.at(3.0).at(0));
+    EXPECT_EQ(1U, log.count(4.0));
+
+    execution.Terminate();
+}
+
+
+TEST(coral_master, Execution_StepWithoutAcceptMixedVersions)
+{
+    using namespace coral::master;
+    using namespace coral::model;
+    const auto timeout = std::chrono::seconds(1);
+
+    const auto testDataDir = std::getenv("CORAL_TEST_DATA_DIR");
+    auto importer = coral::fmi::Importer::Create();
+    auto idFMU = importer->Import(
+        boost::filesystem::path(testDataDir) / "fmi1_cs" / "identity.fmu");
+
+    const auto variableDescriptions = idFMU->Description().Variables();
+    const auto idRealInIt = std::find_if(
+        variableDescriptions.begin(),
+        variableDescriptions.end(),
+        [] (const VariableDescription& v) { return v.Name() == "realIn"; });
+    ASSERT_FALSE(idRealInIt == variableDescriptions.end());
+    const auto idRealOutIt = std::find_if(
+        variableDescriptions.begin(),
+        variableDescriptions.end(),
+        [] (const VariableDescription& v) { return v.Name() == "realOut"; });
+    ASSERT_FALSE(idRealOutIt == variableDescriptions.end());
+
+    // The 'identity' slaves only speak protocol version 4, which predates
+    // STEP implicitly accepting the previous step, so the master has to
+    // accept for them separately.  The logger uses the newest version.
+    auto idSlave1 = SpawnSlave(idFMU->InstantiateSlave(), 4);
+    auto joinID1 = coral::util::OnScopeExit([&idSlave1] () { idSlave1.thread.join(); });
+
+    auto idSlave2 = SpawnSlave(idFMU->InstantiateSlave(), 4);
+    auto joinID2 = coral::util::OnScopeExit([&idSlave2] () { idSlave2.thread.join(); });
+
+    auto logSlaveInstance = std::make_shared<SimpleLogger>(2);
+    auto logSlave = SpawnSlave(logSlaveInstance);
+    auto joinLog = coral::util::OnScopeExit([&logSlave] () { logSlave.thread.join(); });
+
+    auto execution = Execution("coral_test_execution");
+    auto slaves = std::vector<coral::master::AddedSlave>{
+        AddedSlave(idSlave1.locator, "id1"),
+        AddedSlave(idSlave2.locator, "id2"),
+        AddedSlave(logSlave.locator, "log")
+    };
+    execution.Reconstitute(slaves, timeout);
+    const auto idSlave1ID = slaves[0].info.ID();
+    const auto idSlave2ID = slaves[1].info.ID();
+    const auto logSlaveID = slaves[2].info.ID();
+
+    auto settings = std::vector<SlaveConfig>{
+        SlaveConfig(
+            idSlave1ID,
+            std::vector<VariableSetting>{
+                VariableSetting(idRealInIt->ID(), 1.0)
+            }),
+        SlaveConfig(
+            idSlave2ID,
+            std::vector<VariableSetting>{
+                VariableSetting(idRealInIt->ID(), 2.0)
+            }),
+        SlaveConfig(
+            logSlaveID,
+            std::vector<VariableSetting>{
+                VariableSetting(0, Variable(idSlave1ID, idRealOutIt->ID())),
+                VariableSetting(1, Variable(idSlave2ID, idRealOutIt->ID()))
+            })
+    };
+    execution.Reconfigure(settings, timeout);
+
+    EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+    EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+    EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+    execution.AcceptStep(timeout);
+
+    settings.resize(2);
+    settings[0].variableSettings[0] = VariableSetting(idRealInIt->ID(), 3.0);
+    settings[1].variableSettings[0] = VariableSetting(idRealInIt->ID(), 4.0);
+    execution.Reconfigure(settings, timeout);
+    EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+    EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+    execution.AcceptStep(timeout);
+
+    const auto log = logSlaveInstance->Log();
+    ASSERT_EQ(5U, log.size());
+    for (double t = 0.0; t < 3.5; t += 1.0) {
+        EXPECT_EQ(1.0, log.at(t).at(0));
+        EXPECT_EQ(2.0, log.at(t).at(1));
+    }
+    EXPECT_EQ(3.0, log.at(4.0).at(0));
+    EXPECT_EQ(4.0, log.at(4.0).at(1));
+
+    execution.Terminate();
+}
+
+
+TEST(coral_master, Execution_SlaveControlThreads)
+{
+    using namespace coral::master;
+    using namespace coral::model;
+    const auto timeout = std::chrono::seconds(1);
+
+    const auto testDataDir = std::getenv("CORAL_TEST_DATA_DIR");
+    auto importer = coral::fmi::Importer::Create();
+    auto idFMU = importer->Import(
+        boost::filesystem::path(testDataDir) / "fmi1_cs" / "identity.fmu");
+
+    const auto variableDescriptions = idFMU->Description().Variables();
+    const auto idRealInIt = std::find_if(
+        variableDescriptions.begin(),
+        variableDescriptions.end(),
+        [] (const VariableDescription& v) { return v.Name() == "realIn"; });
+    ASSERT_FALSE(idRealInIt == variableDescriptions.end());
+    const auto idRealOutIt = std::find_if(
+        variableDescriptions.begin(),
+        variableDescriptions.end(),
+        [] (const VariableDescription& v) { return v.Name() == "realOut"; });
+    ASSERT_FALSE(idRealOutIt == variableDescriptions.end());
+
+    // Three 'identity' slaves and a logger, divided between two slave
+    // control threads, so that the slaves which are connected to each
+    // other are controlled from different threads.
+    const int idSlaveCount = 3;
+    std::vector<Slave> idSlaves;
+    for (int i = 0; i < idSlaveCount; ++i) {
+        idSlaves.push_back(SpawnSlave(idFMU->InstantiateSlave()));
+    }
+    auto joinIDs = coral::util::OnScopeExit([&idSlaves] ()
+    {
+        for (auto& s : idSlaves) s.thread.join();
+    });
+
+    auto logSlaveInstance = std::make_shared<SimpleLogger>(idSlaveCount);
+    auto logSlave = SpawnSlave(logSlaveInstance);
+    auto joinLog = coral::util::OnScopeExit([&logSlave] () { logSlave.thread.join(); });
+
+    ExecutionOptions options;
+    options.slaveControlThreads = 2;
+    auto execution = Execution("coral_test_execution", options);
+    auto slaves = std::vector<coral::master::AddedSlave>{
+        AddedSlave(idSlaves[0].locator, "id0"),
+        AddedSlave(idSlaves[1].locator, "id1"),
+        AddedSlave(idSlaves[2].locator, "id2"),
+        AddedSlave(logSlave.locator, "log")
+    };
+    execution.Reconstitute(slaves, timeout);
+    const auto logSlaveID = slaves[idSlaveCount].info.ID();
+
+    std::vector<SlaveConfig> settings;
+    std::vector<VariableSetting> logSettings;
+    for (int i = 0; i < idSlaveCount; ++i) {
+        const auto idSlaveID = slaves[i].info.ID();
+        settings.emplace_back(
+            idSlaveID,
+            std::vector<VariableSetting>{
+                VariableSetting(idRealInIt->ID(), 1.0 + i)
+            });
+        logSettings.emplace_back(i, Variable(idSlaveID, idRealOutIt->ID()));
+    }
+    settings.emplace_back(logSlaveID, logSettings);
+    execution.Reconfigure(settings, timeout);
+
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+        execution.AcceptStep(timeout);
+    }
+
+    settings.resize(idSlaveCount);
+    for (int i = 0; i < idSlaveCount; ++i) {
+        settings[i].variableSettings[0] =
+            VariableSetting(idRealInIt->ID(), 10.0 + i);
+    }
+    execution.Reconfigure(settings, timeout);
+    for (int i = 0; i < 2; ++i) {
+        EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+        execution.AcceptStep(timeout);
+    }
+
+    const auto log = logSlaveInstance->Log();
+    ASSERT_EQ(5U, log.size());
+    for (int i = 0; i < idSlaveCount; ++i) {
+        for (double t = 0.0; t < 3.5; t += 1.0) {
+            EXPECT_EQ(1.0 + i, log.at(t).at(i));
+        }
+        EXPECT_EQ(10.0 + i, log.at(4.0).at(i));
+    }
+
+    execution.Terminate();
+}
+
+
+TEST(coral_master, Execution_RelayAndBroadcast)
+{
+    using namespace coral::master;
+    using namespace coral::model;
+    const auto timeout = std::chrono::seconds(1);
+
+    // A sub-master, running in its own thread until `stopSubMaster` is set.
+    std::atomic<bool> stopSubMaster(false);
+    std::promise<coral::net::Endpoint> subMasterEndpointPromise;
+    auto subMasterThread = std::thread([&] ()
+    {
+        coral::net::Reactor reactor;
+        coral::bus::SubMaster subMaster(
+            reactor,
+            coral::net::Endpoint("inproc", coral::util::RandomUUID()));
+        reactor.AddTimer(
+            std::chrono::milliseconds(10),
+            -1,
+            [&stopSubMaster] (coral::net::Reactor& r, int)
+            {
+                if (stopSubMaster) r.Stop();
+            });
+        subMasterEndpointPromise.set_value(subMaster.BoundEndpoint());
+        reactor.Run();
+    });
+    auto joinSubMaster = coral::util::OnScopeExit([&] ()
+    {
+        stopSubMaster = true;
+        subMasterThread.join();
+    });
+    const auto subMasterEndpoint = subMasterEndpointPromise.get_future().get();
+
+    // Two slaves which are served by the sub-master, and two which aren't,
+    // and which therefore get their commands by broadcast once they have
+    // subscribed to them.
+    const int slaveCount = 4;
+    std::vector<std::shared_ptr<StepCounter>> instances;
+    std::vector<Slave> spawnedSlaves;
+    for (int i = 0; i < slaveCount; ++i) {
+        instances.push_back(std::make_shared<StepCounter>());
+        spawnedSlaves.push_back(SpawnSlave(instances.back()));
+    }
+    auto joinSlaves = coral::util::OnScopeExit([&spawnedSlaves] ()
+    {
+        for (auto& s : spawnedSlaves) s.thread.join();
+    });
+
+    auto execution = Execution("coral_test_execution");
+    std::vector<AddedSlave> slaves;
+    for (int i = 0; i < slaveCount; ++i) {
+        const auto& locator = spawnedSlaves[i].locator;
+        slaves.emplace_back(
+            i < 2
+                ? coral::net::SlaveLocator(
+                    locator.ControlEndpoint(),
+                    locator.DataPubEndpoint(),
+                    subMasterEndpoint)
+                : locator,
+            "slave" + std::to_string(i));
+    }
+    execution.Reconstitute(slaves, timeout);
+
+    std::vector<SlaveConfig> settings;
+    for (int i = 0; i < slaveCount; ++i) {
+        settings.emplace_back(
+            slaves[i].info.ID(),
+            std::vector<VariableSetting>{ VariableSetting(0, 1.0 + i) });
+    }
+    execution.Reconfigure(settings, timeout);
+
+    // Steps with and without separate acceptance, mixed.
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+    }
+    execution.AcceptStep(timeout);
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+        execution.AcceptStep(timeout);
+    }
+
+    // Each command must have reached each slave exactly once.
+    for (int i = 0; i < slaveCount; ++i) {
+        EXPECT_EQ(6, instances[i]->StepCount());
+        const auto& log = instances[i]->Log();
+        ASSERT_EQ(6U, log.size());
+        EXPECT_EQ(0.0, log.begin()->first);
+        EXPECT_EQ(5.0, log.rbegin()->first);
+        EXPECT_EQ(1.0 + i, log.rbegin()->second.at(0));
+    }
+
+    execution.Terminate();
+}
+
+
+TEST(coral_master, Execution_RunDecentralized)
+{
+    using namespace coral::master;
+    using namespace coral::model;
+    const auto timeout = std::chrono::seconds(1);
+
+    const auto testDataDir = std::getenv("CORAL_TEST_DATA_DIR");
+    auto importer = coral::fmi::Importer::Create();
+    auto idFMU = importer->Import(
+        boost::filesystem::path(testDataDir) / "fmi1_cs" / "identity.fmu");
+
+    const auto variableDescriptions = idFMU->Description().Variables();
+    const auto idRealInIt = std::find_if(
+        variableDescriptions.begin(),
+        variableDescriptions.end(),
+        [] (const VariableDescription& v) { return v.Name() == "realIn"; });
+    ASSERT_FALSE(idRealInIt == variableDescriptions.end());
+    const auto idRealOutIt = std::find_if(
+        variableDescriptions.begin(),
+        variableDescriptions.end(),
+        [] (const VariableDescription& v) { return v.Name() == "realOut"; });
+    ASSERT_FALSE(idRealOutIt == variableDescriptions.end());
+
+    auto idSlave = SpawnSlave(idFMU->InstantiateSlave());
+    auto joinID = coral::util::OnScopeExit([&idSlave] () { idSlave.thread.join(); });
+
+    auto logSlaveInstance = std::make_shared<SimpleLogger>(1);
+    auto logSlave = SpawnSlave(logSlaveInstance);
+    auto joinLog = coral::util::OnScopeExit([&logSlave] () { logSlave.thread.join(); });
+
+    auto execution = Execution("coral_test_execution");
+    auto slaves = std::vector<coral::master::AddedSlave>{
+        AddedSlave(idSlave.locator, "id"),
+        AddedSlave(logSlave.locator, "log")
+    };
+    execution.Reconstitute(slaves, timeout);
+    const auto idSlaveID = slaves[0].info.ID();
+    const auto logSlaveID = slaves[1].info.ID();
+
+    auto settings = std::vector<SlaveConfig>{
+        SlaveConfig(
+            idSlaveID,
+            std::vector<VariableSetting>{
+                VariableSetting(idRealInIt->ID(), 1.0)
+            }),
+        SlaveConfig(
+            logSlaveID,
+            std::vector<VariableSetting>{
+                VariableSetting(0, Variable(idSlaveID, idRealOutIt->ID()))
+            })
+    };
+    execution.Reconfigure(settings, timeout);
+    EXPECT_EQ(3, execution.RunDecentralized(1.0, 3, timeout));
+
+    // The execution is ready for reconfiguration right after a run.
+    settings.resize(1);
+    settings[0].variableSettings[0] = VariableSetting(idRealInIt->ID(), 2.0);
+    execution.Reconfigure(settings, timeout);
+    EXPECT_EQ(2, execution.RunDecentralized(1.0, 2, timeout));
+
+    auto log = logSlaveInstance->Log();
+    ASSERT_EQ(5U, log.size());
+    EXPECT_EQ(1.0, log.at(0.0).at(0));
+    EXPECT_EQ(1.0, log.at(1.0).at(0));
+    EXPECT_EQ(1.0, log.at(2.0).at(0));
+    EXPECT_EQ(1.0, log.at(3.0).at(0));
+    EXPECT_EQ(1U, log.count(4.0));
+
+    // Interrupt a run at the first progress report.  Both slaves must have
+    // been brought to the same time step afterwards.
+    int progressReports = 0;
+    const auto stepsDone = execution.RunDecentralized(
+        1.0, 10000, timeout, 1,
+        [&] (TimePoint t) {
+            ++progressReports;
+            EXPECT_LT(5.0, t);
+            return false;
+        });
+    EXPECT_LE(1, progressReports);
+    EXPECT_LE(1, stepsDone);
+    EXPECT_GT(10000, stepsDone);
+    log = logSlaveInstance->Log();
+    EXPECT_EQ(5U + stepsDone, log.size());
+    EXPECT_EQ(1U, log.count(5.0 + stepsDone - 1));
+
+    // Ordinary stepping continues where the run left off.
+    EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+    execution.AcceptStep(timeout);
+    log = logSlaveInstance->Log();
+    EXPECT_EQ(6U + stepsDone, log.size());
+    EXPECT_EQ(2.0, log.at(5.0 + stepsDone).at(0));
+
+    execution.Terminate();
+}
+
+
+TEST(coral_master, Execution_Async)
+{
+    using namespace coral::master;
+    using namespace coral::model;
+    const auto timeout = std::chrono::seconds(1);
+
+    const auto testDataDir = std::getenv("CORAL_TEST_DATA_DIR");
+    auto importer = coral::fmi::Importer::Create();
+    auto idFMU = importer->Import(
+        boost::filesystem::path(testDataDir) / "fmi1_cs" / "identity.fmu");
+
+    const auto variableDescriptions = idFMU->Description().Variables();
+    const auto idRealInIt = std::find_if(
+        variableDescriptions.begin(),
+        variableDescriptions.end(),
+        [] (const VariableDescription& v) { return v.Name() == "realIn"; });
+    ASSERT_FALSE(idRealInIt == variableDescriptions.end());
+    const auto idRealOutIt = std::find_if(
+        variableDescriptions.begin(),
+        variableDescriptions.end(),
+        [] (const VariableDescription& v) { return v.Name() == "realOut"; });
+    ASSERT_FALSE(idRealOutIt == variableDescriptions.end());
+
+    auto idSlave = SpawnSlave(idFMU->InstantiateSlave());
+    auto joinID = coral::util::OnScopeExit([&idSlave] () { idSlave.thread.join(); });
+
+    auto logSlaveInstance = std::make_shared<SimpleLogger>(1);
+    auto logSlave = SpawnSlave(logSlaveInstance);
+    auto joinLog = coral::util::OnScopeExit([&logSlave] () { logSlave.thread.join(); });
+
+    ExecutionOptions options;
+    options.maxPendingOperations = 4;
+    auto execution = Execution("coral_test_execution", options);
+    auto slaves = std::vector<coral::master::AddedSlave>{
+        AddedSlave(idSlave.locator, "id"),
+        AddedSlave(logSlave.locator, "log")
+    };
+    execution.ReconstituteAsync(slaves, timeout).get();
+    const auto idSlaveID = slaves[0].info.ID();
+    const auto logSlaveID = slaves[1].info.ID();
+
+    // Queue a reconfiguration and two steps without waiting in between.
+    auto settings = std::vector<SlaveConfig>{
+        SlaveConfig(
+            idSlaveID,
+            std::vector<VariableSetting>{
+                VariableSetting(idRealInIt->ID(), 1.0)
+            }),
+        SlaveConfig(
+            logSlaveID,
+            std::vector<VariableSetting>{
+                VariableSetting(0, Variable(idSlaveID, idRealOutIt->ID()))
+            })
+    };
+    auto reconfigured = execution.ReconfigureAsync(settings, timeout);
+    auto step1 = execution.StepAsync(1.0, timeout);
+    auto step2 = execution.StepAsync(1.0, timeout);
+    auto accepted = execution.AcceptStepAsync(timeout);
+    EXPECT_NO_THROW(reconfigured.get());
+    EXPECT_EQ(StepResult::completed, step1.get());
+    EXPECT_EQ(StepResult::completed, step2.get());
+    EXPECT_NO_THROW(accepted.get());
+
+    // Chain steps from completion handlers, the way an awaitable would.
+    int stepsLeft = 3;
+    std::promise<void> chainDone;
+    auto chainFuture = chainDone.get_future();
+    Execution::AsyncStepHandler onStepped;
+    onStepped = [&] (std::exception_ptr e, StepResult r)
+    {
+        if (e || r != StepResult::completed) {
+            chainDone.set_exception(e ? e : std::make_exception_ptr(std::runtime_error("")));
+        } else if (--stepsLeft > 0) {
+            execution.StepAsync(1.0, timeout, nullptr, onStepped);
+        } else {
+            execution.AcceptStepAsync(timeout, [&] (std::exception_ptr e2)
+            {
+                if (e2) chainDone.set_exception(e2);
+                else chainDone.set_value();
+            });
+        }
+    };
+    execution.StepAsync(1.0, timeout, nullptr, onStepped);
+    EXPECT_NO_THROW(chainFuture.get());
+
+    // A synchronous call waits for everything that was started before it.
+    auto step3 = execution.StepAsync(1.0, timeout);
+    execution.AcceptStep(timeout);
+    EXPECT_EQ(std::future_status::ready, step3.wait_for(std::chrono::seconds(0)));
+
+    const auto log = logSlaveInstance->Log();
+    EXPECT_EQ(6U, log.size());
+    EXPECT_EQ(1.0, log.at(4.0).at(0));
+
+    execution.Terminate();
+}
+
+
+TEST(coral_master, Execution_RunUntil)
+{
+    using namespace coral::master;
+    using namespace coral::model;
+    const auto timeout = std::chrono::seconds(1);
+
+    auto logSlaveInstance = std::make_shared<SimpleLogger>(1);
+    auto logSlave = SpawnSlave(logSlaveInstance);
+    auto joinLog = coral::util::OnScopeExit([&logSlave] () { logSlave.thread.join(); });
+
+    ExecutionOptions options;
+    options.startTime = 1.0;
+    auto execution = Execution("coral_test_execution", options);
+    auto slaves = std::vector<coral::master::AddedSlave>{
+        AddedSlave(logSlave.locator, "log")
+    };
+    execution.Reconstitute(slaves, timeout);
+    const auto logSlaveID = slaves[0].info.ID();
+
+    RunOptions runOptions;
+    runOptions.stepTimeout = timeout;
+    runOptions.commTimeout = timeout;
+    runOptions.scenario.emplace_back(6.0, logSlaveID, VariableSetting(0, 2.0));
+    runOptions.scenario.emplace_back(3.0, logSlaveID, VariableSetting(0, 1.0));
+    runOptions.scenario.emplace_back(100.0, logSlaveID, VariableSetting(0, 3.0));
+    int progressCalls = 0;
+    runOptions.onProgress = [&] (TimePoint t)
+    {
+        ++progressCalls;
+        EXPECT_EQ(1.0 + progressCalls, t);
+        return true;
+    };
+    EXPECT_DOUBLE_EQ(10.0, execution.RunUntil(10.0, 1.0, runOptions));
+    EXPECT_EQ(9, progressCalls);
+
+    const auto& log = logSlaveInstance->Log();
+    ASSERT_EQ(9U, log.size());
+    EXPECT_EQ(0.0, log.at(2.0).at(0));
+    EXPECT_EQ(1.0, log.at(3.0).at(0));
+    EXPECT_EQ(1.0, log.at(5.0).at(0));
+    EXPECT_EQ(2.0, log.at(6.0).at(0));
+    EXPECT_EQ(2.0, log.at(9.0).at(0));
+
+    // The next run continues where the last one stopped, and the progress
+    // handler can stop it early.  The execution must be usable afterwards.
+    RunOptions stopOptions;
+    stopOptions.onProgress = [] (TimePoint t) { return t < 12.0; };
+    EXPECT_DOUBLE_EQ(12.0, execution.RunUntil(20.0, 1.0, stopOptions));
+    EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+    execution.AcceptStep(timeout);
+    EXPECT_EQ(12U, log.size());
+
+    // An exception from the progress handler stops the run and is passed
+    // on to the caller, and the execution is still usable.
+    RunOptions throwOptions;
+    throwOptions.onProgress = [] (TimePoint t) -> bool
+    {
+        if (t >= 15.0) throw std::logic_error("progress handler failed");
+        return true;
+    };
+    EXPECT_THROW(execution.RunUntil(20.0, 1.0, throwOptions), std::logic_error);
+    EXPECT_EQ(14U, log.size());
+    EXPECT_EQ(StepResult::completed, execution.Step(1.0, timeout));
+    execution.AcceptStep(timeout);
+    EXPECT_EQ(15U, log.size());
+
+    execution.Terminate();
+}
@@ -218,33 +218,40 @@ VariableSetting::VariableSetting(
       m_hasValue(true),
       m_value(value),
       m_isConnectionChange(false),
-      m_connectedOutput()
+      m_connectedOutput(),
+      m_connectionDelay(0)
 {
 }
 
 
 VariableSetting::VariableSetting(
     VariableID inputVar,
-    const coral::model::Variable& outputVar)
+    const coral::model::Variable& outputVar,
+    int delay)
     : m_variable(inputVar),
       m_hasValue(false),
       m_value(),
       m_isConnectionChange(true),
-      m_connectedOutput(outputVar)
+      m_connectedOutput(outputVar),
+      m_connectionDelay(delay)
 {
+    CORAL_INPUT_CHECK(delay >= 0);
 }
 
 
 VariableSetting::VariableSetting(
     VariableID inputVar,
     const ScalarValue& value,
-    const coral::model::Variable& outputVar)
+    const coral::model::Variable& outputVar,
+    int delay)
     : m_variable(inputVar),
       m_hasValue(true),
       m_value(value),
       m_isConnectionChange(true),
-      m_connectedOutput(outputVar)
+      m_connectedOutput(outputVar),
+      m_connectionDelay(delay)
 {
+    CORAL_INPUT_CHECK(delay >= 0);
 }
 
 
@@ -280,6 +287,67 @@ const coral::model::Variable& VariableSetting::ConnectedOutput() const
 }
 
 
+int VariableSetting::ConnectionDelay() const
+{
+    CORAL_PRECONDITION_CHECK(IsConnectionChange());
+    return m_connectionDelay;
+}
+
+
+// =============================================================================
+// ValueBlock
+// =============================================================================
+
+namespace
+{
+    class AddToBlock : public boost::static_visitor<>
+    {
+    public:
+        AddToBlock(ValueBlock& block, VariableID id)
+            : m_block(block), m_id(id) { }
+        void operator()(double v) const { m_block.Reals().Add(m_id, v); }
+        void operator()(int v) const { m_block.Integers().Add(m_id, v); }
+        void operator()(bool v) const { m_block.Booleans().Add(m_id, v); }
+        void operator()(const std::string& v) const
+        {
+            m_block.Strings().Add(m_id, v);
+        }
+    private:
+        ValueBlock& m_block;
+        VariableID m_id;
+    };
+}
+
+
+void ValueBlock::Add(VariableID id, const ScalarValue& value)
+{
+    boost::apply_visitor(AddToBlock(*this, id), value);
+}
+
+
+std::size_t ValueBlock::Size() const noexcept
+{
+    return m_reals.Size() + m_integers.Size() + m_booleans.Size()
+        + m_strings.Size();
+}
+
+
+bool ValueBlock::Empty() const noexcept
+{
+    return m_reals.Empty() && m_integers.Empty() && m_booleans.Empty()
+        && m_strings.Empty();
+}
+
+
+void ValueBlock::Clear() noexcept
+{
+    m_reals.Clear();
+    m_integers.Clear();
+    m_booleans.Clear();
+    m_strings.Clear();
+}
+
+
 // =============================================================================
 // Free functions
 // =============================================================================
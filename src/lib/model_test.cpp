@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include <coral/model.hpp>
+#include <string>
+#include <utility>
+
+
+using namespace coral::model;
+
+TEST(coral_model, ValueColumn)
+{
+    ValueColumn<bool> c;
+    EXPECT_TRUE(c.Empty());
+    for (int i = 0; i < 20; ++i) c.Add(i, i % 3 == 0);
+    ASSERT_EQ(20U, c.Size());
+    EXPECT_EQ(7U, c.ID(7));
+    EXPECT_FALSE(c.Value(7));
+    EXPECT_TRUE(c.Values()[9]);
+
+    c.Values()[7] = true;
+    EXPECT_TRUE(c.Value(7));
+
+    auto copy = c;
+    c.Clear();
+    EXPECT_TRUE(c.Empty());
+    ASSERT_EQ(20U, copy.Size());
+    EXPECT_EQ(19U, copy.IDs()[19]);
+    EXPECT_TRUE(copy.Value(7));
+
+    auto moved = std::move(copy);
+    ASSERT_EQ(20U, moved.Size());
+    moved.Add(100, false);
+    EXPECT_EQ(21U, moved.Size());
+    EXPECT_EQ(100U, moved.ID(20));
+}
+
+
+TEST(coral_model, ValueBlock)
+{
+    ValueBlock b;
+    EXPECT_TRUE(b.Empty());
+    b.Add(1, 1.5);
+    b.Add(2, 2);
+    b.Add(3, true);
+    b.Add(4, std::string("four"));
+    b.Add(5, 5.5);
+    EXPECT_EQ(5U, b.Size());
+    ASSERT_EQ(2U, b.Reals().Size());
+    EXPECT_EQ(1U, b.Reals().ID(0));
+    EXPECT_EQ(5.5, b.Reals().Value(1));
+    ASSERT_EQ(1U, b.Integers().Size());
+    EXPECT_EQ(2, b.Integers().Value(0));
+    ASSERT_EQ(1U, b.Booleans().Size());
+    EXPECT_TRUE(b.Booleans().Value(0));
+    ASSERT_EQ(1U, b.Strings().Size());
+    EXPECT_EQ("four", b.Strings().Value(0));
+
+    b.Clear();
+    EXPECT_TRUE(b.Empty());
+    EXPECT_EQ(0U, b.Size());
+}
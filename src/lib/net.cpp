@@ -369,10 +369,12 @@ sockaddr_in Endpoint::ToSockaddrIn() const
 
 SlaveLocator::SlaveLocator(
     const Endpoint& controlEndpoint,
-    const Endpoint& dataPubEndpoint)
+    const Endpoint& dataPubEndpoint,
+    const Endpoint& subMasterEndpoint)
     noexcept
     : m_controlEndpoint{controlEndpoint},
-      m_dataPubEndpoint{dataPubEndpoint}
+      m_dataPubEndpoint{dataPubEndpoint},
+      m_subMasterEndpoint{subMasterEndpoint}
 {
 }
 
@@ -389,4 +391,33 @@ const Endpoint& SlaveLocator::DataPubEndpoint() const noexcept
 }
 
 
+const Endpoint& SlaveLocator::SubMasterEndpoint() const noexcept
+{
+    return m_subMasterEndpoint;
+}
+
+
+// =============================================================================
+// BusyPollStats
+// =============================================================================
+
+BusyPollStats::BusyPollStats() noexcept
+    : spinTime(0),
+      sleepTime(0),
+      spinWakeups(0),
+      sleepWakeups(0)
+{
+}
+
+
+BusyPollStats& BusyPollStats::operator+=(const BusyPollStats& other) noexcept
+{
+    spinTime += other.spinTime;
+    sleepTime += other.sleepTime;
+    spinWakeups += other.spinWakeups;
+    sleepWakeups += other.sleepWakeups;
+    return *this;
+}
+
+
 }} // namespace
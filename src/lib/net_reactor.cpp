@@ -10,7 +10,18 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include <coral/net/reactor.hpp>
 
 #include <algorithm>
+#include <cassert>
 #include <stdexcept>
+
+#ifdef CORAL_REACTOR_USE_EPOLL
+#   include <cerrno>
+#   include <climits>
+#   include <unordered_map>
+#   include <sys/epoll.h>
+#   include <unistd.h>
+#endif
+
+#include <coral/error.hpp>
 #include <coral/util.hpp>
 
 
@@ -20,13 +31,104 @@ namespace net
 {
 
 
+#ifdef CORAL_REACTOR_USE_EPOLL
+
+struct Reactor::Epoll
+{
+    Epoll()
+        : fd(epoll_create1(EPOLL_CLOEXEC)),
+          sweepAll(true),
+          events(1)
+    {
+        if (fd < 0) {
+            throw std::runtime_error(coral::error::ErrnoMessage(
+                "Failed to create epoll instance", errno));
+        }
+    }
+
+    ~Epoll() noexcept { close(fd); }
+
+    // The handlers for one file descriptor, as indices into m_sockets (if
+    // `socket` is non-null) or m_nativeSockets (otherwise).
+    struct Registration
+    {
+        zmq::socket_t* socket;
+        std::vector<std::size_t> handlers;
+    };
+
+    // The epoll file descriptor
+    int fd;
+
+    // The registered file descriptors and their handlers, and a list of
+    // the ones which belong to ZeroMQ sockets.
+    std::unordered_map<int, Registration> registrations;
+    std::vector<const Registration*> zmqRegistrations;
+
+    // The ZMQ_FD signal is edge-triggered, and the edge may be consumed by
+    // any operation on the socket.  A socket or timer handler may have used
+    // any socket, so after a handler has been called, ZMQ_EVENTS must be
+    // checked for all ZeroMQ sockets before we can go to sleep (`sweepAll`).
+    // Iterations in which no handler runs don't pay for this.
+    bool sweepAll;
+
+    // Buffers used by Poll() and Dispatch(), kept here to avoid reallocations.
+    std::vector<epoll_event> events;
+    std::vector<std::size_t> readySockets;
+    std::vector<std::size_t> readyNativeSockets;
+};
+
+
+namespace
+{
+    int ZmqFD(zmq::socket_t& socket)
+    {
+        int fd = -1;
+        std::size_t len = sizeof(fd);
+        socket.getsockopt(ZMQ_FD, &fd, &len);
+        return fd;
+    }
+
+    // Checks ZMQ_EVENTS, which also resets the socket's ZMQ_FD signal.
+    bool HasIncoming(zmq::socket_t& socket)
+    {
+        int events = 0;
+        std::size_t len = sizeof(events);
+        socket.getsockopt(ZMQ_EVENTS, &events, &len);
+        return (events & ZMQ_POLLIN) != 0;
+    }
+
+    void AppendHandlers(
+        const std::vector<std::size_t>& handlers,
+        std::vector<std::size_t>& target)
+    {
+        target.insert(target.end(), handlers.begin(), handlers.end());
+    }
+
+    void SortUnique(std::vector<std::size_t>& v)
+    {
+        std::sort(v.begin(), v.end());
+        v.erase(std::unique(v.begin(), v.end()), v.end());
+    }
+}
+
+#endif // CORAL_REACTOR_USE_EPOLL
+
+
 Reactor::Reactor()
-    : m_nextTimerID(0),
+    :
+#ifdef CORAL_REACTOR_USE_EPOLL
+      m_epoll(std::make_unique<Epoll>()),
+#endif
+      m_nextTimerID(0),
       m_needsRebuild(false),
-      m_running(false)
+      m_running(false),
+      m_spinBudget(0)
 { }
 
 
+Reactor::~Reactor() noexcept { }
+
+
 void Reactor::AddSocket(zmq::socket_t& socket, SocketHandler handler)
 {
     m_sockets.push_back(
@@ -77,122 +179,131 @@ void Reactor::RemoveNativeSocket(NativeSocket socket) noexcept
 }
 
 
-namespace
-{
-    // We use templates to work around the fact that Reactor::Timer is private.
-    template<typename T>
-    bool EventTimeGreater(const T& a, const T& b)
-    {
-        return a.nextEventTime > b.nextEventTime;
-    }
-
-    template<typename T>
-    void PushTimer(std::vector<T>& v, T t)
-    {
-        v.push_back(std::move(t));
-        std::push_heap(std::begin(v), std::end(v), EventTimeGreater<T>);
-    }
-
-    template<typename T>
-    void PopTimer(std::vector<T>& v)
-    {
-        std::pop_heap(std::begin(v), std::end(v), EventTimeGreater<T>);
-        v.pop_back();
-    }
-
-    template<typename T>
-    void HeapifyTimers(std::vector<T>& v)
-    {
-        std::make_heap(std::begin(v), std::end(v), &EventTimeGreater<T>);
-    }
-}
-
-
 const int Reactor::invalidTimerID = -1;
 
 
 int Reactor::AddTimer(
-    std::chrono::milliseconds interval,
+    std::chrono::microseconds interval,
     int count,
     TimerHandler handler)
 {
-    if (interval < std::chrono::milliseconds(0)) {
+    if (interval < std::chrono::microseconds(0)) {
         throw std::invalid_argument("Negative interval");
     }
     if (count == 0) {
         throw std::invalid_argument("Invalid timer count");
     }
+    auto handlerPtr = std::make_unique<TimerHandler>(std::move(handler));
+
+    // Allocate all the memory we need up front, so nothing can throw once
+    // the new timer has been registered.  The free list gets room for all
+    // slots, so DeleteTimer() never has to allocate.
+    if (m_freeTimerSlots.empty()) {
+        m_timers.emplace_back();
+        m_freeTimerSlots.reserve(m_timers.size());
+        m_freeTimerSlots.push_back(m_timers.size() - 1);
+    }
+    m_timerHeap.reserve(m_timerHeap.size() + 1);
+    const auto slot = m_freeTimerSlots.back();
     const auto id = ++m_nextTimerID;
-    PushTimer(m_timers, Timer(
-        id,
-        std::chrono::system_clock::now() + interval,
-        interval,
-        count,
-        std::make_unique<TimerHandler>(std::move(handler))));
+    m_timerSlots.insert(std::make_pair(id, slot));
+    m_freeTimerSlots.pop_back();
+
+    auto& timer = m_timers[slot];
+    timer.id = id;
+    timer.nextEventTime = std::chrono::steady_clock::now() + interval;
+    timer.interval = interval;
+    timer.remaining = count;
+    timer.handler = std::move(handlerPtr);
+    timer.heapPos = m_timerHeap.size();
+    m_timerHeap.push_back(slot);
+    TimerHeapSiftUp(timer.heapPos);
     return id;
 }
 
 
 void Reactor::RemoveTimer(int id)
 {
-    const auto it = std::find_if(m_timers.begin(), m_timers.end(),
-        [id](const Timer& t){ return t.id == id; });
-    if (it == m_timers.end()) {
-        throw std::invalid_argument("Invalid timer ID");
-    }
-    m_timers.erase(it);
-    HeapifyTimers(m_timers);
+    DeleteTimer(TimerSlot(id));
 }
 
 
 void Reactor::RestartTimerInterval(int id)
 {
-    const auto it = std::find_if(m_timers.begin(), m_timers.end(),
-        [id](const Timer& t){ return t.id == id; });
-    if (it == m_timers.end()) {
-        throw std::invalid_argument("Invalid timer ID");
-    }
-    RestartTimerIntervals(it, it+1);
+    auto& timer = m_timers[TimerSlot(id)];
+    timer.nextEventTime = std::chrono::steady_clock::now() + timer.interval;
+    TimerHeapUpdate(timer.heapPos);
 }
 
 
 void Reactor::Run()
 {
-    RestartTimerIntervals(begin(m_timers), end(m_timers));
+    RestartAllTimerIntervals();
     m_running = true;
     for (;;) {
         if (m_needsRebuild) Rebuild();
-        if (m_pollItems.empty() && m_timers.empty()) break;
-
-        // More sockets may be added by the handler functions, so we
-        // need to store the current sizes for use in the loops below.
-        const auto socketCount = m_sockets.size();
-        const auto nativeSocketCount = m_nativeSockets.size();
-        assert(m_pollItems.size() == socketCount + nativeSocketCount);
-
-        zmq::poll(m_pollItems.data(), m_pollItems.size(),
-                  m_timers.empty() ? -1 : static_cast<long>(TimeToNextEvent().count()));
-        std::size_t j = 0;
-        for (std::size_t i = 0; i < socketCount; ++i, ++j) {
-            assert(j < m_pollItems.size());
-            if ((m_pollItems[j].revents & ZMQ_POLLIN) && m_sockets[i].first != nullptr) {
-                (*m_sockets[i].second)(*this, *m_sockets[i].first);
-                if (!m_running) goto endLoop;
+        if (m_sockets.empty() && m_nativeSockets.empty() && m_timerHeap.empty()) {
+            break;
+        }
+
+        // The poll timeout is rounded down to whole milliseconds, so we never
+        // wake up too late for a timer event.  It becomes zero (i.e., we just
+        // check for messages without blocking) during the last millisecond.
+        const auto pollTimeout = [this] () -> long {
+            if (m_timerHeap.empty()) return -1;
+            return static_cast<long>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    TimeToNextEvent()).count());
+        };
+        auto timeout = pollTimeout();
+        bool ready = false;
+        if (m_spinBudget > std::chrono::microseconds(0) && timeout != 0) {
+            const auto t0 = std::chrono::steady_clock::now();
+            auto spinEnd = t0 + m_spinBudget;
+            if (!m_timerHeap.empty()) {
+                spinEnd = std::min(spinEnd, m_timers[m_timerHeap.front()].nextEventTime);
             }
+            auto t1 = t0;
+            do {
+                ready = Poll(0);
+                t1 = std::chrono::steady_clock::now();
+            } while (!ready && t1 < spinEnd);
+            m_pollStats.spinTime += t1 - t0;
+            if (ready) ++m_pollStats.spinWakeups;
+            else timeout = pollTimeout();
         }
-        for (std::size_t i = 0; i < nativeSocketCount; ++i, ++j) {
-            assert(j < m_pollItems.size());
-            if ((m_pollItems[j].revents & ZMQ_POLLIN) && m_nativeSockets[i].first != NULL_NATIVE_SOCKET) {
-                (*m_nativeSockets[i].second)(*this, m_nativeSockets[i].first);
-                if (!m_running) goto endLoop;
+        if (!ready) {
+            if (timeout == 0) {
+                ready = Poll(0);
+            } else {
+                const auto t0 = std::chrono::steady_clock::now();
+                ready = Poll(timeout);
+                m_pollStats.sleepTime += std::chrono::steady_clock::now() - t0;
+                ++m_pollStats.sleepWakeups;
             }
         }
-        assert(j == m_pollItems.size());
-
-        while (!m_timers.empty()
-               && std::chrono::system_clock::now() >= m_timers.front().nextEventTime) {
-            PerformNextEvent();
-            if (!m_running) goto endLoop;
+        if (ready && !Dispatch()) goto endLoop;
+
+        // We take a snapshot of the timers which are due now, and perform
+        // each of their events once, in order.  A timer which is still due
+        // afterwards (e.g. because it has a zero interval) has to wait for
+        // the next iteration, so the sockets get polled in between.
+        if (!m_timerHeap.empty()) {
+            const auto now = std::chrono::steady_clock::now();
+            m_dueTimers.clear();
+            CollectDueTimers(0, now);
+            std::sort(m_dueTimers.begin(), m_dueTimers.end());
+            for (const auto& due : m_dueTimers) {
+                // The timer may have been removed or restarted by one of the
+                // handlers we have called already.
+                const auto it = m_timerSlots.find(due.second);
+                if (it == m_timerSlots.end()
+                        || m_timers[it->second].nextEventTime > now) {
+                    continue;
+                }
+                PerformEvent(it->second);
+                if (!m_running) goto endLoop;
+            }
         }
     }
 endLoop: ;
@@ -205,52 +316,168 @@ void Reactor::Stop()
 }
 
 
-void Reactor::RestartTimerIntervals(
-    std::vector<Timer>::iterator begin,
-    std::vector<Timer>::iterator end)
+void Reactor::SetSpinBudget(std::chrono::microseconds spinBudget) noexcept
+{
+    m_spinBudget = spinBudget;
+}
+
+
+const coral::net::BusyPollStats& Reactor::PollStats() const noexcept
+{
+    return m_pollStats;
+}
+
+
+std::size_t Reactor::TimerSlot(int id) const
+{
+    const auto it = m_timerSlots.find(id);
+    if (it == m_timerSlots.end()) {
+        throw std::invalid_argument("Invalid timer ID");
+    }
+    return it->second;
+}
+
+
+void Reactor::DeleteTimer(std::size_t slot) noexcept
 {
-    const auto t0 = std::chrono::system_clock::now();
-    for (auto it = begin; it != end; ++it) {
-        it->nextEventTime = t0 + it->interval;
+    auto& timer = m_timers[slot];
+    const auto pos = timer.heapPos;
+    const auto lastPos = m_timerHeap.size() - 1;
+    if (pos != lastPos) TimerHeapSwap(pos, lastPos);
+    m_timerHeap.pop_back();
+    if (pos != lastPos) TimerHeapUpdate(pos);
+
+    m_timerSlots.erase(timer.id);
+    timer.id = invalidTimerID;
+    timer.handler.reset();
+    m_freeTimerSlots.push_back(slot);
+}
+
+
+bool Reactor::TimerHeapLess(std::size_t posA, std::size_t posB) const noexcept
+{
+    const auto& a = m_timers[m_timerHeap[posA]];
+    const auto& b = m_timers[m_timerHeap[posB]];
+    // Timers which are due at the same time are triggered in the order they
+    // were added.
+    return a.nextEventTime < b.nextEventTime
+        || (a.nextEventTime == b.nextEventTime && a.id < b.id);
+}
+
+
+void Reactor::TimerHeapSwap(std::size_t posA, std::size_t posB) noexcept
+{
+    std::swap(m_timerHeap[posA], m_timerHeap[posB]);
+    m_timers[m_timerHeap[posA]].heapPos = posA;
+    m_timers[m_timerHeap[posB]].heapPos = posB;
+}
+
+
+void Reactor::TimerHeapSiftUp(std::size_t pos) noexcept
+{
+    while (pos > 0) {
+        const auto parent = (pos - 1) / 2;
+        if (!TimerHeapLess(pos, parent)) break;
+        TimerHeapSwap(pos, parent);
+        pos = parent;
+    }
+}
+
+
+void Reactor::TimerHeapSiftDown(std::size_t pos) noexcept
+{
+    const auto size = m_timerHeap.size();
+    for (;;) {
+        auto smallest = pos;
+        const auto left = 2*pos + 1;
+        const auto right = left + 1;
+        if (left < size && TimerHeapLess(left, smallest)) smallest = left;
+        if (right < size && TimerHeapLess(right, smallest)) smallest = right;
+        if (smallest == pos) break;
+        TimerHeapSwap(pos, smallest);
+        pos = smallest;
+    }
+}
+
+
+void Reactor::TimerHeapUpdate(std::size_t pos) noexcept
+{
+    if (pos > 0 && TimerHeapLess(pos, (pos - 1) / 2)) {
+        TimerHeapSiftUp(pos);
+    } else {
+        TimerHeapSiftDown(pos);
+    }
+}
+
+
+void Reactor::RestartAllTimerIntervals()
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    for (const auto slot : m_timerHeap) {
+        m_timers[slot].nextEventTime = t0 + m_timers[slot].interval;
+    }
+    for (auto pos = m_timerHeap.size() / 2; pos > 0; --pos) {
+        TimerHeapSiftDown(pos - 1);
     }
-    HeapifyTimers(m_timers);
 }
 
 
-std::chrono::milliseconds Reactor::TimeToNextEvent() const
+std::chrono::microseconds Reactor::TimeToNextEvent() const
 {
     return std::max(
-        std::chrono::duration_cast<std::chrono::milliseconds>(
-            m_timers.front().nextEventTime - std::chrono::system_clock::now()),
-        std::chrono::milliseconds(0));
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            m_timers[m_timerHeap.front()].nextEventTime
+                - std::chrono::steady_clock::now()),
+        std::chrono::microseconds(0));
 }
 
 
-void Reactor::PerformNextEvent()
+void Reactor::CollectDueTimers(std::size_t heapPos, TimePoint now)
 {
-    assert (m_timers.front().nextEventTime <= std::chrono::system_clock::now());
-    assert (m_timers.front().remaining != 0);
+    // No event in a subtree of the heap is earlier than the one at its root,
+    // so we only visit the due timers and their immediate children.
+    if (heapPos >= m_timerHeap.size()) return;
+    const auto& timer = m_timers[m_timerHeap[heapPos]];
+    if (timer.nextEventTime > now) return;
+    m_dueTimers.push_back(std::make_pair(timer.nextEventTime, timer.id));
+    CollectDueTimers(2*heapPos + 1, now);
+    CollectDueTimers(2*heapPos + 2, now);
+}
 
-    // The handler may delete the timer, thus also deleting some information
-    // we need.  Therefore, we copy that info first.  We also need to *move*
-    // the handler function object out here, so it doesn't inadvertently delete
-    // itself.
-    const auto id = m_timers.front().id;
-    auto handler = std::move(m_timers.front().handler);
+
+void Reactor::PerformEvent(std::size_t slot)
+{
+    auto& timer = m_timers[slot];
+    assert (timer.nextEventTime <= std::chrono::steady_clock::now());
+    assert (timer.remaining != 0);
+
+    // The handler may delete the timer, or add new ones so that m_timers gets
+    // reallocated.  Therefore, we copy the info we need first.  We also need
+    // to *move* the handler function object out here, so it doesn't
+    // inadvertently delete itself.
+    const auto id = timer.id;
+    const auto eventTime = timer.nextEventTime;
+    auto handler = std::move(timer.handler);
+#ifdef CORAL_REACTOR_USE_EPOLL
+    m_epoll->sweepAll = true;
+#endif
 
     // We use a scope guard, since the handler may throw.
     auto updateTimer = coral::util::OnScopeExit([&] () {
         // The timer may already have been removed by the handler, in which case
         // we do nothing.
-        if (m_timers.front().id == id) {
-            auto t = std::move(m_timers.front());
-            t.handler = std::move(handler);
-            PopTimer(m_timers);
-            if (t.remaining > 0) --t.remaining;
-            if (t.remaining != 0) {
-                t.nextEventTime += t.interval;
-                PushTimer(m_timers, std::move(t));
-            }
+        const auto it = m_timerSlots.find(id);
+        if (it == m_timerSlots.end()) return;
+        auto& t = m_timers[it->second];
+        t.handler = std::move(handler);
+        if (t.remaining > 0) --t.remaining;
+        if (t.remaining == 0) {
+            DeleteTimer(it->second);
+        } else if (t.nextEventTime == eventTime) {
+            // The handler didn't restart the interval, so the next event
+            // follows a full interval after this one.
+            t.nextEventTime += t.interval;
+            TimerHeapUpdate(t.heapPos);
         }
     });
     (*handler)(*this, id);
@@ -269,6 +496,47 @@ void Reactor::Rebuild()
         [](const NativeSocketHandlerPair& a) { return a.first == NULL_NATIVE_SOCKET; });
     m_nativeSockets.erase(newEnd2, m_nativeSockets.end());
 
+#ifdef CORAL_REACTOR_USE_EPOLL
+    // Group the handlers by file descriptor
+    std::unordered_map<int, Epoll::Registration> registrations;
+    for (std::size_t i = 0; i < m_sockets.size(); ++i) {
+        auto& r = registrations[ZmqFD(*m_sockets[i].first)];
+        r.socket = m_sockets[i].first;
+        r.handlers.push_back(i);
+    }
+    for (std::size_t i = 0; i < m_nativeSockets.size(); ++i) {
+        auto& r = registrations[m_nativeSockets[i].first];
+        r.socket = nullptr;
+        r.handlers.push_back(i);
+    }
+
+    // Update the epoll interest list.  A file descriptor which has been
+    // closed is automatically removed from it, so deregistration may fail,
+    // and a new socket may get the same descriptor as an old one.
+    for (const auto& old : m_epoll->registrations) {
+        if (registrations.count(old.first) == 0) {
+            epoll_ctl(m_epoll->fd, EPOLL_CTL_DEL, old.first, nullptr);
+        }
+    }
+    for (const auto& r : registrations) {
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = r.first;
+        if (epoll_ctl(m_epoll->fd, EPOLL_CTL_ADD, r.first, &ev) != 0
+                && errno != EEXIST) {
+            throw std::runtime_error(coral::error::ErrnoMessage(
+                "Failed to register socket with epoll", errno));
+        }
+    }
+
+    m_epoll->registrations.swap(registrations);
+    m_epoll->zmqRegistrations.clear();
+    for (const auto& r : m_epoll->registrations) {
+        if (r.second.socket) m_epoll->zmqRegistrations.push_back(&r.second);
+    }
+    m_epoll->events.resize(std::max<std::size_t>(1, m_epoll->registrations.size()));
+    m_epoll->sweepAll = true;
+#else
     // Rebuild m_pollItems
     m_pollItems.clear();
     for (const auto& s : m_sockets) {
@@ -279,21 +547,122 @@ void Reactor::Rebuild()
         zmq::pollitem_t pi = { nullptr, s.first, ZMQ_POLLIN, 0 };
         m_pollItems.push_back(pi);
     }
+#endif
     m_needsRebuild = false;
 }
 
 
-Reactor::Timer::Timer(
-    int id_,
-    TimePoint nextEventTime_,
-    std::chrono::milliseconds interval_,
-    int remaining_,
-    std::unique_ptr<TimerHandler> handler_)
-    : id(id_),
-      nextEventTime(nextEventTime_),
-      interval(interval_),
-      remaining(remaining_),
-      handler(std::move(handler_))
+#ifdef CORAL_REACTOR_USE_EPOLL
+
+bool Reactor::Poll(long timeout)
+{
+    auto& ep = *m_epoll;
+    ep.readySockets.clear();
+    ep.readyNativeSockets.clear();
+
+    // Look for sockets with incoming messages which may not wake us up
+    // (see Epoll::sweepAll).
+    if (ep.sweepAll) {
+        for (const auto r : ep.zmqRegistrations) {
+            if (HasIncoming(*r->socket)) AppendHandlers(r->handlers, ep.readySockets);
+        }
+        ep.sweepAll = false;
+    }
+    if (!ep.readySockets.empty()) timeout = 0;
+
+    const auto n = epoll_wait(
+        ep.fd,
+        ep.events.data(),
+        static_cast<int>(ep.events.size()),
+        static_cast<int>(std::min<long>(timeout, INT_MAX)));
+    if (n < 0) {
+        if (errno == EINTR) return !ep.readySockets.empty();
+        throw std::runtime_error(coral::error::ErrnoMessage(
+            "Failed to wait for epoll events", errno));
+    }
+    for (int i = 0; i < n; ++i) {
+        const auto& r = ep.registrations.at(ep.events[i].data.fd);
+        if (r.socket == nullptr) {
+            AppendHandlers(r.handlers, ep.readyNativeSockets);
+        } else if (HasIncoming(*r.socket)) {
+            AppendHandlers(r.handlers, ep.readySockets);
+        }
+    }
+    return !ep.readySockets.empty() || !ep.readyNativeSockets.empty();
+}
+
+
+bool Reactor::Dispatch()
+{
+    auto& ep = *m_epoll;
+
+    // Handlers are called in the order they were added, as with zmq::poll().
+    SortUnique(ep.readySockets);
+    SortUnique(ep.readyNativeSockets);
+    if (!ep.readySockets.empty() || !ep.readyNativeSockets.empty()) {
+        ep.sweepAll = true;
+    }
+    for (const auto i : ep.readySockets) {
+        if (m_sockets[i].first != nullptr) {
+            (*m_sockets[i].second)(*this, *m_sockets[i].first);
+            if (!m_running) return false;
+        }
+    }
+    for (const auto i : ep.readyNativeSockets) {
+        if (m_nativeSockets[i].first != NULL_NATIVE_SOCKET) {
+            (*m_nativeSockets[i].second)(*this, m_nativeSockets[i].first);
+            if (!m_running) return false;
+        }
+    }
+    return true;
+}
+
+#else
+
+bool Reactor::Poll(long timeout)
+{
+    assert(m_pollItems.size() == m_sockets.size() + m_nativeSockets.size());
+    return zmq::poll(m_pollItems.data(), m_pollItems.size(), timeout) > 0;
+}
+
+
+bool Reactor::Dispatch()
+{
+    // More sockets may be added by the handler functions, so we
+    // need to store the current sizes for use in the loops below.
+    const auto socketCount = m_sockets.size();
+    const auto nativeSocketCount = m_nativeSockets.size();
+    assert(m_pollItems.size() == socketCount + nativeSocketCount);
+
+    std::size_t j = 0;
+    for (std::size_t i = 0; i < socketCount; ++i, ++j) {
+        assert(j < m_pollItems.size());
+        if ((m_pollItems[j].revents & ZMQ_POLLIN) && m_sockets[i].first != nullptr) {
+            (*m_sockets[i].second)(*this, *m_sockets[i].first);
+            if (!m_running) return false;
+        }
+    }
+    for (std::size_t i = 0; i < nativeSocketCount; ++i, ++j) {
+        assert(j < m_pollItems.size());
+        if ((m_pollItems[j].revents & ZMQ_POLLIN) && m_nativeSockets[i].first != NULL_NATIVE_SOCKET) {
+            (*m_nativeSockets[i].second)(*this, m_nativeSockets[i].first);
+            if (!m_running) return false;
+        }
+    }
+    assert(j == m_pollItems.size());
+    return true;
+}
+
+#endif // CORAL_REACTOR_USE_EPOLL
+
+
+Reactor::Timer::Timer()
+    : id(invalidTimerID),
+      nextEventTime(),
+      interval(0),
+      remaining(0),
+      handler(),
+      heapPos(0)
 {
 }
 
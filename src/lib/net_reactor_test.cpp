@@ -1,4 +1,12 @@
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
 #include <thread>
+#include <vector>
+#ifndef _WIN32
+#   include <unistd.h>
+#endif
 #include <gtest/gtest.h>
 #include <coral/net/reactor.hpp>
 
@@ -138,6 +146,111 @@ TEST(coral_net, Reactor_bug39)
 }
 
 
+// Many sockets, each with several queued messages of which the handler only
+// receives one at a time, and replies that may consume ZMQ_FD edges.
+TEST(coral_net, Reactor_ManySockets)
+{
+    const int SOCKET_COUNT = 500;
+    const int MSG_COUNT = 3;
+
+    zmq::context_t ctx;
+    std::vector<std::unique_ptr<zmq::socket_t>> servers;
+    std::vector<std::unique_ptr<zmq::socket_t>> clients;
+    for (int i = 0; i < SOCKET_COUNT; ++i) {
+        const auto endpoint = "inproc://coral_net_Reactor_ManySockets_" + std::to_string(i);
+        servers.push_back(std::make_unique<zmq::socket_t>(ctx, ZMQ_PAIR));
+        servers.back()->bind(endpoint);
+        clients.push_back(std::make_unique<zmq::socket_t>(ctx, ZMQ_PAIR));
+        clients.back()->connect(endpoint);
+    }
+
+    Reactor reactor;
+    int received = 0;
+    for (const auto& server : servers) {
+        reactor.AddSocket(*server, [&] (Reactor& r, zmq::socket_t& s) {
+            zmq::message_t msg;
+            s.recv(&msg);
+            s.send("", 0);
+            if (++received == SOCKET_COUNT * MSG_COUNT) r.Stop();
+        });
+    }
+    for (const auto& client : clients) {
+        for (int k = 0; k < MSG_COUNT; ++k) client->send("x", 1);
+    }
+    bool timedOut = false;
+    reactor.AddTimer(std::chrono::seconds(10), 1, [&] (Reactor& r, int) {
+        timedOut = true;
+        r.Stop();
+    });
+    reactor.Run();
+    EXPECT_FALSE(timedOut);
+    EXPECT_EQ(SOCKET_COUNT * MSG_COUNT, received);
+}
+
+
+#ifndef _WIN32
+TEST(coral_net, Reactor_NativeSocket)
+{
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+
+    Reactor reactor;
+    int received = 0;
+    reactor.AddNativeSocket(fds[0], [&] (Reactor& r, Reactor::NativeSocket s) {
+        char c;
+        ASSERT_EQ(1, read(s, &c, 1));
+        if (++received == 3) r.RemoveNativeSocket(s);
+    });
+    reactor.AddTimer(std::chrono::milliseconds(5), 3, [&] (Reactor&, int) {
+        ASSERT_EQ(1, write(fds[1], "x", 1));
+    });
+    // Returns when the socket has been removed and the timer has expired.
+    reactor.Run();
+    EXPECT_EQ(3, received);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+
+TEST(coral_net, Reactor_BusyPoll)
+{
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+
+    Reactor reactor;
+    reactor.SetSpinBudget(std::chrono::seconds(1));
+    int received = 0;
+    reactor.AddNativeSocket(fds[0], [&] (Reactor& r, Reactor::NativeSocket s) {
+        char c;
+        ASSERT_EQ(1, read(s, &c, 1));
+        ++received;
+        r.RemoveNativeSocket(s);
+    });
+    // The spinning must stop in time for timer events.
+    bool timerTriggered = false;
+    reactor.AddTimer(std::chrono::milliseconds(10), 1, [&] (Reactor&, int) {
+        timerTriggered = true;
+    });
+    std::thread writer([&] () {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ASSERT_EQ(1, write(fds[1], "x", 1));
+    });
+    reactor.Run();
+    writer.join();
+    close(fds[0]);
+    close(fds[1]);
+
+    EXPECT_TRUE(timerTriggered);
+    EXPECT_EQ(1, received);
+    const auto& stats = reactor.PollStats();
+    EXPECT_EQ(1u, stats.spinWakeups);
+    EXPECT_EQ(0u, stats.sleepWakeups);
+    EXPECT_GE(stats.spinTime, std::chrono::milliseconds(15));
+    EXPECT_EQ(std::chrono::nanoseconds(0), stats.sleepTime);
+}
+#endif
+
+
 TEST(coral_net, Reactor_RestartTimerInterval)
 {
     Reactor reactor;
@@ -181,3 +294,168 @@ TEST(coral_net, Reactor_autostop)
     reactor.Run();
     EXPECT_EQ(2, count);
 }
+
+
+TEST(coral_net, Reactor_RestartTimerIntervalFromHandler)
+{
+    Reactor reactor;
+    int count = 0;
+    reactor.AddTimer(std::chrono::milliseconds(10), 3, [&] (Reactor& r, int id) {
+        ++count;
+        r.RestartTimerInterval(id);
+    });
+    const auto t0 = std::chrono::steady_clock::now();
+    reactor.Run();
+    const auto elapsed = std::chrono::steady_clock::now() - t0;
+    EXPECT_EQ(3, count);
+    EXPECT_GE(elapsed, std::chrono::milliseconds(30));
+}
+
+
+TEST(coral_net, Reactor_SubmillisecondTimer)
+{
+    const auto interval = std::chrono::microseconds(200);
+    Reactor reactor;
+    std::vector<std::chrono::steady_clock::time_point> events;
+    reactor.AddTimer(interval, 25, [&] (Reactor&, int) {
+        events.push_back(std::chrono::steady_clock::now());
+    });
+    const auto t0 = std::chrono::steady_clock::now();
+    reactor.Run();
+    ASSERT_EQ(25u, events.size());
+    // Events are never early.  The schedule doesn't drift either, since each
+    // event is scheduled a whole number of intervals after the start.
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        EXPECT_GE(events[i] - t0, static_cast<int>(i + 1) * interval);
+    }
+}
+
+
+TEST(coral_net, Reactor_ZeroIntervalTimer)
+{
+    zmq::context_t ctx;
+    zmq::socket_t svr(ctx, ZMQ_PULL);
+    svr.bind("inproc://coral_net_Reactor_ZeroIntervalTimer");
+    zmq::socket_t cli(ctx, ZMQ_PUSH);
+    cli.connect("inproc://coral_net_Reactor_ZeroIntervalTimer");
+    cli.send("x", 1);
+
+    // A timer with a zero interval is due again immediately after each
+    // event, but the socket must still be polled in between.
+    const int maxEvents = 1000000;
+    Reactor reactor;
+    int timerEvents = 0;
+    reactor.AddTimer(std::chrono::milliseconds(0), -1, [&] (Reactor& r, int) {
+        if (++timerEvents == maxEvents) r.Stop();
+    });
+    bool received = false;
+    reactor.AddSocket(svr, [&] (Reactor& r, zmq::socket_t& s) {
+        char c;
+        s.recv(&c, 1);
+        received = true;
+        r.Stop();
+    });
+    reactor.Run();
+    EXPECT_TRUE(received);
+    EXPECT_LT(timerEvents, maxEvents);
+}
+
+
+TEST(coral_net, Reactor_ManyTimers)
+{
+    const int TIMER_COUNT = 10000;
+    const int OP_COUNT = 200000;
+
+    Reactor reactor;
+    std::vector<int> ids;
+    for (int i = 0; i < TIMER_COUNT; ++i) {
+        ids.push_back(reactor.AddTimer(
+            std::chrono::seconds(1 + i % 10),
+            -1,
+            [] (Reactor&, int) { }));
+    }
+
+    // Restart and replace random timers, like a master which resets a
+    // per-slave timeout on every reply and adds a new one for each command.
+    std::mt19937 rng;
+    std::uniform_int_distribution<std::size_t> pick(0, TIMER_COUNT - 1);
+    for (int i = 0; i < OP_COUNT; ++i) {
+        auto& id = ids[pick(rng)];
+        if (i % 2 == 0) {
+            reactor.RestartTimerInterval(id);
+        } else {
+            reactor.RemoveTimer(id);
+            id = reactor.AddTimer(
+                std::chrono::seconds(1 + i % 10),
+                -1,
+                [] (Reactor&, int) { });
+        }
+    }
+    for (const auto id : ids) reactor.RemoveTimer(id);
+
+    // Then let thousands of short-lived timers run to completion.  Each
+    // timer's events must come in order, with none skipped or repeated.
+    std::vector<int> eventCounts(TIMER_COUNT, 0);
+    bool inOrder = true;
+    for (int i = 0; i < TIMER_COUNT; ++i) {
+        reactor.AddTimer(
+            std::chrono::microseconds(100 * (i % 50)),
+            3,
+            [i, &eventCounts, &inOrder] (Reactor&, int) {
+                ++eventCounts[i];
+                // Timers with shorter intervals are ahead of the others.
+                if (i % 50 > 0 && eventCounts[i] > eventCounts[i - 1]) {
+                    inOrder = false;
+                }
+            });
+    }
+    reactor.Run();
+    for (const auto count : eventCounts) EXPECT_EQ(3, count);
+    EXPECT_TRUE(inOrder);
+}
+
+
+// A microbenchmark of timer maintenance with many active timers.  The
+// average cost of restarting a timer, and of cancelling one and adding a
+// replacement, in nanoseconds, is reported as a test property (see
+// --gtest_output) rather than checked, since it depends entirely on the
+// machine and its load.
+TEST(coral_net, Reactor_ManyTimersCost)
+{
+    const int TIMER_COUNT = 10000;
+    const int OP_COUNT = 100000;
+
+    Reactor reactor;
+    std::vector<int> ids;
+    for (int i = 0; i < TIMER_COUNT; ++i) {
+        ids.push_back(reactor.AddTimer(
+            std::chrono::seconds(1 + i % 10),
+            -1,
+            [] (Reactor&, int) { }));
+    }
+    std::mt19937 rng;
+    std::uniform_int_distribution<std::size_t> pick(0, TIMER_COUNT - 1);
+    std::vector<std::size_t> picks;
+    for (int i = 0; i < OP_COUNT; ++i) picks.push_back(pick(rng));
+
+    const auto t0 = std::chrono::steady_clock::now();
+    for (const auto p : picks) reactor.RestartTimerInterval(ids[p]);
+    const auto t1 = std::chrono::steady_clock::now();
+    for (const auto p : picks) {
+        reactor.RemoveTimer(ids[p]);
+        ids[p] = reactor.AddTimer(
+            std::chrono::seconds(1 + p % 10),
+            -1,
+            [] (Reactor&, int) { });
+    }
+    const auto t2 = std::chrono::steady_clock::now();
+    for (const auto id : ids) reactor.RemoveTimer(id);
+
+    const auto nsPerOp = [OP_COUNT] (std::chrono::steady_clock::duration d) {
+        return static_cast<int>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()
+            / OP_COUNT);
+    };
+    RecordProperty("RestartNsPerTimer", nsPerOp(t1 - t0));
+    RecordProperty("CancelAndAddNsPerTimer", nsPerOp(t2 - t1));
+}
@@ -45,6 +45,49 @@ bool coral::net::zmqx::WaitForIncoming(
 }
 
 
+bool coral::net::zmqx::WaitForIncoming(
+    zmq::socket_t& socket,
+    std::chrono::milliseconds timeout,
+    std::chrono::microseconds spinBudget,
+    coral::net::BusyPollStats* stats)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    auto t1 = t0;
+    if (spinBudget > std::chrono::microseconds(0)) {
+        const auto spinEnd = t0 + (timeout >= std::chrono::milliseconds(0)
+            ? std::min<std::chrono::microseconds>(spinBudget, timeout)
+            : spinBudget);
+        for (;;) {
+            // Reading ZMQ_EVENTS never blocks.
+            int events = 0;
+            std::size_t len = sizeof(events);
+            socket.getsockopt(ZMQ_EVENTS, &events, &len);
+            t1 = std::chrono::steady_clock::now();
+            if (events & ZMQ_POLLIN) {
+                if (stats) {
+                    stats->spinTime += t1 - t0;
+                    ++stats->spinWakeups;
+                }
+                return true;
+            }
+            if (t1 >= spinEnd) break;
+        }
+        if (stats) stats->spinTime += t1 - t0;
+        if (timeout >= std::chrono::milliseconds(0)) {
+            timeout = std::max(
+                timeout - std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0),
+                std::chrono::milliseconds(0));
+        }
+    }
+    const auto ready = PollSingleSocket(socket, ZMQ_POLLIN, timeout);
+    if (stats) {
+        stats->sleepTime += std::chrono::steady_clock::now() - t1;
+        ++stats->sleepWakeups;
+    }
+    return ready;
+}
+
+
 namespace
 {
     void SendFrames(
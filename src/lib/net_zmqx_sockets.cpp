@@ -216,6 +216,7 @@ void RepSocket::Close()
         m_socket.reset();
         m_boundEndpoint = coral::net::Endpoint{};
         m_clientEnvelope.clear();
+        m_lastClientEnvelope.clear();
     }
 }
 
@@ -241,6 +242,16 @@ namespace
             throw std::runtime_error("Invalid incoming message (not enough frames)");
         }
     }
+
+    void CopyFrames(
+        std::vector<zmq::message_t>& source,
+        std::vector<zmq::message_t>& target)
+    {
+        target.resize(source.size());
+        for (std::size_t i = 0; i < source.size(); ++i) {
+            target[i].copy(&source[i]);
+        }
+    }
 }
 
 
@@ -252,6 +263,7 @@ void RepSocket::Receive(std::vector<zmq::message_t>& msg)
     std::vector<zmq::message_t> clientEnvelope;
     RecvEnvelope(*m_socket, clientEnvelope);
     coral::net::zmqx::Receive(*m_socket, msg);
+    CopyFrames(clientEnvelope, m_lastClientEnvelope);
     m_clientEnvelope = std::move(clientEnvelope);
 }
 
@@ -269,6 +281,20 @@ void RepSocket::Send(std::vector<zmq::message_t>& msg)
 }
 
 
+void RepSocket::SendToLastClient(std::vector<zmq::message_t>& msg)
+{
+    if (!m_socket) {
+        throw std::logic_error("Socket not bound/connected");
+    }
+    CORAL_PRECONDITION_CHECK(!m_lastClientEnvelope.empty());
+    CORAL_INPUT_CHECK(!msg.empty());
+    std::vector<zmq::message_t> envelope;
+    CopyFrames(m_lastClientEnvelope, envelope);
+    coral::net::zmqx::Send(*m_socket, envelope, coral::net::zmqx::SendFlag::more);
+    coral::net::zmqx::Send(*m_socket, msg);
+}
+
+
 zmq::socket_t& RepSocket::Socket()
 {
     return *m_socket;
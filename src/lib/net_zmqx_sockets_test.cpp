@@ -132,3 +132,29 @@ TEST(coral_net, ReqRepSocketOutOfOrder)
     EXPECT_EQ(12U, m[0].size());
     EXPECT_EQ(0, std::memcmp(m[0].data(), "out of order", 5));
 }
+
+
+TEST(coral_net, RepSocketSendToLastClient)
+{
+    ReqSocket cli;
+    RepSocket svr;
+    svr.Bind(coral::net::Endpoint{"inproc://RepSocketSendToLastClient"});
+    cli.Connect(coral::net::Endpoint{"inproc://RepSocketSendToLastClient"});
+
+    RequestReplyTest(cli, svr);
+
+    // The request has been replied to, but we can still send to the client.
+    std::vector<zmq::message_t> m;
+    m.push_back(zmq::message_t(7));
+    std::memcpy(m[0].data(), "unasked", 7);
+    svr.SendToLastClient(m);
+    EXPECT_TRUE(m.empty());
+
+    cli.Receive(m);
+    ASSERT_EQ(1U, m.size());
+    ASSERT_EQ(7U, m[0].size());
+    EXPECT_EQ(0, std::memcmp(m[0].data(), "unasked", 7));
+
+    // Ordinary request-reply still works afterwards.
+    RequestReplyTest(cli, svr);
+}
@@ -6,6 +6,12 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 */
 #include <coral/protocol/exe_data.hpp>
 
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+#include <boost/numeric/conversion/cast.hpp>
+
 #include <coral/error.hpp>
 #include <coral/protobuf.hpp>
 #include <coral/protocol/glue.hpp>
@@ -24,15 +30,20 @@ namespace ed = coral::protocol::exe_data;
 
 
 namespace {
-    coral::model::Variable ParseHeader(const zmq::message_t& msg)
+    coral::model::Variable ParseHeader(const char* data, std::size_t size)
     {
-        if (msg.size() != ed::HEADER_SIZE) {
+        if (size != ed::HEADER_SIZE) {
             throw coral::error::ProtocolViolationException(
                 "Invalid header frame");
         }
         return coral::model::Variable(
-            coral::util::DecodeUint16(static_cast<const char*>(msg.data())),
-            coral::util::DecodeUint32(static_cast<const char*>(msg.data()) + 2));
+            coral::util::DecodeUint16(data),
+            coral::util::DecodeUint32(data + 2));
+    }
+
+    coral::model::Variable ParseHeader(const zmq::message_t& msg)
+    {
+        return ParseHeader(static_cast<const char*>(msg.data()), msg.size());
     }
 
     void CreateRawHeader(
@@ -96,3 +107,416 @@ void ed::Unsubscribe(zmq::socket_t& socket, const coral::model::Variable& variab
     CreateRawHeader(variable, header);
     socket.setsockopt(ZMQ_UNSUBSCRIBE, header, HEADER_SIZE);
 }
+
+
+bool ed::IsBatchMessage(const std::vector<zmq::message_t>& rawMsg)
+{
+    return !rawMsg.empty()
+        && rawMsg[0].size() == HEADER_SIZE
+        && coral::util::DecodeUint32(
+            static_cast<const char*>(rawMsg[0].data()) + 2) == BATCH_VARIABLE_ID;
+}
+
+
+void ed::ParseBatchMessage(
+    const std::vector<zmq::message_t>& rawMsg,
+    ed::BatchMessage& message)
+{
+    if (rawMsg.size() != 2) {
+        throw coral::error::ProtocolViolationException(
+            "Wrong number of frames");
+    }
+    const auto header = ParseHeader(rawMsg[0]);
+    if (header.ID() != BATCH_VARIABLE_ID) {
+        throw coral::error::ProtocolViolationException(
+            "Not a batch message");
+    }
+    coralproto::exe_data::TimestampedValueBatch batch;
+    coral::protobuf::ParseFromFrame(rawMsg[1], batch);
+    message.slaveID = header.Slave();
+    message.timestepID = batch.timestep_id();
+    message.values.clear();
+    for (const auto& entry : batch.entry()) {
+        message.values.emplace_back(
+            entry.variable_id(),
+            coral::protocol::FromProto(entry.value()));
+    }
+}
+
+
+void ed::CreateBatchMessage(
+    const ed::BatchMessage& message,
+    std::vector<zmq::message_t>& rawOut)
+{
+    CORAL_PRECONDITION_CHECK(message.slaveID != coral::model::INVALID_SLAVE_ID);
+    rawOut.clear();
+    rawOut.push_back(CreateHeader(
+        coral::model::Variable(message.slaveID, BATCH_VARIABLE_ID)));
+    coralproto::exe_data::TimestampedValueBatch batch;
+    batch.set_timestep_id(message.timestepID);
+    for (const auto& value : message.values) {
+        auto entry = batch.add_entry();
+        entry->set_variable_id(value.first);
+        coral::protocol::ConvertToProto(value.second, *entry->mutable_value());
+    }
+    rawOut.emplace_back();
+    coral::protobuf::SerializeToFrame(batch, rawOut[1]);
+}
+
+
+void ed::SubscribeBatch(zmq::socket_t& socket, coral::model::SlaveID slaveID)
+{
+    Subscribe(socket, coral::model::Variable(slaveID, BATCH_VARIABLE_ID));
+}
+
+
+void ed::UnsubscribeBatch(zmq::socket_t& socket, coral::model::SlaveID slaveID)
+{
+    Unsubscribe(socket, coral::model::Variable(slaveID, BATCH_VARIABLE_ID));
+}
+
+
+
+// =============================================================================
+// Binary encoding
+// =============================================================================
+
+namespace
+{
+    const std::size_t BINARY_SINGLE_PREFIX_SIZE = 1 + 4;
+    const std::size_t BINARY_BATCH_PREFIX_SIZE = 1 + 4 + 4;
+
+    // Visitor which computes the encoded size of a value, including type tag
+    class EncodedSize : public boost::static_visitor<std::size_t>
+    {
+    public:
+        std::size_t operator()(double) const { return 1 + 8; }
+        std::size_t operator()(int) const { return 1 + 4; }
+        std::size_t operator()(bool) const { return 1 + 1; }
+        std::size_t operator()(const std::string& s) const
+        {
+            return 1 + 4 + s.size();
+        }
+    };
+
+    // Visitor which encodes a value, including type tag, and advances the
+    // buffer pointer.
+    class EncodeValue : public boost::static_visitor<>
+    {
+    public:
+        explicit EncodeValue(char*& buf) : m_buf(buf) { }
+
+        void operator()(double value) const
+        {
+            *m_buf++ = static_cast<char>(coral::model::REAL_DATATYPE);
+            std::uint64_t bits;
+            static_assert(sizeof bits == sizeof value, "Unsupported double format");
+            std::memcpy(&bits, &value, sizeof bits);
+            coral::util::EncodeUint64(bits, m_buf);
+            m_buf += 8;
+        }
+
+        void operator()(int value) const
+        {
+            *m_buf++ = static_cast<char>(coral::model::INTEGER_DATATYPE);
+            coral::util::EncodeUint32(static_cast<std::uint32_t>(value), m_buf);
+            m_buf += 4;
+        }
+
+        void operator()(bool value) const
+        {
+            *m_buf++ = static_cast<char>(coral::model::BOOLEAN_DATATYPE);
+            *m_buf++ = value ? 1 : 0;
+        }
+
+        void operator()(const std::string& value) const
+        {
+            *m_buf++ = static_cast<char>(coral::model::STRING_DATATYPE);
+            coral::util::EncodeUint32(
+                boost::numeric_cast<std::uint32_t>(value.size()),
+                m_buf);
+            m_buf += 4;
+            std::memcpy(m_buf, value.data(), value.size());
+            m_buf += value.size();
+        }
+
+    private:
+        char*& m_buf;
+    };
+
+    [[noreturn]] void Truncated()
+    {
+        throw coral::error::ProtocolViolationException(
+            "Binary variable data message is truncated");
+    }
+}
+
+
+bool ed::IsBinaryMessage(const std::vector<zmq::message_t>& rawMsg)
+{
+    return rawMsg.size() == 2
+        && rawMsg[1].size() > 0
+        && static_cast<std::uint8_t>(*static_cast<const char*>(rawMsg[1].data()))
+            == BINARY_FORMAT_VERSION;
+}
+
+
+void ed::CreateBinaryMessage(
+    const ed::Message& message,
+    std::vector<zmq::message_t>& rawOut)
+{
+    rawOut.clear();
+    rawOut.push_back(CreateHeader(message.variable));
+    rawOut.emplace_back(
+        BINARY_SINGLE_PREFIX_SIZE
+        + boost::apply_visitor(EncodedSize(), message.value));
+    auto buf = static_cast<char*>(rawOut.back().data());
+    *buf++ = static_cast<char>(BINARY_FORMAT_VERSION);
+    coral::util::EncodeUint32(static_cast<std::uint32_t>(message.timestepID), buf);
+    buf += 4;
+    boost::apply_visitor(EncodeValue(buf), message.value);
+    assert(buf == static_cast<char*>(rawOut.back().data()) + rawOut.back().size());
+}
+
+
+void ed::CreateBinaryBatchMessage(
+    const ed::BatchMessage& message,
+    std::vector<zmq::message_t>& rawOut)
+{
+    CORAL_PRECONDITION_CHECK(message.slaveID != coral::model::INVALID_SLAVE_ID);
+    std::size_t size = BINARY_BATCH_PREFIX_SIZE;
+    for (const auto& value : message.values) {
+        size += 4 + boost::apply_visitor(EncodedSize(), value.second);
+    }
+    rawOut.clear();
+    rawOut.push_back(CreateHeader(
+        coral::model::Variable(message.slaveID, BATCH_VARIABLE_ID)));
+    rawOut.emplace_back(size);
+    auto buf = static_cast<char*>(rawOut.back().data());
+    *buf++ = static_cast<char>(BINARY_FORMAT_VERSION);
+    coral::util::EncodeUint32(static_cast<std::uint32_t>(message.timestepID), buf);
+    buf += 4;
+    coral::util::EncodeUint32(
+        boost::numeric_cast<std::uint32_t>(message.values.size()),
+        buf);
+    buf += 4;
+    for (const auto& value : message.values) {
+        coral::util::EncodeUint32(value.first, buf);
+        buf += 4;
+        boost::apply_visitor(EncodeValue(buf), value.second);
+    }
+    assert(buf == static_cast<char*>(rawOut.back().data()) + rawOut.back().size());
+}
+
+
+namespace
+{
+    template<typename T>
+    void EncodeColumn(const coral::model::ValueColumn<T>& column, char*& buf)
+    {
+        const EncodeValue encode(buf);
+        for (std::size_t i = 0; i < column.Size(); ++i) {
+            coral::util::EncodeUint32(column.ID(i), buf);
+            buf += 4;
+            encode(column.Value(i));
+        }
+    }
+}
+
+
+void ed::CreateBinaryBatchMessage(
+    coral::model::SlaveID slaveID,
+    coral::model::StepID timestepID,
+    const coral::model::ValueBlock& values,
+    std::vector<zmq::message_t>& rawOut)
+{
+    CORAL_PRECONDITION_CHECK(slaveID != coral::model::INVALID_SLAVE_ID);
+    const auto& strings = values.Strings();
+    std::size_t size = BINARY_BATCH_PREFIX_SIZE
+        + values.Reals().Size() * (4 + 1 + 8)
+        + values.Integers().Size() * (4 + 1 + 4)
+        + values.Booleans().Size() * (4 + 1 + 1)
+        + strings.Size() * (4 + 1 + 4);
+    for (std::size_t i = 0; i < strings.Size(); ++i) {
+        size += strings.Value(i).size();
+    }
+    rawOut.clear();
+    rawOut.push_back(CreateHeader(
+        coral::model::Variable(slaveID, BATCH_VARIABLE_ID)));
+    rawOut.emplace_back(size);
+    auto buf = static_cast<char*>(rawOut.back().data());
+    *buf++ = static_cast<char>(BINARY_FORMAT_VERSION);
+    coral::util::EncodeUint32(static_cast<std::uint32_t>(timestepID), buf);
+    buf += 4;
+    coral::util::EncodeUint32(
+        boost::numeric_cast<std::uint32_t>(values.Size()),
+        buf);
+    buf += 4;
+    EncodeColumn(values.Reals(), buf);
+    EncodeColumn(values.Integers(), buf);
+    EncodeColumn(values.Booleans(), buf);
+    EncodeColumn(strings, buf);
+    assert(buf == static_cast<char*>(rawOut.back().data()) + rawOut.back().size());
+}
+
+
+ed::BinaryMessageReader::BinaryMessageReader(
+    const std::vector<zmq::message_t>& rawMsg)
+{
+    if (!IsBinaryMessage(rawMsg)) {
+        throw coral::error::ProtocolViolationException(
+            "Not a binary variable data message");
+    }
+    Init(
+        static_cast<const char*>(rawMsg[0].data()), rawMsg[0].size(),
+        static_cast<const char*>(rawMsg[1].data()), rawMsg[1].size());
+}
+
+
+ed::BinaryMessageReader::BinaryMessageReader(
+    const char* header,
+    std::size_t headerSize,
+    const char* body,
+    std::size_t bodySize)
+{
+    if (bodySize == 0
+            || static_cast<std::uint8_t>(*body) != BINARY_FORMAT_VERSION) {
+        throw coral::error::ProtocolViolationException(
+            "Not a binary variable data message");
+    }
+    Init(header, headerSize, body, bodySize);
+}
+
+
+void ed::BinaryMessageReader::Init(
+    const char* header,
+    std::size_t headerSize,
+    const char* body,
+    std::size_t bodySize)
+{
+    m_next = nullptr;
+    m_end = nullptr;
+    m_batch = false;
+    m_remaining = 0;
+    m_slaveID = coral::model::INVALID_SLAVE_ID;
+    m_stepID = coral::model::INVALID_STEP_ID;
+    m_variableID = 0;
+    m_dataType = coral::model::REAL_DATATYPE;
+    m_data = nullptr;
+    m_dataSize = 0;
+
+    const auto var = ParseHeader(header, headerSize);
+    m_slaveID = var.Slave();
+    m_batch = var.ID() == BATCH_VARIABLE_ID;
+
+    m_next = body;
+    m_end = m_next + bodySize;
+    const auto prefixSize =
+        m_batch ? BINARY_BATCH_PREFIX_SIZE : BINARY_SINGLE_PREFIX_SIZE;
+    if (bodySize < prefixSize) Truncated();
+    ++m_next; // skip version
+    m_stepID = static_cast<coral::model::StepID>(coral::util::DecodeUint32(m_next));
+    m_next += 4;
+    if (m_batch) {
+        m_remaining = coral::util::DecodeUint32(m_next);
+        m_next += 4;
+    } else {
+        m_variableID = var.ID();
+        m_remaining = 1;
+    }
+}
+
+
+bool ed::BinaryMessageReader::Next()
+{
+    if (m_remaining == 0) {
+        if (m_next != m_end) {
+            throw coral::error::ProtocolViolationException(
+                "Binary variable data message has trailing data");
+        }
+        return false;
+    }
+    if (m_batch) {
+        if (m_end - m_next < 4) Truncated();
+        m_variableID = coral::util::DecodeUint32(m_next);
+        m_next += 4;
+    }
+    if (m_end - m_next < 1) Truncated();
+    m_dataType = static_cast<coral::model::DataType>(*m_next++);
+    switch (m_dataType) {
+        case coral::model::REAL_DATATYPE:
+            m_dataSize = 8;
+            break;
+        case coral::model::INTEGER_DATATYPE:
+            m_dataSize = 4;
+            break;
+        case coral::model::BOOLEAN_DATATYPE:
+            m_dataSize = 1;
+            break;
+        case coral::model::STRING_DATATYPE:
+            if (m_end - m_next < 4) Truncated();
+            m_dataSize = coral::util::DecodeUint32(m_next);
+            m_next += 4;
+            break;
+        default:
+            throw coral::error::ProtocolViolationException(
+                "Invalid data type in binary variable data message");
+    }
+    if (static_cast<std::size_t>(m_end - m_next) < m_dataSize) Truncated();
+    m_data = m_next;
+    m_next += m_dataSize;
+    --m_remaining;
+    return true;
+}
+
+
+double ed::BinaryMessageReader::RealValue() const
+{
+    CORAL_PRECONDITION_CHECK(m_dataType == coral::model::REAL_DATATYPE);
+    const auto bits = coral::util::DecodeUint64(m_data);
+    double value;
+    std::memcpy(&value, &bits, sizeof value);
+    return value;
+}
+
+
+int ed::BinaryMessageReader::IntegerValue() const
+{
+    CORAL_PRECONDITION_CHECK(m_dataType == coral::model::INTEGER_DATATYPE);
+    return static_cast<int>(coral::util::DecodeUint32(m_data));
+}
+
+
+bool ed::BinaryMessageReader::BooleanValue() const
+{
+    CORAL_PRECONDITION_CHECK(m_dataType == coral::model::BOOLEAN_DATATYPE);
+    return *m_data != 0;
+}
+
+
+const char* ed::BinaryMessageReader::StringData() const
+{
+    CORAL_PRECONDITION_CHECK(m_dataType == coral::model::STRING_DATATYPE);
+    return m_data;
+}
+
+
+std::size_t ed::BinaryMessageReader::StringSize() const
+{
+    CORAL_PRECONDITION_CHECK(m_dataType == coral::model::STRING_DATATYPE);
+    return m_dataSize;
+}
+
+
+coral::model::ScalarValue ed::BinaryMessageReader::Value() const
+{
+    switch (m_dataType) {
+        case coral::model::REAL_DATATYPE:    return RealValue();
+        case coral::model::INTEGER_DATATYPE: return IntegerValue();
+        case coral::model::BOOLEAN_DATATYPE: return BooleanValue();
+        case coral::model::STRING_DATATYPE:
+            return std::string(StringData(), StringSize());
+    }
+    assert(!"Invalid data type");
+    return coral::model::ScalarValue();
+}
@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <coral/error.hpp>
 #include <coral/protocol/exe_data.hpp>
 
 namespace ed = coral::protocol::exe_data;
@@ -18,3 +19,141 @@ TEST(coral_protocol_exe_data, CreateAndParse)
     EXPECT_EQ(msg.value,      msg2.value);
     EXPECT_EQ(msg.timestepID, msg2.timestepID);
 }
+
+
+TEST(coral_protocol_exe_data, CreateAndParseBatch)
+{
+    ed::BatchMessage msg;
+    msg.slaveID = 123;
+    msg.timestepID = 100;
+    msg.values.emplace_back(456, 3.14);
+    msg.values.emplace_back(789, std::string("foo"));
+
+    std::vector<zmq::message_t> raw;
+    ed::CreateBatchMessage(msg, raw);
+    EXPECT_TRUE(ed::IsBatchMessage(raw));
+
+    ed::BatchMessage msg2;
+    ed::ParseBatchMessage(raw, msg2);
+    EXPECT_EQ(msg.slaveID,    msg2.slaveID);
+    EXPECT_EQ(msg.timestepID, msg2.timestepID);
+    EXPECT_EQ(msg.values,     msg2.values);
+
+    ed::Message single;
+    single.variable = coral::model::Variable(123, 456);
+    single.value = 3.14;
+    single.timestepID = 100;
+    ed::CreateMessage(single, raw);
+    EXPECT_FALSE(ed::IsBatchMessage(raw));
+}
+
+
+TEST(coral_protocol_exe_data, CreateAndParseBinary)
+{
+    ed::Message msg;
+    msg.variable = coral::model::Variable(123, 456);
+    msg.value = std::string("Hello");
+    msg.timestepID = 100;
+
+    std::vector<zmq::message_t> raw;
+    ed::CreateBinaryMessage(msg, raw);
+    EXPECT_TRUE(ed::IsBinaryMessage(raw));
+    EXPECT_FALSE(ed::IsBatchMessage(raw));
+
+    ed::BinaryMessageReader reader(raw);
+    EXPECT_EQ(123, reader.Slave());
+    EXPECT_EQ(100, reader.TimestepID());
+    ASSERT_TRUE(reader.Next());
+    EXPECT_EQ(456U, reader.VariableID());
+    EXPECT_EQ(coral::model::STRING_DATATYPE, reader.DataType());
+    EXPECT_EQ("Hello", std::string(reader.StringData(), reader.StringSize()));
+    EXPECT_EQ(msg.value, reader.Value());
+    EXPECT_FALSE(reader.Next());
+
+    ed::CreateMessage(msg, raw);
+    EXPECT_FALSE(ed::IsBinaryMessage(raw));
+}
+
+
+TEST(coral_protocol_exe_data, CreateAndParseBinaryBatch)
+{
+    ed::BatchMessage msg;
+    msg.slaveID = 123;
+    msg.timestepID = -1;
+    msg.values.emplace_back(1, 3.14);
+    msg.values.emplace_back(2, -42);
+    msg.values.emplace_back(3, true);
+    msg.values.emplace_back(4, std::string());
+    msg.values.emplace_back(5, std::string("foo"));
+
+    std::vector<zmq::message_t> raw;
+    ed::CreateBinaryBatchMessage(msg, raw);
+    EXPECT_TRUE(ed::IsBinaryMessage(raw));
+    EXPECT_TRUE(ed::IsBatchMessage(raw));
+
+    ed::BinaryMessageReader reader(raw);
+    EXPECT_EQ(123, reader.Slave());
+    EXPECT_EQ(-1, reader.TimestepID());
+    ASSERT_TRUE(reader.Next());
+    EXPECT_EQ(1U, reader.VariableID());
+    EXPECT_EQ(3.14, reader.RealValue());
+    ASSERT_TRUE(reader.Next());
+    EXPECT_EQ(2U, reader.VariableID());
+    EXPECT_EQ(-42, reader.IntegerValue());
+    EXPECT_THROW(reader.RealValue(), coral::error::PreconditionViolation);
+    ASSERT_TRUE(reader.Next());
+    EXPECT_EQ(3U, reader.VariableID());
+    EXPECT_TRUE(reader.BooleanValue());
+    ASSERT_TRUE(reader.Next());
+    EXPECT_EQ(4U, reader.VariableID());
+    EXPECT_EQ(0U, reader.StringSize());
+    ASSERT_TRUE(reader.Next());
+    EXPECT_EQ(5U, reader.VariableID());
+    EXPECT_EQ(msg.values.back().second, reader.Value());
+    EXPECT_FALSE(reader.Next());
+
+    // Truncated message
+    const auto& body = raw[1];
+    raw[1] = zmq::message_t(body.data(), body.size() - 1);
+    ed::BinaryMessageReader badReader(raw);
+    for (int i = 0; i < 4; ++i) ASSERT_TRUE(badReader.Next());
+    EXPECT_THROW(badReader.Next(), coral::error::ProtocolViolationException);
+}
+
+
+TEST(coral_protocol_exe_data, CreateBinaryBatchFromBlock)
+{
+    coral::model::ValueBlock block;
+    block.Add(1, std::string("foo"));
+    block.Add(2, false);
+    block.Add(3, 7);
+    block.Add(4, 2.5);
+    block.Add(5, 3.5);
+
+    std::vector<zmq::message_t> raw;
+    ed::CreateBinaryBatchMessage(123, 10, block, raw);
+    EXPECT_TRUE(ed::IsBinaryMessage(raw));
+    EXPECT_TRUE(ed::IsBatchMessage(raw));
+
+    // The values are ordered by data type
+    ed::BinaryMessageReader reader(raw);
+    EXPECT_EQ(123, reader.Slave());
+    EXPECT_EQ(10, reader.TimestepID());
+    ASSERT_TRUE(reader.Next());
+    EXPECT_EQ(4U, reader.VariableID());
+    EXPECT_EQ(2.5, reader.RealValue());
+    ASSERT_TRUE(reader.Next());
+    EXPECT_EQ(5U, reader.VariableID());
+    EXPECT_EQ(3.5, reader.RealValue());
+    ASSERT_TRUE(reader.Next());
+    EXPECT_EQ(3U, reader.VariableID());
+    EXPECT_EQ(7, reader.IntegerValue());
+    ASSERT_TRUE(reader.Next());
+    EXPECT_EQ(2U, reader.VariableID());
+    EXPECT_FALSE(reader.BooleanValue());
+    ASSERT_TRUE(reader.Next());
+    EXPECT_EQ(1U, reader.VariableID());
+    EXPECT_EQ(std::string("foo"),
+        std::string(reader.StringData(), reader.StringSize()));
+    EXPECT_FALSE(reader.Next());
+}
@@ -13,6 +13,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include <zmq.hpp>
 
 #include <coral/bus/slave_provider_comm.hpp>
+#include <coral/bus/sub_master.hpp>
 #include <coral/error.hpp>
 #include <coral/net/reactor.hpp>
 #include <coral/net/service.hpp>
@@ -32,8 +33,10 @@ namespace
     {
     public:
         MySlaveProviderOps(
-            std::vector<std::unique_ptr<SlaveCreator>>&& slaveTypes)
+            std::vector<std::unique_ptr<SlaveCreator>>&& slaveTypes,
+            const coral::net::Endpoint& subMasterEndpoint)
             : m_slaveTypes(std::move(slaveTypes))
+            , m_subMasterEndpoint(subMasterEndpoint)
         {
         }
 
@@ -64,11 +67,18 @@ namespace
             if (!(*st)->Instantiate(timeout, loc)) {
                 throw std::runtime_error((*st)->InstantiationFailureDescription());
             }
+            if (!m_subMasterEndpoint.Transport().empty()) {
+                loc = coral::net::SlaveLocator{
+                    loc.ControlEndpoint(),
+                    loc.DataPubEndpoint(),
+                    m_subMasterEndpoint};
+            }
             return loc;
         }
 
     private:
         const std::vector<std::unique_ptr<SlaveCreator>> m_slaveTypes;
+        const coral::net::Endpoint m_subMasterEndpoint;
     };
 
 
@@ -82,6 +92,7 @@ namespace
         std::shared_ptr<zmq::socket_t> killSocket;
         std::shared_ptr<coral::net::reqrep::Server> server;
         std::shared_ptr<coral::net::service::Beacon> beacon;
+        std::shared_ptr<coral::bus::SubMaster> subMaster;
     };
 
     void BackgroundThreadFunction(
@@ -107,7 +118,8 @@ SlaveProvider::SlaveProvider(
     std::vector<std::unique_ptr<SlaveCreator>>&& slaveTypes,
     const coral::net::ip::Address& networkInterface,
     coral::net::ip::Port discoveryPort,
-    std::function<void(std::exception_ptr)> exceptionHandler)
+    std::function<void(std::exception_ptr)> exceptionHandler,
+    bool enableSubMaster)
 {
     CORAL_INPUT_CHECK(!slaveProviderID.empty());
 
@@ -127,12 +139,22 @@ SlaveProvider::SlaveProvider(
         *bg.killSocket,
         [] (coral::net::Reactor& r, zmq::socket_t&) { r.Stop(); });
 
+    coral::net::Endpoint subMasterEndpoint;
+    if (enableSubMaster) {
+        bg.subMaster = std::make_shared<coral::bus::SubMaster>(
+            *bg.reactor,
+            coral::net::ip::Endpoint{networkInterface, "*"}.ToEndpoint("tcp"));
+        subMasterEndpoint = bg.subMaster->BoundEndpoint();
+    }
+
     bg.server = std::make_shared<coral::net::reqrep::Server>(
         *bg.reactor,
         coral::net::ip::Endpoint{networkInterface, "*"}.ToEndpoint("tcp"));
     coral::bus::MakeSlaveProviderServer(
         *bg.server,
-        std::make_shared<MySlaveProviderOps>(std::move(slaveTypes)));
+        std::make_shared<MySlaveProviderOps>(
+            std::move(slaveTypes),
+            subMasterEndpoint));
 
     char beaconPayload[2];
     coral::util::EncodeUint16(
@@ -0,0 +1,177 @@
+/*
+Copyright 2013-present, SINTEF Ocean.
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+#include <coral/slave/instance.hpp>
+
+
+namespace coral
+{
+namespace slave
+{
+
+
+// =============================================================================
+// Instance
+// =============================================================================
+
+
+void Instance::GetRealVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    double* values) const
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        values[i] = GetRealVariable(variables[i]);
+    }
+}
+
+
+void Instance::GetIntegerVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    int* values) const
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        values[i] = GetIntegerVariable(variables[i]);
+    }
+}
+
+
+void Instance::GetBooleanVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    bool* values) const
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        values[i] = GetBooleanVariable(variables[i]);
+    }
+}
+
+
+void Instance::GetStringVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    std::string* values) const
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        values[i] = GetStringVariable(variables[i]);
+    }
+}
+
+
+bool Instance::SetRealVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    const double* values)
+{
+    bool allGood = true;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!SetRealVariable(variables[i], values[i])) allGood = false;
+    }
+    return allGood;
+}
+
+
+bool Instance::SetIntegerVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    const int* values)
+{
+    bool allGood = true;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!SetIntegerVariable(variables[i], values[i])) allGood = false;
+    }
+    return allGood;
+}
+
+
+bool Instance::SetBooleanVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    const bool* values)
+{
+    bool allGood = true;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!SetBooleanVariable(variables[i], values[i])) allGood = false;
+    }
+    return allGood;
+}
+
+
+bool Instance::SetStringVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    const std::string* values)
+{
+    bool allGood = true;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!SetStringVariable(variables[i], values[i])) allGood = false;
+    }
+    return allGood;
+}
+
+
+// =============================================================================
+// Free functions
+// =============================================================================
+
+
+void GetVariables(const Instance& instance, coral::model::ValueBlock& values)
+{
+    auto& reals = values.Reals();
+    if (!reals.Empty()) {
+        instance.GetRealVariables(reals.IDs(), reals.Size(), reals.Values());
+    }
+    auto& integers = values.Integers();
+    if (!integers.Empty()) {
+        instance.GetIntegerVariables(
+            integers.IDs(), integers.Size(), integers.Values());
+    }
+    auto& booleans = values.Booleans();
+    if (!booleans.Empty()) {
+        instance.GetBooleanVariables(
+            booleans.IDs(), booleans.Size(), booleans.Values());
+    }
+    auto& strings = values.Strings();
+    if (!strings.Empty()) {
+        instance.GetStringVariables(
+            strings.IDs(), strings.Size(), strings.Values());
+    }
+}
+
+
+bool SetVariables(Instance& instance, const coral::model::ValueBlock& values)
+{
+    bool allGood = true;
+    const auto& reals = values.Reals();
+    if (!reals.Empty()
+            && !instance.SetRealVariables(
+                reals.IDs(), reals.Size(), reals.Values())) {
+        allGood = false;
+    }
+    const auto& integers = values.Integers();
+    if (!integers.Empty()
+            && !instance.SetIntegerVariables(
+                integers.IDs(), integers.Size(), integers.Values())) {
+        allGood = false;
+    }
+    const auto& booleans = values.Booleans();
+    if (!booleans.Empty()
+            && !instance.SetBooleanVariables(
+                booleans.IDs(), booleans.Size(), booleans.Values())) {
+        allGood = false;
+    }
+    const auto& strings = values.Strings();
+    if (!strings.Empty()
+            && !instance.SetStringVariables(
+                strings.IDs(), strings.Size(), strings.Values())) {
+        allGood = false;
+    }
+    return allGood;
+}
+
+
+}} // namespace
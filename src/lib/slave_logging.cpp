@@ -32,12 +32,46 @@ LoggingInstance::LoggingInstance(
 }
 
 
-coral::model::SlaveTypeDescription LoggingInstance::TypeDescription() const
+const coral::model::SlaveTypeDescription& LoggingInstance::TypeDescription() const
 {
     return m_instance->TypeDescription();
 }
 
 
+namespace
+{
+    // Adds a variable to `values` and records the position of its value.
+    void AddToBlock(
+        const coral::model::VariableDescription& varInfo,
+        coral::model::ValueBlock& values,
+        std::vector<std::pair<coral::model::DataType, std::size_t>>& positions)
+    {
+        std::size_t index = 0;
+        switch (varInfo.DataType()) {
+            case coral::model::REAL_DATATYPE:
+                index = values.Reals().Size();
+                values.Reals().Add(varInfo.ID(), 0.0);
+                break;
+            case coral::model::INTEGER_DATATYPE:
+                index = values.Integers().Size();
+                values.Integers().Add(varInfo.ID(), 0);
+                break;
+            case coral::model::BOOLEAN_DATATYPE:
+                index = values.Booleans().Size();
+                values.Booleans().Add(varInfo.ID(), false);
+                break;
+            case coral::model::STRING_DATATYPE:
+                index = values.Strings().Size();
+                values.Strings().Add(varInfo.ID(), std::string());
+                break;
+            default:
+                assert (false);
+        }
+        positions.emplace_back(varInfo.DataType(), index);
+    }
+}
+
+
 void LoggingInstance::Setup(
     const std::string& slaveName,
     const std::string& executionName,
@@ -82,9 +116,11 @@ void LoggingInstance::Setup(
     }
 
     m_outputStream << "Time";
-    const auto typeDescription  = TypeDescription();
-    for (const auto& var : typeDescription.Variables()) {
+    m_values.Clear();
+    m_printOrder.clear();
+    for (const auto& var : TypeDescription().Variables()) {
         m_outputStream << "," << var.Name();
+        AddToBlock(var, m_values, m_printOrder);
     }
     m_outputStream << std::endl;
 }
@@ -106,22 +142,23 @@ namespace
 {
     void PrintVariable(
         std::ostream& out,
-        const coral::model::VariableDescription& varInfo,
-        Instance& slaveInstance)
+        const coral::model::ValueBlock& values,
+        const std::pair<coral::model::DataType, std::size_t>& position)
     {
         out << ",";
-        switch (varInfo.DataType()) {
+        const auto i = position.second;
+        switch (position.first) {
             case coral::model::REAL_DATATYPE:
-                out << slaveInstance.GetRealVariable(varInfo.ID());
+                out << values.Reals().Value(i);
                 break;
             case coral::model::INTEGER_DATATYPE:
-                out << slaveInstance.GetIntegerVariable(varInfo.ID());
+                out << values.Integers().Value(i);
                 break;
             case coral::model::BOOLEAN_DATATYPE:
-                out << slaveInstance.GetBooleanVariable(varInfo.ID());
+                out << values.Booleans().Value(i);
                 break;
             case coral::model::STRING_DATATYPE:
-                out << slaveInstance.GetStringVariable(varInfo.ID());
+                out << values.Strings().Value(i);
                 break;
             default:
                 assert (false);
@@ -137,9 +174,9 @@ bool LoggingInstance::DoStep(
     const auto ret = m_instance->DoStep(currentT, deltaT);
 
     m_outputStream << std::fixed << (currentT + deltaT) << std::defaultfloat;
-    const auto typeDescription = TypeDescription();
-    for (const auto& var : typeDescription.Variables()) {
-        PrintVariable(m_outputStream, var, *this);
+    GetVariables(*m_instance, m_values);
+    for (const auto& position : m_printOrder) {
+        PrintVariable(m_outputStream, m_values, position);
     }
     m_outputStream << std::endl;
 
@@ -195,4 +232,76 @@ bool LoggingInstance::SetStringVariable(coral::model::VariableID varRef, const s
 }
 
 
+void LoggingInstance::GetRealVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    double* values) const
+{
+    m_instance->GetRealVariables(variables, count, values);
+}
+
+
+void LoggingInstance::GetIntegerVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    int* values) const
+{
+    m_instance->GetIntegerVariables(variables, count, values);
+}
+
+
+void LoggingInstance::GetBooleanVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    bool* values) const
+{
+    m_instance->GetBooleanVariables(variables, count, values);
+}
+
+
+void LoggingInstance::GetStringVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    std::string* values) const
+{
+    m_instance->GetStringVariables(variables, count, values);
+}
+
+
+bool LoggingInstance::SetRealVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    const double* values)
+{
+    return m_instance->SetRealVariables(variables, count, values);
+}
+
+
+bool LoggingInstance::SetIntegerVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    const int* values)
+{
+    return m_instance->SetIntegerVariables(variables, count, values);
+}
+
+
+bool LoggingInstance::SetBooleanVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    const bool* values)
+{
+    return m_instance->SetBooleanVariables(variables, count, values);
+}
+
+
+bool LoggingInstance::SetStringVariables(
+    const coral::model::VariableID* variables,
+    std::size_t count,
+    const std::string* values)
+{
+    return m_instance->SetStringVariables(variables, count, values);
+}
+
+
 }} // namespace
@@ -78,4 +78,19 @@ void Runner::Run()
 }
 
 
+void Runner::SetSpinBudget(std::chrono::microseconds spinBudget)
+{
+    m_reactor->SetSpinBudget(spinBudget);
+    m_slaveAgent->SetSpinBudget(spinBudget);
+}
+
+
+coral::net::BusyPollStats Runner::PollStats() const
+{
+    auto stats = m_reactor->PollStats();
+    stats += m_slaveAgent->PollStats();
+    return stats;
+}
+
+
 }} // namespace
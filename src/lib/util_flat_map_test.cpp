@@ -0,0 +1,50 @@
+#include <stdexcept>
+#include <string>
+#include <gtest/gtest.h>
+#include <coral/util/flat_map.hpp>
+
+
+TEST(coral_util, FlatMap)
+{
+    coral::util::FlatMap<int, std::string> map;
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(map.end(), map.find(1));
+    EXPECT_THROW(map.at(1), std::out_of_range);
+
+    EXPECT_TRUE(map.insert(std::make_pair(3, "three")).second);
+    EXPECT_TRUE(map.insert(std::make_pair(1, "one")).second);
+    const auto dup = map.insert(std::make_pair(3, "drei"));
+    EXPECT_FALSE(dup.second);
+    EXPECT_EQ("three", dup.first->second);
+    map[2] = "two";
+    EXPECT_EQ(3U, map.size());
+    EXPECT_EQ("three", map[3]);
+    EXPECT_EQ(3U, map.size());
+
+    // Elements are sorted by key
+    int expectedKey = 1;
+    for (const auto& e : map) {
+        EXPECT_EQ(expectedKey, e.first);
+        ++expectedKey;
+    }
+    EXPECT_EQ("one", map.at(1));
+    EXPECT_EQ(1U, map.count(2));
+    EXPECT_EQ(0U, map.count(4));
+
+    const auto& cmap = map;
+    ASSERT_NE(cmap.end(), cmap.find(2));
+    EXPECT_EQ("two", cmap.find(2)->second);
+    EXPECT_EQ("two", cmap.at(2));
+
+    EXPECT_EQ(1U, map.erase(2));
+    EXPECT_EQ(0U, map.erase(2));
+    const auto next = map.erase(map.find(1));
+    ASSERT_NE(map.end(), next);
+    EXPECT_EQ(3, next->first);
+    EXPECT_EQ(1U, map.size());
+
+    auto moved = std::move(map);
+    EXPECT_EQ(1U, moved.size());
+    moved.clear();
+    EXPECT_TRUE(moved.empty());
+}
@@ -175,6 +175,24 @@ std::string Archive::EntryName(EntryIndex index) const
 }
 
 
+namespace
+{
+    // Obtains information about an archive entry, and checks that the
+    // fields indicated by `valid` are available.
+    struct zip_stat Stat(::zip* archive, EntryIndex index, zip_uint64_t valid)
+    {
+        struct zip_stat zs;
+        if (zip_stat_index(archive, index, 0, &zs)) {
+            throw Exception(archive);
+        }
+        if ((zs.valid & valid) != valid) {
+            throw Exception("Archive entry information not available");
+        }
+        return zs;
+    }
+}
+
+
 bool Archive::IsDirEntry(EntryIndex index) const
 {
     CORAL_PRECONDITION_CHECK(IsOpen());
@@ -191,6 +209,20 @@ bool Archive::IsDirEntry(EntryIndex index) const
 }
 
 
+std::uint64_t Archive::EntrySize(EntryIndex index) const
+{
+    CORAL_PRECONDITION_CHECK(IsOpen());
+    return Stat(m_archive, index, ZIP_STAT_SIZE).size;
+}
+
+
+std::uint32_t Archive::EntryCRC(EntryIndex index) const
+{
+    CORAL_PRECONDITION_CHECK(IsOpen());
+    return Stat(m_archive, index, ZIP_STAT_CRC).crc;
+}
+
+
 namespace
 {
     void Copy(
@@ -55,6 +55,14 @@ TEST(coral_util_zip, Archive)
     ASSERT_FALSE(archive.IsDirEntry(binIndex));
     ASSERT_FALSE(archive.IsDirEntry(txtIndex));
     ASSERT_THROW(archive.IsDirEntry(invIndex), dz::Exception);
+    ASSERT_EQ(0u, archive.EntrySize(dirIndex));
+    ASSERT_EQ(binSize, archive.EntrySize(binIndex));
+    ASSERT_EQ(txtSize, archive.EntrySize(txtIndex));
+    ASSERT_THROW(archive.EntrySize(invIndex), dz::Exception);
+    ASSERT_EQ(0u, archive.EntryCRC(dirIndex));
+    ASSERT_EQ(0x306ab0c4u, archive.EntryCRC(binIndex));
+    ASSERT_EQ(0x15a2a343u, archive.EntryCRC(txtIndex));
+    ASSERT_THROW(archive.EntryCRC(invIndex), dz::Exception);
 
     // Extract entire archive
     {
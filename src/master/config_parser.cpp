@@ -127,6 +127,7 @@ namespace
         coral::model::VariableID inputId;
         std::string otherSlaveName;
         coral::model::VariableID otherOutputId;
+        int delay;
     };
 
     // Variable name lookup could take a long time for slave types with a
@@ -251,10 +252,15 @@ namespace
                     if (outputVarDesc->Causality() != coral::model::OUTPUT_CAUSALITY) {
                         throw std::runtime_error("Not an output variable: " + outputVarDesc->Name());
                     }
+                    const auto delay = connNode.second.get<int>("delay", 0);
+                    if (delay < 0) {
+                        throw std::runtime_error("Negative delay");
+                    }
                     VariableConnection vc;
                     vc.inputId = inputVarDesc->ID();
                     vc.otherSlaveName = outputSpec.first;
                     vc.otherOutputId = outputVarDesc->ID();
+                    vc.delay = delay;
                     connections[inputSpec.first].push_back(vc);
 
                     if (warningLog) {
@@ -457,7 +463,8 @@ void ParseSystemConfig(
                 conn.inputId,
                 coral::model::Variable(
                     slaveIDs.at(conn.otherSlaveName),
-                    conn.otherOutputId));
+                    conn.otherOutputId),
+                conn.delay);
         }
     }
     try {
@@ -524,7 +531,8 @@ ExecutionConfig::ExecutionConfig()
       stepSize(1.0),
       commTimeout(std::chrono::seconds(1)),
       stepTimeoutMultiplier(100.0),
-      instantiationTimeout(std::chrono::seconds(30))
+      instantiationTimeout(std::chrono::seconds(30)),
+      variableEncoding(coral::bus::PROTOBUF_VARIABLE_ENCODING)
 {
 }
 
@@ -571,5 +579,16 @@ ExecutionConfig ParseExecutionConfig(const std::string& path)
             Error("Invalid instantiation_timeout_ms");
         }
     }
+
+    if (auto encodingNode = ptree.get_child_optional("variable_encoding")) {
+        const auto encoding = encodingNode->get_value<std::string>();
+        if (encoding == "protobuf") {
+            ec.variableEncoding = coral::bus::PROTOBUF_VARIABLE_ENCODING;
+        } else if (encoding == "binary") {
+            ec.variableEncoding = coral::bus::BINARY_VARIABLE_ENCODING;
+        } else {
+            Error("Invalid variable_encoding: " + encoding);
+        }
+    }
     return ec;
 }
@@ -110,6 +110,9 @@ struct ExecutionConfig
     node.
     */
     std::chrono::milliseconds instantiationTimeout;
+
+    /// The encoding of variable values exchanged between slaves.
+    coral::bus::VariableEncoding variableEncoding;
 };
 
 
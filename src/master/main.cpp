@@ -76,7 +76,15 @@ namespace {
             "; or because its instantiation routine is very demanding.\n"
             "; -1 is a special value which means \"wait indefinitely\", which should\n"
             "; only be used for debugging purposes.\n"
-            "instantiation_timeout_ms 10000\n";
+            "instantiation_timeout_ms 10000\n"
+            "\n"
+            "; Encoding of variable values exchanged between slaves (optional,\n"
+            "; defaults to \"protobuf\").\n"
+            ";\n"
+            "; \"binary\" is a compact encoding which is cheaper to process, and\n"
+            "; which is recommended for simulations with very short time steps.\n"
+            "; It is only used if all slaves support it.\n"
+            "variable_encoding binary\n";
     }
 
     void PrintSysConfigHelp()
@@ -112,8 +120,11 @@ namespace {
             ";     <slave A>.<input variable> <slave B>.<output variable>\n"
             "; (To make the order easier to remember, mentally insert an \"equals\" sign\n"
             "; between them.)\n"
+            "; A connection may optionally be given a delay, in time steps.  The input\n"
+            "; then receives the output value from that many steps earlier, which lets\n"
+            "; the receiving slave get ahead of the sending one.\n"
             "connections {\n"
-            "    mass.force        spring.force\n"
+            "    mass.force        spring.force { delay 1 }\n"
             "    spring.position_b mass.position\n"
             "}\n"
             "\n"
@@ -141,6 +152,12 @@ int Run(const std::vector<std::string>& args)
             ("debug-pause",
                 "Wait for a user keypress after slaves have been spawned, "
                 "to allow time to attach a debugger.")
+            ("decentralized,d",
+                "Let the slaves perform time steps on their own, as soon as "
+                "they have received their inputs, rather than waiting for the "
+                "master to tell them to.  The master only steps in at scenario "
+                "events.  This requires all slaves to support it, and cannot "
+                "be combined with --realtime.")
             ("interface", po::value<std::string>()->default_value(DEFAULT_NETWORK_INTERFACE),
                 "The IP address or (OS-specific) name of the network interface to "
                 "use for network communications, or \"*\" for all/any.")
@@ -198,6 +215,7 @@ int Run(const std::vector<std::string>& args)
         const auto execConfigFile = (*argValues)["exec-config"].as<std::string>();
         const auto sysConfigFile = (*argValues)["sys-config"].as<std::string>();
         const auto debugPause= !!argValues->count("debug-pause");
+        const auto decentralized = !!argValues->count("decentralized");
         const auto networkInterface = coral::net::ip::Address{
             (*argValues)["interface"].as<std::string>()};
         const auto execName = (*argValues)["name"].as<std::string>();
@@ -205,6 +223,10 @@ int Run(const std::vector<std::string>& args)
             (*argValues)["port"].as<std::uint16_t>()};
         const auto realtimeMultiplier = (*argValues)["realtime"].as<double>();
         const auto warningStream = argValues->count("warnings") ? &std::clog : nullptr;
+        if (decentralized && realtimeMultiplier > 0.0) {
+            throw std::runtime_error(
+                "--decentralized cannot be combined with --realtime");
+        }
 
         auto providers = coral::master::ProviderCluster{
             networkInterface,
@@ -223,6 +245,7 @@ int Run(const std::vector<std::string>& args)
         execOptions.startTime                   = execConfig.startTime;
         execOptions.maxTime                     = execConfig.stopTime;
         execOptions.slaveVariableRecvTimeout    = execConfig.commTimeout;
+        execOptions.variableEncoding            = execConfig.variableEncoding;
 
         std::cout << "Creating new execution" << std::endl;
         auto exec = coral::master::Execution(execName, execOptions);
@@ -287,10 +310,8 @@ int Run(const std::vector<std::string>& args)
                     wallClockStepSize).count());
         }
 
-        for (double time = execConfig.startTime;
-             time < maxTime;
-             time += execConfig.stepSize)
-        {
+        // Applies the scenario events which are due at or before `time`.
+        const auto applyScenarioEvents = [&] (double time) {
             if (!scenario.empty() && scenario.top().timePoint <= time) {
                 std::vector<coral::master::SlaveConfig> settings;
                 std::map<coral::model::SlaveID, std::size_t> indexes;
@@ -312,13 +333,11 @@ int Run(const std::vector<std::string>& args)
                 }
                 exec.Reconfigure(settings, execConfig.commTimeout);
             }
-            if (exec.Step(execConfig.stepSize, stepTimeout) != coral::master::StepResult::completed) {
-                throw std::runtime_error("One or more slaves failed to perform the time step");
-            }
-            exec.AcceptStep(execConfig.commTimeout);
+        };
 
-            // Print how far we've gotten in the simulation and how fast it's
-            // going.
+        // Prints how far we've gotten in the simulation and how fast it's
+        // going.
+        const auto printProgress = [&] (double time) {
             if ((time-execConfig.startTime)/(execConfig.stopTime-execConfig.startTime) >= nextPerc) {
                 const auto realTime = std::chrono::high_resolution_clock::now();
                 const auto rti = (time - prevSimTime)
@@ -328,10 +347,72 @@ int Run(const std::vector<std::string>& args)
                 prevRealTime = realTime;
                 prevSimTime = time;
             }
+        };
+
+        if (decentralized) {
+            // The slaves run freely between scenario events.  They report
+            // their progress about every 1% of the simulation, which is
+            // plenty for the 5% progress printouts.
+            const auto progressInterval = std::max(1, static_cast<int>(
+                0.01 * (execConfig.stopTime - execConfig.startTime)
+                    / execConfig.stepSize));
+            double time = execConfig.startTime;
+            while (time < maxTime) {
+                applyScenarioEvents(time);
+                int stepCount = 0;
+                double segmentEnd = time;
+                while (segmentEnd < maxTime
+                        && (scenario.empty() || scenario.top().timePoint > segmentEnd)) {
+                    ++stepCount;
+                    segmentEnd += execConfig.stepSize;
+                }
+                exec.RunDecentralized(
+                    execConfig.stepSize,
+                    stepCount,
+                    progressInterval * stepTimeout,
+                    progressInterval,
+                    [&] (coral::model::TimePoint t) {
+                        printProgress(t - execConfig.stepSize);
+                        return true;
+                    });
+                time = segmentEnd;
+            }
+        } else if (realtimeMultiplier <= 0.0) {
+            // Let the execution run the whole loop in its own thread.
+            coral::master::RunOptions runOptions;
+            runOptions.stepTimeout = stepTimeout;
+            runOptions.commTimeout = execConfig.commTimeout;
+            while (!scenario.empty()) {
+                const auto& scenEvent = scenario.top();
+                runOptions.scenario.emplace_back(
+                    scenEvent.timePoint,
+                    scenEvent.slave,
+                    coral::model::VariableSetting(
+                        scenEvent.variable,
+                        scenEvent.newValue));
+                scenario.pop();
+            }
+            runOptions.onProgress = [&] (coral::model::TimePoint t) {
+                printProgress(t - execConfig.stepSize);
+                return true;
+            };
+            exec.RunUntil(execConfig.stopTime, execConfig.stepSize, runOptions);
+        } else {
+            for (double time = execConfig.startTime;
+                 time < maxTime;
+                 time += execConfig.stepSize)
+            {
+                applyScenarioEvents(time);
+                if (exec.Step(execConfig.stepSize, stepTimeout) != coral::master::StepResult::completed) {
+                    throw std::runtime_error("One or more slaves failed to perform the time step");
+                }
+                exec.AcceptStep(execConfig.commTimeout);
+                printProgress(time);
 
-            if (realtimeMultiplier > 0.0) {
-                targetWallClockTime += wallClockStepSize;
-                std::this_thread::sleep_until(targetWallClockTime);
+                if (realtimeMultiplier > 0.0) {
+                    targetWallClockTime += wallClockStepSize;
+                    std::this_thread::sleep_until(targetWallClockTime);
+                }
             }
         }
 
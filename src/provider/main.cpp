@@ -192,15 +192,16 @@ void ScanDirectoryForFMUs(
 int main(int argc, const char** argv)
 {
 try {
-    const auto fmuCacheDir = boost::filesystem::temp_directory_path() / "coral" / "cache";
-    auto importer = coral::fmi::Importer::Create(fmuCacheDir);
-
     namespace po = boost::program_options;
     po::options_description options("Options");
     options.add_options()
         ("clean-cache",
             "Clear the cache which contains previously unpacked FMU contents. "
             "The program will exit immediately after performing this action.")
+        ("cache-size", po::value<std::uint64_t>(),
+            "The maximum size of the cache which contains unpacked FMU contents, "
+            "in megabytes.  When it grows beyond this, the least recently used "
+            "FMUs which are not in use are removed.  The default is no limit.")
         ("interface", po::value<std::string>()->default_value(DEFAULT_NETWORK_INTERFACE),
             "The IP address or (OS-specific) name of the network interface to "
             "use for network communications, or \"*\" for all/any.")
@@ -218,6 +219,10 @@ try {
             "The master must listen on the same port.")
         ("slave-exe", po::value<std::string>(),
             "The path to the slave executable.")
+        ("sub-master",
+            "Let masters relay time step commands to the slaves on this host "
+            "through the slave provider, so that they exchange one message "
+            "with this host per time step rather than one per slave.")
         ("timeout", po::value<int>()->default_value(3600),
             "The number of seconds slaves should wait for commands from a master "
             "before assuming that the connection is broken and shutting themselves "
@@ -240,6 +245,11 @@ try {
     if (!optionValues) return 0;
 
     coral::util::UseLoggingArguments(*optionValues, MY_NAME);
+    const auto fmuCacheDir = boost::filesystem::temp_directory_path() / "coral" / "cache";
+    const auto maxCacheSize = optionValues->count("cache-size")
+        ? (*optionValues)["cache-size"].as<std::uint64_t>() * 1024 * 1024
+        : coral::fmi::Importer::UNLIMITED_CACHE_SIZE;
+    auto importer = coral::fmi::Importer::Create(fmuCacheDir, maxCacheSize);
     if (optionValues->count("clean-cache")) {
         importer->CleanCache();
         return 0;
@@ -250,6 +260,7 @@ try {
         (*optionValues)["interface"].as<std::string>()};
     const auto enableOutput = !optionValues->count("no-output");
     const auto createConsoles = !optionValues->count("no-slave-console");
+    const auto enableSubMaster = optionValues->count("sub-master") > 0;
     const auto outputDir = (*optionValues)["output-dir"].as<std::string>();
     const auto discoveryPort = coral::net::ip::Port{
         (*optionValues)["port"].as<std::uint16_t>()};
@@ -328,7 +339,8 @@ try {
                 coral::log::Log(coral::log::error, e.what());
                 std::exit(1);
             }
-        }
+        },
+        enableSubMaster
     };
     std::cout << "Press ENTER to quit" << std::flush;
     std::cin.ignore();
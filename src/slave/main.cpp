@@ -60,6 +60,11 @@ try {
             "Disable file output of variable values.")
         ("output-dir,o", po::value<std::string>()->default_value("."),
             "The directory where output files should be written.")
+        ("spin-time", po::value<int>()->default_value(0),
+            "Busy-poll for up to this many microseconds whenever waiting for "
+            "messages, before going to sleep.  This reduces latency at the "
+            "cost of CPU time, and is only sensible on machines with cores "
+            "to spare.  The default, 0, disables busy polling.")
         ("coralslaveprovider-endpoint", po::value<std::string>(),
             "For use by coralslaveprovider: An endpoint on which the provider "
             "is listening for status messages.");
@@ -107,6 +112,11 @@ try {
         (*optionValues)["interface"].as<std::string>()};
     const auto enableOutput = !optionValues->count("no-output");
     const auto outputDir = (*optionValues)["output-dir"].as<std::string>();
+    const auto spinTime =
+        std::chrono::microseconds((*optionValues)["spin-time"].as<int>());
+    if (spinTime < std::chrono::microseconds(0)) {
+        throw std::runtime_error("Invalid spin-time value");
+    }
 
     if (!optionValues->count("fmu")) {
         throw std::runtime_error("No FMU specified");
@@ -143,6 +153,7 @@ try {
         coral::net::ip::Endpoint(networkInterface, controlPort).ToEndpoint("tcp"),
         coral::net::ip::Endpoint(networkInterface, dataPort).ToEndpoint("tcp"),
         hangaroundTime);
+    slaveRunner.SetSpinBudget(spinTime);
 
     const auto controlEndpoint =
         coral::net::ip::Endpoint{slaveRunner.BoundControlEndpoint().Address()};
@@ -169,6 +180,16 @@ try {
     }
 
     slaveRunner.Run();
+    if (spinTime > std::chrono::microseconds(0)) {
+        const auto stats = slaveRunner.PollStats();
+        const auto ms = [] (std::chrono::nanoseconds t) {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(t).count();
+        };
+        coral::log::Log(coral::log::info, boost::format(
+                "Busy polling: %d ms spinning (%d wakeups), %d ms sleeping (%d wakeups)")
+            % ms(stats.spinTime) % stats.spinWakeups
+            % ms(stats.sleepTime) % stats.sleepWakeups);
+    }
     CORAL_LOG_DEBUG("Normal shutdown");
 
 } catch (const std::runtime_error& e) {